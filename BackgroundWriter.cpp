@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "BackgroundWriter.h"
+#include "Compression.h"
+#include "Stats.h"
+
+constexpr std::chrono::milliseconds BackgroundWriter::COALESCE_DELAY;
+
+namespace
+{
+    mode_t readUmask()
+    {
+        // umask can only be read by setting it, so it is read once before any thread creates files.
+        mode_t mask = ::umask(0);
+        ::umask(mask);
+        return mask;
+    }
+
+    const mode_t creationMask = readUmask();
+}
+
+BackgroundWriter::BackgroundWriter() : worker(&BackgroundWriter::run, this) {}
+
+BackgroundWriter::~BackgroundWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+void BackgroundWriter::submit(const std::string &filePath, Serializer serializer)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = pending.find(filePath);
+        if (it == pending.end())
+        {
+            pending.emplace(filePath, std::move(serializer));
+        }
+        else
+        {
+            // The replaced snapshot may be large, so it is released by the worker rather than here.
+            superseded.push_back(std::move(it->second));
+            it->second = std::move(serializer);
+        }
+    }
+    wake.notify_all();
+}
+
+void BackgroundWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    flushing++;
+    wake.notify_all();
+    idle.wait(lock, [this]
+              { return pending.empty() && writing.empty(); });
+    flushing--;
+}
+
+bool BackgroundWriter::busy(const std::string &filePath)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pending.count(filePath) > 0 || writing == filePath)
+    {
+        return true;
+    }
+    for (const auto &result : finished)
+    {
+        if (result.filePath == filePath)
+            return true;
+    }
+    return false;
+}
+
+std::vector<BackgroundWriter::Result> BackgroundWriter::collect()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Result> results;
+    results.swap(finished);
+    return results;
+}
+
+void BackgroundWriter::replaceFile(const std::string &filePath, const Serializer &serializer, ParseCache *cache)
+{
+    // The temporary file lives in the target's directory so that the rename never crosses file systems.
+    // mkostemp picks a name no other file or writer uses, and creates it with mode 0600 whatever the umask,
+    // so the mode a new file would get from open is applied by hand.
+    std::string temporary = filePath + ".XXXXXX";
+    struct stat existing;
+    mode_t permissions = stat(filePath.c_str(), &existing) == 0 ? existing.st_mode & 07777 : 0666 & ~creationMask;
+    Compressor compressor(Compressor::choose(filePath));
+
+    int fd = ::mkostemp(&temporary[0], O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Could not open file to write.");
+    }
+    if (::fchmod(fd, permissions) != 0)
+    {
+        std::string reason = std::strerror(errno);
+        ::close(fd);
+        ::unlink(temporary.c_str());
+        throw std::runtime_error("Could not set the permissions of " + filePath + ": " + reason);
+    }
+
+    size_t total = 0;
+    auto writePieces = [&](const std::vector<std::string> &pieces)
+    {
+        std::vector<struct iovec> vectors;
+        for (const auto &piece : pieces)
+        {
+            if (!piece.empty())
+                vectors.push_back({const_cast<char *>(piece.data()), piece.size()});
+            total += piece.size();
+        }
+
+        size_t first = 0;
+        while (first < vectors.size())
+        {
+            int count = static_cast<int>(std::min<size_t>(vectors.size() - first, IOV_MAX));
+            ssize_t written = ::writev(fd, &vectors[first], count);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written < 0)
+                throw std::runtime_error("Could not write " + filePath + ": " + std::strerror(errno));
+
+            // A short write leaves the remainder of a partly written piece at the front.
+            size_t left = static_cast<size_t>(written);
+            while (first < vectors.size() && left >= vectors[first].iov_len)
+                left -= vectors[first++].iov_len;
+            if (left > 0)
+            {
+                vectors[first].iov_base = static_cast<char *>(vectors[first].iov_base) + left;
+                vectors[first].iov_len -= left;
+            }
+        }
+    };
+
+    // The parse cache records the text itself, so it is fed before compression.
+    std::vector<std::string> compressed;
+    auto sink = [&](std::vector<std::string> &pieces)
+    {
+        if (cache != nullptr)
+        {
+            for (const auto &piece : pieces)
+                cache->feed(piece.data(), piece.size());
+        }
+        if (compressor.getCompression() == Compression::NONE)
+        {
+            writePieces(pieces);
+            return;
+        }
+        compressed.clear();
+        for (const auto &piece : pieces)
+            compressor.compress(piece.data(), piece.size(), compressed);
+        writePieces(compressed);
+    };
+
+    try
+    {
+        if (cache != nullptr)
+            cache->begin();
+        serializer(sink);
+        compressed.clear();
+        compressor.finish(compressed);
+        writePieces(compressed);
+        if (cache != nullptr)
+            cache->finish();
+    }
+    catch (const std::exception &)
+    {
+        ::close(fd);
+        ::unlink(temporary.c_str());
+        throw;
+    }
+
+    // The descriptor is closed whether or not fsync succeeds, and the first failure is reported.
+    bool synced = ::fsync(fd) == 0;
+    int syncError = errno;
+    bool closed = ::close(fd) == 0;
+    if (!synced)
+        errno = syncError;
+    if (!synced || !closed || ::rename(temporary.c_str(), filePath.c_str()) != 0)
+    {
+        std::string reason = std::strerror(errno);
+        ::unlink(temporary.c_str());
+        throw std::runtime_error("Could not replace " + filePath + ": " + reason);
+    }
+
+    // Flushing the directory makes the rename itself survive a crash.
+    size_t slash = filePath.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : filePath.substr(0, slash);
+    int directoryFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd >= 0)
+    {
+        ::fsync(directoryFd);
+        ::close(directoryFd);
+    }
+    JSON_STATS_ADD(BYTES_WRITTEN, total);
+}
+
+void BackgroundWriter::replaceFile(const std::string &filePath, std::string content)
+{
+    replaceFile(filePath, [&content](const Sink &sink)
+                {
+                    std::vector<std::string> pieces(1);
+                    pieces[0].swap(content);
+                    sink(pieces); });
+}
+
+void BackgroundWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this]
+                  { return stopping || !pending.empty(); });
+        if (pending.empty())
+        {
+            break;
+        }
+
+        // Give a burst of edits a moment to arrive so that they end up in one write.
+        wake.wait_for(lock, COALESCE_DELAY, [this]
+                      { return stopping || flushing > 0; });
+
+        auto job = pending.begin();
+        Result result;
+        result.filePath = job->first;
+        Serializer serializer = std::move(job->second);
+        pending.erase(job);
+        writing = result.filePath;
+        std::vector<Serializer> released;
+        released.swap(superseded);
+        lock.unlock();
+        released.clear();
+
+        try
+        {
+            replaceFile(result.filePath, serializer, &result.parseCache);
+
+            struct stat info;
+            if (stat(result.filePath.c_str(), &info) == 0)
+            {
+                result.modifiedTime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+                result.fileSize = info.st_size;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            result.error = e.what();
+        }
+        serializer = nullptr;
+
+        lock.lock();
+        writing.clear();
+        if (result.error.empty())
+        {
+            // The file state an earlier write recorded is gone from disk, so only its errors are worth reporting.
+            finished.erase(std::remove_if(finished.begin(), finished.end(), [&](const Result &earlier)
+                                          { return earlier.filePath == result.filePath && earlier.error.empty(); }),
+                           finished.end());
+        }
+        finished.push_back(std::move(result));
+        idle.notify_all();
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef BACKGROUND_WRITER_H
+#define BACKGROUND_WRITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ParseCache.h"
+
+/**
+ * Class persisting documents from a worker thread so that edits do not wait for the disk.
+ *
+ * A submitted write carries a serializer bound to an immutable snapshot of the document.
+ * Writes to the same file are coalesced: while one is waiting or being written, a newer
+ * submission replaces the waiting one, so a burst of edits produces a single write of the
+ * latest state. Files are replaced atomically by writing a temporary file next to the target,
+ * flushing it to disk and renaming it over the target, so a crash never leaves a torn file.
+ */
+class BackgroundWriter
+{
+public:
+    /**
+     * Function receiving the next pieces of a file, in order. It may take the pieces' contents.
+     */
+    using Sink = std::function<void(std::vector<std::string> &)>;
+
+    /**
+     * Function writing a snapshot as a sequence of pieces handed to a sink.
+     */
+    using Serializer = std::function<void(const Sink &)>;
+
+    /**
+     * Structure describing a finished write.
+     */
+    struct Result
+    {
+        std::string filePath;
+        std::string error;
+        int64_t modifiedTime = 0;
+        int64_t fileSize = -1;
+        ParseCache parseCache;
+    };
+
+    /**
+     * Time a write waits for further edits to the same file before it starts.
+     */
+    static constexpr std::chrono::milliseconds COALESCE_DELAY{20};
+
+    BackgroundWriter();
+
+    /**
+     * Finishes the waiting writes and stops the worker thread.
+     */
+    ~BackgroundWriter();
+
+    BackgroundWriter(const BackgroundWriter &) = delete;
+    BackgroundWriter &operator=(const BackgroundWriter &) = delete;
+
+    /**
+     * Schedules a write, replacing a write to the same file that has not started yet.
+     * @param filePath Path of the file to replace.
+     * @param serializer Function writing the snapshot.
+     */
+    void submit(const std::string &filePath, Serializer serializer);
+
+    /**
+     * Waits until every submitted write has finished.
+     */
+    void flush();
+
+    /**
+     * Checks whether a file has a write that is waiting, running, or finished but not yet collected.
+     * @param filePath Path of the file.
+     * @return True if the file's state on disk is about to change.
+     */
+    bool busy(const std::string &filePath);
+
+    /**
+     * Collects the writes finished since the last call. Of several successful writes to the
+     * same file only the last is kept, so results waiting to be collected stay few.
+     * @return Finished writes in completion order.
+     */
+    std::vector<Result> collect();
+
+    /**
+     * Replaces a file atomically with the pieces a serializer produces.
+     * Pieces are written with writev as they arrive, so the content is never assembled in one buffer.
+     * Files named .gz or .zst, or replacing a compressed file, are compressed on the fly.
+     * @param filePath Path of the file to replace.
+     * @param serializer Function producing the new content.
+     * @param cache Receives the hashes of the new content, if not null.
+     */
+    static void replaceFile(const std::string &filePath, const Serializer &serializer, ParseCache *cache = nullptr);
+
+    /**
+     * Replaces a file atomically with the given content.
+     * @param filePath Path of the file to replace.
+     * @param content New file content.
+     */
+    static void replaceFile(const std::string &filePath, std::string content);
+
+private:
+    /**
+     * Runs the worker thread.
+     */
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::map<std::string, Serializer> pending;
+    std::vector<Serializer> superseded;
+    std::string writing;
+    std::vector<Result> finished;
+    size_t flushing = 0;
+    bool stopping = false;
+    std::thread worker;
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "BinarySnapshot.h"
+
+namespace
+{
+    const char MAGIC[4] = {'J', 'S', 'N', 'B'};
+
+    void appendLength(std::string &buffer, size_t length)
+    {
+        if (length > UINT32_MAX)
+        {
+            throw std::runtime_error("Value too large for a binary snapshot.");
+        }
+        uint32_t raw = static_cast<uint32_t>(length);
+        buffer.append(reinterpret_cast<const char *>(&raw), sizeof(raw));
+    }
+
+    void require(const char *cursor, const char *end, size_t bytes)
+    {
+        if (static_cast<size_t>(end - cursor) < bytes)
+        {
+            throw std::runtime_error("Truncated binary snapshot.");
+        }
+    }
+
+    uint32_t readLength(const char *&cursor, const char *end)
+    {
+        uint32_t raw;
+        require(cursor, end, sizeof(raw));
+        std::memcpy(&raw, cursor, sizeof(raw));
+        cursor += sizeof(raw);
+        return raw;
+    }
+
+    void readString(const char *&cursor, const char *end, std::string &target)
+    {
+        uint32_t length = readLength(cursor, end);
+        require(cursor, end, length);
+        target.assign(cursor, length);
+        cursor += length;
+    }
+}
+
+bool BinarySnapshot::isSnapshot(const std::string &data)
+{
+    return data.size() > sizeof(MAGIC) && std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void BinarySnapshot::encode(const JSONValue &value, std::ostream &out)
+{
+    std::string buffer = encode(value);
+    out.write(buffer.data(), buffer.size());
+}
+
+std::string BinarySnapshot::encode(const JSONValue &value)
+{
+    std::string buffer(MAGIC, sizeof(MAGIC));
+    buffer.push_back(static_cast<char>(VERSION));
+    encodeValue(value, buffer);
+    return buffer;
+}
+
+JSONValue BinarySnapshot::decode(const std::string &data)
+{
+    if (!isSnapshot(data))
+    {
+        throw std::runtime_error("Not a binary snapshot.");
+    }
+    if (static_cast<unsigned char>(data[sizeof(MAGIC)]) != VERSION)
+    {
+        throw std::runtime_error("Unsupported binary snapshot version " + std::to_string(static_cast<unsigned char>(data[sizeof(MAGIC)])) + ".");
+    }
+
+    const char *cursor = data.data() + sizeof(MAGIC) + 1;
+    const char *end = data.data() + data.size();
+    JSONValue root;
+    decodeValue(cursor, end, root);
+    if (cursor != end)
+    {
+        throw std::runtime_error("Unexpected data at the end of the binary snapshot.");
+    }
+    return root;
+}
+
+void BinarySnapshot::encodeValue(const JSONValue &value, std::string &buffer)
+{
+    struct Frame
+    {
+        const JSONValue *value;
+        size_t next;
+    };
+
+    // Children are encoded from an explicit stack, so nesting is not limited by the call stack.
+    std::vector<Frame> open;
+    const JSONValue *current = &value;
+    while (current != nullptr)
+    {
+        buffer.push_back(static_cast<char>(current->type));
+        switch (current->type)
+        {
+        case JSONValueType::OBJECT:
+            appendLength(buffer, current->objectValue.size());
+            open.push_back({current, 0});
+            break;
+        case JSONValueType::ARRAY:
+            appendLength(buffer, current->arrayValue.size());
+            open.push_back({current, 0});
+            break;
+        case JSONValueType::STRING:
+            appendLength(buffer, current->stringValue.size());
+            buffer.append(current->stringValue);
+            break;
+        case JSONValueType::NUMBER:
+            buffer.append(reinterpret_cast<const char *>(&current->numberValue), sizeof(current->numberValue));
+            break;
+        case JSONValueType::BOOL:
+            buffer.push_back(current->boolValue ? 1 : 0);
+            break;
+        case JSONValueType::NIL:
+            break;
+        default:
+            throw std::runtime_error("Unknown JSONType encountered in encodeValue.");
+        }
+
+        current = nullptr;
+        while (current == nullptr && !open.empty())
+        {
+            Frame &frame = open.back();
+            bool isObject = frame.value->type == JSONValueType::OBJECT;
+            size_t count = isObject ? frame.value->objectValue.size() : frame.value->arrayValue.size();
+            if (frame.next == count)
+            {
+                open.pop_back();
+                continue;
+            }
+            if (isObject)
+            {
+                const KeyValue &kv = frame.value->objectValue[frame.next];
+                appendLength(buffer, kv.key.size());
+                buffer.append(kv.key);
+                current = kv.value;
+            }
+            else
+            {
+                current = frame.value->arrayValue[frame.next];
+            }
+            frame.next++;
+        }
+    }
+}
+
+void BinarySnapshot::decodeValue(const char *&cursor, const char *end, JSONValue &value)
+{
+    struct Frame
+    {
+        JSONValue *value;
+        uint32_t left;
+    };
+
+    std::vector<Frame> open;
+    JSONValue *current = &value;
+    while (current != nullptr)
+    {
+        require(cursor, end, 1);
+        unsigned char tag = static_cast<unsigned char>(*cursor++);
+        if (tag > static_cast<unsigned char>(JSONValueType::NIL))
+        {
+            throw std::runtime_error("Invalid value tag in binary snapshot.");
+        }
+        current->type = static_cast<JSONValueType>(tag);
+
+        switch (current->type)
+        {
+        case JSONValueType::OBJECT:
+        {
+            uint32_t count = readLength(cursor, end);
+            current->objectValue.reserve(std::min<size_t>(count, end - cursor));
+            open.push_back({current, count});
+            break;
+        }
+        case JSONValueType::ARRAY:
+        {
+            uint32_t count = readLength(cursor, end);
+            current->arrayValue.reserve(std::min<size_t>(count, end - cursor));
+            open.push_back({current, count});
+            break;
+        }
+        case JSONValueType::STRING:
+            readString(cursor, end, current->stringValue);
+            break;
+        case JSONValueType::NUMBER:
+            require(cursor, end, sizeof(current->numberValue));
+            std::memcpy(&current->numberValue, cursor, sizeof(current->numberValue));
+            cursor += sizeof(current->numberValue);
+            break;
+        case JSONValueType::BOOL:
+            require(cursor, end, 1);
+            current->boolValue = *cursor++ != 0;
+            break;
+        case JSONValueType::NIL:
+            break;
+        }
+
+        current = nullptr;
+        while (current == nullptr && !open.empty())
+        {
+            Frame &frame = open.back();
+            if (frame.left == 0)
+            {
+                open.pop_back();
+                continue;
+            }
+            frame.left--;
+            if (frame.value->type == JSONValueType::OBJECT)
+            {
+                frame.value->objectValue.push_back(KeyValue("", new JSONValue()));
+                readString(cursor, end, frame.value->objectValue.back().key);
+                current = frame.value->objectValue.back().value;
+            }
+            else
+            {
+                frame.value->arrayValue.push_back(new JSONValue());
+                current = frame.value->arrayValue.back();
+            }
+        }
+    }
+}
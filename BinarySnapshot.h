@@ -0,0 +1,68 @@
+#ifndef BINARY_SNAPSHOT_H
+#define BINARY_SNAPSHOT_H
+
+#include <ostream>
+#include <string>
+
+#include "JSONValue.h"
+
+/**
+ * Class responsible for the compact binary encoding of a JSONValue tree.
+ *
+ * Layout: the magic "JSNB", a version byte and the root value. Every value starts
+ * with its JSONValueType as one byte. Strings and keys are a 32-bit length followed by
+ * the bytes, numbers are the raw 8-byte double, booleans are one byte, and arrays and
+ * objects are a 32-bit element count followed by their children. All integers and
+ * doubles are stored in host (little-endian) byte order.
+ */
+class BinarySnapshot
+{
+public:
+    /**
+     * Checks whether the given data starts with a binary snapshot header.
+     * @param data File contents.
+     * @return True if the data is a binary snapshot, false otherwise.
+     */
+    static bool isSnapshot(const std::string &data);
+
+    /**
+     * Encodes a JSONValue as a binary snapshot.
+     * @param value JSONValue to be encoded.
+     * @param out Output stream.
+     */
+    static void encode(const JSONValue &value, std::ostream &out);
+
+    /**
+     * Encodes a JSONValue as a binary snapshot held in memory.
+     * @param value JSONValue to be encoded.
+     * @return Snapshot contents including the header.
+     */
+    static std::string encode(const JSONValue &value);
+
+    /**
+     * Decodes a binary snapshot.
+     * @param data Snapshot contents including the header.
+     * @return Decoded JSONValue.
+     */
+    static JSONValue decode(const std::string &data);
+
+    static const unsigned char VERSION = 1;
+
+private:
+    /**
+     * Appends the encoding of a JSONValue to a buffer.
+     * @param value JSONValue to be encoded.
+     * @param buffer Output buffer.
+     */
+    static void encodeValue(const JSONValue &value, std::string &buffer);
+
+    /**
+     * Decodes a single value starting at the cursor and advances it.
+     * @param cursor Current read position.
+     * @param end End of the data.
+     * @param value JSONValue to be filled in.
+     */
+    static void decodeValue(const char *&cursor, const char *end, JSONValue &value);
+};
+
+#endif
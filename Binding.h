@@ -0,0 +1,527 @@
+#ifndef BINDING_H
+#define BINDING_H
+
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Lexer.h"
+
+/**
+ * Structure describing one bound member of a struct: its JSON key and a pointer to the member.
+ */
+template <typename Class, typename Member>
+struct Field
+{
+    std::string_view name;
+    Member Class::*pointer;
+
+    constexpr Field(std::string_view name, Member Class::*pointer) : name(name), pointer(pointer) {}
+};
+
+/**
+ * Declares the fields of a struct for the Binding layer. Specialise it once per struct:
+ *
+ *     template <>
+ *     struct BindingFields<Office>
+ *     {
+ *         static constexpr auto fields = std::make_tuple(Field("name", &Office::name), Field("id", &Office::id));
+ *     };
+ *
+ * Members may be bool, arithmetic types, std::string, std::vector, std::optional or other bound structs.
+ */
+template <typename T>
+struct BindingFields;
+
+/**
+ * Class reading JSON straight into bound structs from the lexer token stream and writing them back,
+ * without building a JSONValue tree. Keys are looked up through a perfect hash computed at compile
+ * time from the declared field names; unknown members are skipped token by token.
+ * Errors are reported by throwing std::runtime_error, like the rest of the parser.
+ */
+class Binding
+{
+public:
+    /**
+     * Reads JSON text into a value of a bound type.
+     * @param input JSON input string.
+     * @return Value read from the input.
+     */
+    template <typename T, typename Policy = DefaultPolicy>
+    static T read(const std::string &input)
+    {
+        T value{};
+        Reader<Policy> reader(input);
+        reader.read(value);
+        reader.expectEnd();
+        return value;
+    }
+
+    /**
+     * Writes a value of a bound type as compact JSON.
+     * @param out Output stream.
+     * @param value Value to be written.
+     */
+    template <typename T>
+    static void write(std::ostream &out, const T &value)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            out << (value ? "true" : "false");
+        }
+        else if constexpr (std::is_arithmetic_v<T>)
+        {
+            out << +value;
+        }
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            out << "\"" << value << "\"";
+        }
+        else if constexpr (IsOptional<T>::value)
+        {
+            if (value)
+                write(out, *value);
+            else
+                out << "null";
+        }
+        else if constexpr (IsVector<T>::value)
+        {
+            out << "[";
+            for (size_t i = 0; i < value.size(); i++)
+            {
+                if (i > 0)
+                    out << ",";
+                write(out, value[i]);
+            }
+            out << "]";
+        }
+        else
+        {
+            static_assert(IsBound<T>::value, "Type has no BindingFields specialisation");
+            out << "{";
+            bool first = true;
+            std::apply([&](const auto &...fields)
+                       { (writeMember(out, value, fields, first), ...); },
+                       BindingFields<T>::fields);
+            out << "}";
+        }
+    }
+
+    /**
+     * Writes a value of a bound type as a compact JSON string.
+     * @param value Value to be written.
+     * @return JSON text.
+     */
+    template <typename T>
+    static std::string toString(const T &value)
+    {
+        std::ostringstream out;
+        write(out, value);
+        return out.str();
+    }
+
+private:
+    template <typename T, typename = void>
+    struct IsBound : std::false_type
+    {
+    };
+
+    template <typename T>
+    struct IsBound<T, std::void_t<decltype(BindingFields<T>::fields)>> : std::true_type
+    {
+    };
+
+    template <typename T>
+    struct IsVector : std::false_type
+    {
+    };
+
+    template <typename T>
+    struct IsVector<std::vector<T>> : std::true_type
+    {
+    };
+
+    template <typename T>
+    struct IsOptional : std::false_type
+    {
+    };
+
+    template <typename T>
+    struct IsOptional<std::optional<T>> : std::true_type
+    {
+    };
+
+    /**
+     * Hashes a key with FNV-1a mixed with a seed.
+     * @param key Key to be hashed.
+     * @param seed Seed selected for the table.
+     * @return Hash value.
+     */
+    static constexpr uint32_t hash(std::string_view key, uint32_t seed)
+    {
+        uint32_t value = 2166136261u ^ seed;
+        for (char c : key)
+        {
+            value ^= static_cast<uint8_t>(c);
+            value *= 16777619u;
+        }
+        return value ^ (value >> 15);
+    }
+
+    /**
+     * Perfect hash table mapping the field names of a bound struct to their positions.
+     * The table has at least twice as many slots as fields, and more for large structs,
+     * so a collision-free seed is found after a few attempts while compiling.
+     */
+    template <typename T>
+    struct FieldTable
+    {
+        static constexpr size_t COUNT = std::tuple_size_v<std::decay_t<decltype(BindingFields<T>::fields)>>;
+        static_assert(COUNT < 0xFFFF, "Too many bound fields");
+
+        static constexpr size_t slotCount()
+        {
+            size_t size = 1;
+            while (size < 2 * COUNT || size < COUNT * COUNT / 2)
+                size *= 2;
+            return size;
+        }
+
+        static constexpr size_t SIZE = slotCount();
+        static constexpr uint16_t EMPTY = 0xFFFF;
+
+        static constexpr std::array<std::string_view, COUNT> names()
+        {
+            return std::apply([](const auto &...fields)
+                              { return std::array<std::string_view, COUNT>{fields.name...}; },
+                              BindingFields<T>::fields);
+        }
+
+        struct Table
+        {
+            uint32_t seed = 0;
+            bool found = false;
+            std::array<uint16_t, SIZE> slots{};
+        };
+
+        static constexpr Table build()
+        {
+            constexpr auto keys = names();
+            Table table;
+            for (uint32_t seed = 0; seed < 4096 && !table.found; seed++)
+            {
+                for (auto &slot : table.slots)
+                    slot = EMPTY;
+                table.seed = seed;
+                table.found = true;
+                for (size_t i = 0; i < COUNT && table.found; i++)
+                {
+                    uint16_t &slot = table.slots[hash(keys[i], seed) & (SIZE - 1)];
+                    table.found = slot == EMPTY;
+                    slot = static_cast<uint16_t>(i);
+                }
+            }
+            return table;
+        }
+
+        static constexpr std::array<std::string_view, COUNT> KEYS = names();
+        static constexpr Table TABLE = build();
+        static_assert(TABLE.found, "No perfect hash found for the bound field names; are two fields named the same?");
+
+        /**
+         * Finds the position of a field by its key.
+         * @param key Key read from the input.
+         * @return Position of the field, or COUNT if the struct has no such field.
+         */
+        static size_t find(std::string_view key)
+        {
+            uint16_t slot = TABLE.slots[hash(key, TABLE.seed) & (SIZE - 1)];
+            return slot != EMPTY && KEYS[slot] == key ? slot : COUNT;
+        }
+    };
+
+    /**
+     * Writes one member of a bound struct.
+     * @param out Output stream.
+     * @param value Struct holding the member.
+     * @param field Field being written.
+     * @param first Whether no member has been written yet.
+     */
+    template <typename T, typename Member>
+    static void writeMember(std::ostream &out, const T &value, const Field<T, Member> &field, bool &first)
+    {
+        if (!first)
+            out << ",";
+        first = false;
+        out << "\"" << field.name << "\":";
+        write(out, value.*field.pointer);
+    }
+
+    /**
+     * Class pulling tokens from a lexer and storing them into typed values.
+     */
+    template <typename Policy>
+    class Reader
+    {
+    public:
+        Reader(const std::string &input) : lexer(input), token(lexer.nextToken()) {}
+
+        template <typename T>
+        void read(T &value)
+        {
+            if constexpr (std::is_same_v<T, bool>)
+            {
+                if (token.type != TokenType::TRUE && token.type != TokenType::FALSE)
+                    fail("boolean");
+                value = token.type == TokenType::TRUE;
+                next();
+            }
+            else if constexpr (std::is_arithmetic_v<T>)
+            {
+                if (token.type != TokenType::NUMBER)
+                    fail("number");
+                if constexpr (std::is_integral_v<T>)
+                    value = readInteger<T>();
+                else
+                    value = static_cast<T>(std::strtod(token.value.c_str(), nullptr));
+                next();
+            }
+            else if constexpr (std::is_same_v<T, std::string>)
+            {
+                if (token.type != TokenType::STRING)
+                    fail("string");
+                value = std::move(token.value);
+                next();
+            }
+            else if constexpr (IsOptional<T>::value)
+            {
+                if (token.type == TokenType::NULL_TYPE)
+                {
+                    value.reset();
+                    next();
+                }
+                else
+                {
+                    read(value.emplace());
+                }
+            }
+            else if constexpr (IsVector<T>::value)
+            {
+                expect(TokenType::LEFT_BRACKET, "'['");
+                value.clear();
+                bool more = token.type != TokenType::RIGHT_BRACKET;
+                while (more)
+                {
+                    typename T::value_type element{};
+                    read(element);
+                    value.push_back(std::move(element));
+                    more = separator(TokenType::RIGHT_BRACKET);
+                }
+                expect(TokenType::RIGHT_BRACKET, "']'");
+            }
+            else
+            {
+                static_assert(IsBound<T>::value, "Type has no BindingFields specialisation");
+                readObject(value, std::make_index_sequence<FieldTable<T>::COUNT>());
+            }
+        }
+
+        void expectEnd()
+        {
+            if (token.type != TokenType::END)
+                throw std::runtime_error("Unexpected characters after the value at " + lexer.position());
+        }
+
+    private:
+        template <typename T, size_t... I>
+        void readObject(T &value, std::index_sequence<I...>)
+        {
+            using Setter = void (*)(Reader &, T &);
+            static constexpr Setter setters[] = {&Reader::readField<T, I>...};
+
+            expect(TokenType::LEFT_BRACE, "'{'");
+            bool more = token.type != TokenType::RIGHT_BRACE;
+            while (more)
+            {
+                if (token.type != TokenType::STRING)
+                    fail("string key");
+                size_t index = FieldTable<T>::find(token.value);
+                next();
+                expect(TokenType::COLON, "':'");
+                if (index < FieldTable<T>::COUNT)
+                    setters[index](*this, value);
+                else
+                    skipValue();
+                more = separator(TokenType::RIGHT_BRACE);
+            }
+            expect(TokenType::RIGHT_BRACE, "'}'");
+        }
+
+        template <typename T, size_t I>
+        static void readField(Reader &reader, T &value)
+        {
+            reader.read(value.*std::get<I>(BindingFields<T>::fields).pointer);
+        }
+
+        /**
+         * Reads what follows a member: a comma before the next one, or the closer of the container.
+         * @param closer Token closing the container.
+         * @return True if another member follows.
+         */
+        bool separator(TokenType closer)
+        {
+            if (token.type != TokenType::COMMA)
+                return false;
+            next();
+            if (token.type == closer)
+            {
+                if (!Policy::ALLOW_TRAILING_COMMAS)
+                    fail("value");
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * Converts the number token to an integer type, rejecting fractions and values out of its range.
+         * @return The integer.
+         */
+        template <typename T>
+        T readInteger()
+        {
+            const char *text = token.value.c_str();
+            char *end;
+            errno = 0;
+            long long integer = std::strtoll(text, &end, 10);
+            if (*end != '\0')
+            {
+                // 2.0 and 2e3 are integers written as decimals; 2.5 is not.
+                double number = std::strtod(text, nullptr);
+                if (number != std::trunc(number) || number < -9.2e18 || number > 9.2e18)
+                    fail("integer");
+                integer = static_cast<long long>(number);
+            }
+            else if (errno == ERANGE)
+            {
+                fail("integer");
+            }
+
+            if constexpr (std::is_signed_v<T>)
+            {
+                if (integer < static_cast<long long>(std::numeric_limits<T>::min()) || integer > static_cast<long long>(std::numeric_limits<T>::max()))
+                    fail("integer");
+            }
+            else
+            {
+                if (integer < 0 || static_cast<unsigned long long>(integer) > std::numeric_limits<T>::max())
+                    fail("integer");
+            }
+            return static_cast<T>(integer);
+        }
+
+        /**
+         * Skips a value the bound struct has no field for. Closers are matched against the
+         * openers on a stack, and whatever follows a member is checked as in the bound containers.
+         */
+        void skipValue()
+        {
+            std::vector<TokenType> closers;
+            do
+            {
+                switch (token.type)
+                {
+                case TokenType::LEFT_BRACE:
+                    closers.push_back(TokenType::RIGHT_BRACE);
+                    next();
+                    if (token.type != TokenType::RIGHT_BRACE)
+                    {
+                        skipKey();
+                        continue;
+                    }
+                    break;
+                case TokenType::LEFT_BRACKET:
+                    closers.push_back(TokenType::RIGHT_BRACKET);
+                    next();
+                    if (token.type != TokenType::RIGHT_BRACKET)
+                        continue;
+                    break;
+                case TokenType::STRING:
+                case TokenType::NUMBER:
+                case TokenType::TRUE:
+                case TokenType::FALSE:
+                case TokenType::NULL_TYPE:
+                    next();
+                    break;
+                default:
+                    fail("value");
+                }
+
+                // A value or an empty container has been read; close every container it completes.
+                while (!closers.empty())
+                {
+                    TokenType closer = closers.back();
+                    if (token.type == closer)
+                    {
+                        closers.pop_back();
+                        next();
+                    }
+                    else if (separator(closer))
+                    {
+                        if (closer == TokenType::RIGHT_BRACE)
+                            skipKey();
+                        break;
+                    }
+                    else if (token.type != closer)
+                    {
+                        fail(closer == TokenType::RIGHT_BRACE ? "'}'" : "']'");
+                    }
+                }
+            } while (!closers.empty());
+        }
+
+        /**
+         * Skips an object key and the colon after it.
+         */
+        void skipKey()
+        {
+            if (token.type != TokenType::STRING)
+                fail("string key");
+            next();
+            expect(TokenType::COLON, "':'");
+        }
+
+        void expect(TokenType type, const char *what)
+        {
+            if (token.type != type)
+                fail(what);
+            next();
+        }
+
+        void next()
+        {
+            token = lexer.nextToken();
+        }
+
+        [[noreturn]] void fail(const char *what)
+        {
+            throw std::runtime_error(std::string("Expected ") + what + " at " + lexer.position());
+        }
+
+        BasicLexer<Policy> lexer;
+        Token token;
+    };
+};
+
+#endif
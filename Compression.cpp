@@ -0,0 +1,304 @@
+#include <cstring>
+#include <stdexcept>
+
+#include <zlib.h>
+#ifdef JSON_PARSER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "Compression.h"
+
+namespace
+{
+    const unsigned char GZIP_MAGIC[2] = {0x1f, 0x8b};
+    const unsigned char ZSTD_MAGIC[4] = {0x28, 0xb5, 0x2f, 0xfd};
+    const size_t OUTPUT_CHUNK_SIZE = 1 << 16;
+
+    bool endsWith(const std::string &text, const std::string &suffix)
+    {
+        return text.size() > suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    Compression fromExtension(const std::string &filePath)
+    {
+        if (endsWith(filePath, ".gz") || endsWith(filePath, ".gzip"))
+            return Compression::GZIP;
+        if (endsWith(filePath, ".zst") || endsWith(filePath, ".zstd"))
+            return Compression::ZSTD;
+        return Compression::NONE;
+    }
+
+    void requireZstd()
+    {
+#ifndef JSON_PARSER_HAVE_ZSTD
+        throw std::runtime_error("Zstandard support is not compiled in.");
+#endif
+    }
+}
+
+struct Decompressor::Stream
+{
+    z_stream gzip;
+#ifdef JSON_PARSER_HAVE_ZSTD
+    ZSTD_DStream *zstd = nullptr;
+    ZSTD_inBuffer input = {nullptr, 0, 0};
+#endif
+};
+
+struct Compressor::Stream
+{
+    z_stream gzip;
+#ifdef JSON_PARSER_HAVE_ZSTD
+    ZSTD_CStream *zstd = nullptr;
+#endif
+};
+
+Compression Decompressor::detect(const std::string &filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    unsigned char magic[4] = {0, 0, 0, 0};
+    file.read(reinterpret_cast<char *>(magic), sizeof(magic));
+    if (file.gcount() >= 2 && std::memcmp(magic, GZIP_MAGIC, 2) == 0)
+        return Compression::GZIP;
+    if (file.gcount() == 4 && std::memcmp(magic, ZSTD_MAGIC, 4) == 0)
+        return Compression::ZSTD;
+    return Compression::NONE;
+}
+
+std::string Decompressor::readAll(const std::string &filePath)
+{
+    Decompressor decompressor(filePath, detect(filePath));
+    std::string text;
+    std::string chunk;
+    while (decompressor.read(chunk))
+    {
+        text += chunk;
+    }
+    return text;
+}
+
+Decompressor::Decompressor(const std::string &filePath, Compression compression)
+    : filePath(filePath), compression(compression), file(filePath, std::ios::binary), stream(new Stream())
+{
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Could not open " + filePath + ".");
+    }
+
+    if (compression == Compression::GZIP)
+    {
+        // A window of 15 bits plus 32 accepts both gzip and zlib headers.
+        std::memset(&stream->gzip, 0, sizeof(stream->gzip));
+        if (inflateInit2(&stream->gzip, 15 + 32) != Z_OK)
+            throw std::runtime_error("Could not start decompressing " + filePath + ".");
+    }
+    else if (compression == Compression::ZSTD)
+    {
+        requireZstd();
+#ifdef JSON_PARSER_HAVE_ZSTD
+        stream->zstd = ZSTD_createDStream();
+        if (stream->zstd == nullptr || ZSTD_isError(ZSTD_initDStream(stream->zstd)))
+            throw std::runtime_error("Could not start decompressing " + filePath + ".");
+#endif
+    }
+}
+
+Decompressor::~Decompressor()
+{
+    if (compression == Compression::GZIP)
+    {
+        inflateEnd(&stream->gzip);
+    }
+#ifdef JSON_PARSER_HAVE_ZSTD
+    if (stream->zstd != nullptr)
+    {
+        ZSTD_freeDStream(stream->zstd);
+    }
+#endif
+}
+
+bool Decompressor::fill()
+{
+    compressed.resize(CHUNK_SIZE);
+    file.read(&compressed[0], compressed.size());
+    compressed.resize(static_cast<size_t>(file.gcount()));
+    return !compressed.empty();
+}
+
+bool Decompressor::read(std::string &chunk)
+{
+    if (compression == Compression::NONE)
+    {
+        chunk.resize(CHUNK_SIZE);
+        file.read(&chunk[0], chunk.size());
+        chunk.resize(static_cast<size_t>(file.gcount()));
+        return !chunk.empty();
+    }
+
+    chunk.resize(CHUNK_SIZE);
+    size_t produced = 0;
+    while (produced < chunk.size())
+    {
+        if (compression == Compression::GZIP)
+        {
+            z_stream &gzip = stream->gzip;
+            if (gzip.avail_in == 0)
+            {
+                if (!fill())
+                    break;
+                gzip.next_in = reinterpret_cast<Bytef *>(&compressed[0]);
+                gzip.avail_in = static_cast<uInt>(compressed.size());
+            }
+            if (frameEnded && gzip.total_in > 0)
+            {
+                // Another gzip member follows the one that just ended.
+                inflateReset(&gzip);
+            }
+
+            gzip.next_out = reinterpret_cast<Bytef *>(&chunk[produced]);
+            gzip.avail_out = static_cast<uInt>(chunk.size() - produced);
+            int status = inflate(&gzip, Z_NO_FLUSH);
+            if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR)
+                throw std::runtime_error("Corrupt gzip data in " + filePath + ".");
+            produced = chunk.size() - gzip.avail_out;
+            frameEnded = status == Z_STREAM_END;
+        }
+        else
+        {
+#ifdef JSON_PARSER_HAVE_ZSTD
+            ZSTD_inBuffer &input = stream->input;
+            if (input.pos == input.size)
+            {
+                if (!fill())
+                    break;
+                input = {compressed.data(), compressed.size(), 0};
+            }
+
+            ZSTD_outBuffer output = {&chunk[0], chunk.size(), produced};
+            size_t status = ZSTD_decompressStream(stream->zstd, &output, &input);
+            if (ZSTD_isError(status))
+                throw std::runtime_error("Corrupt zstd data in " + filePath + ": " + ZSTD_getErrorName(status));
+            produced = output.pos;
+            frameEnded = status == 0;
+#endif
+        }
+    }
+
+    chunk.resize(produced);
+    if (produced == 0 && !frameEnded)
+    {
+        throw std::runtime_error("Compressed data in " + filePath + " is truncated.");
+    }
+    return produced > 0;
+}
+
+Compression Compressor::choose(const std::string &filePath)
+{
+    Compression compression = fromExtension(filePath);
+    return compression != Compression::NONE ? compression : Decompressor::detect(filePath);
+}
+
+std::string Compressor::stripExtension(const std::string &filePath)
+{
+    if (fromExtension(filePath) == Compression::NONE)
+        return filePath;
+    return filePath.substr(0, filePath.find_last_of('.'));
+}
+
+Compressor::Compressor(Compression compression) : compression(compression), stream(new Stream())
+{
+    if (compression == Compression::GZIP)
+    {
+        // A window of 15 bits plus 16 writes a gzip header instead of a zlib one.
+        std::memset(&stream->gzip, 0, sizeof(stream->gzip));
+        if (deflateInit2(&stream->gzip, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("Could not start gzip compression.");
+    }
+    else if (compression == Compression::ZSTD)
+    {
+        requireZstd();
+#ifdef JSON_PARSER_HAVE_ZSTD
+        stream->zstd = ZSTD_createCStream();
+        if (stream->zstd == nullptr || ZSTD_isError(ZSTD_initCStream(stream->zstd, ZSTD_CLEVEL_DEFAULT)))
+            throw std::runtime_error("Could not start zstd compression.");
+#endif
+    }
+}
+
+Compressor::~Compressor()
+{
+    if (compression == Compression::GZIP)
+    {
+        deflateEnd(&stream->gzip);
+    }
+#ifdef JSON_PARSER_HAVE_ZSTD
+    if (stream->zstd != nullptr)
+    {
+        ZSTD_freeCStream(stream->zstd);
+    }
+#endif
+}
+
+Compression Compressor::getCompression() const
+{
+    return compression;
+}
+
+void Compressor::compress(const char *data, size_t size, std::vector<std::string> &output)
+{
+    if (compression == Compression::NONE)
+    {
+        output.emplace_back(data, size);
+        return;
+    }
+    run(data, size, false, output);
+}
+
+void Compressor::finish(std::vector<std::string> &output)
+{
+    if (compression != Compression::NONE)
+    {
+        run(nullptr, 0, true, output);
+    }
+}
+
+void Compressor::run(const char *data, size_t size, bool last, std::vector<std::string> &output)
+{
+    std::string buffer;
+    if (compression == Compression::GZIP)
+    {
+        z_stream &gzip = stream->gzip;
+        gzip.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        gzip.avail_in = static_cast<uInt>(size);
+        int status;
+        do
+        {
+            buffer.resize(OUTPUT_CHUNK_SIZE);
+            gzip.next_out = reinterpret_cast<Bytef *>(&buffer[0]);
+            gzip.avail_out = static_cast<uInt>(buffer.size());
+            status = deflate(&gzip, last ? Z_FINISH : Z_NO_FLUSH);
+            if (status == Z_STREAM_ERROR)
+                throw std::runtime_error("gzip compression failed.");
+            buffer.resize(buffer.size() - gzip.avail_out);
+            if (!buffer.empty())
+                output.push_back(std::move(buffer));
+        } while (last ? status != Z_STREAM_END : gzip.avail_out == 0 || gzip.avail_in > 0);
+        return;
+    }
+
+#ifdef JSON_PARSER_HAVE_ZSTD
+    ZSTD_inBuffer input = {data, size, 0};
+    size_t remaining;
+    do
+    {
+        buffer.resize(OUTPUT_CHUNK_SIZE);
+        ZSTD_outBuffer out = {&buffer[0], buffer.size(), 0};
+        remaining = ZSTD_compressStream2(stream->zstd, &out, &input, last ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(remaining))
+            throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(remaining));
+        buffer.resize(out.pos);
+        if (!buffer.empty())
+            output.push_back(std::move(buffer));
+    } while (last ? remaining != 0 : input.pos < input.size);
+#endif
+}
@@ -0,0 +1,150 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Enum listing the compressed file formats that are read and written transparently.
+ * Zstandard support is compiled in when JSON_PARSER_HAVE_ZSTD is defined and the program is linked with libzstd.
+ */
+enum class Compression
+{
+    NONE,
+    GZIP,
+    ZSTD
+};
+
+/**
+ * Class reading a file in chunks, decompressing it on the fly.
+ * Only one chunk of compressed and one chunk of decompressed data are held at a time,
+ * so a compressed document can be parsed without a decompressed copy of the whole file.
+ * Concatenated gzip members and zstd frames are read as one stream.
+ */
+class Decompressor
+{
+public:
+    static const size_t CHUNK_SIZE = 1 << 18;
+
+    /**
+     * Detects the compression of a file from its magic bytes.
+     * @param filePath Path to the file.
+     * @return Compression of the file, NONE if it is plain or cannot be read.
+     */
+    static Compression detect(const std::string &filePath);
+
+    /**
+     * Reads a whole file, decompressing it if needed.
+     * @param filePath Path to the file.
+     * @return Decompressed file contents.
+     */
+    static std::string readAll(const std::string &filePath);
+
+    /**
+     * Opens a file for reading.
+     * @param filePath Path to the file.
+     * @param compression Compression of the file, as returned by detect.
+     */
+    Decompressor(const std::string &filePath, Compression compression);
+
+    ~Decompressor();
+
+    Decompressor(const Decompressor &) = delete;
+    Decompressor &operator=(const Decompressor &) = delete;
+
+    /**
+     * Reads the next chunk of decompressed data.
+     * Throws std::runtime_error if the compressed data is corrupt or truncated.
+     * @param chunk Replaced with the next decompressed bytes.
+     * @return False once the end of the file was reached, true otherwise.
+     */
+    bool read(std::string &chunk);
+
+private:
+    /**
+     * Reads the next chunk of compressed data from the file.
+     * @return False at the end of the file, true otherwise.
+     */
+    bool fill();
+
+    struct Stream;
+
+    std::string filePath;
+    Compression compression;
+    std::ifstream file;
+    std::string compressed;
+    std::unique_ptr<Stream> stream;
+    bool frameEnded = true;
+};
+
+/**
+ * Class compressing text handed over in pieces, producing pieces of compressed output.
+ */
+class Compressor
+{
+public:
+    /**
+     * Chooses the compression for writing a file: from its extension (.gz, .zst), or else
+     * from the magic bytes of the file it replaces, so that saving keeps a compressed file compressed.
+     * @param filePath Path to the file about to be written.
+     * @return Compression to write the file with.
+     */
+    static Compression choose(const std::string &filePath);
+
+    /**
+     * Removes a compression extension from a file name.
+     * @param filePath Path to a file.
+     * @return The path without a trailing .gz or .zst.
+     */
+    static std::string stripExtension(const std::string &filePath);
+
+    /**
+     * Starts a compressed stream.
+     * @param compression Compression to use; NONE passes the text through unchanged.
+     */
+    explicit Compressor(Compression compression);
+
+    ~Compressor();
+
+    Compressor(const Compressor &) = delete;
+    Compressor &operator=(const Compressor &) = delete;
+
+    /**
+     * Gets the compression of the stream.
+     * @return Compression passed to the constructor.
+     */
+    Compression getCompression() const;
+
+    /**
+     * Compresses the next piece of text.
+     * @param data First byte of the piece.
+     * @param size Number of bytes.
+     * @param output Receives the compressed bytes that are ready.
+     */
+    void compress(const char *data, size_t size, std::vector<std::string> &output);
+
+    /**
+     * Ends the stream.
+     * @param output Receives the remaining compressed bytes.
+     */
+    void finish(std::vector<std::string> &output);
+
+private:
+    /**
+     * Runs the compressor over a piece of text.
+     * @param data First byte of the piece.
+     * @param size Number of bytes.
+     * @param last Whether the stream ends after this piece.
+     * @param output Receives the compressed bytes that are ready.
+     */
+    void run(const char *data, size_t size, bool last, std::vector<std::string> &output);
+
+    struct Stream;
+
+    Compression compression;
+    std::unique_ptr<Stream> stream;
+};
+
+#endif
@@ -0,0 +1,440 @@
+#include <algorithm>
+
+#include <sys/stat.h>
+
+#include "Compression.h"
+#include "DocumentCache.h"
+
+namespace
+{
+    std::string readFile(const std::string &filePath)
+    {
+        std::ifstream file(filePath, std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Could not open " + filePath + ".");
+        }
+
+        std::string input;
+        file.seekg(0, std::ios::end);
+        input.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        file.read(&input[0], input.size());
+        return input;
+    }
+
+    /**
+     * Records the hashes of a file's text, decompressing it chunk by chunk if needed.
+     */
+    void recordFile(const std::string &filePath, ParseCache &cache)
+    {
+        Decompressor decompressor(filePath, Decompressor::detect(filePath));
+        std::string chunk;
+        cache.begin();
+        while (decompressor.read(chunk))
+        {
+            cache.feed(chunk.data(), chunk.size());
+        }
+        cache.finish();
+    }
+
+    /**
+     * Parses a file read chunk by chunk, from a decompressing stream or a pipe. JSON is handed
+     * to a PushParser as it arrives; NDJSON and binary snapshots are decoded from the whole text.
+     */
+    Parser *readChunks(const Document &document, const InputSource &next, ParseCache &cache)
+    {
+        std::string chunk;
+        next(chunk);
+        if (document.format != InputFormat::JSON || BinarySnapshot::isSnapshot(chunk))
+        {
+            std::string input = chunk;
+            while (next(chunk))
+            {
+                input += chunk;
+            }
+            cache.record(input);
+            InputFormat format = BinarySnapshot::isSnapshot(input) ? InputFormat::BINARY : document.format;
+            return new Parser(input, document.filePath, format, document.mode);
+        }
+
+        PushParser pushed(document.mode);
+        cache.begin();
+        do
+        {
+            cache.feed(chunk.data(), chunk.size());
+            pushed.feed(chunk);
+        } while (next(chunk));
+        cache.finish();
+        return new Parser(pushed, document.filePath);
+    }
+
+    /**
+     * Parses a compressed file from the decompressing stream.
+     */
+    Parser *readCompressed(const Document &document, Compression compression, ParseCache &cache)
+    {
+        Decompressor decompressor(document.filePath, compression);
+        return readChunks(document, [&](std::string &chunk)
+                          { return decompressor.read(chunk); },
+                          cache);
+    }
+
+    /**
+     * Parses a pipe or device, which can neither be sized up front nor read twice.
+     */
+    Parser *readPipe(const Document &document, ParseCache &cache)
+    {
+        std::ifstream file(document.filePath, std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Could not open " + document.filePath + ".");
+        }
+        return readChunks(document, [&](std::string &chunk)
+                          {
+                              chunk.resize(Decompressor::CHUNK_SIZE);
+                              file.read(&chunk[0], chunk.size());
+                              chunk.resize(static_cast<size_t>(file.gcount()));
+                              return !chunk.empty(); },
+                          cache);
+    }
+
+    bool readStamp(const std::string &filePath, int64_t &modifiedTime, int64_t &fileSize)
+    {
+        struct stat info;
+        if (stat(filePath.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            // A pipe has no contents to compare again, so a document read from one is never reloaded.
+            return false;
+        }
+        modifiedTime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+        fileSize = info.st_size;
+        return true;
+    }
+}
+
+DocumentCache::DocumentCache(size_t budget) : budget(budget) {}
+
+DocumentCache::~DocumentCache()
+{
+    for (auto &entry : documents)
+    {
+        unload(entry.second);
+        delete entry.second.history;
+    }
+}
+
+Document &DocumentCache::open(const std::string &name, const std::string &filePath, InputFormat format, ParseMode mode)
+{
+    Document loaded;
+    loaded.name = name;
+    loaded.filePath = filePath;
+    loaded.format = format;
+    loaded.mode = mode;
+    load(loaded);
+
+    auto it = documents.find(name);
+    if (it != documents.end())
+    {
+        unload(it->second);
+        delete it->second.history;
+        it->second = loaded;
+    }
+    else
+    {
+        it = documents.emplace(name, loaded).first;
+    }
+
+    touch(name);
+    enforceBudget();
+    return it->second;
+}
+
+bool DocumentCache::isPipe(const std::string &filePath)
+{
+    struct stat info;
+    return stat(filePath.c_str(), &info) == 0 && !S_ISREG(info.st_mode) && !S_ISDIR(info.st_mode);
+}
+
+Document *DocumentCache::get(const std::string &name)
+{
+    auto it = documents.find(name);
+    if (it == documents.end())
+    {
+        return nullptr;
+    }
+
+    if (!it->second.isLoaded())
+    {
+        load(it->second);
+    }
+    touch(name);
+    enforceBudget();
+    return &it->second;
+}
+
+Document *DocumentCache::find(const std::string &name)
+{
+    auto it = documents.find(name);
+    return it == documents.end() ? nullptr : &it->second;
+}
+
+bool DocumentCache::stale(const Document &document) const
+{
+    int64_t modifiedTime;
+    int64_t fileSize;
+    return document.isLoaded() && readStamp(document.filePath, modifiedTime, fileSize) &&
+           (modifiedTime != document.modifiedTime || fileSize != document.fileSize);
+}
+
+bool DocumentCache::refresh(Document &document, size_t &reused)
+{
+    reused = 0;
+    int64_t modifiedTime;
+    int64_t fileSize;
+    if (!document.isLoaded() || !readStamp(document.filePath, modifiedTime, fileSize) ||
+        (modifiedTime == document.modifiedTime && fileSize == document.fileSize))
+    {
+        return false;
+    }
+
+    if (document.mapped != nullptr)
+    {
+        MappedDocument *reloaded = new MappedDocument(document.filePath);
+        delete document.mapped;
+        document.mapped = reloaded;
+        document.modifiedTime = modifiedTime;
+        document.fileSize = fileSize;
+        return true;
+    }
+
+    document.modifiedTime = modifiedTime;
+    document.fileSize = fileSize;
+    Parser *reloaded;
+    Compression compression = Decompressor::detect(document.filePath);
+    if (compression != Compression::NONE)
+    {
+        // Compressed files are only read as a stream, so the text is compared after parsing it.
+        ParseCache recorded;
+        reloaded = readCompressed(document, compression, recorded);
+        if (recorded.unchanged(document.parseCache))
+        {
+            delete reloaded;
+            return false;
+        }
+        document.format = reloaded->getFormat();
+        document.parseCache = recorded;
+        replaceParser(document, reloaded);
+        return true;
+    }
+
+    std::string input = readFile(document.filePath);
+    if (document.parseCache.unchanged(input))
+    {
+        return false;
+    }
+
+    if (document.format == InputFormat::JSON && document.mode == ParseMode::DEFAULT && document.history == nullptr && !BinarySnapshot::isSnapshot(input))
+    {
+        JSONValue root = document.parseCache.reparse(input, document.parser->getRoot(), reused);
+        reloaded = new Parser(input, document.filePath, std::move(root));
+    }
+    else
+    {
+        InputFormat format = BinarySnapshot::isSnapshot(input) ? InputFormat::BINARY : document.format;
+        reloaded = new Parser(input, document.filePath, format, document.mode);
+        document.format = format;
+        document.parseCache.record(input);
+    }
+    replaceParser(document, reloaded);
+    return true;
+}
+
+void DocumentCache::sync(Document &document)
+{
+    int64_t modifiedTime;
+    int64_t fileSize;
+    if (!document.isLoaded() || document.mapped != nullptr || !readStamp(document.filePath, modifiedTime, fileSize) ||
+        (modifiedTime == document.modifiedTime && fileSize == document.fileSize))
+    {
+        return;
+    }
+
+    document.modifiedTime = modifiedTime;
+    document.fileSize = fileSize;
+    recordFile(document.filePath, document.parseCache);
+}
+
+void DocumentCache::written(const BackgroundWriter::Result &result)
+{
+    for (auto &entry : documents)
+    {
+        Document &document = entry.second;
+        if (document.filePath != result.filePath || !document.isLoaded() || document.mapped != nullptr)
+        {
+            continue;
+        }
+        if (result.error.empty())
+        {
+            document.modifiedTime = result.modifiedTime;
+            document.fileSize = result.fileSize;
+            document.parseCache = result.parseCache;
+        }
+        else
+        {
+            // The tree holds edits the file never received, so none of its members may be taken for the text on disk.
+            document.parseCache.clear();
+        }
+    }
+}
+
+bool DocumentCache::close(const std::string &name)
+{
+    auto it = documents.find(name);
+    if (it == documents.end())
+    {
+        return false;
+    }
+
+    unload(it->second);
+    delete it->second.history;
+    documents.erase(it);
+    order.remove(name);
+    return true;
+}
+
+std::vector<const Document *> DocumentCache::list() const
+{
+    std::vector<const Document *> result;
+    for (const auto &name : order)
+    {
+        result.push_back(&documents.at(name));
+    }
+    return result;
+}
+
+void DocumentCache::setBudget(size_t bytes)
+{
+    budget = bytes;
+    enforceBudget();
+}
+
+size_t DocumentCache::getBudget() const
+{
+    return budget;
+}
+
+void DocumentCache::setConcurrent(bool enabled)
+{
+    concurrent = enabled;
+    for (auto &entry : documents)
+    {
+        if (entry.second.parser != nullptr)
+            entry.second.parser->setConcurrent(enabled);
+    }
+}
+
+size_t DocumentCache::getUsage()
+{
+    size_t usage = 0;
+    for (auto &entry : documents)
+    {
+        Document &document = entry.second;
+        if (document.resized && document.parser != nullptr)
+        {
+            document.memoryUsage = document.parser->memoryUsage();
+        }
+        document.resized = false;
+        usage += document.memoryUsage;
+    }
+    return usage;
+}
+
+void DocumentCache::load(Document &document)
+{
+    readStamp(document.filePath, document.modifiedTime, document.fileSize);
+    if (isPipe(document.filePath))
+    {
+        // Probing a pipe for mapped or compressed magic bytes would consume them, so it goes straight to the chunked reader.
+        document.parser = readPipe(document, document.parseCache);
+        document.parser->setConcurrent(concurrent);
+        document.format = document.parser->getFormat();
+        document.memoryUsage = document.parser->memoryUsage();
+        return;
+    }
+    if (MappedDocument::isMapped(document.filePath))
+    {
+        document.mapped = new MappedDocument(document.filePath);
+        document.format = InputFormat::MAPPED;
+        document.memoryUsage = 0;
+        return;
+    }
+
+    Compression compression = Decompressor::detect(document.filePath);
+    if (compression != Compression::NONE)
+    {
+        document.parser = readCompressed(document, compression, document.parseCache);
+        document.parser->setConcurrent(concurrent);
+        document.format = document.parser->getFormat();
+        document.memoryUsage = document.parser->memoryUsage();
+        return;
+    }
+
+    std::string input = readFile(document.filePath);
+    if (BinarySnapshot::isSnapshot(input))
+    {
+        document.format = InputFormat::BINARY;
+    }
+
+    document.parser = new Parser(input, document.filePath, document.format, document.mode);
+    document.parser->setConcurrent(concurrent);
+    document.memoryUsage = document.parser->memoryUsage();
+    document.parseCache.record(input);
+}
+
+void DocumentCache::replaceParser(Document &document, Parser *reloaded)
+{
+    delete document.parser;
+    document.parser = reloaded;
+    document.parser->setConcurrent(concurrent);
+    document.memoryUsage = document.parser->memoryUsage();
+    document.resized = false;
+    if (document.history != nullptr)
+    {
+        document.history->replace(document.parser->getRoot());
+    }
+}
+
+void DocumentCache::unload(Document &document)
+{
+    delete document.parser;
+    delete document.mapped;
+    document.parser = nullptr;
+    document.mapped = nullptr;
+    document.memoryUsage = 0;
+    document.resized = false;
+    document.parseCache.clear();
+}
+
+void DocumentCache::touch(const std::string &name)
+{
+    order.remove(name);
+    order.push_front(name);
+}
+
+void DocumentCache::enforceBudget()
+{
+    for (auto it = order.rbegin(); getUsage() > budget && it != order.rend(); ++it)
+    {
+        if (std::next(it) == order.rend())
+        {
+            break;
+        }
+
+        Document &document = documents.at(*it);
+        if (document.isLoaded() && document.history == nullptr && !isPipe(document.filePath))
+        {
+            unload(document);
+        }
+    }
+}
@@ -0,0 +1,205 @@
+#ifndef DOCUMENT_CACHE_H
+#define DOCUMENT_CACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "BackgroundWriter.h"
+#include "Parser.h"
+#include "ParseCache.h"
+#include "PersistentDocument.h"
+
+/**
+ * Structure representing a document opened in the Engine under a name.
+ * An evicted document keeps its name and file path but holds no parsed tree.
+ */
+struct Document
+{
+    std::string name;
+    std::string filePath;
+    InputFormat format = InputFormat::JSON;
+    ParseMode mode = ParseMode::DEFAULT;
+    Parser *parser = nullptr;
+    MappedDocument *mapped = nullptr;
+    PersistentDocument *history = nullptr;
+    size_t memoryUsage = 0;
+    bool resized = false;
+    int64_t modifiedTime = 0;
+    int64_t fileSize = -1;
+    ParseCache parseCache;
+
+    /**
+     * Checks whether the document currently holds a parsed or mapped tree.
+     * @return True if the document is loaded, false if it was evicted.
+     */
+    bool isLoaded() const { return parser != nullptr || mapped != nullptr; }
+};
+
+/**
+ * Class holding the documents of an Engine session in an LRU cache with a memory budget.
+ * When the parsed trees exceed the budget, the least recently used documents are
+ * evicted and reloaded from their files the next time they are used. The document
+ * in use and documents with persistent history are never evicted.
+ */
+class DocumentCache
+{
+public:
+    /**
+     * Constructs a DocumentCache with the given memory budget.
+     * @param budget Memory budget in bytes.
+     */
+    explicit DocumentCache(size_t budget);
+
+    DocumentCache(const DocumentCache &) = delete;
+
+    DocumentCache &operator=(const DocumentCache &) = delete;
+
+    ~DocumentCache();
+
+    /**
+     * Loads a file under a name, replacing any document already open under that name.
+     * @param name Name of the document.
+     * @param filePath Path to the file.
+     * @param format Layout of the file content; binary snapshots and mapped documents are detected automatically.
+     * @param mode Preset parser policy used for JSON content.
+     * @return The loaded document.
+     */
+    Document &open(const std::string &name, const std::string &filePath, InputFormat format, ParseMode mode = ParseMode::DEFAULT);
+
+    /**
+     * Checks whether a path names a pipe or device rather than a regular file. Its text is parsed
+     * chunk by chunk as it arrives, and it is never probed for a format, reloaded or evicted,
+     * since it can only be read once.
+     * @param filePath Path to check.
+     * @return True if the path is neither a regular file nor a directory.
+     */
+    static bool isPipe(const std::string &filePath);
+
+    /**
+     * Gets a document by name, reloading it if it was evicted, and marks it as most recently used.
+     * @param name Name of the document.
+     * @return The document if it is open, nullptr otherwise.
+     */
+    Document *get(const std::string &name);
+
+    /**
+     * Gets a document by name without reloading it or changing the LRU order,
+     * so that several readers can look documents up at the same time.
+     * @param name Name of the document.
+     * @return The document if it is open, nullptr otherwise.
+     */
+    Document *find(const std::string &name);
+
+    /**
+     * Checks whether a document's file changed since it was last read or written, without reloading it.
+     * @param document Document to check.
+     * @return True if refresh would reload the document, false otherwise.
+     */
+    bool stale(const Document &document) const;
+
+    /**
+     * Reloads a document if its file was changed by another process since it was last read or written.
+     * A file whose timestamp changed but whose bytes did not is not re-parsed, and members of a
+     * top-level object whose text did not change are moved over from the previous tree.
+     * Compressed files are parsed from the decompressing stream and compared after parsing.
+     * @param document Document to check.
+     * @param reused Number of subtrees reused from the previous tree.
+     * @return True if the document was reloaded, false otherwise.
+     */
+    bool refresh(Document &document, size_t &reused);
+
+    /**
+     * Records the current state of the file after the Engine wrote it, so the write is not
+     * mistaken for a change made by another process.
+     * @param document Document whose file may have been written.
+     */
+    void sync(Document &document);
+
+    /**
+     * Records the state of a file the BackgroundWriter finished writing, for every document
+     * open on that file, without reading the file again. After a failed write the recorded
+     * hashes are forgotten, so a later change to the file is parsed in full.
+     * @param result Finished write.
+     */
+    void written(const BackgroundWriter::Result &result);
+
+    /**
+     * Closes a document and frees its tree.
+     * @param name Name of the document.
+     * @return True if the document was open, false otherwise.
+     */
+    bool close(const std::string &name);
+
+    /**
+     * Gets the open documents, most recently used first.
+     * @return Pointers to the open documents.
+     */
+    std::vector<const Document *> list() const;
+
+    /**
+     * Sets the memory budget and evicts documents until it is met.
+     * @param bytes Memory budget in bytes.
+     */
+    void setBudget(size_t bytes);
+
+    /**
+     * Gets the memory budget.
+     * @return Memory budget in bytes.
+     */
+    size_t getBudget() const;
+
+    /**
+     * Turns concurrent mode on or off for the parsers of every loaded document and every document loaded later.
+     * It is on by default, so that a save hands the BackgroundWriter the published version of a tree
+     * instead of a copy. Must be called while no other thread uses the documents and no save is waiting.
+     * @param enabled Whether edits should publish copies of the tree, see Parser::setConcurrent.
+     */
+    void setConcurrent(bool enabled);
+
+    /**
+     * Gets the memory held by the loaded documents, first recounting the documents marked as resized.
+     * @return Approximate size in bytes.
+     */
+    size_t getUsage();
+
+private:
+    /**
+     * Reads and parses the file of a document.
+     * @param document Document to load.
+     */
+    void load(Document &document);
+
+    /**
+     * Replaces the tree of a document with one reloaded from its file.
+     * @param document Document to update.
+     * @param reloaded Parser holding the reloaded tree; the document takes ownership.
+     */
+    void replaceParser(Document &document, Parser *reloaded);
+
+    /**
+     * Frees the tree of a document.
+     * @param document Document to unload.
+     */
+    void unload(Document &document);
+
+    /**
+     * Moves a document to the front of the LRU order.
+     * @param name Name of the document.
+     */
+    void touch(const std::string &name);
+
+    /**
+     * Evicts least recently used documents until the budget is met.
+     */
+    void enforceBudget();
+
+private:
+    std::map<std::string, Document> documents;
+    std::list<std::string> order;
+    size_t budget;
+    bool concurrent = true;
+};
+
+#endif
@@ -1,22 +1,35 @@
 #include "Engine.h"
 
-Engine::Engine() {}
+Engine::Engine()
+    : ownedDocuments(new DocumentCache(DEFAULT_CACHE_BUDGET)), ownedWriter(new BackgroundWriter()),
+      documents(*ownedDocuments), writer(*ownedWriter) {}
+
+Engine::Engine(DocumentCache &documents, BackgroundWriter &writer) : documents(documents), writer(writer) {}
 
 void Engine::prompt()
 {
+    // Reading a command or writing an error flushes std::cout through its ties, so prompts and
+    // messages still appear in order; only the output of a single command is collected.
+    OutputBuffer buffered(std::cout);
+
     if (!fileLoaded)
     {
         std::cout << "Please enter the path of the json file you wish to manipulate." << std::endl;
         std::string filePath;
         std::getline(std::cin, filePath);
-        openFile(filePath);
+        openFile(filePath, filePath);
     }
 
     std::cout << "Welcome! Pick any of the following commands to operate with the JSON Parser: " << std::endl;
     std::cout << "------------------------------------------------------------------------------" << std::endl;
-    std::cout << "open <path> | validate | print | search <key> | " << std::endl;
+    std::cout << "open [--ndjson] [--strict|--lenient|--lossless] <path> [as <name>] | validate [--schema <file> [<json-file>]] | print [<path>] [--depth <n>] [--limit <n>] | search <key> [--limit <n>] | " << std::endl;
+    std::cout << "query [--first|--limit <n>|--count|--explain] <expression> | " << std::endl;
     std::cout << "contains <value> | set <path> <string> | create <path> <string> | " << std::endl;
-    std::cout << "delete <path> | move <from> <to> | save [<path>] | saveas <file> [<path>]" << std::endl;
+    std::cout << "delete <path> | move <from> <to> | save [<path>] | saveas [--binary|--mapped] <file> [<path>]" << std::endl;
+    std::cout << "apply <patch-file> | diff <other-file> [<patch-file>] | extract <json-file> <output-file> [<path>]" << std::endl;
+    std::cout << "persistent on|off | undo | redo | snapshot [<name>] | restore <name>" << std::endl;
+    std::cout << "open <path> as <name> | use <name> | docs | close <name> | cache <megabytes>" << std::endl;
+    std::cout << "memory [<path>] | maxdepth [<n>] | record <trace-file> | record off | stats [reset | dump <file> | dump-on-exit <file>]" << std::endl;
     std::cout << "------------------------------------------------------------------------------" << std::endl;
 
     std::string command;
@@ -26,6 +39,13 @@ void Engine::prompt()
         std::getline(std::cin, command);
         if (command == "exit")
         {
+            writer.flush();
+            collectWrites();
+            if (!statsDumpPath.empty())
+            {
+                std::ofstream out(statsDumpPath);
+                Stats::writeJSON(out);
+            }
             break;
         }
         executeCommand(command);
@@ -33,36 +53,557 @@ void Engine::prompt()
 }
 
 void Engine::executeCommand(const std::string &command)
+{
+    if (command.rfind("record ", 0) == 0)
+    {
+        traceFile.close();
+        if (command != "record off")
+        {
+            traceFile.open(command.substr(7), std::ios::app);
+            std::cout << (traceFile.is_open() ? "Recording commands to " : "Could not open trace file ") << command.substr(7) << std::endl;
+            if (traceFile.is_open() && document != nullptr)
+            {
+                traceFile << "open " << document->filePath << " as " << document->name << std::endl;
+            }
+        }
+        return;
+    }
+    if (traceFile.is_open())
+    {
+        traceFile << command << std::endl;
+    }
+
+    // Commands that read or write files explicitly must not race with a write still in flight,
+    // and a write in flight reads the published tree, which apply and persistent off change in place.
+    if (command.rfind("open ", 0) == 0 || command.rfind("use ", 0) == 0 || command.rfind("close ", 0) == 0 ||
+        command.rfind("save", 0) == 0 || command.rfind("validate --schema ", 0) == 0 ||
+        command.rfind("extract ", 0) == 0 || command.rfind("apply ", 0) == 0 || command == "persistent off")
+    {
+        writer.flush();
+    }
+    collectWrites();
+
+    // While a write of our own is in flight the file is about to change, so it is not checked for outside edits.
+    if (document != nullptr && !writer.busy(document->filePath))
+    {
+        try
+        {
+            size_t reused = 0;
+            if (documents.refresh(*document, reused))
+            {
+                std::cout << "File " << document->filePath << " changed on disk; reloaded";
+                if (reused > 0)
+                    std::cout << " (" << reused << " unchanged sections reused)";
+                std::cout << "." << std::endl;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error reloading " << document->filePath << ": " << e.what() << std::endl;
+        }
+    }
+
+    {
+        JSON_STATS_TIME_COMMAND(command.substr(0, command.find(' ')));
+        dispatchCommand(command);
+    }
+
+    collectWrites();
+    if (document != nullptr && !writer.busy(document->filePath))
+    {
+        documents.sync(*document);
+    }
+    // Versions retired by this command, or held until now by a finished write, are freed here.
+    Epoch::collect();
+}
+
+bool Engine::isReadOnly(const std::string &command)
+{
+    return command == "print" || command.rfind("print ", 0) == 0 || command == "validate" || command == "memory" || command == "stats" ||
+           command.rfind("search ", 0) == 0 || command.rfind("contains ", 0) == 0 || command.rfind("query ", 0) == 0 ||
+           command.rfind("memory ", 0) == 0;
+}
+
+bool Engine::isEdit(const std::string &command)
+{
+    return command.rfind("set ", 0) == 0 || command.rfind("create ", 0) == 0 || command.rfind("delete ", 0) == 0 ||
+           command.rfind("move ", 0) == 0;
+}
+
+bool Engine::resume(bool exclusive)
+{
+    if (documentName.empty())
+    {
+        return true;
+    }
+
+    // A document evicted while its save was in flight must not be reloaded from the file the save replaces.
+    document = documents.find(documentName);
+    if (exclusive && document != nullptr && !document->isLoaded() && writer.busy(document->filePath))
+    {
+        writer.flush();
+    }
+    document = exclusive ? documents.get(documentName) : document;
+    if (document == nullptr)
+    {
+        documentName.clear();
+        fileLoaded = false;
+        currentFilePath.clear();
+        return true;
+    }
+    return exclusive || (document->isLoaded() && (writer.busy(document->filePath) || !documents.stale(*document)));
+}
+
+void Engine::executeReadOnly(const std::string &command)
+{
+    if (traceFile.is_open())
+    {
+        traceFile << command << std::endl;
+    }
+    JSON_STATS_TIME_COMMAND(command.substr(0, command.find(' ')));
+    dispatchCommand(command);
+}
+
+bool Engine::executeEdit(const std::string &command)
+{
+    // Collecting a finished save updates documents other sessions read, so it is left to the next exclusive command.
+    if (document == nullptr || document->parser == nullptr || document->history != nullptr || !document->parser->isConcurrent())
+    {
+        return false;
+    }
+    executeReadOnly(command);
+    return true;
+}
+
+void Engine::applyPatch(const std::string &patchPath)
+{
+    JSONValue patch;
+    try
+    {
+        patch = JSONReader(Decompressor::readAll(patchPath)).parse();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Invalid patch: " << e.what() << std::endl;
+        return;
+    }
+
+    try
+    {
+        size_t applied;
+        if (document->history != nullptr)
+        {
+            JSONValue root = PersistentDocument::toJSONValue(*document->history->getRoot());
+            applied = Patch::apply(root, patch);
+            document->history->replace(root);
+        }
+        else
+        {
+            JSONValue &root = document->parser->getRoot();
+            size_t records = root.arrayValue.size();
+            applied = Patch::apply(root, patch);
+            document->resized = true;
+
+            // Records added, removed or moved no longer sit on the lines searches report and saves
+            // interleave with the lines that could not be parsed, so every line is numbered again.
+            bool reordered = patch.type != JSONValueType::ARRAY || root.arrayValue.size() != records;
+            for (const JSONValue *operation : patch.arrayValue)
+            {
+                for (const KeyValue &member : operation->objectValue)
+                {
+                    if ((member.key == "path" || member.key == "from") && member.value->type == JSONValueType::STRING &&
+                        member.value->stringValue.find('/', 1) == std::string::npos)
+                        reordered = true;
+                }
+            }
+            if (reordered && document->parser->getFormat() == InputFormat::NDJSON)
+            {
+                document->parser->renumberLines();
+            }
+        }
+        std::cout << "Successfully applied " << applied << (patch.type == JSONValueType::ARRAY ? " patch operations." : " merged members.") << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Patch not applied: " << e.what() << std::endl;
+        return;
+    }
+    scheduleSave();
+}
+
+void Engine::diffDocument(const std::string &arguments)
+{
+    size_t space = arguments.find(' ');
+    std::string otherPath = arguments.substr(0, space);
+    std::string patchPath = space == std::string::npos ? "" : arguments.substr(space + 1);
+
+    JSONValue other;
+    try
+    {
+        other = JSONReader(Decompressor::readAll(otherPath)).parse();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Could not read " << otherPath << ": " << e.what() << std::endl;
+        return;
+    }
+
+    JSONValue patch;
+    if (document->history != nullptr)
+        patch = Patch::diff(PersistentDocument::toJSONValue(*document->history->getRoot()), other);
+    else
+        patch = Patch::diff(document->parser->getRoot(), other);
+
+    if (patchPath.empty())
+    {
+        document->parser->writeJSON(std::cout, patch, 0);
+        std::cout << std::endl;
+        return;
+    }
+
+    try
+    {
+        BackgroundWriter::replaceFile(patchPath, [&](const BackgroundWriter::Sink &sink)
+                                      { document->parser->writeParallel(patch, true, sink); });
+        std::cout << "Wrote " << patch.arrayValue.size() << " patch operations to " << patchPath << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error saving to file: " << e.what() << std::endl;
+    }
+}
+
+void Engine::analyzeMemory(const std::string &path)
+{
+    if (document->parser != nullptr && document->history == nullptr)
+    {
+        const JSONValue *value = document->parser->findValueByPath(path);
+        if (value != nullptr)
+        {
+            ShapeAnalysis::print(ShapeAnalysis::analyze(*value), std::cout);
+        }
+        return;
+    }
+
+    // Persistent versions share subtrees and mapped nodes are read in place, so the subtree is
+    // materialized once and accounted for as the tree it takes when the document is loaded.
+    JSONValue subtree;
+    if (document->mapped != nullptr)
+    {
+        uint64_t node = document->mapped->findByPath(path);
+        if (node == 0)
+            return;
+        subtree = document->mapped->toJSONValue(node);
+    }
+    else
+    {
+        NodePtr node = document->history->findByPath(path);
+        if (!node)
+            return;
+        subtree = PersistentDocument::toJSONValue(*node);
+    }
+    ShapeAnalysis::print(ShapeAnalysis::analyze(subtree), std::cout);
+}
+
+void Engine::extractSubtree(const std::string &arguments)
+{
+    size_t first = arguments.find(' ');
+    if (first == std::string::npos)
+    {
+        std::cerr << "Invalid command format." << std::endl;
+        return;
+    }
+    size_t second = arguments.find(' ', first + 1);
+    std::string filePath = arguments.substr(0, first);
+    std::string outputPath = arguments.substr(first + 1, second == std::string::npos ? std::string::npos : second - first - 1);
+    std::string path = second == std::string::npos ? "" : arguments.substr(second + 1);
+
+    try
+    {
+        size_t copied = Extractor::extractFile(filePath, outputPath, path);
+        std::cout << "Successfully extracted " << (path.empty() ? "the document" : "the JSON at path: " + path)
+                  << " (" << copied << " bytes) to " << outputPath << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to extract from " << filePath << ": " << e.what() << std::endl;
+    }
+}
+
+void Engine::scheduleSave()
+{
+    if (document->history != nullptr)
+    {
+        // Persistent versions are immutable, so the current root is a snapshot already.
+        NodePtr root = document->history->getRoot();
+        writer.submit(document->filePath, [root](const BackgroundWriter::Sink &sink)
+                      {
+                          std::ostringstream out;
+                          PersistentDocument::writeJSON(out, *root, 0);
+                          std::vector<std::string> pieces{out.str()};
+                          sink(pieces);
+                      });
+        return;
+    }
+
+    writer.submit(document->filePath, document->parser->snapshot());
+}
+
+void Engine::collectWrites()
+{
+    for (const auto &result : writer.collect())
+    {
+        if (!result.error.empty())
+        {
+            std::cerr << "Error saving to file: " << result.error << std::endl;
+        }
+        documents.written(result);
+    }
+}
+
+void Engine::dispatchCommand(const std::string &command)
 {
     if (command.rfind("open ", 0) == 0)
     {
         std::string filePath = command.substr(5);
-        openFile(filePath);
+        bool lineDelimited = false;
+        ParseMode mode = ParseMode::DEFAULT;
+        const std::pair<const char *, ParseMode> modes[] = {
+            {"--strict ", ParseMode::STRICT}, {"--lenient ", ParseMode::LENIENT}, {"--lossless ", ParseMode::LOSSLESS}};
+        bool flag = true;
+        while (flag)
+        {
+            flag = false;
+            if (filePath.rfind("--ndjson ", 0) == 0)
+            {
+                lineDelimited = flag = true;
+                filePath = filePath.substr(9);
+            }
+            for (const auto &option : modes)
+            {
+                if (filePath.rfind(option.first, 0) == 0)
+                {
+                    mode = option.second;
+                    flag = true;
+                    filePath = filePath.substr(std::string(option.first).size());
+                }
+            }
+        }
+        std::string name = filePath;
+        size_t pos = filePath.rfind(" as ");
+        if (pos != std::string::npos)
+        {
+            name = filePath.substr(pos + 4);
+            filePath = filePath.substr(0, pos);
+        }
+
+        if (lineDelimited)
+            openFile(filePath, name, InputFormat::NDJSON);
+        else if (mode != ParseMode::DEFAULT)
+            openFile(filePath, name, InputFormat::JSON, mode);
+        else
+            openFile(filePath, name);
+    }
+    else if (command == "maxdepth" || command.rfind("maxdepth ", 0) == 0)
+    {
+        try
+        {
+            if (command.size() > 9)
+            {
+                JSONReader::setMaxDepth(std::stoull(command.substr(9)));
+            }
+            std::cout << "Maximum nesting depth: " << JSONReader::getMaxDepth() << std::endl;
+        }
+        catch (const std::exception &)
+        {
+            std::cerr << "Invalid command format." << std::endl;
+        }
+    }
+    else if (command == "stats")
+    {
+        Stats::print(std::cout);
+    }
+    else if (command == "stats reset")
+    {
+        Stats::reset();
+        std::cout << "Statistics reset." << std::endl;
+    }
+    else if (command.rfind("stats dump ", 0) == 0 || command.rfind("stats dump-on-exit ", 0) == 0)
+    {
+        bool onExit = command.rfind("stats dump-on-exit ", 0) == 0;
+        std::string file = command.substr(onExit ? 19 : 11);
+        if (onExit)
+        {
+            statsDumpPath = file;
+            std::cout << "Statistics will be written to " << file << " on exit." << std::endl;
+        }
+        else
+        {
+            std::ofstream out(file);
+            Stats::writeJSON(out);
+            std::cout << (out ? "Statistics written to " : "Could not write statistics to ") << file << std::endl;
+        }
+    }
+    else if (command.rfind("validate --schema ", 0) == 0)
+    {
+        std::string arguments = command.substr(18);
+        size_t space = arguments.find(' ');
+        if (space == std::string::npos)
+            validateSchema(arguments, "");
+        else
+            validateSchema(arguments.substr(0, space), arguments.substr(space + 1));
+    }
+    else if (command.rfind("extract ", 0) == 0)
+    {
+        extractSubtree(command.substr(8));
+    }
+    else if (command.rfind("use ", 0) == 0)
+    {
+        useDocument(command.substr(4));
+    }
+    else if (command == "docs")
+    {
+        size_t usage = documents.getUsage();
+        for (const auto &entry : documents.list())
+        {
+            std::cout << (entry == document ? "* " : "  ") << entry->name << " (" << entry->filePath << ") "
+                      << (entry->mapped != nullptr ? "mapped" : entry->isLoaded() ? "loaded" : "evicted");
+            if (entry->isLoaded())
+                std::cout << ", " << entry->memoryUsage / 1024 << " KB";
+            std::cout << std::endl;
+        }
+        std::cout << "Cache usage: " << usage / (1024 * 1024) << " MB of " << documents.getBudget() / (1024 * 1024) << " MB" << std::endl;
+    }
+    else if (command.rfind("close ", 0) == 0)
+    {
+        std::string name = command.substr(6);
+        if (document != nullptr && document->name == name)
+        {
+            document = nullptr;
+            documentName.clear();
+            fileLoaded = false;
+            currentFilePath.clear();
+        }
+        std::cout << (documents.close(name) ? "Closed document " : "No open document named ") << name << std::endl;
+    }
+    else if (command.rfind("cache ", 0) == 0)
+    {
+        try
+        {
+            documents.setBudget(std::stoull(command.substr(6)) * 1024 * 1024);
+            std::cout << "Cache budget set to " << documents.getBudget() / (1024 * 1024) << " MB" << std::endl;
+        }
+        catch (const std::exception &)
+        {
+            std::cerr << "Invalid command format." << std::endl;
+        }
+    }
+    else if (document == nullptr)
+    {
+        std::cerr << "No document is loaded. Open one with: open <path>" << std::endl;
+    }
+    else if (command.rfind("query ", 0) == 0)
+    {
+        runQuery(command.substr(6));
+    }
+    else if (command == "memory" || command.rfind("memory ", 0) == 0)
+    {
+        analyzeMemory(command.size() > 7 ? command.substr(7) : "");
+    }
+    else if (document->mapped != nullptr)
+    {
+        executeMappedCommand(command);
+    }
+    else if (command == "persistent on" || command == "persistent off")
+    {
+        setPersistent(command == "persistent on");
+    }
+    else if (command.rfind("apply ", 0) == 0)
+    {
+        applyPatch(command.substr(6));
+    }
+    else if (command.rfind("diff ", 0) == 0)
+    {
+        diffDocument(command.substr(5));
+    }
+    else if (document->history != nullptr)
+    {
+        executePersistentCommand(command);
+    }
+    else if (command == "undo" || command == "redo" || command.rfind("snapshot", 0) == 0 || command.rfind("restore ", 0) == 0)
+    {
+        std::cerr << "Persistent mode is off. Turn it on with: persistent on" << std::endl;
     }
     else if (command == "validate")
     {
-        std::cout << (parser->validate() ? "Valid JSON!" : "Invalid JSON!") << std::endl;
+        std::cout << (document->parser->validate() ? "Valid JSON!" : "Invalid JSON!") << std::endl;
     }
-    else if (command == "print")
+    else if (command == "print" || command.rfind("print ", 0) == 0)
     {
-        parser->printJSON(parser->parse(), 0);
-        std::cout << std::endl;
+        std::string path;
+        size_t depth;
+        size_t limit;
+        if (!readPrintOptions(command.substr(5), path, depth, limit))
+            return;
+        const JSONValue *value = document->parser->findValueByPath(path);
+        if (value != nullptr)
+        {
+            document->parser->printJSON(*value, 0, depth, limit);
+            std::cout << std::endl;
+        }
     }
     else if (command.rfind("search ", 0) == 0)
     {
-        std::string key = command.substr(7);
-        auto results = parser->searchKey(key);
-        std::cout << "[" << std::endl;
+        std::string key;
+        size_t limit;
+        if (!readSearchOptions(command.substr(7), key, limit))
+            return;
+
+        // Matches are appended to one reused string, and lines end without flushing.
+        std::string text;
+        if (document->parser->getFormat() == InputFormat::NDJSON)
+        {
+            auto results = document->parser->searchKeyByLine(key, limit);
+            std::cout << "[\n";
+            for (const auto &result : results)
+            {
+                text.clear();
+                result.second->appendTo(text);
+                std::cout << "line " << result.first << ": " << text << '\n';
+            }
+            std::cout << "]" << std::endl;
+            return;
+        }
+
+        auto results = document->parser->searchKey(key, limit);
+        std::cout << "[\n";
         for (const auto &result : results)
         {
-            std::cout << result->toString() << std::endl;
+            text.clear();
+            result->appendTo(text);
+            std::cout << text << '\n';
         }
         std::cout << "]" << std::endl;
     }
     else if (command.rfind("contains ", 0) == 0)
     {
         std::string value = command.substr(9);
-        if (parser->contains(value))
+        if (document->parser->getFormat() == InputFormat::NDJSON)
+        {
+            auto lines = document->parser->containsByLine(value);
+            if (lines.empty())
+            {
+                std::cout << "The value \"" << value << "\" is not present in the JSON document." << std::endl;
+                return;
+            }
+            std::cout << "The value \"" << value << "\" is present on lines: ";
+            for (size_t i = 0; i < lines.size(); i++)
+            {
+                std::cout << (i > 0 ? ", " : "") << lines[i];
+            }
+            std::cout << std::endl;
+        }
+        else if (document->parser->contains(value))
         {
             std::cout << "The value \"" << value << "\" is present in the JSON document." << std::endl;
         }
@@ -84,7 +625,7 @@ void Engine::executeCommand(const std::string &command)
         std::string path = command.substr(4, pos - 4);
         std::string value = command.substr(pos + 1);
 
-        if (parser->set(path, value))
+        if (document->parser->set(path, value))
         {
             std::cout << "Successfully updated the value at path: " << path << std::endl;
         }
@@ -92,7 +633,8 @@ void Engine::executeCommand(const std::string &command)
         {
             std::cout << "Failed to update the value at path: " << path << std::endl;
         }
-        parser->writeToFile(currentFilePath);
+        document->memoryUsage += document->parser->getEditedBytes();
+        scheduleSave();
     }
     else if (command.rfind("create ", 0) == 0)
     {
@@ -106,7 +648,7 @@ void Engine::executeCommand(const std::string &command)
 
         std::string path = command.substr(7, pos - 7);
         std::string value = command.substr(pos + 1);
-        if (parser->create(path, value))
+        if (document->parser->create(path, value))
         {
             std::cout << "Successfully created the value at path: " << path << std::endl;
         }
@@ -114,12 +656,13 @@ void Engine::executeCommand(const std::string &command)
         {
             std::cout << "Failed to create the value at path: " << path << std::endl;
         }
-        parser->writeToFile(currentFilePath);
+        document->memoryUsage += document->parser->getEditedBytes();
+        scheduleSave();
     }
     else if (command.rfind("delete ", 0) == 0)
     {
         std::string path = command.substr(7);
-        if (parser->deleteElement(path))
+        if (document->parser->deleteElement(path))
         {
             std::cout << "Successfully deleted the value at path: " << path << std::endl;
         }
@@ -127,7 +670,8 @@ void Engine::executeCommand(const std::string &command)
         {
             std::cout << "Failed to delete the value at path: " << path << std::endl;
         }
-        parser->writeToFile(currentFilePath);
+        document->memoryUsage += document->parser->getEditedBytes();
+        scheduleSave();
     }
     else if (command.rfind("move ", 0) == 0)
     {
@@ -139,7 +683,7 @@ void Engine::executeCommand(const std::string &command)
         }
         std::string from = command.substr(5, pos - 5);
         std::string to = command.substr(pos + 1);
-        if (parser->move(from, to))
+        if (document->parser->move(from, to))
         {
             std::cout << "Successfully moved the value from path: " << from << " to path: " << to << std::endl;
         }
@@ -147,11 +691,12 @@ void Engine::executeCommand(const std::string &command)
         {
             std::cout << "Failed to move the value from path: " << from << " to path: " << to << std::endl;
         }
-        parser->writeToFile(currentFilePath);
+        document->memoryUsage += document->parser->getEditedBytes();
+        scheduleSave();
     }
     else if (command == "save")
     {
-        if (parser->save(""))
+        if (document->parser->save(""))
         {
             std::cout << "Successfully saved JSON file " << currentFilePath << std::endl;
         }
@@ -163,7 +708,7 @@ void Engine::executeCommand(const std::string &command)
     else if (command.rfind("save ", 0) == 0)
     {
         std::string path = command.substr(5);
-        if (parser->save(path))
+        if (document->parser->save(path))
         {
             std::cout << "Successfully saved " << path << " in JSON file " << currentFilePath << std::endl;
         }
@@ -172,6 +717,22 @@ void Engine::executeCommand(const std::string &command)
             std::cout << "Failed to save JSON path " << path << std::endl;
         }
     }
+    else if (command.rfind("saveas --binary ", 0) == 0 || command.rfind("saveas --mapped ", 0) == 0)
+    {
+        size_t pos = command.find(" ", 16);
+        std::string file = command.substr(16, pos == std::string::npos ? std::string::npos : pos - 16);
+        std::string path = pos == std::string::npos ? "" : command.substr(pos + 1);
+        bool binary = command.rfind("saveas --binary ", 0) == 0;
+
+        if (document->parser->saveas(file, path, binary ? InputFormat::BINARY : InputFormat::MAPPED))
+        {
+            std::cout << "Successfully saved " << (binary ? "binary snapshot" : "mapped document") << " to " << file << std::endl;
+        }
+        else
+        {
+            std::cout << "Failed to save " << (binary ? "binary snapshot" : "mapped document") << " to " << file << std::endl;
+        }
+    }
     else if (command.rfind("saveas ", 0) == 0)
     {
         size_t pos = command.find(" ", 7);
@@ -185,7 +746,7 @@ void Engine::executeCommand(const std::string &command)
 
         if (path.empty())
         {
-            if (parser->saveas(file, ""))
+            if (document->parser->saveas(file, ""))
             {
                 std::cout << "Successfully saved JSON to " << file << std::endl;
             }
@@ -196,7 +757,7 @@ void Engine::executeCommand(const std::string &command)
         }
         else
         {
-            if (parser->saveas(file, path))
+            if (document->parser->saveas(file, path))
             {
                 std::cout << "Successfully saved the JSON at path: " << path << " to " << file << std::endl;
             }
@@ -212,38 +773,575 @@ void Engine::executeCommand(const std::string &command)
     }
 }
 
-void Engine::openFile(const std::string &filePath)
+void Engine::executeMappedCommand(const std::string &command)
 {
-    std::ifstream file(filePath);
-    if (!file.is_open())
+    if (command == "validate")
     {
-        std::cerr << "File does not exist. Creating a new empty file..." << std::endl;
-        std::ofstream newFile(filePath);
-        newFile << "{}";
-        newFile.close();
-        file.open(filePath);
-        if (!file.is_open())
-        {
-            std::cout << "Could not create the file!" << std::endl;
+        std::cout << "Valid JSON!" << std::endl;
+    }
+    else if (command == "print" || command.rfind("print ", 0) == 0)
+    {
+        std::string path;
+        size_t depth;
+        size_t limit;
+        if (!readPrintOptions(command.substr(5), path, depth, limit))
             return;
+        uint64_t node = document->mapped->findByPath(path);
+        if (node != 0)
+        {
+            document->mapped->writeJSON(std::cout, node, 0, depth, limit);
+            std::cout << std::endl;
         }
     }
-
-    std::string input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-    file.close();
-
-    try
+    else if (command.rfind("search ", 0) == 0)
     {
-        parser = new Parser(input, filePath);
-        fileLoaded = true;
-        currentFilePath = filePath;
-        std::cout << "Successfully loaded file: " << filePath << std::endl;
+        std::string key;
+        size_t limit;
+        if (!readSearchOptions(command.substr(7), key, limit))
+            return;
+        std::vector<uint64_t> results;
+        document->mapped->searchKey(compilePattern(key), results, limit);
+        std::cout << "[\n";
+        for (const auto &result : results)
+        {
+            std::cout << document->mapped->toString(result) << '\n';
+        }
+        std::cout << "]" << std::endl;
+    }
+    else if (command.rfind("contains ", 0) == 0)
+    {
+        std::string value = command.substr(9);
+        if (document->mapped->contains(value))
+        {
+            std::cout << "The value \"" << value << "\" is present in the JSON document." << std::endl;
+        }
+        else
+        {
+            std::cout << "The value \"" << value << "\" is not present in the JSON document." << std::endl;
+        }
+    }
+    else if (command.rfind("save ", 0) == 0)
+    {
+        std::string path = command.substr(5);
+        if (document->mapped->saveas(path, path))
+        {
+            std::cout << "Successfully saved " << path << " from mapped document " << currentFilePath << std::endl;
+        }
+        else
+        {
+            std::cout << "Failed to save JSON path " << path << std::endl;
+        }
+    }
+    else if (command.rfind("saveas ", 0) == 0)
+    {
+        size_t pos = command.find(" ", 7);
+        std::string file = command.substr(7, pos == std::string::npos ? std::string::npos : pos - 7);
+        std::string path = pos == std::string::npos ? "" : command.substr(pos + 1);
+        if (document->mapped->saveas(file, path))
+        {
+            std::cout << "Successfully saved JSON to " << file << std::endl;
+        }
+        else
+        {
+            std::cout << "Failed to save JSON to " << file << std::endl;
+        }
+    }
+    else
+    {
+        std::cerr << "The mapped document " << currentFilePath << " is read-only; command not available: " << command << std::endl;
+    }
+}
+
+void Engine::executePersistentCommand(const std::string &command)
+{
+    bool changed = false;
+
+    if (command == "validate")
+    {
+        // The loaded text only describes the first version, so the current one is written out and read back.
+        std::ostringstream text;
+        PersistentDocument::writeJSON(text, *document->history->getRoot(), 0);
+        std::cout << (document->parser->validate(text.str()) ? "Valid JSON!" : "Invalid JSON!") << std::endl;
+    }
+    else if (command == "print" || command.rfind("print ", 0) == 0)
+    {
+        std::string path;
+        size_t depth;
+        size_t limit;
+        if (!readPrintOptions(command.substr(5), path, depth, limit))
+            return;
+        NodePtr node = document->history->findByPath(path);
+        if (node != nullptr)
+        {
+            PersistentDocument::writeJSON(std::cout, *node, 0, depth, limit);
+            std::cout << std::endl;
+        }
+    }
+    else if (command.rfind("search ", 0) == 0)
+    {
+        std::string key;
+        size_t limit;
+        if (!readSearchOptions(command.substr(7), key, limit))
+            return;
+        auto results = document->history->searchKey(compilePattern(key), limit);
+        std::cout << "[\n";
+        for (const auto &result : results)
+        {
+            std::cout << PersistentDocument::toString(*result) << '\n';
+        }
+        std::cout << "]" << std::endl;
+    }
+    else if (command.rfind("contains ", 0) == 0)
+    {
+        std::string value = command.substr(9);
+        if (document->history->contains(value))
+        {
+            std::cout << "The value \"" << value << "\" is present in the JSON document." << std::endl;
+        }
+        else
+        {
+            std::cout << "The value \"" << value << "\" is not present in the JSON document." << std::endl;
+        }
+    }
+    else if (command.rfind("set ", 0) == 0 || command.rfind("create ", 0) == 0)
+    {
+        bool isSet = command.rfind("set ", 0) == 0;
+        size_t start = isSet ? 4 : 7;
+        size_t pos = command.find(" ", start);
+        if (pos == std::string::npos)
+        {
+            std::cerr << "Invalid command format." << std::endl;
+            return;
+        }
+
+        std::string path = command.substr(start, pos - start);
+        std::string value = command.substr(pos + 1);
+        changed = isSet ? document->history->set(path, value) : document->history->create(path, value);
+        std::cout << (changed ? "Successfully " : "Failed to ") << (isSet ? (changed ? "updated" : "update") : (changed ? "created" : "create"))
+                  << " the value at path: " << path << std::endl;
+    }
+    else if (command.rfind("delete ", 0) == 0)
+    {
+        std::string path = command.substr(7);
+        changed = document->history->deleteElement(path);
+        std::cout << (changed ? "Successfully deleted" : "Failed to delete") << " the value at path: " << path << std::endl;
+    }
+    else if (command.rfind("move ", 0) == 0)
+    {
+        size_t pos = command.find(" ", 5);
+        if (pos == std::string::npos)
+        {
+            std::cerr << "Invalid command format." << std::endl;
+            return;
+        }
+        std::string from = command.substr(5, pos - 5);
+        std::string to = command.substr(pos + 1);
+        changed = document->history->move(from, to);
+        std::cout << (changed ? "Successfully moved" : "Failed to move") << " the value from path: " << from << " to path: " << to << std::endl;
+    }
+    else if (command == "undo" || command == "redo")
+    {
+        changed = command == "undo" ? document->history->undo() : document->history->redo();
+        if (changed)
+        {
+            std::cout << (command == "undo" ? "Reverted the last edit." : "Reapplied the last reverted edit.") << std::endl;
+        }
+        else
+        {
+            std::cout << "Nothing to " << command << "." << std::endl;
+        }
+    }
+    else if (command == "snapshot")
+    {
+        for (const auto &name : document->history->getSnapshotNames())
+        {
+            std::cout << name << std::endl;
+        }
+    }
+    else if (command.rfind("snapshot ", 0) == 0)
+    {
+        document->history->snapshot(command.substr(9));
+        std::cout << "Recorded snapshot " << command.substr(9) << std::endl;
+    }
+    else if (command.rfind("restore ", 0) == 0)
+    {
+        changed = document->history->restore(command.substr(8));
+        std::cout << (changed ? "Restored snapshot " : "Unknown snapshot ") << command.substr(8) << std::endl;
+    }
+    else if (command == "save")
+    {
+        if (document->history->saveas(currentFilePath, ""))
+        {
+            std::cout << "Successfully saved JSON file " << currentFilePath << std::endl;
+        }
+        else
+        {
+            std::cout << "Failed to save the JSON" << std::endl;
+        }
+    }
+    else if (command.rfind("save ", 0) == 0)
+    {
+        std::string path = command.substr(5);
+        if (document->history->saveas(path, path))
+        {
+            std::cout << "Successfully saved " << path << " in JSON file " << currentFilePath << std::endl;
+        }
+        else
+        {
+            std::cout << "Failed to save JSON path " << path << std::endl;
+        }
+    }
+    else if (command.rfind("saveas ", 0) == 0)
+    {
+        size_t pos = command.find(" ", 7);
+        std::string file = command.substr(7, pos == std::string::npos ? std::string::npos : pos - 7);
+        std::string path = pos == std::string::npos ? "" : command.substr(pos + 1);
+        if (document->history->saveas(file, path))
+        {
+            std::cout << "Successfully saved JSON to " << file << std::endl;
+        }
+        else
+        {
+            std::cout << "Failed to save JSON to " << file << std::endl;
+        }
+    }
+    else
+    {
+        std::cerr << "Unknown command: " << command << std::endl;
+    }
+
+    if (changed)
+    {
+        scheduleSave();
+    }
+}
+
+void Engine::setPersistent(bool enabled)
+{
+    if (document->parser == nullptr)
+    {
+        std::cerr << "Persistent mode needs a loaded JSON document." << std::endl;
+        return;
+    }
+
+    if (enabled)
+    {
+        if (document->parser->getFormat() != InputFormat::JSON)
+        {
+            std::cerr << "Persistent mode is only available for JSON documents." << std::endl;
+            return;
+        }
+        if (document->history == nullptr)
+        {
+            document->history = new PersistentDocument(document->parser->parse());
+        }
+        std::cout << "Persistent mode is on." << std::endl;
+    }
+    else
+    {
+        if (document->history != nullptr)
+        {
+            document->parser->setRoot(PersistentDocument::toJSONValue(*document->history->getRoot()));
+            delete document->history;
+            document->history = nullptr;
+            document->resized = true;
+        }
+        std::cout << "Persistent mode is off." << std::endl;
+    }
+}
+
+void Engine::validateSchema(const std::string &schemaPath, const std::string &filePath)
+{
+    std::ifstream schemaFile(schemaPath);
+    if (!schemaFile.is_open())
+    {
+        std::cerr << "Could not open schema " << schemaPath << std::endl;
+        return;
+    }
+    std::stringstream schemaText;
+    schemaText << schemaFile.rdbuf();
+
+    auto cached = schemas.find(schemaPath);
+    if (cached == schemas.end() || cached->second.first != schemaText.str())
+    {
+        try
+        {
+            Schema schema = Schema::compile(JSONReader(schemaText.str()).parse());
+            cached = schemas.insert_or_assign(schemaPath, std::make_pair(schemaText.str(), std::move(schema))).first;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Invalid schema: " << e.what() << std::endl;
+            return;
+        }
+    }
+    const Schema &schema = cached->second.second;
+
+    std::vector<std::string> errors;
+    if (!filePath.empty())
+    {
+        std::string text;
+        try
+        {
+            text = Decompressor::readAll(filePath);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return;
+        }
+        schema.validate(text, errors);
+    }
+    else if (document == nullptr)
+    {
+        std::cerr << "No document is loaded. Open one with: open <path>" << std::endl;
+        return;
+    }
+    else if (document->parser != nullptr && document->history == nullptr && document->parser->getFormat() == InputFormat::NDJSON)
+    {
+        const auto &records = document->parser->getRoot().arrayValue;
+        for (size_t i = 0; i < records.size() && errors.empty(); i++)
+        {
+            if (!schema.validate(*records[i], errors))
+                errors.insert(errors.begin(), "Record " + std::to_string(i + 1) + ":");
+        }
+    }
+    else if (document->mapped != nullptr)
+    {
+        schema.validate(*document->mapped, document->mapped->getRoot(), errors);
+    }
+    else if (document->history != nullptr)
+    {
+        schema.validate(*document->history->getRoot(), errors);
+    }
+    else
+    {
+        schema.validate(document->parser->getRoot(), errors);
+    }
+
+    if (errors.empty())
+    {
+        std::cout << "Valid against schema " << schemaPath << std::endl;
+        return;
+    }
+    std::cout << "Invalid against schema " << schemaPath << ":" << std::endl;
+    for (const auto &error : errors)
+    {
+        std::cout << "  " << error << std::endl;
+    }
+}
+
+bool Engine::readPrintOptions(const std::string &arguments, std::string &path, size_t &depth, size_t &limit)
+{
+    std::istringstream in(arguments);
+    std::string word;
+    path.clear();
+    depth = JSONValue::ANY;
+    limit = JSONValue::ANY;
+    while (in >> word)
+    {
+        if (word == "--depth" && in >> depth)
+            ;
+        else if (word == "--limit" && in >> limit && limit > 0)
+            ;
+        else if (word.rfind("--", 0) != 0 && path.empty())
+            path = word;
+        else
+        {
+            std::cerr << "Invalid command format." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Engine::readSearchOptions(const std::string &arguments, std::string &key, size_t &limit)
+{
+    key = arguments;
+    limit = JSONValue::ANY;
+    size_t option = arguments.rfind(" --limit ");
+    if (option == std::string::npos)
+    {
+        return true;
+    }
+
+    std::istringstream in(arguments.substr(option + 9));
+    char rest;
+    if (!(in >> limit) || limit == 0 || in >> rest)
+    {
+        std::cerr << "Invalid command format." << std::endl;
+        return false;
+    }
+    key = arguments.substr(0, option);
+    return true;
+}
+
+void Engine::runQuery(const std::string &arguments)
+{
+    std::istringstream in(arguments);
+    std::string word;
+    size_t limit = Query::ANY;
+    bool count = false;
+    bool explain = false;
+    std::streampos expressionStart = in.tellg();
+    while (in >> word && word.rfind("--", 0) == 0)
+    {
+        if (word == "--first")
+            limit = 1;
+        else if (word == "--count")
+            count = true;
+        else if (word == "--explain")
+            explain = true;
+        else if (word == "--limit" && in >> limit)
+            ;
+        else
+        {
+            std::cerr << "Invalid command format." << std::endl;
+            return;
+        }
+        expressionStart = in.tellg();
+    }
+    size_t start = expressionStart < 0 ? std::string::npos : arguments.find_first_not_of(' ', static_cast<size_t>(expressionStart));
+    if (start == std::string::npos)
+    {
+        std::cerr << "Invalid command format." << std::endl;
+        return;
+    }
+    std::string expression = arguments.substr(start);
+
+    Query query;
+    try
+    {
+        query = Query::compile(expression);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Invalid query: " << e.what() << std::endl;
+        return;
+    }
+    if (explain)
+    {
+        std::cout << query.explain();
+        return;
+    }
+    if (document->mapped != nullptr)
+    {
+        std::cerr << "Queries are not supported on mapped documents." << std::endl;
+        return;
+    }
+
+    // Persistent documents share structure between versions, so the current version is materialized once.
+    JSONValue snapshot;
+    const JSONValue *root = &document->parser->getRoot();
+    if (document->history != nullptr)
+    {
+        snapshot = PersistentDocument::toJSONValue(*document->history->getRoot());
+        root = &snapshot;
+    }
+
+    if (count)
+    {
+        std::cout << query.run(*root, [](const JSONValue &)
+                               { return true; },
+                               limit)
+                  << " matches" << std::endl;
+        return;
+    }
+    // Matches are written as the members of one JSON array, in the same format as print.
+    bool first = true;
+    std::cout << "[";
+    query.run(*root, [&](const JSONValue &value)
+              {
+                  std::cout << (first ? "\n  " : ",\n  ");
+                  document->parser->writeJSON(std::cout, value, 2);
+                  first = false;
+                  return true; },
+              limit);
+    std::cout << (first ? "]" : "\n]") << std::endl;
+}
+
+void Engine::openFile(const std::string &filePath, const std::string &name)
+{
+    std::string plain = Compressor::stripExtension(filePath);
+    bool lineDelimited = plain.size() > 6 && (plain.compare(plain.size() - 6, 6, ".jsonl") == 0 ||
+                                              (plain.size() > 7 && plain.compare(plain.size() - 7, 7, ".ndjson") == 0));
+    openFile(filePath, name, lineDelimited ? InputFormat::NDJSON : InputFormat::JSON);
+}
+
+void Engine::openFile(const std::string &filePath, const std::string &name, InputFormat format, ParseMode mode)
+{
+    for (const auto &entry : documents.list())
+    {
+        if (entry->name == name && entry->filePath == filePath)
+        {
+            useDocument(name);
+            return;
+        }
+    }
+
+    if (!DocumentCache::isPipe(filePath) && !MappedDocument::isMapped(filePath))
+    {
+        std::ifstream file(filePath);
+        if (!file.is_open())
+        {
+            std::cerr << "File does not exist. Creating a new empty file..." << std::endl;
+            std::ofstream newFile(filePath);
+            if (format == InputFormat::JSON)
+                newFile << "{}";
+            newFile.close();
+            if (!newFile)
+            {
+                std::cout << "Could not create the file!" << std::endl;
+                return;
+            }
+        }
+    }
+
+    try
+    {
+        document = &documents.open(name, filePath, format, mode);
+        documentName = name;
+        fileLoaded = true;
+        currentFilePath = filePath;
+        std::cout << (document->mapped != nullptr ? "Successfully mapped file: " : "Successfully loaded file: ") << filePath << std::endl;
+        if (document->parser != nullptr)
+        {
+            for (const auto &error : document->parser->getLineErrors())
+            {
+                std::cerr << "Skipped line " << error.line << ": " << error.message << std::endl;
+            }
+        }
     }
     catch (const std::exception &e)
     {
         std::cerr << "Error loading file: " << e.what() << std::endl;
-        fileLoaded = false;
-        delete parser;
-        parser = nullptr;
     }
-}
\ No newline at end of file
+}
+
+std::regex Engine::compilePattern(const std::string &pattern)
+{
+    JSON_STATS_ADD(REGEX_COMPILATIONS, 1);
+    return std::regex(pattern);
+}
+
+void Engine::useDocument(const std::string &name)
+{
+    try
+    {
+        Document *target = documents.get(name);
+        if (target == nullptr)
+        {
+            std::cerr << "No open document named " << name << std::endl;
+            return;
+        }
+        document = target;
+        documentName = name;
+        fileLoaded = true;
+        currentFilePath = document->filePath;
+        std::cout << "Switched to document: " << name << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error reloading document: " << e.what() << std::endl;
+    }
+}
@@ -1,10 +1,21 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <unordered_map>
 
-#include "Parser.h"
+#include "Compression.h"
+#include "DocumentCache.h"
+#include "Extractor.h"
+#include "OutputBuffer.h"
+#include "Patch.h"
+#include "Query.h"
+#include "Schema.h"
+#include "ShapeAnalysis.h"
 
 /**
  * Class responsible for handling user input and executing commands to manipulate JSON data using the Parser.
@@ -17,28 +28,218 @@ public:
      */
     Engine();
 
+    /**
+     * Constructs an Engine session working on documents shared with other sessions.
+     * Each session has its own current document, trace and schemas. Callers must make sure
+     * that only read-only commands run at the same time as other sessions' commands.
+     * @param documents Shared document cache.
+     * @param writer Shared background writer.
+     */
+    Engine(DocumentCache &documents, BackgroundWriter &writer);
+
+    /**
+     * Default memory budget for parsed documents, in bytes.
+     */
+    static const size_t DEFAULT_CACHE_BUDGET = 512 * 1024 * 1024;
+
     /**
      * Prompts the user for commands and executes them.
      * If no file is loaded, it first prompts the user to enter the path of the JSON file to manipulate.
+     * Output is collected in an OutputBuffer and written out when a command finishes.
      */
     void prompt();
 
-private:
     /**
      * Executes the given command.
+     * The current document is reloaded first if another process changed its file.
+     * While a trace is being recorded, the command is appended to the trace file.
      * @param command The command to execute.
      */
     void executeCommand(const std::string &command);
 
     /**
-     * Opens the specified file and loads its content into the parser.
+     * Checks whether a command only reads documents, so that sessions may run it at the same time.
+     * docs is not among them, since it reads the sizes that edits of a concurrent document update.
+     * @param command The command to check.
+     * @return True for print, search, contains, query, validate, memory and stats.
+     */
+    static bool isReadOnly(const std::string &command);
+
+    /**
+     * Checks whether a command edits a single path, which a concurrent document can take while readers run.
+     * @param command The command to check.
+     * @return True for set, create, delete and move.
+     */
+    static bool isEdit(const std::string &command);
+
+    /**
+     * Looks up the current document again, since another session may have closed, replaced or evicted it.
+     * @param exclusive Whether the caller has exclusive access, which allows reloading the document
+     *                  once any save of it still in flight has finished.
+     * @return True if the session has no document or its document is ready, false if a read-only
+     *         command cannot run without exclusive access first.
+     */
+    bool resume(bool exclusive);
+
+    /**
+     * Executes a read-only command without checking files for outside changes or collecting
+     * finished writes, so that it does not modify any state shared between sessions.
+     * @param command The command to execute.
+     */
+    void executeReadOnly(const std::string &command);
+
+    /**
+     * Executes an edit next to readers, if the current document allows it: the edit must be
+     * the only one running, and the document must be loaded with a concurrent parser.
+     * Like executeReadOnly, it leaves the state shared between sessions alone: saves it finishes
+     * are collected by the next command that runs through executeCommand.
+     * @param command The command to execute.
+     * @return True if the command ran, false if it needs exclusive access instead.
+     */
+    bool executeEdit(const std::string &command);
+
+private:
+    /**
+     * Dispatches the given command to its handler.
+     * @param command The command to execute.
+     */
+    void dispatchCommand(const std::string &command);
+
+    /**
+     * Opens the specified file under a name and makes it the current document.
      * If the file does not exist, it creates a new file with empty content.
+     * If the file is already open under that name, it switches to it without re-parsing.
+     * Files ending in .ndjson or .jsonl are loaded as NDJSON.
+     * @param filePath Path to the file to open.
+     * @param name Name of the document in the session.
+     */
+    void openFile(const std::string &filePath, const std::string &name);
+
+    /**
+     * Opens the specified file under a name using the given format.
      * @param filePath Path to the file to open.
+     * @param name Name of the document in the session.
+     * @param format Layout of the file content.
+     * @param mode Preset parser policy used for JSON content.
+     */
+    void openFile(const std::string &filePath, const std::string &name, InputFormat format, ParseMode mode = ParseMode::DEFAULT);
+
+    /**
+     * Makes an open document the current one, reloading it if it was evicted from the cache.
+     * @param name Name of the document.
+     */
+    void useDocument(const std::string &name);
+
+    /**
+     * Compiles a search pattern and counts the compilation.
+     * @param pattern Regex pattern.
+     * @return Compiled regex.
+     */
+    static std::regex compilePattern(const std::string &pattern);
+
+    /**
+     * Executes a read-only command against the open MappedDocument.
+     * @param command The command to execute.
+     */
+    void executeMappedCommand(const std::string &command);
+
+    /**
+     * Executes a command against the PersistentDocument while persistent mode is on.
+     * Every edit records a new version, which makes undo, redo and snapshots O(1) to keep.
+     * @param command The command to execute.
+     */
+    void executePersistentCommand(const std::string &command);
+
+    /**
+     * Turns persistent mode on or off for the loaded document.
+     * @param enabled Whether persistent mode should be on.
+     */
+    void setPersistent(bool enabled);
+
+    /**
+     * Validates a JSON file, or the current document, against a schema file.
+     * Compiled schemas are kept per schema file and recompiled only when the file content changes.
+     * @param schemaPath Path to the schema file.
+     * @param filePath Path to the JSON file, or empty to validate the current document.
+     */
+    void validateSchema(const std::string &schemaPath, const std::string &filePath);
+
+    /**
+     * Reads the arguments of the print command: an optional path and the options --depth <n> and
+     * --limit <n>, in any order. Prints an error if they are malformed.
+     * @param arguments Text after "print".
+     * @param path Receives the path, or an empty string for the whole document.
+     * @param depth Receives the number of container levels to print.
+     * @param limit Receives the number of members to print per container.
+     * @return True if the arguments are well formed, false otherwise.
+     */
+    static bool readPrintOptions(const std::string &arguments, std::string &path, size_t &depth, size_t &limit);
+
+    /**
+     * Splits a trailing --limit <n> off the arguments of the search command.
+     * Prints an error if the limit is malformed.
+     * @param arguments Text after "search ".
+     * @param key Receives the key or key pattern.
+     * @param limit Receives the number of matches to print.
+     * @return True if the arguments are well formed, false otherwise.
+     */
+    static bool readSearchOptions(const std::string &arguments, std::string &key, size_t &limit);
+
+    /**
+     * Runs a query against the current document and prints the selected values.
+     * Accepts the options --first, --limit <n>, --count and --explain before the expression.
+     * @param arguments Options followed by the query expression.
+     */
+    void runQuery(const std::string &arguments);
+
+    /**
+     * Applies a JSON Patch or merge patch file to the current document as one edit.
+     * If any operation fails, the document is left unchanged.
+     * @param patchPath Path to the patch file.
+     */
+    void applyPatch(const std::string &patchPath);
+
+    /**
+     * Computes the JSON Patch turning the current document into the content of another file,
+     * and prints it or writes it to a file.
+     * @param arguments Path to the other file, optionally followed by the path of the patch file to write.
+     */
+    void diffDocument(const std::string &arguments);
+
+    /**
+     * Prints the memory accounting and shape statistics of a subtree of the current document,
+     * whether it is parsed, persistent or mapped.
+     * @param path Path to the subtree, empty for the whole document.
+     */
+    void analyzeMemory(const std::string &path);
+
+    /**
+     * Copies the value at a path out of a JSON file into another file by streaming through it,
+     * without opening the file as a document or building its tree.
+     * @param arguments Path to the JSON file and the output file, optionally followed by the path of the value.
+     */
+    void extractSubtree(const std::string &arguments);
+
+    /**
+     * Hands a snapshot of the current document to the background writer.
+     */
+    void scheduleSave();
+
+    /**
+     * Reports the background writes that finished and records their files' new state.
      */
-    void openFile(const std::string &filePath);
+    void collectWrites();
 
 private:
-    Parser *parser = nullptr;
+    std::unique_ptr<DocumentCache> ownedDocuments;
+    std::unique_ptr<BackgroundWriter> ownedWriter;
+    DocumentCache &documents;
+    BackgroundWriter &writer;
+    Document *document = nullptr;
+    std::string documentName;
+    std::ofstream traceFile;
+    std::string statsDumpPath;
+    std::unordered_map<std::string, std::pair<std::string, Schema>> schemas;
     bool fileLoaded = false;
     std::string currentFilePath;
 };
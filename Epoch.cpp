@@ -0,0 +1,184 @@
+#include <thread>
+
+#include "Epoch.h"
+
+std::atomic<uint64_t> Epoch::global{0};
+std::atomic<Epoch::Slot *> Epoch::slots{nullptr};
+std::mutex Epoch::retiredMutex;
+std::vector<Epoch::Retired> Epoch::retired;
+
+Epoch::Guard::Guard()
+{
+    Slot &own = slot();
+    if (own.depth++ > 0)
+    {
+        return;
+    }
+    pin(own);
+}
+
+Epoch::Guard::~Guard()
+{
+    Slot &own = slot();
+    if (--own.depth == 0)
+    {
+        own.epoch.store(IDLE, std::memory_order_release);
+    }
+}
+
+Epoch::Pin::Pin() : own(&claim())
+{
+    pin(*own);
+}
+
+Epoch::Pin::~Pin()
+{
+    own->epoch.store(IDLE, std::memory_order_release);
+    own->claimed.store(false, std::memory_order_release);
+}
+
+Epoch::Slot &Epoch::slot()
+{
+    // Releases the slot when the thread exits, so that the next new thread can reuse it.
+    struct Owner
+    {
+        Slot *slot = nullptr;
+
+        ~Owner()
+        {
+            if (slot != nullptr)
+            {
+                slot->epoch.store(IDLE, std::memory_order_release);
+                slot->claimed.store(false, std::memory_order_release);
+            }
+        }
+    };
+    thread_local Owner owner;
+    if (owner.slot == nullptr)
+    {
+        owner.slot = &claim();
+    }
+    return *owner.slot;
+}
+
+Epoch::Slot &Epoch::claim()
+{
+    for (Slot *candidate = slots.load(std::memory_order_acquire); candidate != nullptr; candidate = candidate->next)
+    {
+        bool expected = false;
+        if (!candidate->claimed.load(std::memory_order_relaxed) &&
+            candidate->claimed.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            candidate->depth = 0;
+            return *candidate;
+        }
+    }
+
+    Slot *created = new Slot();
+    created->claimed.store(true, std::memory_order_relaxed);
+    created->next = slots.load(std::memory_order_relaxed);
+    while (!slots.compare_exchange_weak(created->next, created, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+    return *created;
+}
+
+void Epoch::pin(Slot &own)
+{
+    // The pin only counts once it is visible before the epoch is read again; otherwise a writer
+    // may have advanced past it without seeing it, and the pin is retried with the new epoch.
+    uint64_t epoch = global.load(std::memory_order_relaxed);
+    while (true)
+    {
+        own.epoch.store(epoch, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t current = global.load(std::memory_order_relaxed);
+        if (current == epoch)
+        {
+            break;
+        }
+        epoch = current;
+    }
+}
+
+void Epoch::retire(std::function<void()> reclaim)
+{
+    std::unique_lock<std::mutex> lock(retiredMutex);
+    retired.push_back({global.load(std::memory_order_seq_cst), std::move(reclaim)});
+    if (retired.size() >= COLLECT_THRESHOLD)
+    {
+        tryAdvance();
+        Epoch::reclaim(lock);
+    }
+}
+
+void Epoch::collect()
+{
+    std::unique_lock<std::mutex> lock(retiredMutex);
+    if (!retired.empty())
+    {
+        if (tryAdvance())
+            tryAdvance();
+        reclaim(lock);
+    }
+}
+
+void Epoch::synchronize()
+{
+    std::unique_lock<std::mutex> lock(retiredMutex);
+    uint64_t target = global.load(std::memory_order_seq_cst) + 2;
+    while (global.load(std::memory_order_relaxed) < target)
+    {
+        if (!tryAdvance())
+        {
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+        }
+    }
+    reclaim(lock);
+}
+
+size_t Epoch::pending()
+{
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    return retired.size();
+}
+
+bool Epoch::tryAdvance()
+{
+    uint64_t epoch = global.load(std::memory_order_seq_cst);
+    for (Slot *reader = slots.load(std::memory_order_acquire); reader != nullptr; reader = reader->next)
+    {
+        uint64_t pinned = reader->epoch.load(std::memory_order_seq_cst);
+        if (pinned != IDLE && pinned != epoch)
+        {
+            return false;
+        }
+    }
+    global.store(epoch + 1, std::memory_order_seq_cst);
+    return true;
+}
+
+void Epoch::reclaim(std::unique_lock<std::mutex> &lock)
+{
+    uint64_t epoch = global.load(std::memory_order_relaxed);
+    std::vector<Retired> ready;
+    auto keep = retired.begin();
+    for (auto it = retired.begin(); it != retired.end(); ++it)
+    {
+        if (it->epoch + 2 <= epoch)
+            ready.push_back(std::move(*it));
+        else
+            *keep++ = std::move(*it);
+    }
+    retired.erase(keep, retired.end());
+
+    // Large subtrees take a while to free, so other writers may retire in the meantime.
+    lock.unlock();
+    for (auto &node : ready)
+    {
+        node.reclaim();
+    }
+    lock.lock();
+}
@@ -0,0 +1,148 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/**
+ * Class reclaiming memory that lock-free readers may still be looking at.
+ *
+ * A reader pins the current epoch for as long as it holds a Guard. A writer that unlinks a node
+ * retires it instead of freeing it; the node is tagged with the epoch in which it was retired.
+ * The global epoch only advances once every pinned reader has caught up with it, so by the time
+ * it is two ahead of a node's tag, no reader can still hold a pointer to that node, and it is freed.
+ *
+ * Pinning costs one store and one fence on a slot owned by the reading thread, so readers never
+ * wait for writers or for each other.
+ */
+class Epoch
+{
+private:
+    struct Slot;
+
+public:
+    /**
+     * Class pinning the current epoch for the calling thread while it exists. Guards may be nested.
+     */
+    class Guard
+    {
+    public:
+        Guard();
+
+        ~Guard();
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+    };
+
+    /**
+     * Class pinning the epoch in which it was made until it is destroyed, on whichever thread that
+     * happens. Unlike a Guard it holds a slot of its own, so a version read under it can be handed
+     * to another thread, as a save hands the tree to the BackgroundWriter.
+     */
+    class Pin
+    {
+    public:
+        Pin();
+
+        ~Pin();
+
+        Pin(const Pin &) = delete;
+        Pin &operator=(const Pin &) = delete;
+
+    private:
+        Slot *own;
+    };
+
+    /**
+     * Number of retired nodes after which a retire also tries to reclaim.
+     */
+    static const size_t COLLECT_THRESHOLD = 64;
+
+    /**
+     * Hands over a node that is no longer reachable for new readers.
+     * @param reclaim Function freeing the node, called once no reader can see it any more.
+     */
+    static void retire(std::function<void()> reclaim);
+
+    /**
+     * Advances the epoch as far as every reader has caught up, by at most two steps, and frees the
+     * nodes that became safe. Without pinned readers this frees everything retired before the call.
+     */
+    static void collect();
+
+    /**
+     * Waits until every reader that is active now has finished, then frees everything retired so far.
+     * Must not be called while holding a Guard.
+     */
+    static void synchronize();
+
+    /**
+     * Gets the number of retired nodes that are not freed yet.
+     * @return Number of nodes.
+     */
+    static size_t pending();
+
+private:
+    static const uint64_t IDLE = static_cast<uint64_t>(-1);
+
+    /**
+     * Structure holding the epoch pinned by one thread. Slots are never freed, only handed to a new thread.
+     */
+    struct Slot
+    {
+        std::atomic<uint64_t> epoch{IDLE};
+        std::atomic<bool> claimed{false};
+        size_t depth = 0;
+        Slot *next = nullptr;
+    };
+
+    /**
+     * Structure holding a retired node until it can be freed.
+     */
+    struct Retired
+    {
+        uint64_t epoch;
+        std::function<void()> reclaim;
+    };
+
+    /**
+     * Gets the slot of the calling thread, claiming one on first use.
+     * @return Slot of the calling thread.
+     */
+    static Slot &slot();
+
+    /**
+     * Claims a free slot, or adds a new one if every slot is in use.
+     * @return Claimed slot.
+     */
+    static Slot &claim();
+
+    /**
+     * Pins the current epoch in a slot.
+     * @param own Slot to pin.
+     */
+    static void pin(Slot &own);
+
+    /**
+     * Advances the global epoch by one if no pinned reader lags behind it.
+     * @return True if the epoch advanced.
+     */
+    static bool tryAdvance();
+
+    /**
+     * Frees the retired nodes that no reader can see any more.
+     * @param lock Lock on the retired list, released while the nodes are freed.
+     */
+    static void reclaim(std::unique_lock<std::mutex> &lock);
+
+    static std::atomic<uint64_t> global;
+    static std::atomic<Slot *> slots;
+    static std::mutex retiredMutex;
+    static std::vector<Retired> retired;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include <stdexcept>
+
+#include "Compression.h"
+#include "Extractor.h"
+
+Extractor::Extractor(InputSource source) : source(std::move(source)) {}
+
+size_t Extractor::extractFile(const std::string &filePath, const std::string &outputPath, const std::string &path)
+{
+    std::vector<std::string> keys;
+    if (!path.empty())
+    {
+        size_t start = 0;
+        size_t end;
+        while ((end = path.find('/', start)) != std::string::npos)
+        {
+            keys.push_back(path.substr(start, end - start));
+            start = end + 1;
+        }
+        keys.push_back(path.substr(start));
+    }
+
+    Decompressor decompressor(filePath, Decompressor::detect(filePath));
+    Extractor extractor([&decompressor](std::string &chunk)
+                        { return decompressor.read(chunk); });
+    size_t copied = 0;
+    BackgroundWriter::replaceFile(outputPath, [&](const BackgroundWriter::Sink &sink)
+                                  { copied = extractor.extract(keys, sink); });
+    return copied;
+}
+
+size_t Extractor::extract(const std::vector<std::string> &keys, const BackgroundWriter::Sink &sink)
+{
+    for (const auto &key : keys)
+    {
+        if (peek() != '{')
+        {
+            throw std::runtime_error("Invalid path: " + key + " is not an object.");
+        }
+        expect('{');
+
+        bool found = false;
+        while (!found)
+        {
+            if (peek() == '}')
+            {
+                throw std::runtime_error("Path element not found: " + key);
+            }
+            std::string member = readString();
+            expect(':');
+            if (member == key)
+            {
+                found = true;
+                continue;
+            }
+
+            skipValue();
+            if (peek() == '}')
+            {
+                throw std::runtime_error("Path element not found: " + key);
+            }
+            expect(',');
+        }
+    }
+
+    peek();
+    this->sink = &sink;
+    copyStart = pos;
+    skipValue();
+
+    std::vector<std::string> pieces{chunk.substr(copyStart, pos - copyStart)};
+    copied += pieces[0].size();
+    sink(pieces);
+    this->sink = nullptr;
+    return copied;
+}
+
+bool Extractor::available()
+{
+    if (pos < chunk.size())
+    {
+        return true;
+    }
+
+    if (sink != nullptr && copyStart < chunk.size())
+    {
+        std::vector<std::string> pieces{chunk.substr(copyStart)};
+        copied += pieces[0].size();
+        (*sink)(pieces);
+    }
+    copyStart = 0;
+    offset += chunk.size();
+    pos = 0;
+    while (source && source(chunk))
+    {
+        if (!chunk.empty())
+        {
+            return true;
+        }
+    }
+    chunk.clear();
+    source = nullptr;
+    return false;
+}
+
+char Extractor::peek()
+{
+    while (available())
+    {
+        char c = chunk[pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+        {
+            return c;
+        }
+        pos++;
+    }
+    throw error("Unexpected end of input");
+}
+
+void Extractor::expect(char expected)
+{
+    if (peek() != expected)
+    {
+        throw error(std::string("Expected '") + expected + "'");
+    }
+    pos++;
+}
+
+std::string Extractor::readString()
+{
+    expect('"');
+    std::string text;
+    bool escaped = false;
+    while (available())
+    {
+        char c = chunk[pos++];
+        if (!escaped && c == '"')
+        {
+            return text;
+        }
+        escaped = !escaped && c == '\\';
+        text += c;
+    }
+    throw error("Unterminated string");
+}
+
+void Extractor::skipValue()
+{
+    char first = peek();
+    if (first != '{' && first != '[' && first != '"')
+    {
+        // Numbers and keywords end at the first delimiter.
+        while (available())
+        {
+            char c = chunk[pos];
+            if (c == ',' || c == '}' || c == ']' || c == ' ' || c == '\t' || c == '\n' || c == '\r')
+            {
+                return;
+            }
+            pos++;
+        }
+        return;
+    }
+
+    // Brackets are only counted outside strings; the value ends when the count returns to zero.
+    std::vector<char> closers;
+    bool inString = false;
+    bool escaped = false;
+    while (available())
+    {
+        const char *data = chunk.data();
+        size_t size = chunk.size();
+        for (; pos < size; pos++)
+        {
+            char c = data[pos];
+            if (inString)
+            {
+                if (escaped)
+                {
+                    escaped = false;
+                }
+                else if (c == '\\')
+                {
+                    escaped = true;
+                }
+                else if (c == '"')
+                {
+                    inString = false;
+                    if (closers.empty())
+                    {
+                        pos++;
+                        return;
+                    }
+                }
+                continue;
+            }
+
+            switch (c)
+            {
+            case '"':
+                inString = true;
+                break;
+            case '{':
+                closers.push_back('}');
+                break;
+            case '[':
+                closers.push_back(']');
+                break;
+            case '}':
+            case ']':
+                if (closers.empty() || closers.back() != c)
+                {
+                    throw error(std::string("Unexpected '") + c + "'");
+                }
+                closers.pop_back();
+                if (closers.empty())
+                {
+                    pos++;
+                    return;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    throw error(inString ? "Unterminated string" : "Unexpected end of input");
+}
+
+std::runtime_error Extractor::error(const std::string &message) const
+{
+    return std::runtime_error(message + " at offset " + std::to_string(offset + pos));
+}
@@ -0,0 +1,99 @@
+#ifndef EXTRACTOR_H
+#define EXTRACTOR_H
+
+#include <string>
+#include <vector>
+
+#include "BackgroundWriter.h"
+#include "Lexer.h"
+
+/**
+ * Class copying the value at a path out of a JSON document without building a tree.
+ *
+ * The input is read once, front to back, one chunk at a time. Along the path only member keys
+ * are read; the values of other members are skipped by matching brackets and quotes, without
+ * tokenizing them. The bytes of the matching value are handed to the output as they are read,
+ * so extracting one section of a very large file needs memory for a single chunk only.
+ * Reading stops as soon as the matching value ends.
+ *
+ * Skipped values are not validated, and the extracted text keeps its original formatting.
+ */
+class Extractor
+{
+public:
+    /**
+     * Constructs an Extractor reading from a source.
+     * @param source Function supplying the input.
+     */
+    explicit Extractor(InputSource source);
+
+    /**
+     * Copies a file's value at a path into another file, decompressing and compressing as needed.
+     * The output file is only replaced if the path was found.
+     * Throws std::runtime_error if the path does not exist or the input is malformed.
+     * @param filePath Path to the JSON file to read.
+     * @param outputPath Path to the file to write.
+     * @param path Path of the value, with keys separated by '/'; empty for the whole document.
+     * @return Number of bytes copied.
+     */
+    static size_t extractFile(const std::string &filePath, const std::string &outputPath, const std::string &path);
+
+    /**
+     * Streams the value at a path to a sink.
+     * Throws std::runtime_error if the path does not exist or the input is malformed.
+     * @param keys Keys leading to the value; empty for the whole document.
+     * @param sink Function receiving the bytes of the value.
+     * @return Number of bytes copied.
+     */
+    size_t extract(const std::vector<std::string> &keys, const BackgroundWriter::Sink &sink);
+
+private:
+    /**
+     * Makes the next byte available, reading a new chunk if the current one is used up.
+     * Bytes being copied are handed to the sink before the chunk is replaced.
+     * @return False at the end of the input, true otherwise.
+     */
+    bool available();
+
+    /**
+     * Skips whitespace and returns the next byte without consuming it.
+     * Throws std::runtime_error at the end of the input.
+     * @return Next byte.
+     */
+    char peek();
+
+    /**
+     * Consumes the next byte, which must be the given one.
+     * @param expected Expected byte.
+     */
+    void expect(char expected);
+
+    /**
+     * Reads a string starting at the current position.
+     * @return Contents of the string, without the quotes.
+     */
+    std::string readString();
+
+    /**
+     * Skips the value starting at the current position.
+     */
+    void skipValue();
+
+    /**
+     * Builds an error message for the current position.
+     * @param message Description of the error.
+     * @return Exception to throw.
+     */
+    std::runtime_error error(const std::string &message) const;
+
+private:
+    InputSource source;
+    std::string chunk;
+    size_t pos = 0;
+    size_t offset = 0;
+    const BackgroundWriter::Sink *sink = nullptr;
+    size_t copyStart = 0;
+    size_t copied = 0;
+};
+
+#endif
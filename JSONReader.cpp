@@ -0,0 +1,260 @@
+#include <vector>
+
+#include "JSONReader.h"
+
+std::atomic<size_t> JSONReaderBase::maxDepth(JSONReaderBase::DEFAULT_MAX_DEPTH);
+
+void JSONReaderBase::setMaxDepth(size_t depth)
+{
+    maxDepth = depth;
+}
+
+size_t JSONReaderBase::getMaxDepth()
+{
+    return maxDepth;
+}
+
+size_t JSONReaderBase::findKey(const std::string &key, const JSONValue *object, std::unordered_map<std::string, size_t> &index)
+{
+    // Small objects are scanned directly; the index is only built once an object outgrows the scan.
+    if (object != nullptr && object->objectValue.size() < SCAN_LIMIT)
+    {
+        for (size_t i = 0; i < object->objectValue.size(); i++)
+        {
+            if (object->objectValue[i].key == key)
+            {
+                return i;
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    if (object != nullptr && index.empty())
+    {
+        for (size_t i = 0; i < object->objectValue.size(); i++)
+        {
+            index.emplace(object->objectValue[i].key, i);
+        }
+    }
+    auto inserted = index.emplace(key, object != nullptr ? object->objectValue.size() : index.size());
+    return inserted.second ? NOT_FOUND : inserted.first->second;
+}
+
+template <typename Policy>
+BasicJSONReader<Policy>::BasicJSONReader(const std::string &input) : lexer(input), currentToken(lexer.nextToken()) {}
+
+template <typename Policy>
+JSONValue BasicJSONReader<Policy>::parseValue()
+{
+    return read<true>();
+}
+
+template <typename Policy>
+JSONValue BasicJSONReader<Policy>::parse()
+{
+    JSONValue value = read<true>();
+    if (!atEnd())
+    {
+        throw std::runtime_error("Unexpected characters after the value at " + position());
+    }
+    return value;
+}
+
+template <typename Policy>
+void BasicJSONReader<Policy>::validate()
+{
+    lexer.resetPos();
+    currentToken = lexer.nextToken();
+    read<false>();
+    if (!atEnd())
+    {
+        throw std::runtime_error("Unexpected characters at the end of JSON input.");
+    }
+}
+
+template <typename Policy>
+bool BasicJSONReader<Policy>::atEnd() const
+{
+    return currentToken.type == TokenType::END;
+}
+
+template <typename Policy>
+std::string BasicJSONReader<Policy>::position() const
+{
+    return lexer.position();
+}
+
+template <typename Policy>
+size_t BasicJSONReader<Policy>::getInputSize() const
+{
+    return lexer.getInputSize();
+}
+
+template <typename Policy>
+template <bool Build>
+JSONValue BasicJSONReader<Policy>::read()
+{
+    // Keys are only remembered when a duplicate has to be detected or replaced.
+    constexpr bool trackKeys = Policy::DUPLICATE_KEYS == DuplicateKeys::REJECT ||
+                               (Build && Policy::DUPLICATE_KEYS == DuplicateKeys::LAST_WINS);
+
+    JSONValue result;
+    std::vector<TokenType> closers;
+    std::vector<JSONValue *> open;
+    std::vector<std::unordered_map<std::string, size_t>> keys;
+    JSONValue *target = &result;
+
+    auto beginElement = [&]() -> JSONValue *
+    {
+        if (closers.back() == TokenType::RIGHT_BRACKET)
+        {
+            if constexpr (Build)
+            {
+                open.back()->arrayValue.push_back(new JSONValue());
+                return open.back()->arrayValue.back();
+            }
+            return nullptr;
+        }
+
+        if (currentToken.type != TokenType::STRING)
+            throw std::runtime_error("Expected string key at " + position());
+        std::string key = std::move(currentToken.value);
+        currentToken = lexer.nextToken();
+        if (currentToken.type != TokenType::COLON)
+            throw std::runtime_error("Expected ':' at " + position());
+
+        // A duplicate is reported at its colon, before the value is read, as BasicPushReader does.
+        if constexpr (trackKeys)
+        {
+            size_t existing = findKey(key, Build ? open.back() : nullptr, keys.back());
+            if (existing != NOT_FOUND)
+            {
+                if constexpr (Policy::DUPLICATE_KEYS == DuplicateKeys::REJECT)
+                {
+                    throw std::runtime_error("Duplicate key \"" + key + "\" at " + position());
+                }
+                else if constexpr (Build)
+                {
+                    currentToken = lexer.nextToken();
+                    JSONValue *slot = open.back()->objectValue[existing].value;
+                    *slot = JSONValue();
+                    return slot;
+                }
+            }
+        }
+        currentToken = lexer.nextToken();
+
+        if constexpr (Build)
+        {
+            open.back()->objectValue.push_back(KeyValue(key, new JSONValue()));
+            return open.back()->objectValue.back().value;
+        }
+        return nullptr;
+    };
+
+    while (true)
+    {
+        switch (currentToken.type)
+        {
+        case TokenType::LEFT_BRACE:
+        case TokenType::LEFT_BRACKET:
+        {
+            checkDepth(closers.size());
+            TokenType close = currentToken.type == TokenType::LEFT_BRACE ? TokenType::RIGHT_BRACE : TokenType::RIGHT_BRACKET;
+            if constexpr (Build)
+                target->type = close == TokenType::RIGHT_BRACE ? JSONValueType::OBJECT : JSONValueType::ARRAY;
+            currentToken = lexer.nextToken();
+            if (currentToken.type != close)
+            {
+                closers.push_back(close);
+                if constexpr (Build)
+                    open.push_back(target);
+                if constexpr (trackKeys)
+                    keys.emplace_back();
+                target = beginElement();
+                continue;
+            }
+            currentToken = lexer.nextToken();
+            break;
+        }
+        case TokenType::STRING:
+        case TokenType::NUMBER:
+        case TokenType::TRUE:
+        case TokenType::FALSE:
+        case TokenType::NULL_TYPE:
+            if constexpr (Build)
+                readScalar(*target);
+            currentToken = lexer.nextToken();
+            break;
+        default:
+            throw std::runtime_error("Unexpected token at " + position());
+        }
+
+        while (!closers.empty())
+        {
+            if (currentToken.type == TokenType::COMMA)
+            {
+                currentToken = lexer.nextToken();
+                if (!(Policy::ALLOW_TRAILING_COMMAS && currentToken.type == closers.back()))
+                    break;
+            }
+            else if (currentToken.type != closers.back())
+            {
+                throw std::runtime_error(std::string("Expected '") + (closers.back() == TokenType::RIGHT_BRACE ? "}" : "]") + "' at " + position());
+            }
+
+            currentToken = lexer.nextToken();
+            closers.pop_back();
+            if constexpr (Build)
+                open.pop_back();
+            if constexpr (trackKeys)
+                keys.pop_back();
+        }
+        if (closers.empty())
+        {
+            return result;
+        }
+
+        target = beginElement();
+    }
+}
+
+template <typename Policy>
+void BasicJSONReader<Policy>::checkDepth(size_t depth) const
+{
+    if (depth >= maxDepth)
+    {
+        throw std::runtime_error("Maximum nesting depth of " + std::to_string(maxDepth.load()) + " exceeded at " + position());
+    }
+}
+
+template <typename Policy>
+void BasicJSONReader<Policy>::readScalar(JSONValue &target)
+{
+    switch (currentToken.type)
+    {
+    case TokenType::STRING:
+        target.type = JSONValueType::STRING;
+        target.stringValue = std::move(currentToken.value);
+        break;
+    case TokenType::NUMBER:
+        target.type = JSONValueType::NUMBER;
+        target.numberValue = std::stod(currentToken.value);
+        if constexpr (Policy::RAW_NUMBERS)
+            target.stringValue = std::move(currentToken.value);
+        break;
+    case TokenType::TRUE:
+    case TokenType::FALSE:
+        target.type = JSONValueType::BOOL;
+        target.boolValue = currentToken.type == TokenType::TRUE;
+        break;
+    default:
+        target.type = JSONValueType::NIL;
+        break;
+    }
+}
+
+template class BasicJSONReader<DefaultPolicy>;
+template class BasicJSONReader<StrictPolicy>;
+template class BasicJSONReader<LenientPolicy>;
+template class BasicJSONReader<LosslessPolicy>;
@@ -0,0 +1,130 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+
+#include "Lexer.h"
+#include "JSONValue.h"
+
+/**
+ * Base class holding the settings and helpers shared by every BasicJSONReader and BasicPushReader instantiation.
+ */
+class JSONReaderBase
+{
+public:
+    static const size_t DEFAULT_MAX_DEPTH = 10000;
+
+    /**
+     * Sets the maximum nesting depth accepted by parsing and validation.
+     * Parsing, writing and destruction use explicit stacks, so the limit bounds memory rather than recursion.
+     * @param depth Maximum number of nested objects and arrays.
+     */
+    static void setMaxDepth(size_t depth);
+
+    /**
+     * Gets the maximum nesting depth accepted by parsing and validation.
+     * @return Maximum number of nested objects and arrays.
+     */
+    static size_t getMaxDepth();
+
+protected:
+    static const size_t SCAN_LIMIT = 16;
+    static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+    /**
+     * Looks up a member key among the keys already read for the innermost open object.
+     * @param key Key of the member being read.
+     * @param object Object being built, or nullptr when only validating.
+     * @param index Key index of the object, filled on demand.
+     * @return Position of the earlier member with the same key, or NOT_FOUND.
+     */
+    static size_t findKey(const std::string &key, const JSONValue *object, std::unordered_map<std::string, size_t> &index);
+
+    static std::atomic<size_t> maxDepth;
+};
+
+/**
+ * Class turning JSON text into a JSONValue tree, or only checking it, under a compile-time Policy.
+ * Parsing and validation share one loop over an explicit stack of open containers, instantiated
+ * once with tree building and once without. Instantiations exist for the presets in ParserPolicy.h.
+ */
+template <typename Policy>
+class BasicJSONReader : public JSONReaderBase
+{
+public:
+    /**
+     * Constructs a reader positioned on the first token of the input.
+     * @param input JSON input string.
+     */
+    BasicJSONReader(const std::string &input);
+
+    /**
+     * Parses the value at the current position, leaving any text after it unread.
+     * @return Parsed JSONValue.
+     */
+    JSONValue parseValue();
+
+    /**
+     * Parses the whole input as a single value.
+     * @return Parsed JSONValue.
+     */
+    JSONValue parse();
+
+    /**
+     * Checks the whole input from the beginning without building a tree.
+     * Throws std::runtime_error describing the first error.
+     */
+    void validate();
+
+    /**
+     * Checks whether all of the input has been consumed.
+     * @return True if the current token is the end of the input.
+     */
+    bool atEnd() const;
+
+    /**
+     * Describes the current position for error messages.
+     * @return Position as reported by the lexer.
+     */
+    std::string position() const;
+
+    /**
+     * Gets the size of the input held by the reader.
+     * @return Input size in bytes.
+     */
+    size_t getInputSize() const;
+
+private:
+    /**
+     * Reads one value with an explicit stack of open containers.
+     * @tparam Build Whether to build the tree or only check the input.
+     * @return Parsed JSONValue, or null when Build is false.
+     */
+    template <bool Build>
+    JSONValue read();
+
+    /**
+     * Checks that opening another container does not exceed the nesting limit.
+     * @param depth Number of containers currently open.
+     */
+    void checkDepth(size_t depth) const;
+
+    /**
+     * Builds a scalar JSONValue from the current token.
+     * @param target JSONValue receiving the scalar.
+     */
+    void readScalar(JSONValue &target);
+
+private:
+    BasicLexer<Policy> lexer;
+    Token currentToken;
+};
+
+using JSONReader = BasicJSONReader<DefaultPolicy>;
+using StrictReader = BasicJSONReader<StrictPolicy>;
+using LenientReader = BasicJSONReader<LenientPolicy>;
+using LosslessReader = BasicJSONReader<LosslessPolicy>;
+
+#endif
@@ -7,129 +7,272 @@ JSONValue::JSONValue(const JSONValue &other)
     copy(other);
 }
 
+JSONValue::JSONValue(JSONValue &&other) noexcept
+    : type(other.type), stringValue(std::move(other.stringValue)), numberValue(other.numberValue), boolValue(other.boolValue),
+      arrayValue(std::move(other.arrayValue)), objectValue(std::move(other.objectValue))
+{
+    other.arrayValue.clear();
+    other.objectValue.clear();
+    other.type = JSONValueType::NIL;
+}
+
 JSONValue &JSONValue::operator=(const JSONValue &other)
 {
     if (this != &other)
     {
-        this->~JSONValue();
+        clear();
         copy(other);
     }
 
     return *this;
 }
 
+JSONValue &JSONValue::operator=(JSONValue &&other) noexcept
+{
+    if (this != &other)
+    {
+        clear();
+        type = other.type;
+        stringValue = std::move(other.stringValue);
+        numberValue = other.numberValue;
+        boolValue = other.boolValue;
+        arrayValue = std::move(other.arrayValue);
+        objectValue = std::move(other.objectValue);
+        other.arrayValue.clear();
+        other.objectValue.clear();
+        other.type = JSONValueType::NIL;
+    }
+
+    return *this;
+}
+
 JSONValue::~JSONValue()
 {
-    for (auto val : arrayValue)
-        delete val;
-    for (auto &kv : objectValue)
-        delete kv.value;
+    releaseChildren();
+}
+
+void *JSONValue::operator new(size_t size)
+{
+    JSON_STATS_ADD(NODES_ALLOCATED, 1);
+    return ::operator new(size);
+}
+
+void JSONValue::operator delete(void *pointer)
+{
+    ::operator delete(pointer);
 }
 
 std::string JSONValue::toString() const
 {
-    switch (type)
+    std::string result;
+    appendTo(result);
+    return result;
+}
+
+void JSONValue::appendTo(std::string &result) const
+{
+    struct Frame
     {
-    case JSONValueType::STRING:
-        return "\"" + stringValue + "\"";
-    case JSONValueType::NUMBER:
-        if (numberValue == std::floor(numberValue))
+        const JSONValue *value;
+        size_t next;
+    };
+
+    std::vector<Frame> open;
+    const JSONValue *current = this;
+
+    while (true)
+    {
+        switch (current->type)
         {
-            return std::to_string(static_cast<int>(numberValue));
+        case JSONValueType::STRING:
+            result += '"';
+            result += current->stringValue;
+            result += '"';
+            break;
+        case JSONValueType::NUMBER:
+            if (!current->stringValue.empty())
+            {
+                result += current->stringValue;
+            }
+            else if (current->numberValue == std::floor(current->numberValue))
+            {
+                result += std::to_string(static_cast<int>(current->numberValue));
+            }
+            else
+            {
+                result += std::to_string(current->numberValue);
+            }
+            break;
+        case JSONValueType::BOOL:
+            result += current->boolValue ? "true" : "false";
+            break;
+        case JSONValueType::ARRAY:
+            open.push_back({current, 0});
+            break;
+        case JSONValueType::OBJECT:
+            result += "  {\n";
+            open.push_back({current, 0});
+            break;
+        case JSONValueType::NIL:
+            result += "null";
+            break;
+        default:
+            break;
         }
-        else
+
+        current = nullptr;
+        while (current == nullptr && !open.empty())
         {
-            return std::to_string(numberValue);
+            Frame &frame = open.back();
+            bool isObject = frame.value->type == JSONValueType::OBJECT;
+            size_t count = isObject ? frame.value->objectValue.size() : frame.value->arrayValue.size();
+
+            if (frame.next == count)
+            {
+                if (isObject)
+                    result += "\n  }";
+                open.pop_back();
+                continue;
+            }
+
+            if (frame.next > 0)
+                result += ", \n";
+            if (isObject)
+            {
+                result += "\t\"";
+                result += frame.value->objectValue[frame.next].key;
+                result += "\": ";
+                current = frame.value->objectValue[frame.next].value;
+            }
+            else
+            {
+                current = frame.value->arrayValue[frame.next];
+            }
+            frame.next++;
         }
-    case JSONValueType::BOOL:
-        return boolValue ? "true" : "false";
-    case JSONValueType::ARRAY:
-    {
-        std::string result;
-        for (size_t i = 0; i < arrayValue.size(); i++)
+
+        if (current == nullptr)
         {
-            if (i > 0)
-                result += ", \n";
-            result += arrayValue[i]->toString();
+            return;
         }
-        return result;
     }
-    case JSONValueType::OBJECT:
+}
+
+void JSONValue::searchKey(const std::string &key, std::vector<JSONValue *> &results, size_t limit) const
+{
+    JSON_STATS_ADD(REGEX_COMPILATIONS, 1);
+    searchKey(std::regex(key), results, limit);
+}
+
+void JSONValue::searchKey(const std::regex &pattern, std::vector<JSONValue *> &results, size_t limit) const
+{
+    // Children are pushed in reverse so that matches come out in document order.
+    std::vector<std::pair<const JSONValue *, bool>> pending = {{this, false}};
+    while (!pending.empty() && results.size() < limit)
     {
-        std::string result = "  {\n";
-        for (size_t i = 0; i < objectValue.size(); i++)
+        const JSONValue *current = pending.back().first;
+        if (pending.back().second)
         {
-            if (i > 0)
-                result += ", \n";
-            result += "\t\"" + objectValue[i].key + "\": " + objectValue[i].value->toString();
+            results.push_back(const_cast<JSONValue *>(current));
+        }
+        pending.pop_back();
+
+        for (auto it = current->objectValue.rbegin(); it != current->objectValue.rend(); ++it)
+        {
+            pending.emplace_back(it->value, std::regex_match(it->key, pattern));
+        }
+        for (auto it = current->arrayValue.rbegin(); it != current->arrayValue.rend(); ++it)
+        {
+            pending.emplace_back(*it, false);
         }
-        result += "\n  }";
-        return result;
-    }
-    case JSONValueType::NIL:
-        return "null";
-    default:
-        return "";
     }
 }
 
-void JSONValue::searchKey(const std::string &key, std::vector<JSONValue *> &results) const
+size_t JSONValue::memoryUsage() const
 {
-    searchKey(std::regex(key), results);
+    size_t bytes = 0;
+    std::vector<const JSONValue *> pending = {this};
+    while (!pending.empty())
+    {
+        const JSONValue *current = pending.back();
+        pending.pop_back();
+
+        bytes += sizeof(JSONValue) + (current->stringValue.capacity() > 15 ? current->stringValue.capacity() : 0);
+        bytes += current->arrayValue.capacity() * sizeof(JSONValue *) + current->objectValue.capacity() * sizeof(KeyValue);
+        pending.insert(pending.end(), current->arrayValue.begin(), current->arrayValue.end());
+        for (const auto &kv : current->objectValue)
+        {
+            bytes += kv.key.capacity() > 15 ? kv.key.capacity() : 0;
+            pending.push_back(kv.value);
+        }
+    }
+    return bytes;
 }
 
-void JSONValue::searchKey(const std::regex &pattern, std::vector<JSONValue *> &results) const
+void JSONValue::copy(const JSONValue &other)
 {
-    switch (type)
+    std::vector<std::pair<JSONValue *, const JSONValue *>> pending = {{this, &other}};
+    while (!pending.empty())
     {
-    case JSONValueType::OBJECT:
-        for (const auto &kv : objectValue)
+        JSONValue *target = pending.back().first;
+        const JSONValue *source = pending.back().second;
+        pending.pop_back();
+
+        target->type = source->type;
+        target->stringValue = source->stringValue;
+        target->numberValue = source->numberValue;
+        target->boolValue = source->boolValue;
+
+        target->arrayValue.reserve(source->arrayValue.size());
+        for (const auto &val : source->arrayValue)
         {
-            if (std::regex_match(kv.key, pattern))
-            {
-                results.push_back(kv.value);
-            }
-            kv.value->searchKey(pattern, results);
+            target->arrayValue.push_back(new JSONValue());
+            pending.emplace_back(target->arrayValue.back(), val);
         }
-        break;
-    case JSONValueType::ARRAY:
-        for (const auto &item : arrayValue)
+
+        target->objectValue.reserve(source->objectValue.size());
+        for (const auto &kv : source->objectValue)
         {
-            item->searchKey(pattern, results);
+            target->objectValue.push_back(KeyValue(kv.key, new JSONValue()));
+            pending.emplace_back(target->objectValue.back().value, kv.value);
         }
-        break;
-    default:
-        break;
     }
 }
 
-void JSONValue::copy(const JSONValue &other)
+void JSONValue::releaseChildren()
 {
-    type = other.type;
-    stringValue = other.stringValue;
-    numberValue = other.numberValue;
-    boolValue = other.boolValue;
-
-    for (const auto &val : other.arrayValue)
+    // Each node is emptied before it is deleted, so its destructor has nothing left to recurse into.
+    std::vector<JSONValue *> pending(arrayValue.begin(), arrayValue.end());
+    for (auto &kv : objectValue)
     {
-        arrayValue.push_back(new JSONValue(*val));
+        pending.push_back(kv.value);
     }
+    arrayValue.clear();
+    objectValue.clear();
 
-    for (const auto &kv : other.objectValue)
+    while (!pending.empty())
     {
-        objectValue.push_back(KeyValue(kv.key, new JSONValue(*kv.value)));
+        JSONValue *current = pending.back();
+        pending.pop_back();
+        if (current == nullptr)
+        {
+            // A member whose value was handed to another tree, as ParseCache::reparse does, is left empty.
+            continue;
+        }
+        pending.insert(pending.end(), current->arrayValue.begin(), current->arrayValue.end());
+        for (auto &kv : current->objectValue)
+        {
+            pending.push_back(kv.value);
+        }
+        current->arrayValue.clear();
+        current->objectValue.clear();
+        delete current;
     }
 }
 
 void JSONValue::clear()
 {
-    for (auto val : arrayValue)
-        delete val;
-    for (auto &kv : objectValue)
-        delete kv.value;
-
-    arrayValue.clear();
-    objectValue.clear();
+    releaseChildren();
 
     type = JSONValueType::NIL;
     stringValue.clear();
@@ -5,6 +5,8 @@
 #include <regex>
 #include <cmath>
 
+#include "Stats.h"
+
 /**
  * Enum representing the type of a JSON value.
  */
@@ -45,6 +47,11 @@ struct KeyValue
 class JSONValue
 {
 public:
+    /**
+     * Limit meaning that there is none, for the number of results or the levels and members printed.
+     */
+    static const size_t ANY = static_cast<size_t>(-1);
+
     JSONValueType type;
     std::string stringValue;
     double numberValue;
@@ -57,29 +64,57 @@ public:
 
     JSONValue(const JSONValue &other);
 
+    JSONValue(JSONValue &&other) noexcept;
+
     JSONValue &operator=(const JSONValue &other);
 
+    JSONValue &operator=(JSONValue &&other) noexcept;
+
     ~JSONValue();
 
+    /**
+     * Allocates a JSONValue on the heap and counts the allocation.
+     * @param size Size of the allocation.
+     * @return Pointer to the allocated memory.
+     */
+    static void *operator new(size_t size);
+
+    static void operator delete(void *pointer);
+
     /**
      * Converts the JSON value to a string representation.
      * @return String representation of the JSON value.
      */
     std::string toString() const;
 
+    /**
+     * Appends the string representation returned by toString to a buffer, without building
+     * intermediate strings, so that many values can be written into one buffer.
+     * @param out Buffer receiving the text.
+     */
+    void appendTo(std::string &out) const;
+
     /**
      * Searches for a key in the JSON value and collects all matching values.
      * @param key Key to search for.
      * @param results Vector to store pointers to matching JSON values.
+     * @param limit Number of results after which the search stops.
      */
-    void searchKey(const std::string &key, std::vector<JSONValue *> &results) const;
+    void searchKey(const std::string &key, std::vector<JSONValue *> &results, size_t limit = ANY) const;
 
     /**
      * Searches for keys matching a regex pattern in the JSON value and collects all matching values.
      * @param pattern Regex pattern to match keys against.
      * @param results Vector to store pointers to matching JSON values.
+     * @param limit Number of results after which the search stops.
      */
-    void searchKey(const std::regex &pattern, std::vector<JSONValue *> &results) const;
+    void searchKey(const std::regex &pattern, std::vector<JSONValue *> &results, size_t limit = ANY) const;
+
+    /**
+     * Estimates the heap and inline memory held by the JSON value and its children.
+     * @return Approximate size in bytes.
+     */
+    size_t memoryUsage() const;
 
 private:
     /**
@@ -92,6 +127,11 @@ private:
      * Clears the contents of the JSONValue.
      */
     void clear();
+
+    /**
+     * Deletes every value below this one using an explicit stack, leaving the containers empty.
+     */
+    void releaseChildren();
 };
 
 #endif
\ No newline at end of file
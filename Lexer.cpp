@@ -1,25 +1,58 @@
 #include "Lexer.h"
 
-Lexer::Lexer(const std::string &input) : input(input), pos(0), line(1), column(1) {}
+template <typename Policy>
+BasicLexer<Policy>::BasicLexer(const std::string &input) : input(input), pos(0) {}
 
-size_t Lexer::getLine()
+template <typename Policy>
+size_t BasicLexer<Policy>::getLine()
 {
+    size_t line = 0;
+    size_t column = 0;
+    if constexpr (Policy::TRACK_POSITION)
+        lines.locate(input.data(), input.size(), pos, line, column);
     return line;
 }
 
-size_t Lexer::getColumn()
+template <typename Policy>
+size_t BasicLexer<Policy>::getColumn()
 {
+    size_t line = 0;
+    size_t column = 0;
+    if constexpr (Policy::TRACK_POSITION)
+        lines.locate(input.data(), input.size(), pos, line, column);
     return column;
 }
 
-Token Lexer::nextToken()
+template <typename Policy>
+std::string BasicLexer<Policy>::position() const
+{
+    return lines.describe(input.data(), input.size(), pos, Policy::TRACK_POSITION);
+}
+
+template <typename Policy>
+size_t BasicLexer<Policy>::getInputSize() const
+{
+    return input.size();
+}
+
+template <typename Policy>
+Token BasicLexer<Policy>::nextToken()
 {
     skipWhitespace();
 
     if (pos >= input.length())
     {
+#ifndef JSON_PARSER_NO_STATS
+        JSON_STATS_ADD(TOKENS, tokenCount);
+        JSON_STATS_ADD(BYTES_LEXED, input.size() - countedBytes);
+        tokenCount = 0;
+        countedBytes = input.size();
+#endif
         return {TokenType::END, ""};
     }
+#ifndef JSON_PARSER_NO_STATS
+    tokenCount++;
+#endif
 
     char curr = input[pos];
     switch (curr)
@@ -53,70 +86,101 @@ Token Lexer::nextToken()
         {
             return parseNumber();
         }
-        throw std::runtime_error("Unexpected character at line " + std::to_string(line) + ", column " + std::to_string(column));
+        throw std::runtime_error("Unexpected character at " + position());
     }
 }
 
-void Lexer::resetPos()
+template <typename Policy>
+void BasicLexer<Policy>::resetPos()
 {
     pos = 0;
+#ifndef JSON_PARSER_NO_STATS
+    countedBytes = 0;
+#endif
 }
 
-void Lexer::advance()
+template <typename Policy>
+void BasicLexer<Policy>::skipWhitespace()
 {
-    if (input[pos] == '\n')
-    {
-        line++;
-        column = 1;
-    }
-    else
+    while (pos < input.size())
     {
-        column++;
+        if (isspace(input[pos]))
+        {
+            pos++;
+        }
+        else if (!(Policy::ALLOW_COMMENTS && skipComment()))
+        {
+            return;
+        }
     }
-    pos++;
 }
 
-void Lexer::skipWhitespace()
+template <typename Policy>
+bool BasicLexer<Policy>::skipComment()
 {
-    while (pos < input.size() && isspace(input[pos]))
+    if (input[pos] != '/' || pos + 1 >= input.size() || (input[pos + 1] != '/' && input[pos + 1] != '*'))
     {
-        advance();
+        return false;
     }
+
+    bool block = input[pos + 1] == '*';
+    pos += 2;
+    while (pos < input.size())
+    {
+        if (!block && input[pos] == '\n')
+        {
+            return true;
+        }
+        if (block && input[pos] == '*' && pos + 1 < input.size() && input[pos + 1] == '/')
+        {
+            pos += 2;
+            return true;
+        }
+        pos++;
+    }
+    if (block)
+    {
+        throw std::runtime_error("Unterminated comment at " + position());
+    }
+    return true;
 }
 
-Token Lexer::parseString()
+template <typename Policy>
+Token BasicLexer<Policy>::parseString()
 {
     size_t start = pos + 1;
-    advance();
+    pos++;
     while (pos < input.size() && input[pos] != '"')
     {
-        advance();
+        pos++;
     }
     if (pos >= input.size())
     {
-        throw std::runtime_error("Unterminated string at line " + std::to_string(line) + ", column " + std::to_string(column));
+        throw std::runtime_error("Unterminated string at " + position());
     }
     size_t end = pos;
-    advance();
+    pos++;
     return {TokenType::STRING, input.substr(start, end - start)};
 }
 
-Token Lexer::parseNumber()
+template <typename Policy>
+Token BasicLexer<Policy>::parseNumber()
 {
     size_t start = pos;
     while (pos < input.size() && (isdigit(input[pos]) || input[pos] == '.' || input[pos] == '-' || input[pos] == '+'))
     {
-        advance();
+        pos++;
     }
     return {TokenType::NUMBER, input.substr(start, pos - start)};
 }
 
-Token Lexer::parseKeyword()
+template <typename Policy>
+Token BasicLexer<Policy>::parseKeyword()
 {
     size_t start = pos;
     while (pos < input.size() && isalpha(input[pos]))
     {
-        advance();
+        pos++;
     }
     std::string keyword = input.substr(start, pos - start);
     if (keyword == "true")
@@ -125,5 +189,10 @@ Token Lexer::parseKeyword()
         return {TokenType::FALSE, "false"};
     if (keyword == "null")
         return {TokenType::NULL_TYPE, "null"};
-    throw std::runtime_error("Invalid keyword '" + keyword + "' at line " + std::to_string(line) + ", column " + std::to_string(column));
+    throw std::runtime_error("Invalid keyword '" + keyword + "' at " + position());
 }
+
+template class BasicLexer<DefaultPolicy>;
+template class BasicLexer<StrictPolicy>;
+template class BasicLexer<LenientPolicy>;
+template class BasicLexer<LosslessPolicy>;
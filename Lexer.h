@@ -3,33 +3,59 @@
 
 #pragma once
 
+#include <functional>
 #include <iostream>
+#include "LineIndex.h"
 #include "Token.h"
+#include "ParserPolicy.h"
+#include "Stats.h"
+
+/**
+ * Function supplying the next chunk of a streamed input.
+ * It replaces the contents of the chunk and returns false at the end of the input.
+ */
+using InputSource = std::function<bool(std::string &chunk)>;
 
 /**
  * Class responsible for lexical analysis of JSON input.
+ * The Policy decides at compile time whether comments are skipped and whether errors give
+ * line and column numbers or a byte offset. Only the offset is kept while reading; lines and
+ * columns are worked out from it when an error is reported. Instantiations exist for the presets in ParserPolicy.h.
  */
-class Lexer
+template <typename Policy>
+class BasicLexer
 {
 public:
     /**
      * Constructs a Lexer object with the given input.
      * @param input JSON input string.
      */
-    Lexer(const std::string &input);
+    BasicLexer(const std::string &input);
 
     /**
      * Gets the current line number.
-     * @return Current line number.
+     * @return Current line number, or 0 if the policy does not track positions.
      */
     size_t getLine();
 
     /**
      * Gets the current column number.
-     * @return Current column number.
+     * @return Current column number, or 0 if the policy does not track positions.
      */
     size_t getColumn();
 
+    /**
+     * Describes the current position for error messages, with an excerpt of the line and a caret under it.
+     * @return "line L, column C", or "offset N" if the policy does not track positions, followed by the excerpt.
+     */
+    std::string position() const;
+
+    /**
+     * Gets the size of the input held by the lexer.
+     * @return Input size in bytes.
+     */
+    size_t getInputSize() const;
+
     /**
      * Gets the next token from the input.
      * @return The next token.
@@ -43,14 +69,15 @@ public:
 
 private:
     /**
-     * Advances the current position by one character.
+     * Skips whitespace characters in the input, and comments if the policy allows them.
      */
-    void advance();
+    void skipWhitespace();
 
     /**
-     * Skips whitespace characters in the input.
+     * Skips a // or block comment starting at the current position.
+     * @return True if a comment was skipped, false otherwise.
      */
-    void skipWhitespace();
+    bool skipComment();
 
     /**
      * Parses a string token.
@@ -73,8 +100,13 @@ private:
 private:
     std::string input;
     size_t pos;
-    size_t line;
-    size_t column;
+    LineIndex lines;
+#ifndef JSON_PARSER_NO_STATS
+    size_t tokenCount = 0;
+    size_t countedBytes = 0;
+#endif
 };
 
+using Lexer = BasicLexer<DefaultPolicy>;
+
 #endif
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cstring>
+
+#include "LineIndex.h"
+
+void LineIndex::drop(const char *data, size_t size)
+{
+    const char *lastNewline = nullptr;
+    for (const char *p = data; (p = static_cast<const char *>(std::memchr(p, '\n', data + size - p))) != nullptr; p++)
+    {
+        droppedLines++;
+        lastNewline = p;
+    }
+    droppedColumn = lastNewline != nullptr ? data + size - lastNewline - 1 : droppedColumn + size;
+    dropped += size;
+    starts.clear();
+    scanned = 0;
+}
+
+void LineIndex::locate(const char *text, size_t size, size_t offset, size_t &line, size_t &column) const
+{
+    if (offset < dropped)
+    {
+        // Only the end of the last dropped line is ever asked for, such as a '/' that turned out not to start a comment.
+        line = droppedLines + 1;
+        column = dropped - offset <= droppedColumn ? droppedColumn - (dropped - offset) + 1 : 1;
+        return;
+    }
+
+    size_t position = std::min(offset - dropped, size);
+    extend(text, size, position);
+    size_t passed = std::upper_bound(starts.begin(), starts.end(), position) - starts.begin();
+    line = droppedLines + 1 + passed;
+    column = passed > 0 ? position - starts[passed - 1] + 1 : droppedColumn + position + 1;
+}
+
+std::string LineIndex::describe(const char *text, size_t size, size_t offset, bool byLine) const
+{
+    std::string where = "offset " + std::to_string(offset);
+    if (byLine)
+    {
+        size_t line;
+        size_t column;
+        locate(text, size, offset, line, column);
+        where = "line " + std::to_string(line) + ", column " + std::to_string(column);
+    }
+    if (offset < dropped || size == 0)
+    {
+        return where;
+    }
+
+    size_t position = std::min(offset - dropped, size);
+    extend(text, size, position);
+    size_t passed = std::upper_bound(starts.begin(), starts.end(), position) - starts.begin();
+    size_t lineStart = passed > 0 ? starts[passed - 1] : 0;
+    const char *newline = static_cast<const char *>(std::memchr(text + position, '\n', size - position));
+    size_t lineEnd = newline != nullptr ? newline - text : size;
+    size_t from = position - lineStart > EXCERPT_RADIUS ? position - EXCERPT_RADIUS : lineStart;
+    size_t to = std::min(lineEnd, position + EXCERPT_RADIUS);
+    if (from == to)
+    {
+        return where;
+    }
+
+    std::string shown = from > lineStart ? "..." : "";
+    size_t caret = shown.size() + position - from;
+    for (size_t i = from; i < to; i++)
+    {
+        // Tabs and other control characters would shift the caret, so they are shown as spaces.
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        shown += c < 0x20 || c == 0x7f ? ' ' : text[i];
+    }
+    if (to < lineEnd)
+    {
+        shown += "...";
+    }
+    return where + ":\n    " + shown + "\n    " + std::string(caret, ' ') + "^";
+}
+
+void LineIndex::extend(const char *text, size_t size, size_t position) const
+{
+    size_t limit = std::min(position, size);
+    while (scanned < limit)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(text + scanned, '\n', limit - scanned));
+        if (newline == nullptr)
+        {
+            scanned = limit;
+            break;
+        }
+        scanned = newline - text + 1;
+        starts.push_back(scanned);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Class turning byte offsets into line and column numbers, for error messages only.
+ * Nothing is recorded while text is read: the table of line starts is built on the first lookup,
+ * and only as far as the offset looked up. Text that a streaming reader drops from the front of
+ * its buffer is counted once, in bulk, so that later positions keep their line numbers.
+ */
+class LineIndex
+{
+public:
+    static const size_t EXCERPT_RADIUS = 32;
+
+    /**
+     * Records bytes removed from the front of the text, and forgets the table built for it.
+     * @param data First dropped byte.
+     * @param size Number of dropped bytes.
+     */
+    void drop(const char *data, size_t size);
+
+    /**
+     * Finds the line and column of a position.
+     * @param text Text held after the dropped bytes.
+     * @param size Size of the text.
+     * @param offset Offset from the very start of the input, dropped bytes included.
+     * @param line Receives the 1-based line.
+     * @param column Receives the 1-based column, in bytes.
+     */
+    void locate(const char *text, size_t size, size_t offset, size_t &line, size_t &column) const;
+
+    /**
+     * Describes a position for the end of an error message: where it is, then the line it is on
+     * with a caret under it, clipped to EXCERPT_RADIUS bytes on either side.
+     * @param text Text held after the dropped bytes.
+     * @param size Size of the text.
+     * @param offset Offset from the very start of the input, dropped bytes included.
+     * @param byLine Whether to give the line and column rather than the byte offset.
+     * @return "line L, column C" or "offset N", followed by the excerpt if the position is in the text.
+     */
+    std::string describe(const char *text, size_t size, size_t offset, bool byLine) const;
+
+private:
+    /**
+     * Extends the table of line starts until it covers an offset into the text.
+     * @param text Text held after the dropped bytes.
+     * @param size Size of the text.
+     * @param position Offset into the text.
+     */
+    void extend(const char *text, size_t size, size_t position) const;
+
+    mutable std::vector<size_t> starts;
+    mutable size_t scanned = 0;
+    size_t dropped = 0;
+    size_t droppedLines = 0;
+    size_t droppedColumn = 0;
+};
+
+#endif
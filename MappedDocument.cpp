@@ -0,0 +1,733 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MappedDocument.h"
+#include "BackgroundWriter.h"
+
+namespace
+{
+    const char MAGIC[4] = {'J', 'S', 'N', 'M'};
+    const uint64_t HEADER_SIZE = 32;
+    const uint64_t NODE_HEADER_SIZE = 8;
+    const uint64_t ENTRY_SIZE = 16;
+
+    /**
+     * Serializes a JSONValue tree into the mapped document layout.
+     */
+    class MappedWriter
+    {
+    public:
+        std::string buffer;
+
+        MappedWriter() : buffer(HEADER_SIZE, '\0') {}
+
+        uint64_t writeNode(const JSONValue &value)
+        {
+            struct Frame
+            {
+                const JSONValue *value;
+                size_t next;
+                std::vector<uint64_t> children;
+            };
+
+            // A container is written after its children, so each open one collects the offsets of the
+            // children written so far (key and value for objects) on an explicit stack.
+            std::vector<Frame> open;
+            const JSONValue *current = &value;
+            uint64_t offset = 0;
+            bool written = false;
+            while (true)
+            {
+                if (current != nullptr)
+                {
+                    if (current->type == JSONValueType::OBJECT || current->type == JSONValueType::ARRAY)
+                    {
+                        open.push_back({current, 0, {}});
+                        open.back().children.reserve(current->type == JSONValueType::OBJECT ? 2 * current->objectValue.size() : current->arrayValue.size());
+                    }
+                    else
+                    {
+                        offset = writeScalar(*current);
+                        written = true;
+                    }
+                    current = nullptr;
+                }
+                if (open.empty())
+                {
+                    return offset;
+                }
+
+                Frame &frame = open.back();
+                if (written)
+                {
+                    frame.children.push_back(offset);
+                    written = false;
+                }
+                bool isObject = frame.value->type == JSONValueType::OBJECT;
+                size_t count = isObject ? frame.value->objectValue.size() : frame.value->arrayValue.size();
+                if (frame.next < count)
+                {
+                    if (isObject)
+                    {
+                        frame.children.push_back(writeKey(frame.value->objectValue[frame.next].key));
+                        current = frame.value->objectValue[frame.next].value;
+                    }
+                    else
+                    {
+                        current = frame.value->arrayValue[frame.next];
+                    }
+                    frame.next++;
+                    continue;
+                }
+
+                offset = isObject ? writeObject(*frame.value, frame.children) : writeArray(frame.children);
+                written = true;
+                open.pop_back();
+            }
+        }
+
+    private:
+        std::unordered_map<std::string, uint64_t> keys;
+
+        uint64_t writeObject(const JSONValue &value, const std::vector<uint64_t> &entries)
+        {
+            std::vector<uint32_t> sorted(value.objectValue.size());
+            for (uint32_t i = 0; i < sorted.size(); i++)
+                sorted[i] = i;
+            std::stable_sort(sorted.begin(), sorted.end(), [&](uint32_t a, uint32_t b)
+                             { return value.objectValue[a].key < value.objectValue[b].key; });
+
+            uint64_t offset = beginNode(value.type, sorted.size());
+            buffer.append(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(uint64_t));
+            buffer.append(reinterpret_cast<const char *>(sorted.data()), sorted.size() * sizeof(uint32_t));
+            return offset;
+        }
+
+        uint64_t writeArray(const std::vector<uint64_t> &children)
+        {
+            uint64_t offset = beginNode(JSONValueType::ARRAY, children.size());
+            buffer.append(reinterpret_cast<const char *>(children.data()), children.size() * sizeof(uint64_t));
+            return offset;
+        }
+
+        uint64_t writeScalar(const JSONValue &value)
+        {
+            switch (value.type)
+            {
+            case JSONValueType::STRING:
+            {
+                uint64_t offset = beginNode(value.type, value.stringValue.size());
+                buffer.append(value.stringValue);
+                return offset;
+            }
+            case JSONValueType::NUMBER:
+            {
+                uint64_t offset = beginNode(value.type, 0);
+                append(value.numberValue);
+                return offset;
+            }
+            case JSONValueType::BOOL:
+            {
+                uint64_t offset = beginNode(value.type, 0);
+                buffer.push_back(value.boolValue ? 1 : 0);
+                return offset;
+            }
+            case JSONValueType::NIL:
+                return beginNode(value.type, 0);
+            default:
+                throw std::runtime_error("Unknown JSONType encountered in writeNode.");
+            }
+        }
+
+        template <typename T>
+        void append(const T &raw)
+        {
+            buffer.append(reinterpret_cast<const char *>(&raw), sizeof(raw));
+        }
+
+        void align()
+        {
+            buffer.resize((buffer.size() + 7) & ~static_cast<size_t>(7), '\0');
+        }
+
+        uint64_t beginNode(JSONValueType type, size_t count)
+        {
+            if (count > UINT32_MAX)
+            {
+                throw std::runtime_error("Value too large for a mapped document.");
+            }
+            align();
+            uint64_t offset = buffer.size();
+            append(static_cast<uint32_t>(type));
+            append(static_cast<uint32_t>(count));
+            return offset;
+        }
+
+        uint64_t writeKey(const std::string &key)
+        {
+            auto it = keys.find(key);
+            if (it != keys.end())
+            {
+                return it->second;
+            }
+            uint64_t offset = beginNode(JSONValueType::STRING, key.size());
+            buffer.append(key);
+            keys.emplace(key, offset);
+            return offset;
+        }
+    };
+
+    std::vector<std::string> splitPath(const std::string &path)
+    {
+        JSON_STATS_ADD(PATH_LOOKUPS, 1);
+        std::vector<std::string> keys;
+        size_t start = 0;
+        size_t end = path.find('/');
+
+        while (end != std::string::npos)
+        {
+            keys.push_back(path.substr(start, end - start));
+            start = end + 1;
+            end = path.find('/', start);
+        }
+
+        keys.push_back(path.substr(start));
+        return keys;
+    }
+}
+
+MappedDocument::MappedDocument(const std::string &filePath)
+{
+    fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Could not open mapped document " + filePath + ".");
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < HEADER_SIZE)
+    {
+        ::close(fd);
+        throw std::runtime_error("Mapped document " + filePath + " is truncated.");
+    }
+    size = info.st_size;
+
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        ::close(fd);
+        throw std::runtime_error("Could not map " + filePath + ".");
+    }
+    data = static_cast<const char *>(mapping);
+
+    uint32_t version;
+    uint64_t declaredSize;
+    std::memcpy(&version, data + 4, sizeof(version));
+    std::memcpy(&root, data + 8, sizeof(root));
+    std::memcpy(&declaredSize, data + 16, sizeof(declaredSize));
+    if (std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION || declaredSize != size || root < HEADER_SIZE)
+    {
+        munmap(const_cast<char *>(data), size);
+        ::close(fd);
+        throw std::runtime_error("Invalid or unsupported mapped document " + filePath + ".");
+    }
+}
+
+MappedDocument::~MappedDocument()
+{
+    munmap(const_cast<char *>(data), size);
+    ::close(fd);
+}
+
+bool MappedDocument::isMapped(const std::string &filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void MappedDocument::write(const JSONValue &value, const std::string &filePath)
+{
+    MappedWriter writer;
+    uint64_t rootOffset = writer.writeNode(value);
+    writer.buffer.resize((writer.buffer.size() + 7) & ~static_cast<size_t>(7), '\0');
+
+    uint32_t version = VERSION;
+    uint64_t fileSize = writer.buffer.size();
+    std::memcpy(&writer.buffer[0], MAGIC, sizeof(MAGIC));
+    std::memcpy(&writer.buffer[4], &version, sizeof(version));
+    std::memcpy(&writer.buffer[8], &rootOffset, sizeof(rootOffset));
+    std::memcpy(&writer.buffer[16], &fileSize, sizeof(fileSize));
+
+    std::ofstream outFile(filePath, std::ios::binary);
+    if (!outFile.is_open())
+    {
+        throw std::runtime_error("Could not open file to write.");
+    }
+    outFile.write(writer.buffer.data(), writer.buffer.size());
+    JSON_STATS_ADD(BYTES_WRITTEN, writer.buffer.size());
+    outFile.close();
+}
+
+uint64_t MappedDocument::getRoot() const
+{
+    return root;
+}
+
+uint64_t MappedDocument::findByPath(const std::string &path) const
+{
+    if (path.empty())
+    {
+        return root;
+    }
+
+    uint64_t target = root;
+    for (const auto &key : splitPath(path))
+    {
+        if (typeOf(target) != JSONValueType::OBJECT)
+        {
+            std::cerr << "Invalid path: " << key << " is not an object." << std::endl;
+            return 0;
+        }
+
+        target = findKey(target, key);
+        if (target == 0)
+        {
+            std::cerr << "Path element not found: " << key << std::endl;
+            return 0;
+        }
+    }
+
+    return target;
+}
+
+void MappedDocument::searchKey(const std::regex &pattern, std::vector<uint64_t> &results, size_t limit) const
+{
+    searchKey(root, pattern, results, limit);
+}
+
+bool MappedDocument::contains(const std::string &value) const
+{
+    return containsHelper(root, value);
+}
+
+void MappedDocument::writeJSON(std::ostream &out, uint64_t node, int indent, size_t depth, size_t limit) const
+{
+    struct Frame
+    {
+        uint64_t node;
+        uint32_t next;
+        int indent;
+    };
+
+    std::vector<Frame> open;
+    uint64_t current = node;
+    int currentIndent = indent;
+    while (true)
+    {
+        JSONValueType type = typeOf(current);
+        bool isContainer = type == JSONValueType::OBJECT || type == JSONValueType::ARRAY;
+        if (isContainer && countOf(current) > 0 && open.size() >= depth)
+        {
+            out << (type == JSONValueType::OBJECT ? "{...}" : "[...]");
+        }
+        else
+        {
+            switch (type)
+            {
+            case JSONValueType::OBJECT:
+            case JSONValueType::ARRAY:
+                out << (type == JSONValueType::OBJECT ? "{\n" : "[\n");
+                open.push_back({current, 0, currentIndent});
+                break;
+            case JSONValueType::STRING:
+                out << "\"" << stringOf(current) << "\"";
+                break;
+            case JSONValueType::NUMBER:
+                out << numberOf(current);
+                break;
+            case JSONValueType::BOOL:
+                out << (boolOf(current) ? "true" : "false");
+                break;
+            case JSONValueType::NIL:
+                out << "null";
+                break;
+            }
+        }
+
+        current = 0;
+        while (current == 0 && !open.empty())
+        {
+            Frame &frame = open.back();
+            bool isObject = typeOf(frame.node) == JSONValueType::OBJECT;
+            uint32_t count = countOf(frame.node);
+            uint32_t shown = static_cast<uint32_t>(std::min<size_t>(count, limit));
+            std::string indentStr(frame.indent, ' ');
+
+            // Coming back to a frame after one of its members means that member is complete.
+            if (frame.next > 0)
+                out << (frame.next < count ? ",\n" : "\n");
+            if (frame.next == shown)
+            {
+                if (shown < count)
+                    out << indentStr << "  ... " << count - shown << " more\n";
+                out << indentStr << (isObject ? "}" : "]");
+                open.pop_back();
+                continue;
+            }
+
+            out << indentStr << "  ";
+            if (isObject)
+            {
+                out << "\"" << keyOf(frame.node, frame.next) << "\": ";
+                current = valueOf(frame.node, frame.next);
+            }
+            else
+            {
+                current = childOf(frame.node, frame.next);
+            }
+            currentIndent = frame.indent + 2;
+            frame.next++;
+        }
+
+        if (current == 0)
+        {
+            return;
+        }
+    }
+}
+
+std::string MappedDocument::toString(uint64_t node) const
+{
+    std::string result;
+    appendTo(result, node);
+    return result;
+}
+
+JSONValue MappedDocument::toJSONValue(uint64_t node) const
+{
+    // Every child is allocated in place and filled in from an explicit stack, so nesting is not limited by the call stack.
+    JSONValue value;
+    std::vector<std::pair<uint64_t, JSONValue *>> pending = {{node, &value}};
+    while (!pending.empty())
+    {
+        uint64_t source = pending.back().first;
+        JSONValue *target = pending.back().second;
+        pending.pop_back();
+
+        target->type = typeOf(source);
+        uint32_t count = countOf(source);
+        switch (target->type)
+        {
+        case JSONValueType::STRING:
+            target->stringValue = stringOf(source);
+            break;
+        case JSONValueType::NUMBER:
+            target->numberValue = numberOf(source);
+            break;
+        case JSONValueType::BOOL:
+            target->boolValue = boolOf(source);
+            break;
+        case JSONValueType::ARRAY:
+            target->arrayValue.reserve(count);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                target->arrayValue.push_back(new JSONValue());
+                pending.emplace_back(childOf(source, i), target->arrayValue.back());
+            }
+            break;
+        case JSONValueType::OBJECT:
+            target->objectValue.reserve(count);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                target->objectValue.push_back(KeyValue(keyOf(source, i), new JSONValue()));
+                pending.emplace_back(valueOf(source, i), target->objectValue.back().value);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return value;
+}
+
+void MappedDocument::appendTo(std::string &out, uint64_t node) const
+{
+    struct Frame
+    {
+        uint64_t node;
+        uint32_t next;
+    };
+
+    std::vector<Frame> open;
+    uint64_t current = node;
+    while (true)
+    {
+        switch (typeOf(current))
+        {
+        case JSONValueType::STRING:
+            out += '"';
+            out += stringOf(current);
+            out += '"';
+            break;
+        case JSONValueType::NUMBER:
+        {
+            double number = numberOf(current);
+            if (number == std::floor(number))
+            {
+                out += std::to_string(static_cast<int>(number));
+            }
+            else
+            {
+                out += std::to_string(number);
+            }
+            break;
+        }
+        case JSONValueType::BOOL:
+            out += boolOf(current) ? "true" : "false";
+            break;
+        case JSONValueType::ARRAY:
+            open.push_back({current, 0});
+            break;
+        case JSONValueType::OBJECT:
+            out += "  {\n";
+            open.push_back({current, 0});
+            break;
+        case JSONValueType::NIL:
+            out += "null";
+            break;
+        default:
+            break;
+        }
+
+        current = 0;
+        while (current == 0 && !open.empty())
+        {
+            Frame &frame = open.back();
+            bool isObject = typeOf(frame.node) == JSONValueType::OBJECT;
+            if (frame.next == countOf(frame.node))
+            {
+                if (isObject)
+                    out += "\n  }";
+                open.pop_back();
+                continue;
+            }
+
+            if (frame.next > 0)
+                out += ", \n";
+            if (isObject)
+            {
+                out += "\t\"";
+                out += keyOf(frame.node, frame.next);
+                out += "\": ";
+                current = valueOf(frame.node, frame.next);
+            }
+            else
+            {
+                current = childOf(frame.node, frame.next);
+            }
+            frame.next++;
+        }
+
+        if (current == 0)
+        {
+            return;
+        }
+    }
+}
+
+bool MappedDocument::saveas(const std::string &file, const std::string &path) const
+{
+    uint64_t node = findByPath(path);
+    if (node == 0)
+    {
+        std::cerr << "Invalid path." << std::endl;
+        return false;
+    }
+
+    try
+    {
+        std::ostringstream out;
+        writeJSON(out, node, 0);
+        BackgroundWriter::replaceFile(file, out.str());
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error saving to file: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+const char *MappedDocument::at(uint64_t offset, uint64_t bytes) const
+{
+    if (offset > size || bytes > size - offset)
+    {
+        throw std::runtime_error("Corrupt mapped document: offset " + std::to_string(offset) + " is out of range.");
+    }
+    return data + offset;
+}
+
+JSONValueType MappedDocument::typeOf(uint64_t node) const
+{
+    uint32_t type;
+    std::memcpy(&type, at(node, NODE_HEADER_SIZE), sizeof(type));
+    if (type > static_cast<uint32_t>(JSONValueType::NIL))
+    {
+        throw std::runtime_error("Corrupt mapped document: invalid node type.");
+    }
+    return static_cast<JSONValueType>(type);
+}
+
+uint32_t MappedDocument::countOf(uint64_t node) const
+{
+    uint32_t count;
+    std::memcpy(&count, at(node, NODE_HEADER_SIZE) + 4, sizeof(count));
+    return count;
+}
+
+std::string MappedDocument::stringOf(uint64_t node) const
+{
+    uint32_t length = countOf(node);
+    return std::string(at(node + NODE_HEADER_SIZE, length), length);
+}
+
+double MappedDocument::numberOf(uint64_t node) const
+{
+    double number;
+    std::memcpy(&number, at(node + NODE_HEADER_SIZE, sizeof(number)), sizeof(number));
+    return number;
+}
+
+bool MappedDocument::boolOf(uint64_t node) const
+{
+    return *at(node + NODE_HEADER_SIZE, 1) != 0;
+}
+
+uint64_t MappedDocument::childOf(uint64_t node, uint32_t index) const
+{
+    uint64_t child;
+    std::memcpy(&child, at(node + NODE_HEADER_SIZE + index * sizeof(uint64_t), sizeof(child)), sizeof(child));
+    return child;
+}
+
+std::string MappedDocument::keyOf(uint64_t node, uint32_t index) const
+{
+    uint64_t key;
+    std::memcpy(&key, at(node + NODE_HEADER_SIZE + index * ENTRY_SIZE, sizeof(key)), sizeof(key));
+    return stringOf(key);
+}
+
+uint64_t MappedDocument::valueOf(uint64_t node, uint32_t index) const
+{
+    uint64_t value;
+    std::memcpy(&value, at(node + NODE_HEADER_SIZE + index * ENTRY_SIZE + 8, sizeof(value)), sizeof(value));
+    return value;
+}
+
+uint64_t MappedDocument::findKey(uint64_t node, const std::string &key) const
+{
+    uint32_t count = countOf(node);
+    uint64_t sortedIndex = node + NODE_HEADER_SIZE + count * ENTRY_SIZE;
+    const char *indices = at(sortedIndex, count * sizeof(uint32_t));
+
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        uint32_t entry;
+        std::memcpy(&entry, indices + middle * sizeof(uint32_t), sizeof(entry));
+        if (keyOf(node, entry) < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (low == count)
+    {
+        return 0;
+    }
+    uint32_t entry;
+    std::memcpy(&entry, indices + low * sizeof(uint32_t), sizeof(entry));
+    return keyOf(node, entry) == key ? valueOf(node, entry) : 0;
+}
+
+void MappedDocument::searchKey(uint64_t node, const std::regex &pattern, std::vector<uint64_t> &results, size_t limit) const
+{
+    // Children are pushed in reverse so that matches come out in document order.
+    std::vector<std::pair<uint64_t, bool>> pending = {{node, false}};
+    while (!pending.empty() && results.size() < limit)
+    {
+        uint64_t current = pending.back().first;
+        if (pending.back().second)
+        {
+            results.push_back(current);
+        }
+        pending.pop_back();
+
+        uint32_t count = countOf(current);
+        switch (typeOf(current))
+        {
+        case JSONValueType::OBJECT:
+            for (uint32_t i = count; i > 0; i--)
+            {
+                pending.emplace_back(valueOf(current, i - 1), std::regex_match(keyOf(current, i - 1), pattern));
+            }
+            break;
+        case JSONValueType::ARRAY:
+            for (uint32_t i = count; i > 0; i--)
+            {
+                pending.emplace_back(childOf(current, i - 1), false);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+bool MappedDocument::containsHelper(uint64_t node, const std::string &value) const
+{
+    std::vector<uint64_t> pending = {node};
+    while (!pending.empty())
+    {
+        uint64_t current = pending.back();
+        pending.pop_back();
+
+        uint32_t count = countOf(current);
+        switch (typeOf(current))
+        {
+        case JSONValueType::OBJECT:
+            for (uint32_t i = 0; i < count; i++)
+                pending.push_back(valueOf(current, i));
+            break;
+        case JSONValueType::ARRAY:
+            for (uint32_t i = 0; i < count; i++)
+                pending.push_back(childOf(current, i));
+            break;
+        case JSONValueType::STRING:
+        {
+            const char *begin = at(current + NODE_HEADER_SIZE, count);
+            // An empty value is found in every string, the empty one included, as in Parser::contains.
+            if (value.empty() || std::search(begin, begin + count, value.begin(), value.end()) != begin + count)
+                return true;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,205 @@
+#ifndef MAPPED_DOCUMENT_H
+#define MAPPED_DOCUMENT_H
+
+#include <cstdint>
+#include <ostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "JSONValue.h"
+
+/**
+ * Class representing a read-only JSON document which is memory-mapped and queried in place.
+ *
+ * The file starts with a 32-byte header: the magic "JSNM", a 32-bit version, the offset of
+ * the root node and the file size. Every node is 8-byte aligned and starts with a 32-bit
+ * JSONValueType and a 32-bit count. Strings store their length in the count followed by
+ * the bytes, numbers a raw double, booleans a single byte. Arrays store one 64-bit child
+ * offset per element. Objects store (key offset, value offset) pairs in document order
+ * followed by 32-bit entry indices sorted by key, which makes key lookups a binary search.
+ * Keys live in a deduplicated key table of length-prefixed strings.
+ *
+ * Opening maps the file with MAP_SHARED, so the cost does not depend on the document size
+ * and several processes share the same page cache.
+ */
+class MappedDocument
+{
+public:
+    /**
+     * Maps the given file.
+     * @param filePath Path to a file written by MappedDocument::write.
+     */
+    explicit MappedDocument(const std::string &filePath);
+
+    MappedDocument(const MappedDocument &) = delete;
+
+    MappedDocument &operator=(const MappedDocument &) = delete;
+
+    ~MappedDocument();
+
+    /**
+     * Checks whether a file starts with the mapped document header.
+     * @param filePath Path to the file.
+     * @return True if the file is a mapped document, false otherwise.
+     */
+    static bool isMapped(const std::string &filePath);
+
+    /**
+     * Writes a JSONValue in the mapped document layout.
+     * @param value JSONValue to be written.
+     * @param filePath Path to the file.
+     */
+    static void write(const JSONValue &value, const std::string &filePath);
+
+    /**
+     * Gets the offset of the root node.
+     * @return Root node offset.
+     */
+    uint64_t getRoot() const;
+
+    /**
+     * Finds a node by a given path.
+     * @param path Path to the JSON element.
+     * @return Offset of the node if found, 0 otherwise.
+     */
+    uint64_t findByPath(const std::string &path) const;
+
+    /**
+     * Searches for keys matching a regex pattern and collects the matching nodes.
+     * @param pattern Regex pattern to match keys against.
+     * @param results Vector to store the offsets of matching nodes.
+     * @param limit Number of matches after which the search stops.
+     */
+    void searchKey(const std::regex &pattern, std::vector<uint64_t> &results, size_t limit = JSONValue::ANY) const;
+
+    /**
+     * Checks if a value is contained in the document.
+     * @param value Value to search for.
+     * @return True if the value is found, false otherwise.
+     */
+    bool contains(const std::string &value) const;
+
+    /**
+     * Writes a node to an output stream with indentation, in the same format as Parser.
+     * @param out Output stream.
+     * @param node Offset of the node.
+     * @param indent Current indentation level.
+     * @param depth Number of container levels to open; deeper containers are written as {...} or [...].
+     * @param limit Number of members written per container; the rest are summed up as "... N more".
+     */
+    void writeJSON(std::ostream &out, uint64_t node, int indent, size_t depth = JSONValue::ANY, size_t limit = JSONValue::ANY) const;
+
+    /**
+     * Converts a node to the string representation used by JSONValue::toString.
+     * @param node Offset of the node.
+     * @return String representation of the node.
+     */
+    std::string toString(uint64_t node) const;
+
+    /**
+     * Converts a node to a JSONValue tree.
+     * @param node Offset of the node.
+     * @return Equivalent JSONValue.
+     */
+    JSONValue toJSONValue(uint64_t node) const;
+
+    /**
+     * Saves a node as JSON text to a file, replacing it atomically and compressing it as its extension asks.
+     * @param file Path to the file where the JSON will be saved.
+     * @param path Optional path within the document to save.
+     * @return True if the JSON is successfully saved, false otherwise.
+     */
+    bool saveas(const std::string &file, const std::string &path) const;
+
+    /**
+     * Gets the JSONValueType stored in a node header.
+     */
+    JSONValueType typeOf(uint64_t node) const;
+
+    /**
+     * Gets the element count or string length stored in a node header.
+     */
+    uint32_t countOf(uint64_t node) const;
+
+    /**
+     * Gets the payload of a string node.
+     */
+    std::string stringOf(uint64_t node) const;
+
+    /**
+     * Gets the payload of a number node.
+     */
+    double numberOf(uint64_t node) const;
+
+    /**
+     * Gets the payload of a boolean node.
+     */
+    bool boolOf(uint64_t node) const;
+
+    /**
+     * Gets the offset of an array element.
+     */
+    uint64_t childOf(uint64_t node, uint32_t index) const;
+
+    /**
+     * Gets the key of an object entry in document order.
+     */
+    std::string keyOf(uint64_t node, uint32_t index) const;
+
+    /**
+     * Gets the offset of the value of an object entry in document order.
+     */
+    uint64_t valueOf(uint64_t node, uint32_t index) const;
+
+    static const uint32_t VERSION = 1;
+
+private:
+    /**
+     * Returns a pointer into the mapping after checking the range lies inside the file.
+     * @param offset Offset of the first byte.
+     * @param bytes Number of bytes which will be read.
+     * @return Pointer to the first byte.
+     */
+    const char *at(uint64_t offset, uint64_t bytes) const;
+
+    /**
+     * Looks up a key in an object node using its sorted index.
+     * @param node Offset of the object node.
+     * @param key Key to look up.
+     * @return Offset of the value if found, 0 otherwise.
+     */
+    uint64_t findKey(uint64_t node, const std::string &key) const;
+
+    /**
+     * Searches a subtree for keys matching a regex pattern.
+     * @param node Offset of the subtree root.
+     * @param pattern Regex pattern to match keys against.
+     * @param results Vector to store the offsets of matching nodes.
+     * @param limit Number of matches after which the search stops.
+     */
+    void searchKey(uint64_t node, const std::regex &pattern, std::vector<uint64_t> &results, size_t limit) const;
+
+    /**
+     * Appends the string representation used by JSONValue::toString to a string.
+     * @param out String to append to.
+     * @param node Offset of the node.
+     */
+    void appendTo(std::string &out, uint64_t node) const;
+
+    /**
+     * Helper function to check if a value is contained in a subtree.
+     * @param node Offset of the subtree root.
+     * @param value Value to search for.
+     * @return True if the value is found, false otherwise.
+     */
+    bool containsHelper(uint64_t node, const std::string &value) const;
+
+private:
+    int fd = -1;
+    const char *data = nullptr;
+    uint64_t size = 0;
+    uint64_t root = 0;
+};
+
+#endif
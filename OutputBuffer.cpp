@@ -0,0 +1,41 @@
+#include "OutputBuffer.h"
+
+OutputBuffer::OutputBuffer(std::ostream &stream) : stream(stream), block(CAPACITY)
+{
+    setp(block.data(), block.data() + block.size());
+    target = stream.rdbuf(this);
+}
+
+OutputBuffer::~OutputBuffer()
+{
+    sync();
+    stream.rdbuf(target);
+}
+
+int OutputBuffer::overflow(int c)
+{
+    if (!drain())
+    {
+        return traits_type::eof();
+    }
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+}
+
+int OutputBuffer::sync()
+{
+    return drain() && target->pubsync() == 0 ? 0 : -1;
+}
+
+bool OutputBuffer::drain()
+{
+    std::streamsize size = pptr() - pbase();
+    std::streamsize written = size > 0 ? target->sputn(pbase(), size) : 0;
+    setp(block.data(), block.data() + block.size());
+    return written == size;
+}
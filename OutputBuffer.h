@@ -0,0 +1,60 @@
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+/**
+ * Class collecting what is written to a stream in one large block and handing it to the stream's
+ * own buffer only when the block fills or the stream is flushed.
+ * Printing a document writes many short pieces; through std::cout each of them would otherwise
+ * go to the C stdio buffer on its own, with a lock taken every time. The buffer is installed on
+ * the stream for as long as it exists, and everything still in it is written out when it goes.
+ */
+class OutputBuffer : public std::streambuf
+{
+public:
+    static const size_t CAPACITY = 1 << 16;
+
+    /**
+     * Installs the buffer on a stream.
+     * @param stream Stream whose output is buffered.
+     */
+    explicit OutputBuffer(std::ostream &stream);
+
+    /**
+     * Writes out what is left and gives the stream its own buffer back.
+     */
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer &) = delete;
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+protected:
+    /**
+     * Writes out the full block to make room for one more character.
+     * @param c Character that did not fit, or EOF.
+     * @return The character, or EOF if the stream's own buffer failed.
+     */
+    int overflow(int c) override;
+
+    /**
+     * Writes out the block and flushes the stream's own buffer.
+     * @return 0 on success, -1 otherwise.
+     */
+    int sync() override;
+
+private:
+    /**
+     * Hands the collected bytes to the stream's own buffer.
+     * @return True if all of them were taken.
+     */
+    bool drain();
+
+    std::ostream &stream;
+    std::streambuf *target;
+    std::vector<char> block;
+};
+
+#endif
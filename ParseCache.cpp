@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+
+#include "ParseCache.h"
+#include "Parser.h"
+
+namespace
+{
+    size_t skipWhitespace(const std::string &input, size_t pos)
+    {
+        while (pos < input.size() && isspace(static_cast<unsigned char>(input[pos])))
+            pos++;
+        return pos;
+    }
+}
+
+uint64_t ParseCache::hash(const char *data, size_t size)
+{
+    uint64_t result = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        result ^= static_cast<unsigned char>(data[i]);
+        result *= 1099511628211ULL;
+    }
+    return result;
+}
+
+uint64_t ParseCache::check(uint64_t state, char c)
+{
+    state = (state + static_cast<unsigned char>(c) + 1) * 0x9E3779B97F4A7C15ULL;
+    return state ^ (state >> 29);
+}
+
+bool ParseCache::unchanged(const std::string &input) const
+{
+    return valid && input.size() == contentSize && hash(input.data(), input.size()) == contentHash;
+}
+
+bool ParseCache::unchanged(const ParseCache &other) const
+{
+    return valid && other.valid && contentSize == other.contentSize && contentHash == other.contentHash;
+}
+
+void ParseCache::record(const std::string &input)
+{
+    begin();
+    feed(input.data(), input.size());
+    finish();
+}
+
+void ParseCache::begin()
+{
+    valid = false;
+    contentSize = 0;
+    contentHash = hash(nullptr, 0);
+    scanned.clear();
+    scanState = ScanState::BEFORE_OBJECT;
+}
+
+void ParseCache::feed(const char *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        contentHash ^= static_cast<unsigned char>(data[i]);
+        contentHash *= 1099511628211ULL;
+    }
+    contentSize += size;
+
+    // The same member boundaries and hashes as scanMembers, computed one byte at a time so
+    // that the text never has to be in one piece. Whitespace inside a value is held back
+    // until the next significant byte, since trailing whitespace is not part of the member.
+    for (size_t i = 0; i < size && scanState != ScanState::FAILED; i++)
+    {
+        char c = data[i];
+        bool space = isspace(static_cast<unsigned char>(c));
+        switch (scanState)
+        {
+        case ScanState::BEFORE_OBJECT:
+            if (!space)
+                scanState = c == '{' ? ScanState::AFTER_OPEN : ScanState::FAILED;
+            break;
+        case ScanState::AFTER_OPEN:
+        case ScanState::BEFORE_KEY:
+            if (space)
+                break;
+            if (c == '}' && scanState == ScanState::AFTER_OPEN)
+                scanState = ScanState::TRAILING;
+            else if (c == '"')
+            {
+                scanKey.clear();
+                scanState = ScanState::KEY;
+            }
+            else
+                scanState = ScanState::FAILED;
+            break;
+        case ScanState::KEY:
+            if (c == '"')
+                scanState = ScanState::AFTER_KEY;
+            else
+                scanKey += c;
+            break;
+        case ScanState::AFTER_KEY:
+            if (!space)
+                scanState = c == ':' ? ScanState::BEFORE_VALUE : ScanState::FAILED;
+            break;
+        case ScanState::BEFORE_VALUE:
+            if (space)
+                break;
+            if (c == ',' || c == '}' || c == ']')
+            {
+                scanState = ScanState::FAILED;
+                break;
+            }
+            scanHash = hash(nullptr, 0);
+            scanCheck = 0;
+            scanLength = 0;
+            scanSpaces.clear();
+            scanDepth = 0;
+            scanInString = false;
+            scanState = ScanState::VALUE;
+            // fall through
+        case ScanState::VALUE:
+            if (!scanInString && scanDepth == 0 && (c == ',' || c == '}' || c == ']'))
+            {
+                scanned.push_back({scanKey, scanHash, 0, scanLength, scanCheck});
+                scanState = c == '}' ? ScanState::TRAILING : ScanState::BEFORE_KEY;
+                break;
+            }
+            if (space && !scanInString)
+            {
+                scanSpaces += c;
+                break;
+            }
+            if (scanInString)
+                scanInString = c != '"';
+            else if (c == '"')
+                scanInString = true;
+            else if (c == '{' || c == '[')
+                scanDepth++;
+            else if (c == '}' || c == ']')
+                scanDepth--;
+            scanSpaces += c;
+            for (char pending : scanSpaces)
+            {
+                scanHash ^= static_cast<unsigned char>(pending);
+                scanHash *= 1099511628211ULL;
+                scanCheck = check(scanCheck, pending);
+            }
+            scanLength += scanSpaces.size();
+            scanSpaces.clear();
+            break;
+        case ScanState::TRAILING:
+            if (!space)
+                scanState = ScanState::FAILED;
+            break;
+        case ScanState::FAILED:
+            break;
+        }
+    }
+}
+
+void ParseCache::finish()
+{
+    valid = true;
+    if (scanState == ScanState::TRAILING)
+        members.swap(scanned);
+    else
+        members.clear();
+    scanned.clear();
+    scanState = ScanState::FAILED;
+}
+
+void ParseCache::clear()
+{
+    valid = false;
+    members.clear();
+}
+
+JSONValue ParseCache::reparse(const std::string &input, JSONValue &previous, size_t &reused)
+{
+    reused = 0;
+    std::vector<Member> current;
+    bool aligned = valid && previous.type == JSONValueType::OBJECT && previous.objectValue.size() == members.size();
+    for (size_t i = 0; aligned && i < members.size(); i++)
+    {
+        aligned = previous.objectValue[i].key == members[i].key;
+    }
+
+    if (!aligned || !scanMembers(input, current))
+    {
+        JSONValue root = Parser::parseRecord(input);
+        record(input);
+        return root;
+    }
+
+    std::unordered_multimap<uint64_t, size_t> available;
+    for (size_t i = 0; i < members.size(); i++)
+    {
+        available.emplace(members[i].hash, i);
+    }
+
+    std::vector<size_t> sources(current.size(), members.size());
+    for (size_t i = 0; i < current.size(); i++)
+    {
+        auto range = available.equal_range(current[i].hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            const Member &recorded = members[it->second];
+            if (recorded.length == current[i].length && recorded.check == current[i].check &&
+                previous.objectValue[it->second].key == current[i].key && previous.objectValue[it->second].value != nullptr)
+            {
+                sources[i] = it->second;
+                available.erase(it);
+                break;
+            }
+        }
+    }
+
+    std::vector<JSONValue> parsed(current.size());
+    for (size_t i = 0; i < current.size(); i++)
+    {
+        if (sources[i] == members.size())
+        {
+            parsed[i] = Parser::parseRecord(input.substr(current[i].start, current[i].length));
+        }
+    }
+
+    JSONValue root;
+    root.type = JSONValueType::OBJECT;
+    root.objectValue.reserve(current.size());
+    for (size_t i = 0; i < current.size(); i++)
+    {
+        JSONValue *value;
+        if (sources[i] == members.size())
+        {
+            value = new JSONValue(std::move(parsed[i]));
+        }
+        else
+        {
+            value = previous.objectValue[sources[i]].value;
+            previous.objectValue[sources[i]].value = nullptr;
+            reused++;
+        }
+        root.objectValue.push_back(KeyValue(current[i].key, value));
+    }
+    // The previous tree keeps only the members that were not reused, so it can be freed as usual.
+    previous.objectValue.erase(std::remove_if(previous.objectValue.begin(), previous.objectValue.end(), [](const KeyValue &kv)
+                                              { return kv.value == nullptr; }),
+                               previous.objectValue.end());
+
+    valid = true;
+    contentSize = input.size();
+    contentHash = hash(input.data(), input.size());
+    members = current;
+    return root;
+}
+
+bool ParseCache::scanMembers(const std::string &input, std::vector<Member> &result)
+{
+    std::vector<Member> found;
+    size_t pos = skipWhitespace(input, 0);
+    if (pos >= input.size() || input[pos] != '{')
+        return false;
+    pos = skipWhitespace(input, pos + 1);
+    if (pos < input.size() && input[pos] == '}')
+    {
+        result.clear();
+        return skipWhitespace(input, pos + 1) == input.size();
+    }
+
+    while (pos < input.size())
+    {
+        if (input[pos] != '"')
+            return false;
+        size_t keyEnd = input.find('"', pos + 1);
+        if (keyEnd == std::string::npos)
+            return false;
+        std::string key = input.substr(pos + 1, keyEnd - pos - 1);
+
+        pos = skipWhitespace(input, keyEnd + 1);
+        if (pos >= input.size() || input[pos] != ':')
+            return false;
+        pos = skipWhitespace(input, pos + 1);
+
+        size_t start = pos;
+        size_t end = pos;
+        int depth = 0;
+        for (; pos < input.size(); pos++)
+        {
+            char c = input[pos];
+            if (c == '"')
+            {
+                pos = input.find('"', pos + 1);
+                if (pos == std::string::npos)
+                    return false;
+            }
+            else if (c == '{' || c == '[')
+                depth++;
+            else if (c == '}' || c == ']')
+            {
+                if (depth == 0)
+                    break;
+                depth--;
+            }
+            else if (c == ',' && depth == 0)
+                break;
+
+            if (!isspace(static_cast<unsigned char>(c)))
+                end = pos + 1;
+        }
+        if (pos >= input.size() || end == start)
+            return false;
+
+        uint64_t checked = 0;
+        for (size_t i = start; i < end; i++)
+        {
+            checked = check(checked, input[i]);
+        }
+        found.push_back({key, hash(input.data() + start, end - start), start, end - start, checked});
+        if (input[pos] == '}')
+        {
+            if (skipWhitespace(input, pos + 1) != input.size())
+                return false;
+            result = found;
+            return true;
+        }
+        pos = skipWhitespace(input, pos + 1);
+    }
+
+    return false;
+}
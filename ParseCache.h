@@ -0,0 +1,145 @@
+#ifndef PARSE_CACHE_H
+#define PARSE_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "JSONValue.h"
+
+/**
+ * Class remembering content hashes of the text a document was last parsed from.
+ *
+ * The hash of the whole file tells whether a changed timestamp hides unchanged bytes,
+ * in which case nothing is re-parsed. When the document is a top-level object, the raw
+ * text of every member is hashed as well, so a reload only parses the members whose
+ * bytes changed and moves the unchanged subtrees over from the previous tree.
+ */
+class ParseCache
+{
+public:
+    /**
+     * Computes the 64-bit FNV-1a hash of a byte range.
+     * @param data First byte.
+     * @param size Number of bytes.
+     * @return Hash of the bytes.
+     */
+    static uint64_t hash(const char *data, size_t size);
+
+    /**
+     * Checks whether the given text is the one last recorded.
+     * @param input File contents.
+     * @return True if the bytes are unchanged, false otherwise.
+     */
+    bool unchanged(const std::string &input) const;
+
+    /**
+     * Checks whether another cache recorded the same text as this one.
+     * @param other Cache to compare with.
+     * @return True if both recorded text with the same size and hash, false otherwise.
+     */
+    bool unchanged(const ParseCache &other) const;
+
+    /**
+     * Records the hashes of the text the current tree corresponds to.
+     * @param input File contents.
+     */
+    void record(const std::string &input);
+
+    /**
+     * Starts recording text that is handed over in pieces, as it is written.
+     */
+    void begin();
+
+    /**
+     * Records the next piece of the text.
+     * @param data First byte of the piece.
+     * @param size Number of bytes.
+     */
+    void feed(const char *data, size_t size);
+
+    /**
+     * Finishes recording the text handed over since begin().
+     */
+    void finish();
+
+    /**
+     * Forgets the recorded hashes.
+     */
+    void clear();
+
+    /**
+     * Parses changed text, reusing subtrees of the previous tree whose member text did not change.
+     * Member text counts as unchanged when its key, length and two independent hashes all match.
+     * Reused subtrees are moved out of the previous tree, and their members are removed from it.
+     * @param input New file contents.
+     * @param previous Tree parsed from the recorded text.
+     * @param reused Number of reused members.
+     * @return Parsed tree.
+     */
+    JSONValue reparse(const std::string &input, JSONValue &previous, size_t &reused);
+
+private:
+    /**
+     * Structure describing the raw text of a top-level object member.
+     */
+    struct Member
+    {
+        std::string key;
+        uint64_t hash;
+        size_t start;
+        size_t length;
+        uint64_t check;
+    };
+
+    /**
+     * Adds a byte to a check hash, which is built unlike FNV-1a so that text colliding under one
+     * hash is not likely to collide under the other.
+     * @param state Check hash of the bytes before.
+     * @param c Next byte.
+     * @return Check hash including the byte.
+     */
+    static uint64_t check(uint64_t state, char c);
+
+    /**
+     * Splits a top-level object into the raw text of its members.
+     * @param input JSON text.
+     * @param members Members in document order.
+     * @return True if the text is a top-level object that could be split, false otherwise.
+     */
+    static bool scanMembers(const std::string &input, std::vector<Member> &members);
+
+    /**
+     * Enum listing the states of the incremental member scan.
+     */
+    enum class ScanState
+    {
+        BEFORE_OBJECT,
+        AFTER_OPEN,
+        BEFORE_KEY,
+        KEY,
+        AFTER_KEY,
+        BEFORE_VALUE,
+        VALUE,
+        TRAILING,
+        FAILED
+    };
+
+private:
+    bool valid = false;
+    uint64_t contentHash = 0;
+    size_t contentSize = 0;
+    std::vector<Member> members;
+
+    ScanState scanState = ScanState::FAILED;
+    std::vector<Member> scanned;
+    std::string scanKey;
+    std::string scanSpaces;
+    uint64_t scanHash = 0;
+    uint64_t scanCheck = 0;
+    size_t scanLength = 0;
+    int scanDepth = 0;
+    bool scanInString = false;
+};
+
+#endif
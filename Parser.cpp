@@ -1,22 +1,105 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
 #include "Parser.h"
 
-Parser::Parser(const std::string &input, const std::string &currentFilePath = "") : lexer(input), currentFilePath(currentFilePath), currentToken(lexer.nextToken()), root(parseValue()) {}
+namespace
+{
+    template <typename Reader>
+    JSONValue readWith(const std::string &input)
+    {
+        Reader reader(input);
+        return reader.parseValue();
+    }
+
+    template <typename Reader>
+    void validateWith(const std::string &input)
+    {
+        Reader reader(input);
+        reader.validate();
+    }
+}
+
+Parser::Parser(const std::string &input, const std::string &currentFilePath = "", InputFormat format = InputFormat::JSON, ParseMode mode)
+    : input(format == InputFormat::JSON ? input : ""), currentFilePath(currentFilePath), format(format), mode(mode)
+{
+    switch (format)
+    {
+    case InputFormat::NDJSON:
+        root = parseLines(input);
+        break;
+    case InputFormat::BINARY:
+        root = BinarySnapshot::decode(input);
+        break;
+    case InputFormat::MAPPED:
+        throw std::runtime_error("Mapped documents are opened read-only through MappedDocument.");
+    default:
+        root = readValue(input, mode);
+        break;
+    }
+}
+
+Parser::Parser(const std::string &input, const std::string &currentFilePath, JSONValue root)
+    : input(input), root(std::move(root)), currentFilePath(currentFilePath), format(InputFormat::JSON), mode(ParseMode::DEFAULT) {}
+
+Parser::Parser(PushParser &pushed, const std::string &currentFilePath)
+    : root(pushed.finish()), currentFilePath(currentFilePath), format(InputFormat::JSON), mode(pushed.getMode()), streamed(true) {}
 
 JSONValue Parser::parse()
 {
-    return root;
+    return tree();
+}
+
+void Parser::setRoot(JSONValue value)
+{
+    tree() = std::move(value);
+}
+
+JSONValue &Parser::getRoot()
+{
+    return tree();
 }
 
 bool Parser::validate()
+{
+    if (format == InputFormat::NDJSON)
+    {
+        for (const auto &error : sourceLines->errors)
+        {
+            std::cerr << "Validation error at line " << error.line << ": " << error.message << std::endl;
+        }
+        return sourceLines->errors.empty();
+    }
+    if (format == InputFormat::BINARY || streamed)
+    {
+        // Streamed text is not kept; it was read in full by the policy's reader when the document was loaded.
+        return true;
+    }
+    return validate(input);
+}
+
+bool Parser::validate(const std::string &text) const
 {
     try
     {
-        lexer.resetPos();
-        currentToken = lexer.nextToken();
-        validateValue();
-        if (currentToken.type != TokenType::END)
+        switch (mode)
         {
-            throw std::runtime_error("Unexpected characters at the end of JSON input.");
+        case ParseMode::STRICT:
+            validateWith<StrictReader>(text);
+            break;
+        case ParseMode::LENIENT:
+            validateWith<LenientReader>(text);
+            break;
+        case ParseMode::LOSSLESS:
+            validateWith<LosslessReader>(text);
+            break;
+        default:
+            validateWith<JSONReader>(text);
+            break;
         }
         return true;
     }
@@ -27,83 +110,388 @@ bool Parser::validate()
     }
 }
 
-std::vector<JSONValue *> Parser::searchKey(const std::string &key) const
+std::vector<JSONValue *> Parser::searchKey(const std::string &key, size_t limit) const
 {
     std::vector<JSONValue *> results;
-    root.searchKey(key, results);
+    tree().searchKey(key, results, limit);
     return results;
 }
 
-std::vector<JSONValue *> Parser::searchKey(const std::regex &pattern) const
+std::vector<JSONValue *> Parser::searchKey(const std::regex &pattern, size_t limit) const
 {
     std::vector<JSONValue *> results;
-    root.searchKey(pattern, results);
+    tree().searchKey(pattern, results, limit);
     return results;
 }
 
 bool Parser::contains(const std::string &value) const
 {
-    return containsHelper(root, value);
+    return containsHelper(tree(), value);
 }
 
-bool Parser::set(const std::string &path, const std::string &newValue)
+std::vector<std::pair<size_t, JSONValue *>> Parser::searchKeyByLine(const std::string &key, size_t limit) const
 {
-    std::vector<std::string> keys = splitPath(path);
-    if (keys.empty())
+    std::vector<std::pair<size_t, JSONValue *>> results;
+    JSON_STATS_ADD(REGEX_COMPILATIONS, 1);
+    std::regex pattern(key);
+    const JSONValue &records = tree();
+    const std::vector<size_t> &recordLines = sourceLines->records;
+    for (size_t i = 0; i < records.arrayValue.size() && i < recordLines.size() && results.size() < limit; i++)
     {
-        std::cerr << "Invalid path!" << std::endl;
-        return false;
+        std::vector<JSONValue *> matches;
+        records.arrayValue[i]->searchKey(pattern, matches, limit - results.size());
+        for (auto match : matches)
+        {
+            results.push_back({recordLines[i], match});
+        }
     }
+    return results;
+}
 
-    JSONValue *target = &root;
-    for (size_t i = 0; i < keys.size() - 1; i++)
+std::vector<size_t> Parser::containsByLine(const std::string &value) const
+{
+    std::vector<size_t> lines;
+    const JSONValue &records = tree();
+    const std::vector<size_t> &recordLines = sourceLines->records;
+    for (size_t i = 0; i < records.arrayValue.size() && i < recordLines.size(); i++)
     {
+        if (containsHelper(*records.arrayValue[i], value))
+        {
+            lines.push_back(recordLines[i]);
+        }
+    }
+    return lines;
+}
+
+InputFormat Parser::getFormat() const
+{
+    return format;
+}
+
+size_t Parser::memoryUsage() const
+{
+    return sizeof(Parser) + tree().memoryUsage() + input.size();
+}
+
+int64_t Parser::getEditedBytes() const
+{
+    return editedBytes;
+}
+
+const std::vector<LineError> &Parser::getLineErrors() const
+{
+    return sourceLines->errors;
+}
+
+void Parser::renumberLines()
+{
+    const JSONValue &records = tree();
+    size_t count = records.type == JSONValueType::ARRAY ? records.arrayValue.size() : 0;
+    auto renumbered = std::make_shared<SourceLines>();
+    renumbered->records.reserve(count);
+    renumbered->errors = sourceLines->errors;
+    size_t line = 1;
+    for (auto &error : renumbered->errors)
+    {
+        size_t before = std::lower_bound(sourceLines->records.begin(), sourceLines->records.end(), error.line) - sourceLines->records.begin();
+        while (renumbered->records.size() < std::min(before, count))
+        {
+            renumbered->records.push_back(line++);
+        }
+        error.line = line++;
+    }
+    while (renumbered->records.size() < count)
+    {
+        renumbered->records.push_back(line++);
+    }
+    sourceLines = std::move(renumbered);
+}
+
+class Parser::Edit
+{
+public:
+    explicit Edit(Parser &parser) : concurrent(parser.live.load(std::memory_order_relaxed) != nullptr), parser(parser)
+    {
+        root = concurrent ? copy(parser.live.load(std::memory_order_relaxed)) : &parser.root;
+        parser.editedBytes = 0;
+    }
+
+    ~Edit()
+    {
+        if (concurrent && !committed)
+        {
+            for (JSONValue *node : copies)
+                release(node);
+        }
+    }
+
+    /**
+     * Finds the object holding the last key of a path. In concurrent mode every object on the way
+     * is copied, so the caller may change the returned object without readers noticing.
+     * @param keys Keys of the path.
+     * @param create Whether missing objects along the path are created.
+     * @return The object holding the last key, or nullptr with an error printed.
+     */
+    JSONValue *parent(const std::vector<std::string> &keys, bool create)
+    {
+        JSONValue *target = root;
+        for (size_t i = 0; i + 1 < keys.size(); i++)
+        {
+            if (target->type != JSONValueType::OBJECT)
+            {
+                std::cerr << "Invalid path: " << keys[i] << " is not an object." << std::endl;
+                return nullptr;
+            }
+
+            auto it = std::find_if(target->objectValue.begin(), target->objectValue.end(), [&](const KeyValue &kv)
+                                   { return kv.key == keys[i]; });
+            if (it == target->objectValue.end())
+            {
+                if (!create)
+                {
+                    std::cerr << "Path element not found: " << keys[i] << std::endl;
+                    return nullptr;
+                }
+                JSONValue *newObject = new JSONValue();
+                newObject->type = JSONValueType::OBJECT;
+                insert(target, keys[i], newObject);
+                if (concurrent)
+                    copies.push_back(newObject);
+                target = newObject;
+            }
+            else
+            {
+                if (concurrent)
+                    it->value = copy(it->value);
+                target = it->value;
+            }
+        }
+
         if (target->type != JSONValueType::OBJECT)
         {
-            std::cerr << "Invalid path: " << keys[i] << " is not an object." << std::endl;
-            return false;
+            std::cerr << "Invalid path: final element is not an object." << std::endl;
+            return nullptr;
         }
+        return target;
+    }
 
-        auto it = std::find_if(target->objectValue.begin(), target->objectValue.end(), [&](const KeyValue &kv)
-                               { return kv.key == keys[i]; });
-        if (it == target->objectValue.end())
+    /**
+     * Adds a member to an object returned by parent.
+     * @param target Object to add the member to.
+     * @param key Key of the member.
+     * @param value Value of the member.
+     * @param moved Whether the value is already in the tree, so that only the member itself is new.
+     */
+    void insert(JSONValue *target, const std::string &key, JSONValue *value, bool moved = false)
+    {
+        target->objectValue.push_back(KeyValue(key, value));
+        count(memberBytes(key) + (moved ? 0 : value->memoryUsage()), true);
+    }
+
+    /**
+     * Takes a member out of an object returned by parent.
+     * @param target Object holding the member.
+     * @param index Index of the member.
+     * @param moved Whether the value stays in the tree; otherwise it is freed once the edit is committed.
+     */
+    void erase(JSONValue *target, size_t index, bool moved = false)
+    {
+        KeyValue &member = target->objectValue[index];
+        count(memberBytes(member.key), false);
+        if (!moved)
+            remove(member.value);
+        target->objectValue.erase(target->objectValue.begin() + index);
+    }
+
+    /**
+     * Replaces the value of a member of an object returned by parent.
+     * @param member Member to change.
+     * @param value New value, which the tree takes over.
+     */
+    void replace(KeyValue &member, JSONValue *value)
+    {
+        remove(member.value);
+        member.value = value;
+        count(value->memoryUsage(), true);
+    }
+
+    /**
+     * Makes the edit visible: in concurrent mode the copied path is published as the new tree,
+     * and the nodes it replaces are retired.
+     */
+    void commit()
+    {
+        committed = true;
+        parser.editedBytes = bytes;
+        if (!concurrent)
         {
-            std::cerr << "Path element not found: " << keys[i] << std::endl;
-            return false;
+            for (JSONValue *value : removed)
+                delete value;
+            return;
         }
 
-        target = it->value;
+        parser.live.store(root, std::memory_order_release);
+        for (JSONValue *node : originals)
+            Epoch::retire([node]
+                          { release(node); });
+        for (JSONValue *value : removed)
+            Epoch::retire([value]
+                          { delete value; });
     }
 
-    std::string finalKey = keys.back();
-    if (target->type != JSONValueType::OBJECT)
+private:
+    /**
+     * Copies a node without its children, unless this edit made the node itself.
+     * @param node Node to copy.
+     * @return Node that this edit may change.
+     */
+    JSONValue *copy(JSONValue *node)
+    {
+        if (std::find(copies.begin(), copies.end(), node) != copies.end())
+            return node;
+
+        JSONValue *copied = new JSONValue();
+        copied->type = node->type;
+        copied->stringValue = node->stringValue;
+        copied->numberValue = node->numberValue;
+        copied->boolValue = node->boolValue;
+        copied->arrayValue = node->arrayValue;
+        copied->objectValue = node->objectValue;
+        copies.push_back(copied);
+        originals.push_back(node);
+        return copied;
+    }
+
+    /**
+     * Frees a node whose children belong to another node.
+     * @param node Node to free.
+     */
+    static void release(JSONValue *node)
+    {
+        node->arrayValue.clear();
+        node->objectValue.clear();
+        delete node;
+    }
+
+    /**
+     * Frees a value taken out of the tree once the edit is committed and no reader can see it any more.
+     * @param value Removed value.
+     */
+    void remove(JSONValue *value)
     {
-        std::cerr << "Invalid path: final element is not an object." << std::endl;
+        count(value->memoryUsage(), false);
+        removed.push_back(value);
+    }
+
+    /**
+     * Adds bytes the edit gives to or takes from the tree to the change reported by getEditedBytes.
+     * @param size Number of bytes.
+     * @param added Whether the bytes are added to the tree.
+     */
+    void count(size_t size, bool added)
+    {
+        bytes += added ? static_cast<int64_t>(size) : -static_cast<int64_t>(size);
+    }
+
+    /**
+     * Estimates the bytes an object member takes besides its value, as JSONValue::memoryUsage counts them.
+     * @param key Key of the member.
+     * @return Approximate size in bytes.
+     */
+    static size_t memberBytes(const std::string &key)
+    {
+        return sizeof(KeyValue) + (key.size() > 15 ? key.size() : 0);
+    }
+
+    bool concurrent;
+    bool committed = false;
+    Parser &parser;
+    JSONValue *root;
+    std::vector<JSONValue *> copies;
+    std::vector<JSONValue *> originals;
+    std::vector<JSONValue *> removed;
+    int64_t bytes = 0;
+};
+
+Parser::~Parser()
+{
+    // Readers and saves still in flight may hold the published tree, so it is freed through Epoch.
+    JSONValue *current = live.load(std::memory_order_relaxed);
+    if (current != nullptr)
+    {
+        Epoch::retire([current]
+                      { delete current; });
+        Epoch::collect();
+    }
+}
+
+void Parser::setConcurrent(bool enabled)
+{
+    JSONValue *current = live.load(std::memory_order_relaxed);
+    if (enabled && current == nullptr)
+    {
+        live.store(new JSONValue(std::move(root)), std::memory_order_release);
+    }
+    else if (!enabled && current != nullptr)
+    {
+        live.store(nullptr, std::memory_order_release);
+        root = std::move(*current);
+        delete current;
+    }
+}
+
+bool Parser::isConcurrent() const
+{
+    return live.load(std::memory_order_relaxed) != nullptr;
+}
+
+JSONValue &Parser::tree()
+{
+    JSONValue *current = live.load(std::memory_order_acquire);
+    return current != nullptr ? *current : root;
+}
+
+const JSONValue &Parser::tree() const
+{
+    const JSONValue *current = live.load(std::memory_order_acquire);
+    return current != nullptr ? *current : root;
+}
+
+bool Parser::set(const std::string &path, const std::string &newValue)
+{
+    std::vector<std::string> keys = splitPath(path);
+    if (keys.empty())
+    {
+        std::cerr << "Invalid path!" << std::endl;
         return false;
     }
 
-    auto it = std::find_if(target->objectValue.begin(), target->objectValue.end(), [&](const KeyValue &kv)
-                           { return kv.key == finalKey; });
-    if (it == target->objectValue.end())
+    Edit edit(*this);
+    JSONValue *target = edit.parent(keys, false);
+    if (target == nullptr)
     {
-        std::cerr << "Final path element not found: " << finalKey << std::endl;
         return false;
     }
 
-    Lexer valueLexer(newValue);
-    Token valueToken = valueLexer.nextToken();
-    if (valueToken.type == TokenType::END)
+    std::string finalKey = keys.back();
+    auto it = std::find_if(target->objectValue.begin(), target->objectValue.end(), [&](const KeyValue &kv)
+                           { return kv.key == finalKey; });
+    if (it == target->objectValue.end())
     {
-        std::cerr << "Invalid new value!" << std::endl;
+        std::cerr << "Final path element not found: " << finalKey << std::endl;
         return false;
     }
 
     JSONValue newParsedValue;
     try
     {
-        Parser valueParser(newValue);
-        valueParser.currentToken = valueToken;
-        newParsedValue = valueParser.parseValue();
+        JSONReader valueReader(newValue);
+        if (valueReader.atEnd())
+        {
+            std::cerr << "Invalid new value!" << std::endl;
+            return false;
+        }
+        newParsedValue = valueReader.parseValue();
     }
     catch (const std::exception &e)
     {
@@ -111,8 +499,8 @@ bool Parser::set(const std::string &path, const std::string &newValue)
         return false;
     }
 
-    delete it->value;
-    it->value = new JSONValue(newParsedValue);
+    edit.replace(*it, new JSONValue(std::move(newParsedValue)));
+    edit.commit();
     return true;
 }
 
@@ -125,37 +513,14 @@ bool Parser::create(const std::string &path, const std::string &newValue)
         return false;
     }
 
-    JSONValue *target = &root;
-    for (size_t i = 0; i < keys.size() - 1; ++i)
-    {
-        if (target->type != JSONValueType::OBJECT)
-        {
-            std::cerr << "Invalid path: " << keys[i] << " is not an object." << std::endl;
-            return false;
-        }
-
-        auto it = std::find_if(target->objectValue.begin(), target->objectValue.end(), [&](const KeyValue &kv)
-                               { return kv.key == keys[i]; });
-        if (it == target->objectValue.end())
-        {
-            JSONValue *newObject = new JSONValue();
-            newObject->type = JSONValueType::OBJECT;
-            target->objectValue.push_back(KeyValue(keys[i], newObject));
-            target = newObject;
-        }
-        else
-        {
-            target = it->value;
-        }
-    }
-
-    std::string finalKey = keys.back();
-    if (target->type != JSONValueType::OBJECT)
+    Edit edit(*this);
+    JSONValue *target = edit.parent(keys, true);
+    if (target == nullptr)
     {
-        std::cerr << "Invalid path: final element is not an object." << std::endl;
         return false;
     }
 
+    std::string finalKey = keys.back();
     auto it = std::find_if(target->objectValue.begin(), target->objectValue.end(), [&](const KeyValue &kv)
                            { return kv.key == finalKey; });
     if (it != target->objectValue.end())
@@ -166,13 +531,10 @@ bool Parser::create(const std::string &path, const std::string &newValue)
 
     try
     {
-        Lexer valueLexer(newValue);
-        Parser valueParser(newValue);
-
-        valueParser.currentToken = valueLexer.nextToken();
-
-        JSONValue newParsedValue = valueParser.parseValue();
-        target->objectValue.push_back(KeyValue(finalKey, new JSONValue(newParsedValue)));
+        JSONReader valueReader(newValue);
+        JSONValue newParsedValue = valueReader.parseValue();
+        edit.insert(target, finalKey, new JSONValue(std::move(newParsedValue)));
+        edit.commit();
         return true;
     }
     catch (const std::exception &e)
@@ -191,33 +553,14 @@ bool Parser::deleteElement(const std::string &path)
         return false;
     }
 
-    JSONValue *target = &root;
-    for (size_t i = 0; i < keys.size() - 1; ++i)
-    {
-        if (target->type != JSONValueType::OBJECT)
-        {
-            std::cerr << "Invalid path: " << keys[i] << " is not an object." << std::endl;
-            return false;
-        }
-
-        auto it = std::find_if(target->objectValue.begin(), target->objectValue.end(), [&](const KeyValue &kv)
-                               { return kv.key == keys[i]; });
-        if (it == target->objectValue.end())
-        {
-            std::cerr << "Path element not found: " << keys[i] << std::endl;
-            return false;
-        }
-
-        target = it->value;
-    }
-
-    std::string finalKey = keys.back();
-    if (target->type != JSONValueType::OBJECT)
+    Edit edit(*this);
+    JSONValue *target = edit.parent(keys, false);
+    if (target == nullptr)
     {
-        std::cerr << "Invalid path: final element is not an object." << std::endl;
         return false;
     }
 
+    std::string finalKey = keys.back();
     auto it = std::find_if(target->objectValue.begin(), target->objectValue.end(), [&](const KeyValue &kv)
                            { return kv.key == finalKey; });
     if (it == target->objectValue.end())
@@ -226,9 +569,8 @@ bool Parser::deleteElement(const std::string &path)
         return false;
     }
 
-    delete it->value;
-    target->objectValue.erase(it);
-
+    edit.erase(target, it - target->objectValue.begin());
+    edit.commit();
     return true;
 }
 
@@ -242,34 +584,21 @@ bool Parser::move(const std::string &from, const std::string &to)
         std::cerr << "Invalid path." << std::endl;
         return false;
     }
-
-    JSONValue *fromTarget = &root;
-    for (size_t i = 0; i < fromKeys.size() - 1; ++i)
+    // Checked before the edit copies any path, since the element would end up inside itself.
+    if (toKeys.size() > fromKeys.size() && std::equal(fromKeys.begin(), fromKeys.end(), toKeys.begin()))
     {
-        if (fromTarget->type != JSONValueType::OBJECT)
-        {
-            std::cerr << "Invalid path: " << fromKeys[i] << " is not an object." << std::endl;
-            return false;
-        }
-
-        auto it = std::find_if(fromTarget->objectValue.begin(), fromTarget->objectValue.end(), [&](const KeyValue &kv)
-                               { return kv.key == fromKeys[i]; });
-        if (it == fromTarget->objectValue.end())
-        {
-            std::cerr << "Path element not found: " << fromKeys[i] << std::endl;
-            return false;
-        }
-
-        fromTarget = it->value;
+        std::cerr << "Cannot move an element into itself: " << to << std::endl;
+        return false;
     }
 
-    std::string finalFromKey = fromKeys.back();
-    if (fromTarget->type != JSONValueType::OBJECT)
+    Edit edit(*this);
+    JSONValue *fromTarget = edit.parent(fromKeys, false);
+    if (fromTarget == nullptr)
     {
-        std::cerr << "Invalid path: final element is not an object." << std::endl;
         return false;
     }
 
+    std::string finalFromKey = fromKeys.back();
     auto fromIt = std::find_if(fromTarget->objectValue.begin(), fromTarget->objectValue.end(), [&](const KeyValue &kv)
                                { return kv.key == finalFromKey; });
     if (fromIt == fromTarget->objectValue.end())
@@ -277,40 +606,16 @@ bool Parser::move(const std::string &from, const std::string &to)
         std::cerr << "Element not found at path: " << from << std::endl;
         return false;
     }
-
+    size_t fromIndex = fromIt - fromTarget->objectValue.begin();
     JSONValue *fromValue = fromIt->value;
 
-    JSONValue *toTarget = &root;
-    for (size_t i = 0; i < toKeys.size() - 1; ++i)
+    JSONValue *toTarget = edit.parent(toKeys, true);
+    if (toTarget == nullptr)
     {
-        if (toTarget->type != JSONValueType::OBJECT)
-        {
-            std::cerr << "Invalid path: " << toKeys[i] << " is not an object." << std::endl;
-            return false;
-        }
-
-        auto it = std::find_if(toTarget->objectValue.begin(), toTarget->objectValue.end(), [&](const KeyValue &kv)
-                               { return kv.key == toKeys[i]; });
-        if (it == toTarget->objectValue.end())
-        {
-            JSONValue *newObject = new JSONValue();
-            newObject->type = JSONValueType::OBJECT;
-            toTarget->objectValue.push_back(KeyValue(toKeys[i], newObject));
-            toTarget = newObject;
-        }
-        else
-        {
-            toTarget = it->value;
-        }
-    }
-
-    std::string finalToKey = toKeys.back();
-    if (toTarget->type != JSONValueType::OBJECT)
-    {
-        std::cerr << "Invalid path: final element is not an object." << std::endl;
         return false;
     }
 
+    std::string finalToKey = toKeys.back();
     auto toIt = std::find_if(toTarget->objectValue.begin(), toTarget->objectValue.end(), [&](const KeyValue &kv)
                              { return kv.key == finalToKey; });
     if (toIt != toTarget->objectValue.end())
@@ -319,15 +624,16 @@ bool Parser::move(const std::string &from, const std::string &to)
         return false;
     }
 
-    toTarget->objectValue.push_back(KeyValue(finalToKey, fromValue));
-    fromTarget->objectValue.erase(fromIt);
-
+    // Both paths may lead to the same object, so the member is removed by index before the insertion moves it.
+    edit.erase(fromTarget, fromIndex, true);
+    edit.insert(toTarget, finalToKey, fromValue, true);
+    edit.commit();
     return true;
 }
 
 bool Parser::save(const std::string &path)
 {
-    JSONValue *value = path.empty() ? &root : findValueByPath(path);
+    JSONValue *value = path.empty() ? &tree() : findValueByPath(path);
     if (value == nullptr)
     {
         std::cerr << "Invalid path." << std::endl;
@@ -336,8 +642,14 @@ bool Parser::save(const std::string &path)
 
     try
     {
-        std::string savePath = path.empty() ? currentFilePath : path;
-        writeJSONToFile(*value, savePath);
+        if (path.empty())
+        {
+            writeToFile(currentFilePath);
+        }
+        else
+        {
+            writeJSONToFile(*value, path);
+        }
         return true;
     }
     catch (const std::exception &e)
@@ -347,9 +659,9 @@ bool Parser::save(const std::string &path)
     }
 }
 
-bool Parser::saveas(const std::string &file, const std::string &path)
+bool Parser::saveas(const std::string &file, const std::string &path, InputFormat format)
 {
-    JSONValue *value = path.empty() ? &root : findValueByPath(path);
+    JSONValue *value = path.empty() ? &tree() : findValueByPath(path);
     if (value == nullptr)
     {
         std::cerr << "Invalid path." << std::endl;
@@ -358,7 +670,18 @@ bool Parser::saveas(const std::string &file, const std::string &path)
 
     try
     {
-        writeJSONToFile(*value, file);
+        switch (format)
+        {
+        case InputFormat::BINARY:
+            writeBinaryToFile(*value, file);
+            break;
+        case InputFormat::MAPPED:
+            MappedDocument::write(*value, file);
+            break;
+        default:
+            writeJSONToFile(*value, file);
+            break;
+        }
         return true;
     }
     catch (const std::exception &e)
@@ -370,433 +693,663 @@ bool Parser::saveas(const std::string &file, const std::string &path)
 
 void Parser::writeToFile(const std::string &filePath)
 {
-    std::ofstream outFile(filePath);
-    if (!outFile.is_open())
+    BackgroundWriter::replaceFile(filePath, [this](const BackgroundWriter::Sink &sink)
+                                  { write(sink); });
+}
+
+void Parser::write(const BackgroundWriter::Sink &sink) const
+{
+    write(tree(), sink);
+}
+
+void Parser::write(const JSONValue &value, const BackgroundWriter::Sink &sink) const
+{
+    if (format == InputFormat::JSON)
     {
-        throw std::runtime_error("Could not open file to write.");
+        writeParallel(value, true, sink);
+        return;
     }
 
-    writeJSON(outFile, root, 0);
-    outFile.close();
+    std::vector<std::string> pieces(1);
+    if (format == InputFormat::BINARY)
+    {
+        pieces[0] = BinarySnapshot::encode(value);
+    }
+    else
+    {
+        std::ostringstream out;
+        writeLines(out, value);
+        pieces[0] = out.str();
+    }
+    sink(pieces);
 }
 
-void Parser::writeJSONToFile(const JSONValue &value, const std::string &filePath)
+BackgroundWriter::Serializer Parser::snapshot() const
 {
-    std::ofstream outFile(filePath);
-    if (!outFile.is_open())
+    auto shell = std::make_shared<Parser>("", currentFilePath, JSONValue());
+    shell->format = format;
+    shell->sourceLines = sourceLines;
+    shell->mode = mode;
+    if (isConcurrent())
+    {
+        // Published versions are never changed in place, so the pinned one is written as it is.
+        auto pin = std::make_shared<Epoch::Pin>();
+        const JSONValue *version = live.load(std::memory_order_acquire);
+        return [shell, pin, version](const BackgroundWriter::Sink &sink)
+        { shell->write(*version, sink); };
+    }
+    if (mode == ParseMode::LOSSLESS)
     {
-        throw std::runtime_error("Could not open file to write.");
+        // Binary snapshots store numbers as doubles, so the raw number text is only kept by a full copy.
+        shell->root = tree();
+        return [shell](const BackgroundWriter::Sink &sink)
+        { shell->write(sink); };
     }
 
-    writeJSON(outFile, value, 0);
-    outFile.close();
+    auto encoded = std::make_shared<const std::string>(BinarySnapshot::encode(tree()));
+    if (format == InputFormat::BINARY)
+    {
+        return [encoded](const BackgroundWriter::Sink &sink)
+        {
+            std::vector<std::string> pieces{*encoded};
+            sink(pieces);
+        };
+    }
+    return [encoded, shell](const BackgroundWriter::Sink &sink)
+    {
+        shell->root = BinarySnapshot::decode(*encoded);
+        shell->write(sink);
+    };
 }
 
-void Parser::writeJSON(std::ostream &out, const JSONValue &value, int indent = 0) const
+void Parser::writeJSONToFile(const JSONValue &value, const std::string &filePath)
+{
+    BackgroundWriter::replaceFile(filePath, [this, &value](const BackgroundWriter::Sink &sink)
+                                  { writeParallel(value, true, sink); });
+}
+
+void Parser::writeBinaryToFile(const JSONValue &value, const std::string &filePath)
 {
-    std::string indentStr(indent, ' ');
-    switch (value.type)
+    BackgroundWriter::replaceFile(filePath, BinarySnapshot::encode(value));
+}
+
+JSONValue Parser::parseLines(const std::string &input)
+{
+    struct Line
     {
-    case JSONValueType::OBJECT:
-        out << "{\n";
-        for (size_t i = 0; i < value.objectValue.size(); ++i)
+        size_t number;
+        size_t start;
+        size_t length;
+    };
+
+    std::vector<Line> lines;
+    size_t number = 1;
+    size_t start = 0;
+    while (start < input.size())
+    {
+        size_t end = input.find('\n', start);
+        if (end == std::string::npos)
+            end = input.size();
+
+        size_t length = end - start;
+        if (length > 0 && input[start + length - 1] == '\r')
+            length--;
+        if (input.find_first_not_of(" \t", start) < start + length)
+            lines.push_back({number, start, length});
+
+        start = end + 1;
+        number++;
+    }
+
+    const size_t batchSize = 1024;
+    const size_t batchCount = (lines.size() + batchSize - 1) / batchSize;
+    std::vector<JSONValue> records(lines.size());
+    std::vector<std::string> errors(lines.size());
+    std::atomic<size_t> nextBatch(0);
+
+    auto worker = [&]()
+    {
+        for (size_t batch = nextBatch++; batch < batchCount; batch = nextBatch++)
         {
-            out << indentStr << "  \"" << value.objectValue[i].key << "\": ";
-            writeJSON(out, *value.objectValue[i].value, indent + 2);
-            if (i < value.objectValue.size() - 1)
-                out << ",";
-            out << "\n";
+            size_t last = std::min(lines.size(), (batch + 1) * batchSize);
+            for (size_t i = batch * batchSize; i < last; i++)
+            {
+                try
+                {
+                    records[i] = parseRecord(input.substr(lines[i].start, lines[i].length));
+                }
+                catch (const std::exception &e)
+                {
+                    errors[i] = e.what();
+                    if (errors[i].empty())
+                        errors[i] = "Invalid record";
+                }
+            }
         }
-        out << indentStr << "}";
-        break;
-    case JSONValueType::ARRAY:
-        out << "[\n";
-        for (size_t i = 0; i < value.arrayValue.size(); ++i)
+    };
+
+    size_t workerCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), batchCount);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < workerCount; i++)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : workers)
+    {
+        thread.join();
+    }
+
+    JSONValue result;
+    result.type = JSONValueType::ARRAY;
+    result.arrayValue.reserve(lines.size());
+    auto parsed = std::make_shared<SourceLines>();
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        if (errors[i].empty())
         {
-            out << indentStr << "  ";
-            writeJSON(out, *value.arrayValue[i], indent + 2);
-            if (i < value.arrayValue.size() - 1)
-                out << ",";
-            out << "\n";
+            result.arrayValue.push_back(new JSONValue(std::move(records[i])));
+            parsed->records.push_back(lines[i].number);
+        }
+        else
+        {
+            parsed->errors.push_back(LineError(lines[i].number, input.substr(lines[i].start, lines[i].length), errors[i]));
         }
-        out << indentStr << "]";
-        break;
-    case JSONValueType::STRING:
-        out << "\"" << value.stringValue << "\"";
-        break;
-    case JSONValueType::NUMBER:
-        out << value.numberValue;
-        break;
-    case JSONValueType::BOOL:
-        out << (value.boolValue ? "true" : "false");
-        break;
-    case JSONValueType::NIL:
-        out << "null";
-        break;
-    default:
-        throw std::runtime_error("Unknown JSONType encountered in writeJSON.");
     }
+    sourceLines = std::move(parsed);
+
+    return result;
 }
 
-JSONValue *Parser::findValueByPath(const std::string &path)
+JSONValue Parser::parseRecord(const std::string &text)
 {
-    if (path.empty())
+    JSONReader reader(text);
+    JSONValue record = reader.parseValue();
+    if (!reader.atEnd())
     {
-        return &root;
+        throw std::runtime_error("Unexpected characters after the record at " + reader.position());
     }
+    return record;
+}
 
-    std::vector<std::string> keys = splitPath(path);
-    JSONValue *target = &root;
-
-    for (const auto &key : keys)
+void Parser::writeLines(std::ostream &out, const JSONValue &records) const
+{
+    const std::vector<size_t> &recordLines = sourceLines->records;
+    const std::vector<LineError> &lineErrors = sourceLines->errors;
+    size_t record = 0;
+    size_t error = 0;
+    while (record < records.arrayValue.size() || error < lineErrors.size())
     {
-        if (target->type != JSONValueType::OBJECT)
+        bool takeRecord = error >= lineErrors.size() ||
+                          (record < records.arrayValue.size() && record < recordLines.size() && recordLines[record] < lineErrors[error].line);
+        if (takeRecord)
         {
-            std::cerr << "Invalid path: " << key << " is not an object." << std::endl;
-            return nullptr;
+            writeCompactJSON(out, *records.arrayValue[record++]);
         }
-
-        auto it = std::find_if(target->objectValue.begin(), target->objectValue.end(), [&](const KeyValue &kv)
-                               { return kv.key == key; });
-        if (it == target->objectValue.end())
+        else
         {
-            std::cerr << "Path element not found: " << key << std::endl;
-            return nullptr;
+            out << lineErrors[error++].text;
         }
-
-        target = it->value;
+        out << "\n";
     }
+}
 
-    return target;
+void Parser::writeCompactJSON(std::ostream &out, const JSONValue &value) const
+{
+    writeValue(out, value, 0, false);
 }
 
-JSONValue Parser::parseValue()
-{
-    switch (currentToken.type)
-    {
-    case TokenType::LEFT_BRACE:
-        return parseObject();
-    case TokenType::LEFT_BRACKET:
-        return parseArray();
-    case TokenType::STRING:
-        return parseString();
-    case TokenType::NUMBER:
-        return parseNumber();
-    case TokenType::TRUE:
-        currentToken = lexer.nextToken();
-        return parseBool(true);
-    case TokenType::FALSE:
-        currentToken = lexer.nextToken();
-        return parseBool(false);
-    case TokenType::NULL_TYPE:
-        currentToken = lexer.nextToken();
-        return parseNull();
-    default:
-        throw std::runtime_error("Unexpected token at line " + std::to_string(lexer.getLine()) + ", column " + std::to_string(lexer.getColumn()));
-    }
+void Parser::writeJSON(std::ostream &out, const JSONValue &value, int indent = 0) const
+{
+    writeValue(out, value, indent, true);
 }
 
-JSONValue Parser::parseObject()
+void Parser::writeValue(std::ostream &out, const JSONValue &value, int indent, bool pretty, size_t depth, size_t limit) const
 {
-    JSONValue objectValue;
-    objectValue.type = JSONValueType::OBJECT;
+    struct Frame
+    {
+        const JSONValue *value;
+        size_t next;
+        int indent;
+    };
 
-    currentToken = lexer.nextToken();
-    if (currentToken.type != TokenType::RIGHT_BRACE)
+    std::vector<Frame> open;
+    const JSONValue *current = &value;
+    int currentIndent = indent;
+
+    while (true)
     {
-        while (true)
+        switch (current->type)
+        {
+        case JSONValueType::OBJECT:
+        case JSONValueType::ARRAY:
         {
-            if (currentToken.type != TokenType::STRING)
+            bool isObject = current->type == JSONValueType::OBJECT;
+            bool empty = isObject ? current->objectValue.empty() : current->arrayValue.empty();
+            if (!empty && open.size() >= depth)
             {
-                throw std::runtime_error("Expected string key");
+                out << (isObject ? "{...}" : "[...]");
+                break;
             }
-            std::string key = currentToken.value;
-            currentToken = lexer.nextToken();
+            out << (isObject ? "{" : "[") << (pretty ? "\n" : "");
+            open.push_back({current, 0, currentIndent});
+            break;
+        }
+        case JSONValueType::STRING:
+            out << "\"" << current->stringValue << "\"";
+            break;
+        case JSONValueType::NUMBER:
+            if (current->stringValue.empty())
+                out << current->numberValue;
+            else
+                out << current->stringValue;
+            break;
+        case JSONValueType::BOOL:
+            out << (current->boolValue ? "true" : "false");
+            break;
+        case JSONValueType::NIL:
+            out << "null";
+            break;
+        default:
+            throw std::runtime_error("Unknown JSONType encountered in writeJSON.");
+        }
 
-            if (currentToken.type != TokenType::COLON)
+        current = nullptr;
+        while (current == nullptr && !open.empty())
+        {
+            Frame &frame = open.back();
+            bool isObject = frame.value->type == JSONValueType::OBJECT;
+            size_t count = isObject ? frame.value->objectValue.size() : frame.value->arrayValue.size();
+
+            if (frame.next == limit && count > limit)
+            {
+                if (frame.next > 0)
+                {
+                    out << (pretty ? ",\n" : ",");
+                }
+                if (pretty)
+                {
+                    out << std::string(frame.indent, ' ') << "  ";
+                }
+                out << "... " << count - limit << " more";
+                frame.next = count;
+            }
+            if (frame.next == count)
             {
-                throw std::runtime_error("Expected ':'");
+                if (pretty)
+                {
+                    out << (count > 0 ? "\n" : "") << std::string(frame.indent, ' ');
+                }
+                out << (isObject ? "}" : "]");
+                open.pop_back();
+                continue;
             }
-            currentToken = lexer.nextToken();
-            objectValue.objectValue.push_back(KeyValue(key, new JSONValue(parseValue())));
-            if (currentToken.type == TokenType::COMMA)
+
+            if (frame.next > 0)
+            {
+                out << (pretty ? ",\n" : ",");
+            }
+            if (pretty)
             {
-                currentToken = lexer.nextToken();
+                out << std::string(frame.indent, ' ') << "  ";
+            }
+            if (isObject)
+            {
+                out << "\"" << frame.value->objectValue[frame.next].key << (pretty ? "\": " : "\":");
+                current = frame.value->objectValue[frame.next].value;
             }
             else
             {
-                break;
+                current = frame.value->arrayValue[frame.next];
             }
+            currentIndent = frame.indent + 2;
+            frame.next++;
         }
-        if (currentToken.type != TokenType::RIGHT_BRACE)
-            throw std::runtime_error("Expected '}' at line " + std::to_string(lexer.getLine()) + ", column: " + std::to_string(lexer.getColumn()));
-    }
 
-    currentToken = lexer.nextToken();
-    return objectValue;
+        if (current == nullptr)
+        {
+            return;
+        }
+    }
 }
 
-JSONValue Parser::parseArray()
+void Parser::writeRange(std::ostream &out, const JSONValue &container, size_t begin, size_t end, int indent, bool pretty) const
 {
-    JSONValue arrayValue;
-    arrayValue.type = JSONValueType::ARRAY;
+    bool isObject = container.type == JSONValueType::OBJECT;
+    for (size_t i = begin; i < end; i++)
+    {
+        if (i > 0)
+        {
+            out << (pretty ? ",\n" : ",");
+        }
+        if (pretty)
+        {
+            out << std::string(indent, ' ') << "  ";
+        }
+        if (isObject)
+        {
+            out << "\"" << container.objectValue[i].key << (pretty ? "\": " : "\":");
+        }
+        writeValue(out, isObject ? *container.objectValue[i].value : *container.arrayValue[i], indent + 2, pretty);
+    }
+}
 
-    currentToken = lexer.nextToken();
-    if (currentToken.type != TokenType::RIGHT_BRACKET)
+void Parser::writeParallel(const JSONValue &value, bool pretty, const BackgroundWriter::Sink &sink) const
+{
+    // Containers with this many members are cut into chunks; nothing deeper than planDepth is looked into.
+    const size_t splitMembers = 1024;
+    const size_t chunkMembers = 256;
+    const size_t maxChunks = 256;
+    const size_t planDepth = 4;
+    const size_t maxSegments = 4096;
+
+    struct Segment
+    {
+        std::string text;
+        const JSONValue *container;
+        size_t begin;
+        size_t end;
+        int indent;
+    };
+
+    struct Frame
+    {
+        const JSONValue *value;
+        size_t next;
+        int indent;
+    };
+
+    // Plan: the top of the tree is written here as literal text, and member ranges of large
+    // or deep containers become tasks, each of which will be written into its own buffer.
+    std::vector<Segment> segments;
+    std::vector<size_t> tasks;
+    size_t taskMembers = 0;
+    std::string literal;
+    auto addTask = [&](const JSONValue *container, size_t begin, size_t end, int indent)
+    {
+        if (!literal.empty())
+            segments.push_back({std::move(literal), nullptr, 0, 0, 0});
+        literal.clear();
+        tasks.push_back(segments.size());
+        segments.push_back({"", container, begin, end, indent});
+        taskMembers += end - begin;
+    };
+    auto closing = [&](const JSONValue &container, size_t count, int indent)
     {
-        while (true)
+        if (pretty)
+            literal += (count > 0 ? "\n" : "") + std::string(indent, ' ');
+        literal += container.type == JSONValueType::OBJECT ? "}" : "]";
+    };
+
+    std::vector<Frame> open;
+    const JSONValue *current = &value;
+    int currentIndent = 0;
+    while (current != nullptr)
+    {
+        if (current->type == JSONValueType::OBJECT || current->type == JSONValueType::ARRAY)
         {
-            arrayValue.arrayValue.push_back(new JSONValue(parseValue()));
-            if (currentToken.type == TokenType::COMMA)
+            bool isObject = current->type == JSONValueType::OBJECT;
+            size_t count = isObject ? current->objectValue.size() : current->arrayValue.size();
+            literal += isObject ? "{" : "[";
+            literal += pretty ? "\n" : "";
+            if (count >= splitMembers || (count > 0 && (open.size() >= planDepth || segments.size() >= maxSegments)))
             {
-                currentToken = lexer.nextToken();
+                size_t chunks = count >= splitMembers ? std::min(maxChunks, count / chunkMembers) : 1;
+                for (size_t c = 0; c < chunks; c++)
+                {
+                    addTask(current, count * c / chunks, count * (c + 1) / chunks, currentIndent);
+                }
+                closing(*current, count, currentIndent);
             }
             else
             {
-                break;
+                open.push_back({current, 0, currentIndent});
             }
         }
-        if (currentToken.type != TokenType::RIGHT_BRACKET)
-            throw std::runtime_error("Expected ']' at line " + std::to_string(lexer.getLine()) + ", column: " + std::to_string(lexer.getColumn()));
-    }
-
-    currentToken = lexer.nextToken();
-    return arrayValue;
-}
+        else
+        {
+            std::ostringstream out;
+            writeValue(out, *current, currentIndent, pretty);
+            literal += out.str();
+        }
 
-JSONValue Parser::parseString()
-{
-    JSONValue stringValue;
-    stringValue.type = JSONValueType::STRING;
-    stringValue.stringValue = currentToken.value;
-    currentToken = lexer.nextToken();
-    return stringValue;
-}
+        current = nullptr;
+        while (current == nullptr && !open.empty())
+        {
+            Frame &frame = open.back();
+            bool isObject = frame.value->type == JSONValueType::OBJECT;
+            size_t count = isObject ? frame.value->objectValue.size() : frame.value->arrayValue.size();
+            if (frame.next == count)
+            {
+                closing(*frame.value, count, frame.indent);
+                open.pop_back();
+                continue;
+            }
 
-JSONValue Parser::parseNumber()
-{
-    JSONValue numberValue;
-    numberValue.type = JSONValueType::NUMBER;
-    numberValue.numberValue = std::stod(currentToken.value);
-    currentToken = lexer.nextToken();
-    return numberValue;
-}
+            if (frame.next > 0)
+                literal += pretty ? ",\n" : ",";
+            if (pretty)
+                literal += std::string(frame.indent, ' ') + "  ";
+            if (isObject)
+                literal += "\"" + frame.value->objectValue[frame.next].key + (pretty ? "\": " : "\":");
+            current = isObject ? frame.value->objectValue[frame.next].value : frame.value->arrayValue[frame.next];
+            currentIndent = frame.indent + 2;
+            frame.next++;
+        }
+    }
+    if (!literal.empty())
+        segments.push_back({std::move(literal), nullptr, 0, 0, 0});
 
-JSONValue Parser::parseBool(bool value)
-{
-    JSONValue boolValue;
-    boolValue.type = JSONValueType::BOOL;
-    boolValue.boolValue = value;
-    currentToken = lexer.nextToken();
-    return boolValue;
-}
+    auto run = [&](Segment &segment)
+    {
+        std::ostringstream out;
+        writeRange(out, *segment.container, segment.begin, segment.end, segment.indent, pretty);
+        segment.text = out.str();
+    };
 
-JSONValue Parser::parseNull()
-{
-    JSONValue nullValue;
-    nullValue.type = JSONValueType::NIL;
-    currentToken = lexer.nextToken();
-    return nullValue;
-}
+    std::vector<std::string> pieces;
+    if (taskMembers < splitMembers)
+    {
+        for (auto &segment : segments)
+        {
+            if (segment.container != nullptr)
+                run(segment);
+            pieces.push_back(std::move(segment.text));
+        }
+        sink(pieces);
+        return;
+    }
 
-bool Parser::containsHelper(const JSONValue &jsonValue, const std::string &value) const
-{
-    switch (jsonValue.type)
+    // Workers take tasks in document order; this thread hands every prefix of finished segments to the sink.
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::vector<char> ready(segments.size(), 1);
+    for (size_t task : tasks)
+        ready[task] = 0;
+    std::atomic<size_t> nextTask(0);
+    std::atomic<bool> stop(false);
+    std::exception_ptr failure;
+
+    auto worker = [&]()
     {
-    case JSONValueType::OBJECT:
-        for (const auto &kv : jsonValue.objectValue)
+        for (size_t t = nextTask++; t < tasks.size() && !stop; t = nextTask++)
         {
-            if (containsHelper(*kv.value, value))
+            Segment &segment = segments[tasks[t]];
+            try
             {
-                return true;
+                run(segment);
             }
-        }
-        break;
-    case JSONValueType::ARRAY:
-        for (const auto &val : jsonValue.arrayValue)
-        {
-            if (containsHelper(*val, value))
+            catch (...)
             {
-                return true;
+                std::lock_guard<std::mutex> lock(mutex);
+                failure = std::current_exception();
+                stop = true;
             }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready[tasks[t]] = 1;
+            }
+            finished.notify_all();
         }
-        break;
-    case JSONValueType::STRING:
-        if (jsonValue.stringValue.find(value) != std::string::npos)
+    };
+
+    size_t workerCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), tasks.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        workers.emplace_back(worker);
+    }
+
+    try
+    {
+        size_t emitted = 0;
+        while (emitted < segments.size())
         {
-            return true;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                finished.wait(lock, [&]
+                              { return ready[emitted] || failure; });
+                if (failure)
+                    break;
+                while (emitted < segments.size() && ready[emitted])
+                    pieces.push_back(std::move(segments[emitted++].text));
+            }
+            sink(pieces);
+            pieces.clear();
         }
-        break;
-    case JSONValueType::BOOL:
-    case JSONValueType::NUMBER:
-    case JSONValueType::NIL:
-        break;
-    default:
-        throw std::runtime_error("Invalid JSON type encountered in containsHelper.");
+    }
+    catch (...)
+    {
+        stop = true;
+        for (auto &thread : workers)
+            thread.join();
+        throw;
     }
 
-    return false;
+    for (auto &thread : workers)
+    {
+        thread.join();
+    }
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
 }
 
-std::vector<std::string> Parser::splitPath(const std::string &path) const
+JSONValue *Parser::findValueByPath(const std::string &path)
 {
-    std::vector<std::string> keys;
-    size_t start = 0;
-    size_t end = path.find('/');
+    if (path.empty())
+    {
+        return &tree();
+    }
 
-    while (end != std::string::npos)
+    std::vector<std::string> keys = splitPath(path);
+    JSONValue *target = &tree();
+
+    for (const auto &key : keys)
     {
-        keys.push_back(path.substr(start, end - start));
-        start = end + 1;
-        end = path.find('/', start);
+        if (target->type != JSONValueType::OBJECT)
+        {
+            std::cerr << "Invalid path: " << key << " is not an object." << std::endl;
+            return nullptr;
+        }
+
+        auto it = std::find_if(target->objectValue.begin(), target->objectValue.end(), [&](const KeyValue &kv)
+                               { return kv.key == key; });
+        if (it == target->objectValue.end())
+        {
+            std::cerr << "Path element not found: " << key << std::endl;
+            return nullptr;
+        }
+
+        target = it->value;
     }
 
-    keys.push_back(path.substr(start));
-    return keys;
+    return target;
 }
 
-void Parser::validateValue()
+JSONValue Parser::readValue(const std::string &text, ParseMode mode)
 {
-    switch (currentToken.type)
+    switch (mode)
     {
-    case TokenType::LEFT_BRACE:
-        validateObject();
-        break;
-    case TokenType::LEFT_BRACKET:
-        validateArray();
-        break;
-    case TokenType::STRING:
-        validateString();
-        break;
-    case TokenType::NUMBER:
-        validateNumber();
-        break;
-    case TokenType::TRUE:
-    case TokenType::FALSE:
-    case TokenType::NULL_TYPE:
-        currentToken = lexer.nextToken();
-        break;
+    case ParseMode::STRICT:
+        return readWith<StrictReader>(text);
+    case ParseMode::LENIENT:
+        return readWith<LenientReader>(text);
+    case ParseMode::LOSSLESS:
+        return readWith<LosslessReader>(text);
     default:
-        throw std::runtime_error("Unexpected token at line " + std::to_string(lexer.getLine()) + ", column " + std::to_string(lexer.getColumn()));
+        return readWith<JSONReader>(text);
     }
 }
 
-void Parser::validateObject()
+ParseMode Parser::getMode() const
 {
-    currentToken = lexer.nextToken();
-    if (currentToken.type != TokenType::RIGHT_BRACE)
-    {
-        while (true)
-        {
-            if (currentToken.type != TokenType::STRING)
-                throw std::runtime_error("Expected string key at line " + std::to_string(lexer.getLine()) + ", column " + std::to_string(lexer.getColumn()));
-            validateString();
-            if (currentToken.type != TokenType::COLON)
-                throw std::runtime_error("Expected ':' at line " + std::to_string(lexer.getLine()) + ", column " + std::to_string(lexer.getColumn()));
-            currentToken = lexer.nextToken();
-            validateValue();
-            if (currentToken.type == TokenType::COMMA)
-            {
-                currentToken = lexer.nextToken();
-            }
-            else
-            {
-                break;
-            }
-        }
-        if (currentToken.type != TokenType::RIGHT_BRACE)
-            throw std::runtime_error("Expected '}' at line " + std::to_string(lexer.getLine()) + ", column " + std::to_string(lexer.getColumn()));
-    }
-    currentToken = lexer.nextToken();
+    return mode;
 }
 
-void Parser::validateArray()
+bool Parser::containsHelper(const JSONValue &jsonValue, const std::string &value) const
 {
-    currentToken = lexer.nextToken();
-    if (currentToken.type != TokenType::RIGHT_BRACKET)
+    std::vector<const JSONValue *> pending = {&jsonValue};
+    while (!pending.empty())
     {
-        while (true)
+        const JSONValue *current = pending.back();
+        pending.pop_back();
+
+        switch (current->type)
         {
-            validateValue();
-            if (currentToken.type == TokenType::COMMA)
+        case JSONValueType::OBJECT:
+            for (const auto &kv : current->objectValue)
             {
-                currentToken = lexer.nextToken();
+                pending.push_back(kv.value);
             }
-            else
+            break;
+        case JSONValueType::ARRAY:
+            pending.insert(pending.end(), current->arrayValue.begin(), current->arrayValue.end());
+            break;
+        case JSONValueType::STRING:
+            if (current->stringValue.find(value) != std::string::npos)
             {
-                break;
+                return true;
             }
+            break;
+        case JSONValueType::BOOL:
+        case JSONValueType::NUMBER:
+        case JSONValueType::NIL:
+            break;
+        default:
+            throw std::runtime_error("Invalid JSON type encountered in containsHelper.");
         }
-        if (currentToken.type != TokenType::RIGHT_BRACKET)
-            throw std::runtime_error("Expected ']' at line " + std::to_string(lexer.getLine()) + ", column " + std::to_string(lexer.getColumn()));
     }
-    currentToken = lexer.nextToken();
-}
 
-void Parser::validateString()
-{
-    if (currentToken.type != TokenType::STRING)
-        throw std::runtime_error("Expected string at line " + std::to_string(lexer.getLine()) + ", column " + std::to_string(lexer.getColumn()));
-    currentToken = lexer.nextToken();
+    return false;
 }
 
-void Parser::validateNumber()
+std::vector<std::string> Parser::splitPath(const std::string &path) const
 {
-    if (currentToken.type != TokenType::NUMBER)
-        throw std::runtime_error("Expected number at line " + std::to_string(lexer.getLine()) + ", column " + std::to_string(lexer.getColumn()));
-    currentToken = lexer.nextToken();
-}
+    JSON_STATS_ADD(PATH_LOOKUPS, 1);
+    std::vector<std::string> keys;
+    size_t start = 0;
+    size_t end = path.find('/');
 
-void Parser::printJSON(const JSONValue &value, int indent = 0)
-{
-    std::string indentStr(indent, ' ');
-    switch (value.type)
-    {
-    case JSONValueType::OBJECT:
-    {
-        std::cout << "{\n";
-        for (size_t i = 0; i < value.objectValue.size(); ++i)
-        {
-            std::cout << indentStr << "  \"" << value.objectValue[i].key << "\": ";
-            printJSON(*value.objectValue[i].value, indent + 2);
-            if (i < value.objectValue.size() - 1)
-                std::cout << ",";
-            std::cout << "\n";
-        }
-        std::cout << indentStr << "}";
-        break;
-    }
-    case JSONValueType::ARRAY:
+    while (end != std::string::npos)
     {
-        std::cout << "[\n";
-        for (size_t i = 0; i < value.arrayValue.size(); ++i)
-        {
-            std::cout << indentStr << "  ";
-            printJSON(*value.arrayValue[i], indent + 2);
-            if (i < value.arrayValue.size() - 1)
-                std::cout << ",";
-            std::cout << "\n";
-        }
-        std::cout << indentStr << "]";
-        break;
-    }
-    case JSONValueType::STRING:
-        std::cout << "\"" << value.stringValue << "\"";
-        break;
-    case JSONValueType::NUMBER:
-        std::cout << value.numberValue;
-        break;
-    case JSONValueType::BOOL:
-        std::cout << (value.boolValue ? "true" : "false");
-        break;
-    case JSONValueType::NIL:
-        std::cout << "null";
-        break;
+        keys.push_back(path.substr(start, end - start));
+        start = end + 1;
+        end = path.find('/', start);
     }
+
+    keys.push_back(path.substr(start));
+    return keys;
+}
+
+void Parser::printJSON(const JSONValue &value, int indent, size_t depth, size_t limit)
+{
+    writeValue(std::cout, value, indent, true, depth, limit);
 }
 
 void Parser::printOperation(const JSONValue &json)
 {
-    printJSON(json);
+    printJSON(json, 0);
     std::cout << std::endl;
 }
\ No newline at end of file
@@ -1,27 +1,126 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <atomic>
 #include <fstream>
+#include <memory>
 
-#include "Lexer.h"
+#include "BackgroundWriter.h"
+#include "Epoch.h"
+#include "JSONReader.h"
+#include "PushReader.h"
 #include "JSONValue.h"
+#include "BinarySnapshot.h"
+#include "MappedDocument.h"
+
+/**
+ * Enum representing the layout of the input handed to the Parser.
+ */
+enum class InputFormat
+{
+    JSON,
+    NDJSON,
+    BINARY,
+    MAPPED
+};
+
+/**
+ * Structure describing a line of NDJSON input that could not be parsed.
+ */
+struct LineError
+{
+    size_t line;
+    std::string text;
+    std::string message;
+
+    LineError(size_t line = 0, const std::string &text = "", const std::string &message = "")
+        : line(line), text(text), message(message) {}
+};
 
 /**
  * Class responsible for parsing, manipulating, and validating JSON data.
  */
 class Parser
 {
-    Lexer lexer;
-    Token currentToken;
+    std::string input;
     JSONValue root;
     std::string currentFilePath;
+    /**
+     * Structure holding the source lines of the NDJSON records and of the lines which could not
+     * be parsed. It is shared with the functions snapshot returns and replaced as a whole when
+     * the lines change, so capturing it never copies the vectors.
+     */
+    struct SourceLines
+    {
+        std::vector<size_t> records;
+        std::vector<LineError> errors;
+    };
+
+    InputFormat format;
+    std::shared_ptr<const SourceLines> sourceLines = std::make_shared<const SourceLines>();
+    ParseMode mode;
+    bool streamed = false;
+    std::atomic<JSONValue *> live{nullptr};
+    int64_t editedBytes = 0;
 
 public:
     /**
      * Constructs a Parser object with the given JSON input.
+     * In NDJSON mode every non-empty line is parsed as a separate record and the
+     * records are exposed as the elements of a root array. In BINARY mode the input
+     * is decoded as a BinarySnapshot.
+     * @param input JSON input as a string.
+     * @param currentFilePath Path of the file the input was read from.
+     * @param format Layout of the input.
+     * @param mode Preset parser policy used for JSON input.
+     */
+    Parser(const std::string &input, const std::string &currentFilePath, InputFormat format, ParseMode mode = ParseMode::DEFAULT);
+
+    /**
+     * Constructs a Parser object around a tree which has already been parsed from the given JSON input.
      * @param input JSON input as a string.
+     * @param currentFilePath Path of the file the input was read from.
+     * @param root Tree parsed from the input.
+     */
+    Parser(const std::string &input, const std::string &currentFilePath, JSONValue root);
+
+    /**
+     * Constructs a Parser object around the value a PushParser has been fed, ending its input.
+     * The text is not kept, so the document counts as streamed.
+     * @param pushed Push parser that was handed the whole JSON text.
+     * @param currentFilePath Path of the file the input was read from.
      */
-    Parser(const std::string &input, const std::string &currentFilePath);
+    Parser(PushParser &pushed, const std::string &currentFilePath);
+
+    ~Parser();
+
+    Parser(const Parser &) = delete;
+    Parser &operator=(const Parser &) = delete;
+
+    /**
+     * Turns concurrent mode on or off.
+     * In concurrent mode set, create, delete and move copy the objects along the edited path and
+     * publish the copy as the new tree instead of changing nodes in place, so threads holding an
+     * Epoch::Guard can search, print and look up paths while a single writer edits. Replaced
+     * nodes are retired through Epoch, and so is the tree when the Parser is destroyed. Other
+     * changes, and turning the mode off, need the writer to be alone with the tree, with no
+     * function returned by snapshot still waiting to write it.
+     * @param enabled Whether concurrent mode should be on.
+     */
+    void setConcurrent(bool enabled);
+
+    /**
+     * Checks whether concurrent mode is on.
+     * @return True if edits publish copies of the tree.
+     */
+    bool isConcurrent() const;
+
+    /**
+     * Parses a single JSON value which must span the whole text.
+     * @param text JSON text.
+     * @return Parsed JSONValue.
+     */
+    static JSONValue parseRecord(const std::string &text);
 
     /**
      * Parses the JSON input and returns the root JSONValue.
@@ -29,25 +128,46 @@ public:
      */
     JSONValue parse();
 
+    /**
+     * Replaces the root of the JSON structure.
+     * @param value New root JSONValue.
+     */
+    void setRoot(JSONValue value);
+
+    /**
+     * Gets the root of the JSON structure without copying it.
+     * @return Root JSONValue.
+     */
+    JSONValue &getRoot();
+
     /**
      * Validates the JSON structure.
      * @return True if the JSON structure is valid, false otherwise.
      */
     bool validate();
 
+    /**
+     * Validates JSON text with the reader of the parser's policy, printing the first error.
+     * @param text JSON text to validate.
+     * @return True if the text is valid, false otherwise.
+     */
+    bool validate(const std::string &text) const;
+
     /**
      * Searches for a key in the JSON structure.
      * @param key Key to search for.
+     * @param limit Number of matches after which the search stops.
      * @return Vector of pointers to JSONValue that match the key.
      */
-    std::vector<JSONValue *> searchKey(const std::string &key) const;
+    std::vector<JSONValue *> searchKey(const std::string &key, size_t limit = JSONValue::ANY) const;
 
     /**
      * Searches for keys matching a regex pattern in the JSON structure.
      * @param pattern Regex pattern to match keys against.
+     * @param limit Number of matches after which the search stops.
      * @return Vector of pointers to JSONValue that match the pattern.
      */
-    std::vector<JSONValue *> searchKey(const std::regex &pattern) const;
+    std::vector<JSONValue *> searchKey(const std::regex &pattern, size_t limit = JSONValue::ANY) const;
 
     /**
      * Checks if a value is contained in the JSON structure.
@@ -56,6 +176,60 @@ public:
      */
     bool contains(const std::string &value) const;
 
+    /**
+     * Searches for a key in every NDJSON record.
+     * @param key Key to search for.
+     * @param limit Number of matches after which the search stops.
+     * @return Pairs of source line number and matching JSONValue.
+     */
+    std::vector<std::pair<size_t, JSONValue *>> searchKeyByLine(const std::string &key, size_t limit = JSONValue::ANY) const;
+
+    /**
+     * Finds the NDJSON records which contain a value.
+     * @param value Value to search for.
+     * @return Source line numbers of the matching records.
+     */
+    std::vector<size_t> containsByLine(const std::string &value) const;
+
+    /**
+     * Gets the layout of the loaded input.
+     * @return Input format.
+     */
+    InputFormat getFormat() const;
+
+    /**
+     * Gets the parser policy the input was parsed with.
+     * @return Parse mode.
+     */
+    ParseMode getMode() const;
+
+    /**
+     * Estimates the memory held by the parsed tree and the retained input.
+     * @return Approximate size in bytes.
+     */
+    size_t memoryUsage() const;
+
+    /**
+     * Gets how much the last set, create, delete or move changed the memory held by the tree.
+     * The change is counted from the members and values the edit added and removed, so keeping
+     * a size up to date with it never walks the rest of the tree.
+     * @return Change in bytes, 0 if the edit failed.
+     */
+    int64_t getEditedBytes() const;
+
+    /**
+     * Gets the NDJSON lines which could not be parsed.
+     * @return Errors in source line order.
+     */
+    const std::vector<LineError> &getLineErrors() const;
+
+    /**
+     * Numbers the NDJSON records and unparsed lines with the lines they take when the document is
+     * written, after records were added, removed or reordered. Each unparsed line stays behind the
+     * records which came before it, or behind the last record if fewer are left.
+     */
+    void renumberLines();
+
     /**
      * Sets a new value at the specified path in the JSON structure.
      * @param path Path to the element to be updated.
@@ -98,9 +272,10 @@ public:
      * Saves the JSON structure to a specified file.
      * @param file Path to the file where the JSON will be saved.
      * @param path Optional path within the JSON structure to save.
+     * @param format Layout to write: JSON text, a BinarySnapshot or a MappedDocument.
      * @return True if the JSON is successfully saved, false otherwise.
      */
-    bool saveas(const std::string &file, const std::string &path);
+    bool saveas(const std::string &file, const std::string &path, InputFormat format = InputFormat::JSON);
 
     /**
      * Writes the JSON structure to a file.
@@ -108,6 +283,34 @@ public:
      */
     void writeToFile(const std::string &filePath);
 
+    /**
+     * Writes the whole document in its own format: JSON text, NDJSON lines or a binary snapshot.
+     * @param sink Receives the text in pieces, in order.
+     */
+    void write(const BackgroundWriter::Sink &sink) const;
+
+    /**
+     * Writes a JSONValue like writeJSON or writeCompactJSON, serializing large arrays and objects
+     * in chunks on several threads. Each chunk goes into its own buffer, and buffers are handed to
+     * the sink in document order as soon as they and all buffers before them are ready.
+     * @param value JSONValue to be written.
+     * @param pretty Whether to write one member per line, as writeJSON does.
+     * @param sink Receives the text in pieces, in order.
+     */
+    void writeParallel(const JSONValue &value, bool pretty, const BackgroundWriter::Sink &sink) const;
+
+    /**
+     * Captures the document so that it can be written while the original keeps changing.
+     * In concurrent mode the published version is pinned through Epoch and shared with the
+     * function, so capturing it takes constant time and edits keep copying only their path.
+     * Otherwise the tree is held as a binary snapshot, or copied in LOSSLESS mode, which takes
+     * time proportional to the document on the calling thread; this fallback is only there for
+     * parsers whose concurrent mode was turned off, as DocumentCache turns it on by default.
+     * The NDJSON line numbers are shared with the function rather than copied.
+     * @return Function writing the captured document in its own format.
+     */
+    BackgroundWriter::Serializer snapshot() const;
+
     /**
      * Writes a JSONValue to a file.
      * @param value JSONValue to be written.
@@ -115,7 +318,13 @@ public:
      */
     void writeJSONToFile(const JSONValue &value, const std::string &filePath);
 
-private:
+    /**
+     * Writes a JSONValue to a file as a binary snapshot.
+     * @param value JSONValue to be written.
+     * @param filePath Path to the file.
+     */
+    void writeBinaryToFile(const JSONValue &value, const std::string &filePath);
+
     /**
      * Writes a JSONValue to an output stream with indentation.
      * @param out Output stream.
@@ -131,90 +340,101 @@ private:
      */
     JSONValue *findValueByPath(const std::string &path);
 
+private:
     /**
-     * Parses a JSON value.
-     * @return Parsed JSONValue.
+     * Class making one edit of the tree, copying the path it changes in concurrent mode.
      */
-    JSONValue parseValue();
+    class Edit;
 
     /**
-     * Parses a JSON object.
-     * @return Parsed JSONValue representing the object.
+     * Gets the current tree, which in concurrent mode is the version published last.
+     * @return Root JSONValue.
      */
-    JSONValue parseObject();
+    JSONValue &tree();
 
     /**
-     * Parses a JSON array.
-     * @return Parsed JSONValue representing the array.
+     * Gets the current tree, which in concurrent mode is the version published last.
+     * @return Root JSONValue.
      */
-    JSONValue parseArray();
+    const JSONValue &tree() const;
 
     /**
-     * Parses a JSON string.
-     * @return Parsed JSONValue representing the string.
+     * Parses NDJSON input line by line in parallel batches.
+     * @param input NDJSON input string.
+     * @return Array holding one element per successfully parsed line.
      */
-    JSONValue parseString();
+    JSONValue parseLines(const std::string &input);
 
     /**
-     * Parses a JSON number.
-     * @return Parsed JSONValue representing the number.
+     * Writes a tree in the document's own format: JSON text, NDJSON lines or a binary snapshot.
+     * @param value Root of the tree.
+     * @param sink Receives the text in pieces, in order.
      */
-    JSONValue parseNumber();
+    void write(const JSONValue &value, const BackgroundWriter::Sink &sink) const;
 
     /**
-     * Parses a JSON boolean.
-     * @param value Boolean value.
-     * @return Parsed JSONValue representing the boolean.
-     */
-    JSONValue parseBool(bool value);
-    
-    /**
-     * Parses a JSON null value.
-     * @return Parsed JSONValue representing null.
-     */
-    JSONValue parseNull();
-
-    /**
-     * Helper function to check if a value is contained in a JSONValue.
-     * @param jsonValue JSONValue to check.
-     * @param value Value to search for.
-     * @return True if the value is found, false otherwise.
+     * Writes the NDJSON records one per line, keeping malformed lines as they were read.
+     * @param out Output stream.
+     * @param records Array holding the records.
      */
-    bool containsHelper(const JSONValue &jsonValue, const std::string &value) const;
+    void writeLines(std::ostream &out, const JSONValue &records) const;
 
     /**
-     * Splits a path string by '/' into individual keys.
-     * @param path Path string.
-     * @return Vector of keys.
+     * Writes a JSONValue to an output stream on a single line.
+     * @param out Output stream.
+     * @param value JSONValue to be written.
      */
-    std::vector<std::string> splitPath(const std::string &path) const;
+    void writeCompactJSON(std::ostream &out, const JSONValue &value) const;
 
-private:
     /**
-     * Validates a JSON value.
+     * Writes a JSONValue using an explicit stack instead of recursion.
+     * Containers below the depth limit are written as {...} or [...] without being visited, and
+     * members past the member limit are summed up as "... N more" without being visited.
+     * @param out Output stream.
+     * @param value JSONValue to be written.
+     * @param indent Indentation of the value.
+     * @param pretty Whether to write one member per line.
+     * @param depth Number of container levels to open.
+     * @param limit Number of members written per container.
      */
-    void validateValue();
+    void writeValue(std::ostream &out, const JSONValue &value, int indent, bool pretty, size_t depth = JSONValue::ANY, size_t limit = JSONValue::ANY) const;
 
     /**
-     * Validates a JSON object.
+     * Writes a range of the members of an array or object, with the separators and indentation
+     * they have when the whole container is written.
+     * @param out Output stream.
+     * @param container Array or object.
+     * @param begin Index of the first member.
+     * @param end Index past the last member.
+     * @param indent Indentation of the container.
+     * @param pretty Whether to write one member per line.
      */
-    void validateObject();
+    void writeRange(std::ostream &out, const JSONValue &container, size_t begin, size_t end, int indent, bool pretty) const;
 
     /**
-     * Validates a JSON array.
+     * Parses a JSON value with the reader instantiated for a parser policy.
+     * @param text JSON text.
+     * @param mode Preset parser policy.
+     * @return Parsed JSONValue.
      */
-    void validateArray();
+    static JSONValue readValue(const std::string &text, ParseMode mode);
 
     /**
-     * Validates a JSON string.
+     * Helper function to check if a value is contained in a JSONValue.
+     * @param jsonValue JSONValue to check.
+     * @param value Value to search for.
+     * @return True if the value is found, false otherwise.
      */
-    void validateString();
+    bool containsHelper(const JSONValue &jsonValue, const std::string &value) const;
 
     /**
-     * Validates a JSON number.
+     * Splits a path string by '/' into individual keys.
+     * @param path Path string.
+     * @return Vector of keys.
      */
-    void validateNumber();
+    std::vector<std::string> splitPath(const std::string &path) const;
 
+private:
     /**
      * Prints a JSONValue.
      * @param json JSONValue to be printed.
@@ -226,8 +446,10 @@ public:
      * Prints a JSONValue with indentation.
      * @param value JSONValue to be printed.
      * @param indent Current indentation level.
+     * @param depth Number of container levels to open; deeper containers are printed as {...} or [...].
+     * @param limit Number of members printed per container; the rest are summed up as "... N more".
      */
-    void printJSON(const JSONValue &value, int indent);
+    void printJSON(const JSONValue &value, int indent, size_t depth = JSONValue::ANY, size_t limit = JSONValue::ANY);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef PARSER_POLICY_H
+#define PARSER_POLICY_H
+
+/**
+ * Enum describing what happens when an object contains the same key more than once.
+ */
+enum class DuplicateKeys
+{
+    KEEP,
+    REJECT,
+    LAST_WINS
+};
+
+/**
+ * Enum selecting one of the preset parser policies at runtime.
+ */
+enum class ParseMode
+{
+    DEFAULT,
+    STRICT,
+    LENIENT,
+    LOSSLESS
+};
+
+/**
+ * Policy matching the historical behaviour of the parser: standard JSON, duplicate keys
+ * kept in document order, numbers converted to doubles and errors reported by line and column.
+ *
+ * A policy is a set of compile-time constants read by BasicLexer, BasicJSONReader and BasicPushReader.
+ * Checks on a policy constant are either if constexpr or conditions the constant short-circuits,
+ * so the compiler folds away the branches an instantiation's configuration does not need.
+ */
+struct DefaultPolicy
+{
+    static constexpr bool ALLOW_COMMENTS = false;
+    static constexpr bool ALLOW_TRAILING_COMMAS = false;
+    static constexpr bool TRACK_POSITION = true;
+    static constexpr bool RAW_NUMBERS = false;
+    static constexpr DuplicateKeys DUPLICATE_KEYS = DuplicateKeys::KEEP;
+};
+
+/**
+ * Policy for ingestion of trusted machine-generated input: duplicate keys are rejected and
+ * errors are reported by byte offset rather than by line and column.
+ */
+struct StrictPolicy : DefaultPolicy
+{
+    static constexpr bool TRACK_POSITION = false;
+    static constexpr DuplicateKeys DUPLICATE_KEYS = DuplicateKeys::REJECT;
+};
+
+/**
+ * Policy for hand-edited configuration files: // and block comments and trailing commas
+ * are accepted, and a repeated key replaces the earlier value.
+ */
+struct LenientPolicy : DefaultPolicy
+{
+    static constexpr bool ALLOW_COMMENTS = true;
+    static constexpr bool ALLOW_TRAILING_COMMAS = true;
+    static constexpr DuplicateKeys DUPLICATE_KEYS = DuplicateKeys::LAST_WINS;
+};
+
+/**
+ * Policy keeping the literal text of every number next to its double value, so that
+ * large integers and exact decimals are written back unchanged.
+ */
+struct LosslessPolicy : DefaultPolicy
+{
+    static constexpr bool RAW_NUMBERS = true;
+};
+
+#endif
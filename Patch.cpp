@@ -0,0 +1,791 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "ParseCache.h"
+#include "Patch.h"
+
+namespace
+{
+    JSONValue *makeString(const std::string &text)
+    {
+        JSONValue *value = new JSONValue();
+        value->type = JSONValueType::STRING;
+        value->stringValue = text;
+        return value;
+    }
+
+    void addOperation(JSONValue &patch, const std::string &op, const std::string &path, const JSONValue *value)
+    {
+        JSONValue *operation = new JSONValue();
+        operation->type = JSONValueType::OBJECT;
+        operation->objectValue.push_back(KeyValue("op", makeString(op)));
+        operation->objectValue.push_back(KeyValue("path", makeString(path)));
+        if (value != nullptr)
+            operation->objectValue.push_back(KeyValue("value", new JSONValue(*value)));
+        patch.arrayValue.push_back(operation);
+    }
+
+    const JSONValue *member(const JSONValue &object, const std::string &key)
+    {
+        for (const auto &kv : object.objectValue)
+        {
+            if (kv.key == key)
+                return kv.value;
+        }
+        return nullptr;
+    }
+
+    const std::string &stringMember(const JSONValue &operation, const std::string &key)
+    {
+        const JSONValue *value = member(operation, key);
+        if (value == nullptr || value->type != JSONValueType::STRING)
+            throw std::runtime_error("missing \"" + key + "\" string.");
+        return value->stringValue;
+    }
+
+    size_t arrayIndex(const std::string &token)
+    {
+        if (token.empty() || token.size() > 18 || (token.size() > 1 && token[0] == '0') ||
+            !std::all_of(token.begin(), token.end(), [](char c)
+                         { return c >= '0' && c <= '9'; }))
+        {
+            throw std::runtime_error("invalid array index \"" + token + "\".");
+        }
+        return std::stoull(token);
+    }
+
+    JSONValue *&slot(JSONValue *container, size_t index)
+    {
+        return container->type == JSONValueType::OBJECT ? container->objectValue[index].value : container->arrayValue[index];
+    }
+
+    uint64_t combine(uint64_t seed, uint64_t value)
+    {
+        return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    }
+}
+
+class Patch::Transaction
+{
+public:
+    explicit Transaction(JSONValue &root) : root(root) {}
+
+    ~Transaction()
+    {
+        rollback();
+    }
+
+    /**
+     * Applies one operation of a JSON Patch.
+     * @param operation Operation object.
+     */
+    void run(const JSONValue &operation)
+    {
+        if (operation.type != JSONValueType::OBJECT)
+            throw std::runtime_error("operation is not an object.");
+        const std::string &op = stringMember(operation, "op");
+        std::vector<std::string> path = parsePointer(stringMember(operation, "path"));
+        const JSONValue *value = member(operation, "value");
+        if (value == nullptr && (op == "add" || op == "replace" || op == "test"))
+            throw std::runtime_error("missing \"value\".");
+
+        if (op == "add")
+        {
+            insert(locate(path, true), new JSONValue(*value), true);
+        }
+        else if (op == "remove")
+        {
+            remove(locate(path, false), true);
+        }
+        else if (op == "replace")
+        {
+            Location target = locate(path, false);
+            if (target.container == nullptr)
+            {
+                insert(target, new JSONValue(*value), true);
+                return;
+            }
+            JSONValue *&current = slot(target.container, target.index);
+            log.push_back({Change::Kind::REPLACED, target.container, target.index, "", current, true});
+            current = new JSONValue(*value);
+        }
+        else if (op == "copy")
+        {
+            const JSONValue *source = node(locate(parsePointer(stringMember(operation, "from")), false));
+            insert(locate(path, true), new JSONValue(*source), true);
+        }
+        else if (op == "move")
+        {
+            std::vector<std::string> from = parsePointer(stringMember(operation, "from"));
+            if (from.size() < path.size() && std::equal(from.begin(), from.end(), path.begin()))
+                throw std::runtime_error("cannot move a value into itself.");
+
+            // The root is held by value, so a value moved there is copied and the moved node freed on commit.
+            bool toRoot = path.empty();
+            JSONValue *moved = remove(locate(from, false), toRoot);
+            insert(locate(path, true), toRoot ? new JSONValue(*moved) : moved, toRoot);
+        }
+        else if (op == "test")
+        {
+            if (!equal(*node(locate(path, false)), *value))
+                throw std::runtime_error("test failed.");
+        }
+        else
+        {
+            throw std::runtime_error("unknown operation \"" + op + "\".");
+        }
+    }
+
+    /**
+     * Keeps the changes and frees the nodes the patch removed or replaced.
+     */
+    void commit()
+    {
+        for (const auto &change : log)
+        {
+            if (change.kind == Change::Kind::REPLACED || change.kind == Change::Kind::ROOT ||
+                (change.kind == Change::Kind::REMOVED && change.owned))
+            {
+                delete change.value;
+            }
+        }
+        log.clear();
+    }
+
+private:
+    /**
+     * Resolves a JSON pointer to the slot it names in its parent container.
+     * @param tokens Reference tokens of the pointer.
+     * @param inserting Whether the slot may be one past the end of an array or a new member.
+     * @return Location of the slot.
+     */
+    Location locate(const std::vector<std::string> &tokens, bool inserting)
+    {
+        Location location;
+        location.exists = true;
+        JSONValue *current = &root;
+        for (size_t i = 0; i < tokens.size(); i++)
+        {
+            const std::string &token = tokens[i];
+            bool last = i + 1 == tokens.size();
+            size_t index;
+            size_t count;
+            if (current->type == JSONValueType::OBJECT)
+            {
+                count = current->objectValue.size();
+                index = 0;
+                while (index < count && current->objectValue[index].key != token)
+                    index++;
+            }
+            else if (current->type == JSONValueType::ARRAY)
+            {
+                count = current->arrayValue.size();
+                index = last && inserting && token == "-" ? count : arrayIndex(token);
+                if (index > count || (index == count && !(last && inserting)))
+                    throw std::runtime_error("array index " + token + " is out of range.");
+            }
+            else
+            {
+                throw std::runtime_error("path not found.");
+            }
+
+            if (last)
+            {
+                location.container = current;
+                location.index = index;
+                location.key = token;
+                location.exists = index < count;
+                if (!location.exists && !inserting)
+                    throw std::runtime_error("path not found.");
+                return location;
+            }
+            if (index == count)
+                throw std::runtime_error("path not found.");
+            current = slot(current, index);
+        }
+        return location;
+    }
+
+    /**
+     * Gets the value at a location that exists.
+     * @param location Location of the value.
+     * @return The value.
+     */
+    JSONValue *node(const Location &location)
+    {
+        return location.container == nullptr ? &root : slot(location.container, location.index);
+    }
+
+    /**
+     * Adds a value at a location: replaces the root or an existing object member, or inserts a new member or element.
+     * @param location Where to add the value.
+     * @param value Node to add.
+     * @param owned Whether the node is freed when the patch is rolled back.
+     */
+    void insert(const Location &location, JSONValue *value, bool owned)
+    {
+        if (location.container == nullptr)
+        {
+            JSONValue *previous = new JSONValue(std::move(root));
+            log.push_back({Change::Kind::ROOT, nullptr, 0, "", previous, true});
+            root = std::move(*value);
+            delete value;
+            return;
+        }
+
+        JSONValue *container = location.container;
+        if (container->type == JSONValueType::OBJECT && location.exists)
+        {
+            JSONValue *&current = slot(container, location.index);
+            log.push_back({Change::Kind::REPLACED, container, location.index, "", current, owned});
+            current = value;
+            return;
+        }
+
+        if (container->type == JSONValueType::OBJECT)
+            container->objectValue.insert(container->objectValue.begin() + location.index, KeyValue(location.key, value));
+        else
+            container->arrayValue.insert(container->arrayValue.begin() + location.index, value);
+        log.push_back({Change::Kind::INSERTED, container, location.index, "", value, owned});
+    }
+
+    /**
+     * Detaches the value at a location from its container.
+     * @param location Location of the value.
+     * @param owned Whether the node is freed when the patch commits.
+     * @return The detached node.
+     */
+    JSONValue *remove(const Location &location, bool owned)
+    {
+        if (location.container == nullptr)
+            throw std::runtime_error("cannot remove the root.");
+        if (!location.exists)
+            throw std::runtime_error("path not found.");
+
+        JSONValue *container = location.container;
+        JSONValue *value = slot(container, location.index);
+        std::string key;
+        if (container->type == JSONValueType::OBJECT)
+        {
+            key = container->objectValue[location.index].key;
+            container->objectValue.erase(container->objectValue.begin() + location.index);
+        }
+        else
+        {
+            container->arrayValue.erase(container->arrayValue.begin() + location.index);
+        }
+        log.push_back({Change::Kind::REMOVED, container, location.index, key, value, owned});
+        return value;
+    }
+
+    /**
+     * Undoes the logged changes, newest first.
+     */
+    void rollback()
+    {
+        for (auto it = log.rbegin(); it != log.rend(); ++it)
+        {
+            JSONValue *container = it->container;
+            switch (it->kind)
+            {
+            case Change::Kind::INSERTED:
+                if (container->type == JSONValueType::OBJECT)
+                    container->objectValue.erase(container->objectValue.begin() + it->index);
+                else
+                    container->arrayValue.erase(container->arrayValue.begin() + it->index);
+                if (it->owned)
+                    delete it->value;
+                break;
+            case Change::Kind::REMOVED:
+                if (container->type == JSONValueType::OBJECT)
+                    container->objectValue.insert(container->objectValue.begin() + it->index, KeyValue(it->key, it->value));
+                else
+                    container->arrayValue.insert(container->arrayValue.begin() + it->index, it->value);
+                break;
+            case Change::Kind::REPLACED:
+            {
+                JSONValue *&current = slot(container, it->index);
+                if (it->owned)
+                    delete current;
+                current = it->value;
+                break;
+            }
+            case Change::Kind::ROOT:
+                root = std::move(*it->value);
+                delete it->value;
+                break;
+            }
+        }
+        log.clear();
+    }
+
+    JSONValue &root;
+    std::vector<Change> log;
+};
+
+size_t Patch::apply(JSONValue &root, const JSONValue &patch)
+{
+    if (patch.type != JSONValueType::ARRAY)
+    {
+        return merge(root, patch);
+    }
+
+    Transaction transaction(root);
+    for (size_t i = 0; i < patch.arrayValue.size(); i++)
+    {
+        try
+        {
+            transaction.run(*patch.arrayValue[i]);
+        }
+        catch (const std::exception &e)
+        {
+            throw std::runtime_error("Operation " + std::to_string(i) + " failed: " + e.what());
+        }
+    }
+    transaction.commit();
+    return patch.arrayValue.size();
+}
+
+size_t Patch::merge(JSONValue &root, const JSONValue &patch)
+{
+    if (patch.type != JSONValueType::OBJECT)
+    {
+        root = patch;
+        return 1;
+    }
+
+    size_t merged = 0;
+    std::vector<std::pair<JSONValue *, const JSONValue *>> pending = {{&root, &patch}};
+    while (!pending.empty())
+    {
+        JSONValue *target = pending.back().first;
+        const JSONValue *changes = pending.back().second;
+        pending.pop_back();
+        if (target->type != JSONValueType::OBJECT)
+        {
+            *target = JSONValue();
+            target->type = JSONValueType::OBJECT;
+        }
+
+        auto &members = target->objectValue;
+        for (const auto &change : changes->objectValue)
+        {
+            if (change.value->type == JSONValueType::NIL)
+            {
+                auto removed = std::remove_if(members.begin(), members.end(), [&](const KeyValue &kv)
+                                              {
+                                                  if (kv.key != change.key)
+                                                      return false;
+                                                  delete kv.value;
+                                                  return true; });
+                members.erase(removed, members.end());
+                merged++;
+                continue;
+            }
+
+            auto it = std::find_if(members.begin(), members.end(), [&](const KeyValue &kv)
+                                   { return kv.key == change.key; });
+            if (change.value->type == JSONValueType::OBJECT)
+            {
+                if (it == members.end())
+                {
+                    members.push_back(KeyValue(change.key, new JSONValue()));
+                    it = members.end() - 1;
+                }
+                pending.push_back({it->value, change.value});
+                continue;
+            }
+
+            if (it == members.end())
+                members.push_back(KeyValue(change.key, new JSONValue(*change.value)));
+            else
+                *it->value = *change.value;
+            merged++;
+        }
+    }
+    return merged;
+}
+
+JSONValue Patch::diff(const JSONValue &from, const JSONValue &to)
+{
+    std::unordered_map<const JSONValue *, uint64_t> hashes;
+    hashTree(from, hashes);
+    hashTree(to, hashes);
+
+    JSONValue patch;
+    patch.type = JSONValueType::ARRAY;
+
+    struct Frame
+    {
+        const JSONValue *from;
+        const JSONValue *to;
+        std::string path;
+    };
+
+    // Operations on an array are emitted left to right, so a nested frame's index stays valid:
+    // everything emitted after it at its own level touches later positions only.
+    std::vector<Frame> pending;
+    auto compare = [&](const JSONValue *left, const JSONValue *right, const std::string &path)
+    {
+        // Equal hashes may still be a collision, so they are confirmed before the subtree is skipped.
+        if (hashes[left] == hashes[right] && equal(*left, *right))
+            return;
+        if (left->type == right->type && (left->type == JSONValueType::OBJECT || left->type == JSONValueType::ARRAY))
+            pending.push_back({left, right, path});
+        else
+            addOperation(patch, "replace", path, right);
+    };
+
+    compare(&from, &to, "");
+    while (!pending.empty())
+    {
+        Frame frame = std::move(pending.back());
+        pending.pop_back();
+
+        if (frame.from->type == JSONValueType::OBJECT)
+        {
+            const auto &left = frame.from->objectValue;
+            const auto &right = frame.to->objectValue;
+            std::unordered_map<std::string, size_t> keys;
+            for (size_t j = 0; j < right.size(); j++)
+                keys.emplace(right[j].key, j);
+
+            std::vector<bool> matched(right.size(), false);
+            for (const auto &kv : left)
+            {
+                auto it = keys.find(kv.key);
+                std::string path = frame.path + "/" + escape(kv.key);
+                if (it == keys.end() || matched[it->second])
+                {
+                    addOperation(patch, "remove", path, nullptr);
+                    continue;
+                }
+                matched[it->second] = true;
+                compare(kv.value, right[it->second].value, path);
+            }
+            for (size_t j = 0; j < right.size(); j++)
+            {
+                if (!matched[j])
+                    addOperation(patch, "add", frame.path + "/" + escape(right[j].key), right[j].value);
+            }
+            continue;
+        }
+
+        const auto &left = frame.from->arrayValue;
+        const auto &right = frame.to->arrayValue;
+        // Elements are numbered by class: an element joins the first earlier one with the same hash
+        // which it is equal to, so a hash collision never aligns two different elements.
+        std::unordered_map<uint64_t, std::vector<size_t>> candidates;
+        std::vector<const JSONValue *> representatives;
+        auto classOf = [&](const JSONValue *element)
+        {
+            std::vector<size_t> &classes = candidates[hashes[element]];
+            for (size_t index : classes)
+            {
+                if (equal(*representatives[index], *element))
+                    return static_cast<uint64_t>(index);
+            }
+            classes.push_back(representatives.size());
+            representatives.push_back(element);
+            return static_cast<uint64_t>(representatives.size() - 1);
+        };
+        std::vector<uint64_t> leftClasses;
+        std::vector<uint64_t> rightClasses;
+        for (const JSONValue *element : left)
+            leftClasses.push_back(classOf(element));
+        for (const JSONValue *element : right)
+            rightClasses.push_back(classOf(element));
+        std::vector<std::pair<size_t, size_t>> matches;
+        align(leftClasses, rightClasses, matches);
+        matches.push_back({left.size(), right.size()});
+
+        // Between two aligned elements, differing elements are paired up first, then the surplus is removed or added.
+        size_t index = 0;
+        size_t i = 0;
+        size_t j = 0;
+        for (const auto &match : matches)
+        {
+            size_t removed = match.first - i;
+            size_t added = match.second - j;
+            size_t paired = std::min(removed, added);
+            for (size_t k = 0; k < paired; k++)
+                compare(left[i + k], right[j + k], frame.path + "/" + std::to_string(index++));
+            for (size_t k = paired; k < removed; k++)
+                addOperation(patch, "remove", frame.path + "/" + std::to_string(index), nullptr);
+            for (size_t k = paired; k < added; k++)
+                addOperation(patch, "add", frame.path + "/" + std::to_string(index++), right[j + k]);
+            index++;
+            i = match.first + 1;
+            j = match.second + 1;
+        }
+    }
+    return patch;
+}
+
+void Patch::align(const std::vector<uint64_t> &left, const std::vector<uint64_t> &right, std::vector<std::pair<size_t, size_t>> &matches)
+{
+    struct Range
+    {
+        size_t leftBegin;
+        size_t leftEnd;
+        size_t rightBegin;
+        size_t rightEnd;
+    };
+
+    struct Occurrence
+    {
+        size_t leftCount = 0;
+        size_t rightCount = 0;
+        size_t leftIndex = 0;
+    };
+
+    std::vector<Range> pending = {{0, left.size(), 0, right.size()}};
+    while (!pending.empty())
+    {
+        Range range = pending.back();
+        pending.pop_back();
+        while (range.leftBegin < range.leftEnd && range.rightBegin < range.rightEnd && left[range.leftBegin] == right[range.rightBegin])
+            matches.push_back({range.leftBegin++, range.rightBegin++});
+        while (range.leftBegin < range.leftEnd && range.rightBegin < range.rightEnd && left[range.leftEnd - 1] == right[range.rightEnd - 1])
+            matches.push_back({--range.leftEnd, --range.rightEnd});
+
+        size_t rows = range.leftEnd - range.leftBegin;
+        size_t columns = range.rightEnd - range.rightBegin;
+        if (rows == 0 || columns == 0)
+            continue;
+
+        if (rows * columns <= ALIGN_LIMIT)
+        {
+            // Longest common subsequence of the remaining elements.
+            size_t width = columns + 1;
+            std::vector<uint32_t> common((rows + 1) * width, 0);
+            for (size_t i = rows; i-- > 0;)
+            {
+                for (size_t j = columns; j-- > 0;)
+                {
+                    common[i * width + j] = left[range.leftBegin + i] == right[range.rightBegin + j]
+                                                ? common[(i + 1) * width + j + 1] + 1
+                                                : std::max(common[(i + 1) * width + j], common[i * width + j + 1]);
+                }
+            }
+            size_t i = 0;
+            size_t j = 0;
+            while (i < rows && j < columns)
+            {
+                if (left[range.leftBegin + i] == right[range.rightBegin + j])
+                    matches.push_back({range.leftBegin + i++, range.rightBegin + j++});
+                else if (common[(i + 1) * width + j] >= common[i * width + j + 1])
+                    i++;
+                else
+                    j++;
+            }
+            continue;
+        }
+
+        // Too large for a full alignment: split at elements occurring exactly once on each side,
+        // keeping the longest chain of them that both sides order the same way.
+        std::unordered_map<uint64_t, Occurrence> occurrences;
+        for (size_t i = range.leftBegin; i < range.leftEnd; i++)
+        {
+            Occurrence &occurrence = occurrences[left[i]];
+            occurrence.leftCount++;
+            occurrence.leftIndex = i;
+        }
+        for (size_t j = range.rightBegin; j < range.rightEnd; j++)
+        {
+            auto it = occurrences.find(right[j]);
+            if (it != occurrences.end())
+                it->second.rightCount++;
+        }
+
+        std::vector<std::pair<size_t, size_t>> anchors;
+        for (size_t j = range.rightBegin; j < range.rightEnd; j++)
+        {
+            auto it = occurrences.find(right[j]);
+            if (it != occurrences.end() && it->second.leftCount == 1 && it->second.rightCount == 1)
+                anchors.push_back({it->second.leftIndex, j});
+        }
+
+        std::vector<size_t> tails;
+        std::vector<size_t> previous(anchors.size());
+        for (size_t k = 0; k < anchors.size(); k++)
+        {
+            auto position = std::lower_bound(tails.begin(), tails.end(), anchors[k].first, [&](size_t tail, size_t value)
+                                             { return anchors[tail].first < value; });
+            previous[k] = position == tails.begin() ? ANY : *(position - 1);
+            if (position == tails.end())
+                tails.push_back(k);
+            else
+                *position = k;
+        }
+
+        std::vector<std::pair<size_t, size_t>> chain;
+        for (size_t k = tails.empty() ? ANY : tails.back(); k != ANY; k = previous[k])
+            chain.push_back(anchors[k]);
+        std::reverse(chain.begin(), chain.end());
+
+        size_t leftBegin = range.leftBegin;
+        size_t rightBegin = range.rightBegin;
+        for (const auto &anchor : chain)
+        {
+            pending.push_back({leftBegin, anchor.first, rightBegin, anchor.second});
+            matches.push_back(anchor);
+            leftBegin = anchor.first + 1;
+            rightBegin = anchor.second + 1;
+        }
+        if (!chain.empty())
+            pending.push_back({leftBegin, range.leftEnd, rightBegin, range.rightEnd});
+    }
+    std::sort(matches.begin(), matches.end());
+}
+
+std::vector<std::string> Patch::parsePointer(const std::string &pointer)
+{
+    std::vector<std::string> tokens;
+    if (pointer.empty())
+    {
+        return tokens;
+    }
+    if (pointer[0] != '/')
+    {
+        throw std::runtime_error("invalid JSON pointer \"" + pointer + "\".");
+    }
+
+    tokens.emplace_back();
+    for (size_t i = 1; i < pointer.size(); i++)
+    {
+        if (pointer[i] == '/')
+        {
+            tokens.emplace_back();
+        }
+        else if (pointer[i] != '~')
+        {
+            tokens.back() += pointer[i];
+        }
+        else if (i + 1 < pointer.size() && (pointer[i + 1] == '0' || pointer[i + 1] == '1'))
+        {
+            tokens.back() += pointer[++i] == '0' ? '~' : '/';
+        }
+        else
+        {
+            throw std::runtime_error("invalid escape in JSON pointer \"" + pointer + "\".");
+        }
+    }
+    return tokens;
+}
+
+std::string Patch::escape(const std::string &token)
+{
+    std::string escaped;
+    for (char c : token)
+    {
+        if (c == '~')
+            escaped += "~0";
+        else if (c == '/')
+            escaped += "~1";
+        else
+            escaped += c;
+    }
+    return escaped;
+}
+
+bool Patch::equal(const JSONValue &left, const JSONValue &right)
+{
+    std::vector<std::pair<const JSONValue *, const JSONValue *>> pending = {{&left, &right}};
+    while (!pending.empty())
+    {
+        const JSONValue *a = pending.back().first;
+        const JSONValue *b = pending.back().second;
+        pending.pop_back();
+        if (a->type != b->type)
+            return false;
+
+        switch (a->type)
+        {
+        case JSONValueType::STRING:
+            if (a->stringValue != b->stringValue)
+                return false;
+            break;
+        case JSONValueType::NUMBER:
+            if (a->numberValue != b->numberValue)
+                return false;
+            break;
+        case JSONValueType::BOOL:
+            if (a->boolValue != b->boolValue)
+                return false;
+            break;
+        case JSONValueType::ARRAY:
+            if (a->arrayValue.size() != b->arrayValue.size())
+                return false;
+            for (size_t i = 0; i < a->arrayValue.size(); i++)
+                pending.push_back({a->arrayValue[i], b->arrayValue[i]});
+            break;
+        case JSONValueType::OBJECT:
+            if (a->objectValue.size() != b->objectValue.size())
+                return false;
+            for (size_t i = 0; i < a->objectValue.size(); i++)
+            {
+                // Members usually come in the same order, so the same position is tried first.
+                const std::string &key = a->objectValue[i].key;
+                const JSONValue *other = b->objectValue[i].key == key ? b->objectValue[i].value : member(*b, key);
+                if (other == nullptr)
+                    return false;
+                pending.push_back({a->objectValue[i].value, other});
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+void Patch::hashTree(const JSONValue &root, std::unordered_map<const JSONValue *, uint64_t> &hashes)
+{
+    std::vector<std::pair<const JSONValue *, bool>> pending = {{&root, false}};
+    while (!pending.empty())
+    {
+        const JSONValue *node = pending.back().first;
+        if (!pending.back().second && (!node->arrayValue.empty() || !node->objectValue.empty()))
+        {
+            pending.back().second = true;
+            for (const JSONValue *child : node->arrayValue)
+                pending.push_back({child, false});
+            for (const auto &kv : node->objectValue)
+                pending.push_back({kv.value, false});
+            continue;
+        }
+        pending.pop_back();
+
+        uint64_t hash = static_cast<uint64_t>(node->type) + 1;
+        switch (node->type)
+        {
+        case JSONValueType::STRING:
+            hash = combine(hash, ParseCache::hash(node->stringValue.data(), node->stringValue.size()));
+            break;
+        case JSONValueType::NUMBER:
+        {
+            double number = node->numberValue == 0 ? 0.0 : node->numberValue;
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+            hash = combine(hash, bits);
+            break;
+        }
+        case JSONValueType::BOOL:
+            hash = combine(hash, node->boolValue);
+            break;
+        case JSONValueType::ARRAY:
+            for (const JSONValue *child : node->arrayValue)
+                hash = combine(hash, hashes[child]);
+            break;
+        case JSONValueType::OBJECT:
+            for (const auto &kv : node->objectValue)
+                hash = combine(combine(hash, ParseCache::hash(kv.key.data(), kv.key.size())), hashes[kv.value]);
+            break;
+        default:
+            break;
+        }
+        hashes[node] = hash;
+    }
+}
@@ -0,0 +1,140 @@
+#ifndef PATCH_H
+#define PATCH_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "JSONValue.h"
+
+/**
+ * Class applying and computing patches: RFC 6902 JSON Patch documents (an array of add, remove,
+ * replace, move, copy and test operations addressed by JSON pointers) and RFC 7396 merge patches.
+ *
+ * A JSON Patch is applied as one transaction. Each operation resolves its pointer once and then
+ * works on the parent container by index; every change is recorded in an undo log, and if any
+ * operation fails the log is replayed backwards so that the document is left exactly as it was.
+ * Nodes removed by the patch are only freed once the whole patch has succeeded.
+ *
+ * A diff hashes every subtree of both documents first, so differing subtrees are told apart in
+ * one comparison; a matching hash is confirmed with Patch::equal before a subtree is skipped.
+ * Array elements are aligned on classes of equal elements, which turns insertions and deletions
+ * in the middle of an array into single add and remove operations instead of a run of replaces.
+ */
+class Patch
+{
+public:
+    /**
+     * Applies a patch to a document: an array is a JSON Patch, any other value a merge patch.
+     * Throws std::runtime_error describing the failing operation, leaving the document unchanged.
+     * @param root Document to patch.
+     * @param patch Patch document.
+     * @return Number of operations applied, or of members merged.
+     */
+    static size_t apply(JSONValue &root, const JSONValue &patch);
+
+    /**
+     * Computes a JSON Patch turning one document into another.
+     * @param from Original document.
+     * @param to Target document.
+     * @return Array of patch operations.
+     */
+    static JSONValue diff(const JSONValue &from, const JSONValue &to);
+
+private:
+    static const size_t ANY = static_cast<size_t>(-1);
+
+    /**
+     * Ranges of array elements with more element pairs than this are not aligned exhaustively,
+     * but split at elements which occur exactly once on each side.
+     */
+    static const size_t ALIGN_LIMIT = 1 << 22;
+
+    /**
+     * Structure recording one change to the document, so that it can be undone.
+     * For REPLACED and ROOT, value holds the displaced node, which is freed on commit.
+     * For REMOVED, value holds the removed node, freed on commit if owned.
+     * For INSERTED and REPLACED, owned tells whether the node now in the document is freed on rollback.
+     */
+    struct Change
+    {
+        enum class Kind
+        {
+            INSERTED,
+            REMOVED,
+            REPLACED,
+            ROOT
+        };
+
+        Kind kind;
+        JSONValue *container;
+        size_t index;
+        std::string key;
+        JSONValue *value;
+        bool owned;
+    };
+
+    /**
+     * Structure describing where a pointer leads: a member slot of a container, or the root.
+     */
+    struct Location
+    {
+        JSONValue *container = nullptr;
+        size_t index = 0;
+        std::string key;
+        bool exists = false;
+    };
+
+    /**
+     * Class applying JSON Patch operations while keeping an undo log.
+     */
+    class Transaction;
+
+    /**
+     * Applies a merge patch.
+     * @param root Document to patch.
+     * @param patch Merge patch.
+     * @return Number of members merged.
+     */
+    static size_t merge(JSONValue &root, const JSONValue &patch);
+
+    /**
+     * Aligns the elements of two arrays on their classes.
+     * @param left Classes of the original elements; two elements share a class only if they are equal.
+     * @param right Classes of the target elements.
+     * @param matches Receives the pairs of equal elements, increasing on both sides.
+     */
+    static void align(const std::vector<uint64_t> &left, const std::vector<uint64_t> &right, std::vector<std::pair<size_t, size_t>> &matches);
+
+    /**
+     * Splits a JSON pointer into its unescaped reference tokens.
+     * @param pointer JSON pointer.
+     * @return Reference tokens.
+     */
+    static std::vector<std::string> parsePointer(const std::string &pointer);
+
+    /**
+     * Escapes a member key or index for use in a JSON pointer.
+     * @param token Reference token.
+     * @return Escaped token.
+     */
+    static std::string escape(const std::string &token);
+
+    /**
+     * Compares two values structurally; members of objects are compared by key, in any order.
+     * @param left First value.
+     * @param right Second value.
+     * @return True if the values are equal.
+     */
+    static bool equal(const JSONValue &left, const JSONValue &right);
+
+    /**
+     * Computes the hash of every subtree of a document.
+     * @param root Document.
+     * @param hashes Receives the hash of each node.
+     */
+    static void hashTree(const JSONValue &root, std::unordered_map<const JSONValue *, uint64_t> &hashes);
+};
+
+#endif
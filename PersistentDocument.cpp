@@ -0,0 +1,570 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "PersistentDocument.h"
+#include "BackgroundWriter.h"
+#include "Parser.h"
+
+PersistentNode::~PersistentNode()
+{
+    std::vector<NodePtr> pending;
+    for (auto &item : arrayValue)
+        pending.push_back(std::move(item));
+    for (auto &kv : objectValue)
+        pending.push_back(std::move(kv.second));
+
+    // A child held only here is emptied before it is released, so its own destructor has nothing left to recurse into.
+    while (!pending.empty())
+    {
+        NodePtr node = std::move(pending.back());
+        pending.pop_back();
+        if (node.use_count() != 1)
+            continue;
+        PersistentNode &owned = const_cast<PersistentNode &>(*node);
+        for (auto &item : owned.arrayValue)
+            pending.push_back(std::move(item));
+        for (auto &kv : owned.objectValue)
+            pending.push_back(std::move(kv.second));
+        owned.arrayValue.clear();
+        owned.objectValue.clear();
+    }
+}
+
+PersistentDocument::PersistentDocument(const JSONValue &value) : current(fromJSONValue(value)) {}
+
+NodePtr PersistentDocument::getRoot() const
+{
+    return current;
+}
+
+bool PersistentDocument::set(const std::string &path, const std::string &newValue)
+{
+    NodePtr parsed;
+    if (!parseValue(newValue, parsed))
+    {
+        return false;
+    }
+
+    NodePtr newRoot = rebuild(current, splitPath(path), 0, false, [&](PersistentNode &parent, const std::string &key)
+                              {
+        auto it = std::find_if(parent.objectValue.begin(), parent.objectValue.end(), [&](const std::pair<std::string, NodePtr> &kv)
+                               { return kv.first == key; });
+        if (it == parent.objectValue.end())
+        {
+            std::cerr << "Final path element not found: " << key << std::endl;
+            return false;
+        }
+        it->second = parsed;
+        return true; });
+
+    if (!newRoot)
+    {
+        return false;
+    }
+    commit(newRoot);
+    return true;
+}
+
+bool PersistentDocument::create(const std::string &path, const std::string &newValue)
+{
+    NodePtr parsed;
+    if (!parseValue(newValue, parsed))
+    {
+        return false;
+    }
+
+    NodePtr newRoot = rebuild(current, splitPath(path), 0, true, [&](PersistentNode &parent, const std::string &key)
+                              {
+        auto it = std::find_if(parent.objectValue.begin(), parent.objectValue.end(), [&](const std::pair<std::string, NodePtr> &kv)
+                               { return kv.first == key; });
+        if (it != parent.objectValue.end())
+        {
+            std::cerr << "Element already exists at path: " << path << std::endl;
+            return false;
+        }
+        parent.objectValue.push_back({key, parsed});
+        return true; });
+
+    if (!newRoot)
+    {
+        return false;
+    }
+    commit(newRoot);
+    return true;
+}
+
+bool PersistentDocument::deleteElement(const std::string &path)
+{
+    NodePtr newRoot = rebuild(current, splitPath(path), 0, false, [&](PersistentNode &parent, const std::string &key)
+                              {
+        auto it = std::find_if(parent.objectValue.begin(), parent.objectValue.end(), [&](const std::pair<std::string, NodePtr> &kv)
+                               { return kv.first == key; });
+        if (it == parent.objectValue.end())
+        {
+            std::cerr << "Element not found at path: " << path << std::endl;
+            return false;
+        }
+        parent.objectValue.erase(it);
+        return true; });
+
+    if (!newRoot)
+    {
+        return false;
+    }
+    commit(newRoot);
+    return true;
+}
+
+bool PersistentDocument::move(const std::string &from, const std::string &to)
+{
+    NodePtr value = findByPath(from);
+    if (!value || from.empty() || to.empty())
+    {
+        std::cerr << "Element not found at path: " << from << std::endl;
+        return false;
+    }
+    std::vector<std::string> fromKeys = splitPath(from);
+    std::vector<std::string> toKeys = splitPath(to);
+    if (toKeys.size() > fromKeys.size() && std::equal(fromKeys.begin(), fromKeys.end(), toKeys.begin()))
+    {
+        std::cerr << "Cannot move an element into itself: " << to << std::endl;
+        return false;
+    }
+
+    NodePtr withTarget = rebuild(current, toKeys, 0, true, [&](PersistentNode &parent, const std::string &key)
+                                 {
+        auto it = std::find_if(parent.objectValue.begin(), parent.objectValue.end(), [&](const std::pair<std::string, NodePtr> &kv)
+                               { return kv.first == key; });
+        if (it != parent.objectValue.end())
+        {
+            std::cerr << "Element already exists at path: " << to << std::endl;
+            return false;
+        }
+        parent.objectValue.push_back({key, value});
+        return true; });
+    if (!withTarget)
+    {
+        return false;
+    }
+
+    NodePtr newRoot = rebuild(withTarget, fromKeys, 0, false, [&](PersistentNode &parent, const std::string &key)
+                              {
+        auto it = std::find_if(parent.objectValue.begin(), parent.objectValue.end(), [&](const std::pair<std::string, NodePtr> &kv)
+                               { return kv.first == key && kv.second == value; });
+        if (it == parent.objectValue.end())
+        {
+            std::cerr << "Element not found at path: " << from << std::endl;
+            return false;
+        }
+        parent.objectValue.erase(it);
+        return true; });
+    if (!newRoot)
+    {
+        return false;
+    }
+
+    commit(newRoot);
+    return true;
+}
+
+void PersistentDocument::replace(const JSONValue &value)
+{
+    commit(fromJSONValue(value));
+}
+
+bool PersistentDocument::undo()
+{
+    if (undoStack.empty())
+    {
+        return false;
+    }
+    redoStack.push_back(current);
+    current = undoStack.back();
+    undoStack.pop_back();
+    return true;
+}
+
+bool PersistentDocument::redo()
+{
+    if (redoStack.empty())
+    {
+        return false;
+    }
+    undoStack.push_back(current);
+    current = redoStack.back();
+    redoStack.pop_back();
+    return true;
+}
+
+void PersistentDocument::snapshot(const std::string &name)
+{
+    snapshots[name] = current;
+}
+
+bool PersistentDocument::restore(const std::string &name)
+{
+    auto it = snapshots.find(name);
+    if (it == snapshots.end())
+    {
+        return false;
+    }
+    commit(it->second);
+    return true;
+}
+
+std::vector<std::string> PersistentDocument::getSnapshotNames() const
+{
+    std::vector<std::string> names;
+    for (const auto &entry : snapshots)
+    {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+NodePtr PersistentDocument::findByPath(const std::string &path) const
+{
+    if (path.empty())
+    {
+        return current;
+    }
+
+    NodePtr target = current;
+    for (const auto &key : splitPath(path))
+    {
+        if (target->type != JSONValueType::OBJECT)
+        {
+            std::cerr << "Invalid path: " << key << " is not an object." << std::endl;
+            return nullptr;
+        }
+
+        auto it = std::find_if(target->objectValue.begin(), target->objectValue.end(), [&](const std::pair<std::string, NodePtr> &kv)
+                               { return kv.first == key; });
+        if (it == target->objectValue.end())
+        {
+            std::cerr << "Path element not found: " << key << std::endl;
+            return nullptr;
+        }
+
+        target = it->second;
+    }
+
+    return target;
+}
+
+std::vector<NodePtr> PersistentDocument::searchKey(const std::regex &pattern, size_t limit) const
+{
+    std::vector<NodePtr> results;
+    searchKey(*current, pattern, results, limit);
+    return results;
+}
+
+bool PersistentDocument::contains(const std::string &value) const
+{
+    return containsHelper(*current, value);
+}
+
+void PersistentDocument::writeJSON(std::ostream &out, const PersistentNode &node, int indent, size_t depth, size_t limit)
+{
+    struct Frame
+    {
+        const PersistentNode *node;
+        size_t next;
+        int indent;
+    };
+
+    std::vector<Frame> open;
+    const PersistentNode *current = &node;
+    int currentIndent = indent;
+    while (true)
+    {
+        bool isContainer = current->type == JSONValueType::OBJECT || current->type == JSONValueType::ARRAY;
+        if (isContainer && !(current->objectValue.empty() && current->arrayValue.empty()) && open.size() >= depth)
+        {
+            out << (current->type == JSONValueType::OBJECT ? "{...}" : "[...]");
+        }
+        else
+        {
+            switch (current->type)
+            {
+            case JSONValueType::OBJECT:
+            case JSONValueType::ARRAY:
+                out << (current->type == JSONValueType::OBJECT ? "{\n" : "[\n");
+                open.push_back({current, 0, currentIndent});
+                break;
+            case JSONValueType::STRING:
+                out << "\"" << current->stringValue << "\"";
+                break;
+            case JSONValueType::NUMBER:
+                out << current->numberValue;
+                break;
+            case JSONValueType::BOOL:
+                out << (current->boolValue ? "true" : "false");
+                break;
+            case JSONValueType::NIL:
+                out << "null";
+                break;
+            }
+        }
+
+        current = nullptr;
+        while (current == nullptr && !open.empty())
+        {
+            Frame &frame = open.back();
+            bool isObject = frame.node->type == JSONValueType::OBJECT;
+            size_t count = isObject ? frame.node->objectValue.size() : frame.node->arrayValue.size();
+            size_t shown = std::min(count, limit);
+            std::string indentStr(frame.indent, ' ');
+
+            // Coming back to a frame after one of its members means that member is complete.
+            if (frame.next > 0)
+                out << (frame.next < count ? ",\n" : "\n");
+            if (frame.next == shown)
+            {
+                if (shown < count)
+                    out << indentStr << "  ... " << count - shown << " more\n";
+                out << indentStr << (isObject ? "}" : "]");
+                open.pop_back();
+                continue;
+            }
+
+            out << indentStr << "  ";
+            if (isObject)
+            {
+                out << "\"" << frame.node->objectValue[frame.next].first << "\": ";
+                current = frame.node->objectValue[frame.next].second.get();
+            }
+            else
+            {
+                current = frame.node->arrayValue[frame.next].get();
+            }
+            currentIndent = frame.indent + 2;
+            frame.next++;
+        }
+
+        if (current == nullptr)
+        {
+            return;
+        }
+    }
+}
+
+std::string PersistentDocument::toString(const PersistentNode &node)
+{
+    return toJSONValue(node).toString();
+}
+
+JSONValue PersistentDocument::toJSONValue(const PersistentNode &node)
+{
+    // Every child is allocated in place and filled in from an explicit stack, so nesting is not limited by the call stack.
+    JSONValue value;
+    std::vector<std::pair<const PersistentNode *, JSONValue *>> pending = {{&node, &value}};
+    while (!pending.empty())
+    {
+        const PersistentNode *source = pending.back().first;
+        JSONValue *target = pending.back().second;
+        pending.pop_back();
+
+        target->type = source->type;
+        target->stringValue = source->stringValue;
+        target->numberValue = source->numberValue;
+        target->boolValue = source->boolValue;
+        target->arrayValue.reserve(source->arrayValue.size());
+        for (const auto &item : source->arrayValue)
+        {
+            target->arrayValue.push_back(new JSONValue());
+            pending.emplace_back(item.get(), target->arrayValue.back());
+        }
+        target->objectValue.reserve(source->objectValue.size());
+        for (const auto &kv : source->objectValue)
+        {
+            target->objectValue.push_back(KeyValue(kv.first, new JSONValue()));
+            pending.emplace_back(kv.second.get(), target->objectValue.back().value);
+        }
+    }
+    return value;
+}
+
+bool PersistentDocument::saveas(const std::string &file, const std::string &path) const
+{
+    NodePtr node = findByPath(path);
+    if (!node)
+    {
+        std::cerr << "Invalid path." << std::endl;
+        return false;
+    }
+
+    try
+    {
+        std::ostringstream out;
+        writeJSON(out, *node, 0);
+        BackgroundWriter::replaceFile(file, out.str());
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error saving to file: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+NodePtr PersistentDocument::fromJSONValue(const JSONValue &value)
+{
+    auto root = std::make_shared<PersistentNode>();
+    std::vector<std::pair<const JSONValue *, PersistentNode *>> pending = {{&value, root.get()}};
+    while (!pending.empty())
+    {
+        const JSONValue *source = pending.back().first;
+        PersistentNode *target = pending.back().second;
+        pending.pop_back();
+
+        target->type = source->type;
+        target->stringValue = source->stringValue;
+        target->numberValue = source->numberValue;
+        target->boolValue = source->boolValue;
+        target->arrayValue.reserve(source->arrayValue.size());
+        for (const auto *item : source->arrayValue)
+        {
+            auto child = std::make_shared<PersistentNode>();
+            pending.emplace_back(item, child.get());
+            target->arrayValue.push_back(std::move(child));
+        }
+        target->objectValue.reserve(source->objectValue.size());
+        for (const auto &kv : source->objectValue)
+        {
+            auto child = std::make_shared<PersistentNode>();
+            pending.emplace_back(kv.value, child.get());
+            target->objectValue.push_back({kv.key, std::move(child)});
+        }
+    }
+    return root;
+}
+
+bool PersistentDocument::parseValue(const std::string &text, NodePtr &result)
+{
+    try
+    {
+        Parser valueParser(text, "", InputFormat::JSON);
+        result = fromJSONValue(valueParser.parse());
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Invalid new value: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+template <typename Edit>
+NodePtr PersistentDocument::rebuild(const NodePtr &node, const std::vector<std::string> &keys, size_t index, bool createMissing, Edit edit)
+{
+    if (node->type != JSONValueType::OBJECT)
+    {
+        if (index == keys.size() - 1)
+            std::cerr << "Invalid path: final element is not an object." << std::endl;
+        else
+            std::cerr << "Invalid path: " << keys[index] << " is not an object." << std::endl;
+        return nullptr;
+    }
+
+    auto copy = std::make_shared<PersistentNode>(*node);
+    if (index == keys.size() - 1)
+    {
+        return edit(*copy, keys[index]) ? copy : nullptr;
+    }
+
+    auto it = std::find_if(copy->objectValue.begin(), copy->objectValue.end(), [&](const std::pair<std::string, NodePtr> &kv)
+                           { return kv.first == keys[index]; });
+    if (it == copy->objectValue.end())
+    {
+        if (!createMissing)
+        {
+            std::cerr << "Path element not found: " << keys[index] << std::endl;
+            return nullptr;
+        }
+        auto newObject = std::make_shared<PersistentNode>();
+        newObject->type = JSONValueType::OBJECT;
+        copy->objectValue.push_back({keys[index], newObject});
+        it = copy->objectValue.end() - 1;
+    }
+
+    NodePtr updated = rebuild(it->second, keys, index + 1, createMissing, edit);
+    if (!updated)
+    {
+        return nullptr;
+    }
+    it->second = updated;
+    return copy;
+}
+
+void PersistentDocument::commit(const NodePtr &newRoot)
+{
+    undoStack.push_back(current);
+    redoStack.clear();
+    current = newRoot;
+}
+
+void PersistentDocument::searchKey(const PersistentNode &node, const std::regex &pattern, std::vector<NodePtr> &results, size_t limit)
+{
+    // Children are pushed in reverse so that matches come out in document order; a match carries its handle.
+    std::vector<std::pair<const PersistentNode *, const NodePtr *>> pending = {{&node, nullptr}};
+    while (!pending.empty() && results.size() < limit)
+    {
+        const PersistentNode *current = pending.back().first;
+        if (pending.back().second != nullptr)
+        {
+            results.push_back(*pending.back().second);
+        }
+        pending.pop_back();
+
+        for (auto it = current->objectValue.rbegin(); it != current->objectValue.rend(); ++it)
+        {
+            pending.emplace_back(it->second.get(), std::regex_match(it->first, pattern) ? &it->second : nullptr);
+        }
+        for (auto it = current->arrayValue.rbegin(); it != current->arrayValue.rend(); ++it)
+        {
+            pending.emplace_back(it->get(), nullptr);
+        }
+    }
+}
+
+bool PersistentDocument::containsHelper(const PersistentNode &node, const std::string &value)
+{
+    std::vector<const PersistentNode *> pending = {&node};
+    while (!pending.empty())
+    {
+        const PersistentNode *current = pending.back();
+        pending.pop_back();
+
+        if (current->type == JSONValueType::STRING && current->stringValue.find(value) != std::string::npos)
+        {
+            return true;
+        }
+        for (const auto &kv : current->objectValue)
+            pending.push_back(kv.second.get());
+        for (const auto &item : current->arrayValue)
+            pending.push_back(item.get());
+    }
+    return false;
+}
+
+std::vector<std::string> PersistentDocument::splitPath(const std::string &path)
+{
+    JSON_STATS_ADD(PATH_LOOKUPS, 1);
+    std::vector<std::string> keys;
+    size_t start = 0;
+    size_t end = path.find('/');
+
+    while (end != std::string::npos)
+    {
+        keys.push_back(path.substr(start, end - start));
+        start = end + 1;
+        end = path.find('/', start);
+    }
+
+    keys.push_back(path.substr(start));
+    return keys;
+}
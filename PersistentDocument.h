@@ -0,0 +1,243 @@
+#ifndef PERSISTENT_DOCUMENT_H
+#define PERSISTENT_DOCUMENT_H
+
+#include <map>
+#include <memory>
+#include <ostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "JSONValue.h"
+
+struct PersistentNode;
+
+/**
+ * Shared handle to an immutable node. Versions of a document share every subtree they have in common.
+ */
+using NodePtr = std::shared_ptr<const PersistentNode>;
+
+/**
+ * Structure representing an immutable JSON value inside a PersistentDocument.
+ */
+struct PersistentNode
+{
+    JSONValueType type = JSONValueType::NIL;
+    std::string stringValue;
+    double numberValue = 0;
+    bool boolValue = false;
+    std::vector<NodePtr> arrayValue;
+    std::vector<std::pair<std::string, NodePtr>> objectValue;
+
+    PersistentNode() = default;
+    PersistentNode(const PersistentNode &) = default;
+    PersistentNode(PersistentNode &&) = default;
+    PersistentNode &operator=(const PersistentNode &) = default;
+    PersistentNode &operator=(PersistentNode &&) = default;
+
+    /**
+     * Releases the children without recursion: subtrees no other version shares are taken
+     * apart on an explicit stack, so that a deeply nested node does not overflow the call stack.
+     */
+    ~PersistentNode();
+};
+
+/**
+ * Class representing a JSON document as a persistent tree with structural sharing.
+ * Every mutation copies only the nodes on the path from the root to the change and
+ * produces a new version, which keeps undo, redo and named snapshots O(1) to record.
+ */
+class PersistentDocument
+{
+public:
+    /**
+     * Constructs a PersistentDocument from a JSONValue tree.
+     * @param value Root of the document.
+     */
+    explicit PersistentDocument(const JSONValue &value);
+
+    /**
+     * Gets the root of the current version.
+     * @return Root node.
+     */
+    NodePtr getRoot() const;
+
+    /**
+     * Sets a new value at the specified path.
+     * @param path Path to the element to be updated.
+     * @param newValue New value to set, as JSON text.
+     * @return True if the value is successfully set, false otherwise.
+     */
+    bool set(const std::string &path, const std::string &newValue);
+
+    /**
+     * Creates a new element at the specified path, creating missing parent objects.
+     * @param path Path to the new element to be created.
+     * @param newValue Value of the new element, as JSON text.
+     * @return True if the element is successfully created, false otherwise.
+     */
+    bool create(const std::string &path, const std::string &newValue);
+
+    /**
+     * Deletes an element at the specified path.
+     * @param path Path to the element to be deleted.
+     * @return True if the element is successfully deleted, false otherwise.
+     */
+    bool deleteElement(const std::string &path);
+
+    /**
+     * Moves an element from one path to another.
+     * @param from Source path.
+     * @param to Destination path.
+     * @return True if the element is successfully moved, false otherwise.
+     */
+    bool move(const std::string &from, const std::string &to);
+
+    /**
+     * Replaces the whole document with a new tree, recorded as an edit which can be undone.
+     * @param value New root of the document.
+     */
+    void replace(const JSONValue &value);
+
+    /**
+     * Reverts the last edit.
+     * @return True if there was an edit to revert, false otherwise.
+     */
+    bool undo();
+
+    /**
+     * Reapplies the last reverted edit.
+     * @return True if there was an edit to reapply, false otherwise.
+     */
+    bool redo();
+
+    /**
+     * Records the current version under a name.
+     * @param name Name of the snapshot.
+     */
+    void snapshot(const std::string &name);
+
+    /**
+     * Makes a named snapshot the current version. The restore itself can be undone.
+     * @param name Name of the snapshot.
+     * @return True if the snapshot exists, false otherwise.
+     */
+    bool restore(const std::string &name);
+
+    /**
+     * Gets the names of all recorded snapshots.
+     * @return Snapshot names in alphabetical order.
+     */
+    std::vector<std::string> getSnapshotNames() const;
+
+    /**
+     * Finds a node by a given path in the current version.
+     * @param path Path to the JSON element.
+     * @return The node if found, nullptr otherwise.
+     */
+    NodePtr findByPath(const std::string &path) const;
+
+    /**
+     * Searches for keys matching a regex pattern in the current version.
+     * @param pattern Regex pattern to match keys against.
+     * @param limit Number of matches after which the search stops.
+     * @return Matching nodes.
+     */
+    std::vector<NodePtr> searchKey(const std::regex &pattern, size_t limit = JSONValue::ANY) const;
+
+    /**
+     * Checks if a value is contained in the current version.
+     * @param value Value to search for.
+     * @return True if the value is found, false otherwise.
+     */
+    bool contains(const std::string &value) const;
+
+    /**
+     * Writes a node to an output stream with indentation, in the same format as Parser.
+     * @param out Output stream.
+     * @param node Node to be written.
+     * @param indent Current indentation level.
+     * @param depth Number of container levels to open; deeper containers are written as {...} or [...].
+     * @param limit Number of members written per container; the rest are summed up as "... N more".
+     */
+    static void writeJSON(std::ostream &out, const PersistentNode &node, int indent, size_t depth = JSONValue::ANY, size_t limit = JSONValue::ANY);
+
+    /**
+     * Converts a node to the string representation used by JSONValue::toString.
+     * @param node Node to convert.
+     * @return String representation of the node.
+     */
+    static std::string toString(const PersistentNode &node);
+
+    /**
+     * Converts a node back into a JSONValue tree.
+     * @param node Node to convert.
+     * @return Deep copy of the node as a JSONValue.
+     */
+    static JSONValue toJSONValue(const PersistentNode &node);
+
+    /**
+     * Saves the current version, or a path within it, as JSON text.
+     * @param file Path to the file where the JSON will be saved.
+     * @param path Optional path within the document to save.
+     * @return True if the JSON is successfully saved, false otherwise.
+     */
+    bool saveas(const std::string &file, const std::string &path) const;
+
+private:
+    /**
+     * Converts a JSONValue tree into persistent nodes.
+     * @param value JSONValue to convert.
+     * @return Root of the converted tree.
+     */
+    static NodePtr fromJSONValue(const JSONValue &value);
+
+    /**
+     * Parses JSON text into persistent nodes.
+     * @param text JSON text.
+     * @param result Parsed node.
+     * @return True if the text is valid, false otherwise.
+     */
+    static bool parseValue(const std::string &text, NodePtr &result);
+
+    /**
+     * Rebuilds the path from a node down to the parent object of the last key, applying an edit to a copy of that parent.
+     * @param node Current node on the path.
+     * @param keys Path split into keys.
+     * @param index Index of the key to descend into.
+     * @param createMissing Whether missing intermediate objects are created.
+     * @param edit Edit applied to the copied parent object with the final key.
+     * @return Copy of the node with the edit applied, or nullptr if the edit failed.
+     */
+    template <typename Edit>
+    static NodePtr rebuild(const NodePtr &node, const std::vector<std::string> &keys, size_t index, bool createMissing, Edit edit);
+
+    /**
+     * Makes a new root the current version and records the previous one for undo.
+     * @param newRoot Root of the new version.
+     */
+    void commit(const NodePtr &newRoot);
+
+    /**
+     * Collects nodes whose keys match a pattern, up to a number of matches.
+     */
+    static void searchKey(const PersistentNode &node, const std::regex &pattern, std::vector<NodePtr> &results, size_t limit);
+
+    /**
+     * Helper function to check if a value is contained in a node.
+     */
+    static bool containsHelper(const PersistentNode &node, const std::string &value);
+
+    /**
+     * Splits a path string by '/' into individual keys.
+     */
+    static std::vector<std::string> splitPath(const std::string &path);
+
+private:
+    NodePtr current;
+    std::vector<NodePtr> undoStack;
+    std::vector<NodePtr> redoStack;
+    std::map<std::string, NodePtr> snapshots;
+};
+
+#endif
@@ -0,0 +1,449 @@
+#include <cstring>
+
+#include "PushReader.h"
+
+template <typename Policy>
+BasicPushReader<Policy>::BasicPushReader() : target(&result) {}
+
+template <typename Policy>
+void BasicPushReader<Policy>::feed(const char *data, size_t size)
+{
+    chunk = data;
+    chunkSize = size;
+    const char *end = data + size;
+    const char *p = data;
+    while (p < end)
+    {
+        switch (scan)
+        {
+        case Scan::BETWEEN:
+        {
+            char c = *p;
+            TokenType type;
+            switch (c)
+            {
+            case '{':
+                type = TokenType::LEFT_BRACE;
+                break;
+            case '}':
+                type = TokenType::RIGHT_BRACE;
+                break;
+            case '[':
+                type = TokenType::LEFT_BRACKET;
+                break;
+            case ']':
+                type = TokenType::RIGHT_BRACKET;
+                break;
+            case ',':
+                type = TokenType::COMMA;
+                break;
+            case ':':
+                type = TokenType::COLON;
+                break;
+            case '"':
+                offset++;
+                p++;
+                text.clear();
+                scan = Scan::STRING;
+                continue;
+            case 't':
+            case 'f':
+            case 'n':
+                text.clear();
+                scan = Scan::KEYWORD;
+                continue;
+            default:
+                if (isspace(static_cast<unsigned char>(c)))
+                {
+                    const char *next = p + 1;
+                    while (next < end && isspace(static_cast<unsigned char>(*next)))
+                        next++;
+                    offset += next - p;
+                    p = next;
+                    continue;
+                }
+                if (isdigit(static_cast<unsigned char>(c)) || c == '-')
+                {
+                    text.clear();
+                    scan = Scan::NUMBER;
+                    continue;
+                }
+                if (Policy::ALLOW_COMMENTS && c == '/')
+                {
+                    // The slash is only counted once the next character shows that a comment starts.
+                    p++;
+                    scan = Scan::SLASH;
+                    continue;
+                }
+                throw std::runtime_error("Unexpected character at " + position());
+            }
+            offset++;
+            p++;
+            token(type);
+            break;
+        }
+        case Scan::STRING:
+        {
+            const char *quote = static_cast<const char *>(std::memchr(p, '"', end - p));
+            const char *stop = quote != nullptr ? quote : end;
+            text.append(p, stop);
+            if (quote == nullptr)
+            {
+                offset += end - p;
+                p = end;
+                break;
+            }
+            offset += quote + 1 - p;
+            p = quote + 1;
+            scan = Scan::BETWEEN;
+            token(TokenType::STRING);
+            break;
+        }
+        case Scan::NUMBER:
+        {
+            const char *stop = p;
+            while (stop < end && (isdigit(static_cast<unsigned char>(*stop)) || *stop == '.' || *stop == '-' || *stop == '+'))
+                stop++;
+            text.append(p, stop);
+            offset += stop - p;
+            p = stop;
+            if (p < end)
+            {
+                scan = Scan::BETWEEN;
+                token(TokenType::NUMBER);
+            }
+            break;
+        }
+        case Scan::KEYWORD:
+        {
+            const char *stop = p;
+            while (stop < end && isalpha(static_cast<unsigned char>(*stop)))
+                stop++;
+            text.append(p, stop);
+            offset += stop - p;
+            p = stop;
+            if (p < end)
+            {
+                scan = Scan::BETWEEN;
+                keyword();
+            }
+            break;
+        }
+        case Scan::SLASH:
+            if (*p != '/' && *p != '*')
+            {
+                throw std::runtime_error("Unexpected character at " + position());
+            }
+            offset += 2;
+            scan = *p == '/' ? Scan::LINE_COMMENT : Scan::BLOCK_COMMENT;
+            p++;
+            break;
+        case Scan::LINE_COMMENT:
+        {
+            const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+            const char *stop = newline != nullptr ? newline : end;
+            offset += stop - p;
+            p = stop;
+            if (newline != nullptr)
+                scan = Scan::BETWEEN;
+            break;
+        }
+        case Scan::BLOCK_COMMENT:
+        {
+            const char *star = static_cast<const char *>(std::memchr(p, '*', end - p));
+            const char *stop = star != nullptr ? star + 1 : end;
+            offset += stop - p;
+            p = stop;
+            if (star != nullptr)
+                scan = Scan::BLOCK_STAR;
+            break;
+        }
+        case Scan::BLOCK_STAR:
+            if (*p == '/')
+                scan = Scan::BETWEEN;
+            else if (*p != '*')
+                scan = Scan::BLOCK_COMMENT;
+            offset++;
+            p++;
+            break;
+        }
+    }
+
+    // Lines are counted once per chunk, in bulk, so that positions in later chunks keep their line numbers.
+    lines.drop(data, size);
+    chunk = nullptr;
+    chunkSize = 0;
+
+#ifndef JSON_PARSER_NO_STATS
+    JSON_STATS_ADD(TOKENS, tokenCount);
+    JSON_STATS_ADD(BYTES_LEXED, size);
+    tokenCount = 0;
+#endif
+}
+
+template <typename Policy>
+JSONValue BasicPushReader<Policy>::finish()
+{
+    switch (scan)
+    {
+    case Scan::STRING:
+        throw std::runtime_error("Unterminated string at " + position());
+    case Scan::NUMBER:
+        scan = Scan::BETWEEN;
+        token(TokenType::NUMBER);
+        break;
+    case Scan::KEYWORD:
+        scan = Scan::BETWEEN;
+        keyword();
+        break;
+    case Scan::SLASH:
+        throw std::runtime_error("Unexpected character at " + position());
+    case Scan::BLOCK_COMMENT:
+    case Scan::BLOCK_STAR:
+        throw std::runtime_error("Unterminated comment at " + position());
+    default:
+        break;
+    }
+
+    token(TokenType::END);
+#ifndef JSON_PARSER_NO_STATS
+    JSON_STATS_ADD(TOKENS, tokenCount);
+    tokenCount = 0;
+#endif
+    return std::move(result);
+}
+
+template <typename Policy>
+std::string BasicPushReader<Policy>::position() const
+{
+    return lines.describe(chunk, chunkSize, offset, Policy::TRACK_POSITION);
+}
+
+template <typename Policy>
+size_t BasicPushReader<Policy>::getInputSize() const
+{
+    return offset;
+}
+
+template <typename Policy>
+void BasicPushReader<Policy>::token(TokenType type)
+{
+#ifndef JSON_PARSER_NO_STATS
+    if (type != TokenType::END)
+    {
+        tokenCount++;
+    }
+#endif
+
+    switch (expect)
+    {
+    case Expect::VALUE:
+        value(type);
+        break;
+    case Expect::FIRST_MEMBER:
+    case Expect::MEMBER:
+        if (type == closers.back() && (expect == Expect::FIRST_MEMBER || Policy::ALLOW_TRAILING_COMMAS))
+        {
+            closers.pop_back();
+            open.pop_back();
+            if constexpr (Policy::DUPLICATE_KEYS != DuplicateKeys::KEEP)
+                keys.pop_back();
+            ended();
+        }
+        else
+        {
+            member(type);
+        }
+        break;
+    case Expect::COLON:
+    {
+        if (type != TokenType::COLON)
+            throw std::runtime_error("Expected ':' at " + position());
+        expect = Expect::VALUE;
+
+        // Keys are only remembered when a duplicate has to be detected or replaced.
+        if constexpr (Policy::DUPLICATE_KEYS != DuplicateKeys::KEEP)
+        {
+            size_t existing = findKey(key, open.back(), keys.back());
+            if (existing != NOT_FOUND)
+            {
+                if constexpr (Policy::DUPLICATE_KEYS == DuplicateKeys::REJECT)
+                {
+                    throw std::runtime_error("Duplicate key \"" + key + "\" at " + position());
+                }
+                else
+                {
+                    target = open.back()->objectValue[existing].value;
+                    *target = JSONValue();
+                    break;
+                }
+            }
+        }
+        open.back()->objectValue.push_back(KeyValue(key, new JSONValue()));
+        target = open.back()->objectValue.back().value;
+        break;
+    }
+    case Expect::SEPARATOR:
+        if (type == TokenType::COMMA)
+        {
+            expect = Expect::MEMBER;
+        }
+        else if (type == closers.back())
+        {
+            closers.pop_back();
+            open.pop_back();
+            if constexpr (Policy::DUPLICATE_KEYS != DuplicateKeys::KEEP)
+                keys.pop_back();
+            ended();
+        }
+        else
+        {
+            throw std::runtime_error(std::string("Expected '") + (closers.back() == TokenType::RIGHT_BRACE ? "}" : "]") + "' at " + position());
+        }
+        break;
+    default:
+        if (type != TokenType::END)
+            throw std::runtime_error("Unexpected characters after the value at " + position());
+        break;
+    }
+}
+
+template <typename Policy>
+void BasicPushReader<Policy>::keyword()
+{
+    if (text == "true")
+        token(TokenType::TRUE);
+    else if (text == "false")
+        token(TokenType::FALSE);
+    else if (text == "null")
+        token(TokenType::NULL_TYPE);
+    else
+        throw std::runtime_error("Invalid keyword '" + text + "' at " + position());
+}
+
+template <typename Policy>
+void BasicPushReader<Policy>::value(TokenType type)
+{
+    switch (type)
+    {
+    case TokenType::LEFT_BRACE:
+    case TokenType::LEFT_BRACKET:
+        if (closers.size() >= maxDepth)
+        {
+            throw std::runtime_error("Maximum nesting depth of " + std::to_string(maxDepth.load()) + " exceeded at " + position());
+        }
+        target->type = type == TokenType::LEFT_BRACE ? JSONValueType::OBJECT : JSONValueType::ARRAY;
+        closers.push_back(type == TokenType::LEFT_BRACE ? TokenType::RIGHT_BRACE : TokenType::RIGHT_BRACKET);
+        open.push_back(target);
+        if constexpr (Policy::DUPLICATE_KEYS != DuplicateKeys::KEEP)
+            keys.emplace_back();
+        expect = Expect::FIRST_MEMBER;
+        break;
+    case TokenType::STRING:
+    case TokenType::NUMBER:
+    case TokenType::TRUE:
+    case TokenType::FALSE:
+    case TokenType::NULL_TYPE:
+        readScalar(type);
+        ended();
+        break;
+    default:
+        throw std::runtime_error("Unexpected token at " + position());
+    }
+}
+
+template <typename Policy>
+void BasicPushReader<Policy>::member(TokenType type)
+{
+    if (closers.back() == TokenType::RIGHT_BRACKET)
+    {
+        open.back()->arrayValue.push_back(new JSONValue());
+        target = open.back()->arrayValue.back();
+        value(type);
+        return;
+    }
+
+    if (type != TokenType::STRING)
+        throw std::runtime_error("Expected string key at " + position());
+    key = std::move(text);
+    expect = Expect::COLON;
+}
+
+template <typename Policy>
+void BasicPushReader<Policy>::ended()
+{
+    expect = closers.empty() ? Expect::DONE : Expect::SEPARATOR;
+}
+
+template <typename Policy>
+void BasicPushReader<Policy>::readScalar(TokenType type)
+{
+    switch (type)
+    {
+    case TokenType::STRING:
+        target->type = JSONValueType::STRING;
+        target->stringValue = std::move(text);
+        break;
+    case TokenType::NUMBER:
+        target->type = JSONValueType::NUMBER;
+        target->numberValue = std::stod(text);
+        if constexpr (Policy::RAW_NUMBERS)
+            target->stringValue = std::move(text);
+        break;
+    case TokenType::TRUE:
+    case TokenType::FALSE:
+        target->type = JSONValueType::BOOL;
+        target->boolValue = type == TokenType::TRUE;
+        break;
+    default:
+        target->type = JSONValueType::NIL;
+        break;
+    }
+}
+
+template class BasicPushReader<DefaultPolicy>;
+template class BasicPushReader<StrictPolicy>;
+template class BasicPushReader<LenientPolicy>;
+template class BasicPushReader<LosslessPolicy>;
+
+PushParser::PushParser(ParseMode mode) : mode(mode)
+{
+    switch (mode)
+    {
+    case ParseMode::STRICT:
+        reader.emplace<StrictPushReader>();
+        break;
+    case ParseMode::LENIENT:
+        reader.emplace<LenientPushReader>();
+        break;
+    case ParseMode::LOSSLESS:
+        reader.emplace<LosslessPushReader>();
+        break;
+    default:
+        break;
+    }
+}
+
+void PushParser::feed(const char *data, size_t size)
+{
+    std::visit([&](auto &active)
+               { active.feed(data, size); },
+               reader);
+}
+
+void PushParser::feed(const std::string &chunk)
+{
+    feed(chunk.data(), chunk.size());
+}
+
+JSONValue PushParser::finish()
+{
+    return std::visit([](auto &active)
+                      { return active.finish(); },
+                      reader);
+}
+
+ParseMode PushParser::getMode() const
+{
+    return mode;
+}
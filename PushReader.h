@@ -0,0 +1,187 @@
+#ifndef PUSH_READER_H
+#define PUSH_READER_H
+
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "JSONReader.h"
+
+/**
+ * Class turning JSON text into a JSONValue tree as the text is handed over, under a compile-time Policy.
+ * Chunks may end anywhere, including inside a string, number, keyword or comment: the token being
+ * read is kept and the next chunk continues it. Instead of a call stack, the reader keeps the open
+ * containers and what it expects next, so it holds no more than the partial token, the stack and
+ * the tree built so far. Tokens, errors and the tree are the same as for BasicJSONReader::parse.
+ * Instantiations exist for the presets in ParserPolicy.h.
+ */
+template <typename Policy>
+class BasicPushReader : public JSONReaderBase
+{
+public:
+    BasicPushReader();
+
+    BasicPushReader(const BasicPushReader &) = delete;
+    BasicPushReader &operator=(const BasicPushReader &) = delete;
+
+    /**
+     * Reads the next piece of the input.
+     * Throws std::runtime_error at the first error; the reader must not be used afterwards.
+     * @param data First byte of the piece.
+     * @param size Number of bytes.
+     */
+    void feed(const char *data, size_t size);
+
+    /**
+     * Ends the input and hands over the value read.
+     * Throws std::runtime_error if the input ended inside the value.
+     * @return Parsed JSONValue.
+     */
+    JSONValue finish();
+
+    /**
+     * Describes the current position for error messages, with an excerpt of the line and a caret
+     * under it while the position lies in the chunk being fed. The excerpt only shows that chunk:
+     * a line which began in an earlier chunk is clipped at the chunk's start, and after the last
+     * chunk (while finishing) there is no excerpt at all.
+     * @return "line L, column C", or "offset N" if the policy does not track positions, followed by the excerpt.
+     */
+    std::string position() const;
+
+    /**
+     * Gets the number of bytes read so far.
+     * @return Input size in bytes.
+     */
+    size_t getInputSize() const;
+
+private:
+    /**
+     * Enum describing the kind of text being read when a chunk ends.
+     */
+    enum class Scan
+    {
+        BETWEEN,
+        STRING,
+        NUMBER,
+        KEYWORD,
+        SLASH,
+        LINE_COMMENT,
+        BLOCK_COMMENT,
+        BLOCK_STAR
+    };
+
+    /**
+     * Enum describing the token the grammar expects next.
+     */
+    enum class Expect
+    {
+        VALUE,
+        FIRST_MEMBER,
+        MEMBER,
+        COLON,
+        SEPARATOR,
+        DONE
+    };
+
+    /**
+     * Hands a complete token to the grammar, whose state decides what it means.
+     * @param type Type of the token; its text is in the token buffer.
+     */
+    void token(TokenType type);
+
+    /**
+     * Hands the keyword in the token buffer to the grammar.
+     */
+    void keyword();
+
+    /**
+     * Reads a token where a value has to start.
+     * @param type Type of the token.
+     */
+    void value(TokenType type);
+
+    /**
+     * Reads the token after '{', '[' or ',' that starts the next member of the innermost container.
+     * @param type Type of the token.
+     */
+    void member(TokenType type);
+
+    /**
+     * Moves the grammar on after a complete value.
+     */
+    void ended();
+
+    /**
+     * Builds a scalar JSONValue from the token buffer.
+     * @param type Type of the token.
+     */
+    void readScalar(TokenType type);
+
+    Scan scan = Scan::BETWEEN;
+    Expect expect = Expect::VALUE;
+    std::string text;
+    std::string key;
+    JSONValue result;
+    JSONValue *target;
+    std::vector<TokenType> closers;
+    std::vector<JSONValue *> open;
+    std::vector<std::unordered_map<std::string, size_t>> keys;
+    size_t offset = 0;
+    LineIndex lines;
+    const char *chunk = nullptr;
+    size_t chunkSize = 0;
+#ifndef JSON_PARSER_NO_STATS
+    size_t tokenCount = 0;
+#endif
+};
+
+using PushReader = BasicPushReader<DefaultPolicy>;
+using StrictPushReader = BasicPushReader<StrictPolicy>;
+using LenientPushReader = BasicPushReader<LenientPolicy>;
+using LosslessPushReader = BasicPushReader<LosslessPolicy>;
+
+/**
+ * Class parsing JSON text handed over in pieces with the push reader of a parser policy chosen at runtime.
+ */
+class PushParser
+{
+public:
+    /**
+     * Starts parsing a value.
+     * @param mode Preset parser policy.
+     */
+    explicit PushParser(ParseMode mode = ParseMode::DEFAULT);
+
+    /**
+     * Reads the next piece of the input. Throws std::runtime_error at the first error.
+     * @param data First byte of the piece.
+     * @param size Number of bytes.
+     */
+    void feed(const char *data, size_t size);
+
+    /**
+     * Reads the next piece of the input. Throws std::runtime_error at the first error.
+     * @param chunk Piece of the input.
+     */
+    void feed(const std::string &chunk);
+
+    /**
+     * Ends the input and hands over the value read.
+     * Throws std::runtime_error if the input ended inside the value.
+     * @return Parsed JSONValue.
+     */
+    JSONValue finish();
+
+    /**
+     * Gets the parser policy the input is parsed with.
+     * @return Parse mode.
+     */
+    ParseMode getMode() const;
+
+private:
+    ParseMode mode;
+    std::variant<PushReader, StrictPushReader, LenientPushReader, LosslessPushReader> reader;
+};
+
+#endif
@@ -0,0 +1,866 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+#include "Query.h"
+#include "Stats.h"
+
+namespace
+{
+    size_t childCount(const JSONValue &node)
+    {
+        if (node.type == JSONValueType::ARRAY)
+            return node.arrayValue.size();
+        if (node.type == JSONValueType::OBJECT)
+            return node.objectValue.size();
+        return 0;
+    }
+
+    const JSONValue *childAt(const JSONValue &node, size_t index)
+    {
+        return node.type == JSONValueType::ARRAY ? node.arrayValue[index] : node.objectValue[index].value;
+    }
+}
+
+class Query::Compiler
+{
+public:
+    Compiler(Query &query, const std::string &text) : query(query), text(text) {}
+
+    /**
+     * Reads the whole query into steps.
+     */
+    void compilePath()
+    {
+        skipSpaces();
+        if (peek() == '$')
+        {
+            pos++;
+        }
+        else if (pos < text.size() && peek() != '.' && peek() != '[')
+        {
+            // A query may start with a bare member name, as in "store.book".
+            Step step;
+            step.kind = StepKind::NAMES;
+            step.names.push_back(readName());
+            step.hints.push_back(query.hintCount++);
+            query.steps.push_back(std::move(step));
+        }
+
+        while (true)
+        {
+            skipSpaces();
+            if (pos >= text.size())
+                break;
+
+            Step step;
+            if (text.compare(pos, 2, "..") == 0)
+            {
+                pos += 2;
+                step.recursive = true;
+                if (peek() == '[')
+                {
+                    pos++;
+                    readBracket(step);
+                }
+                else
+                {
+                    readDotted(step);
+                }
+            }
+            else if (peek() == '.')
+            {
+                pos++;
+                readDotted(step);
+            }
+            else if (peek() == '[')
+            {
+                pos++;
+                readBracket(step);
+            }
+            else
+            {
+                fail("'.' or '['");
+            }
+            query.steps.push_back(std::move(step));
+        }
+    }
+
+private:
+    char peek() const
+    {
+        return pos < text.size() ? text[pos] : '\0';
+    }
+
+    void skipSpaces()
+    {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+            pos++;
+    }
+
+    bool consume(const std::string &token)
+    {
+        skipSpaces();
+        if (text.compare(pos, token.size(), token) != 0)
+            return false;
+        pos += token.size();
+        return true;
+    }
+
+    void expect(const std::string &token)
+    {
+        if (!consume(token))
+            fail("'" + token + "'");
+    }
+
+    [[noreturn]] void fail(const std::string &what)
+    {
+        throw std::runtime_error("Expected " + what + " at position " + std::to_string(pos + 1) + " of the query.");
+    }
+
+    std::string readName()
+    {
+        size_t start = pos;
+        while (pos < text.size())
+        {
+            unsigned char c = static_cast<unsigned char>(text[pos]);
+            if (!std::isalnum(c) && c != '_' && c != '-' && c != '$' && c < 0x80)
+                break;
+            pos++;
+        }
+        if (pos == start)
+            fail("a member name");
+        return text.substr(start, pos - start);
+    }
+
+    std::string readQuoted()
+    {
+        char quote = text[pos++];
+        std::string result;
+        while (pos < text.size() && text[pos] != quote)
+        {
+            if (text[pos] == '\\' && pos + 1 < text.size())
+                pos++;
+            result += text[pos++];
+        }
+        if (pos >= text.size())
+            fail(std::string("closing ") + quote);
+        pos++;
+        return result;
+    }
+
+    bool readInteger(long &value)
+    {
+        skipSpaces();
+        size_t start = pos;
+        if (peek() == '-')
+            pos++;
+        while (std::isdigit(static_cast<unsigned char>(peek())))
+            pos++;
+        if (pos == start || (pos == start + 1 && text[start] == '-'))
+        {
+            pos = start;
+            return false;
+        }
+        value = std::stol(text.substr(start, pos - start));
+        return true;
+    }
+
+    void readDotted(Step &step)
+    {
+        if (peek() == '*')
+        {
+            pos++;
+            step.kind = StepKind::WILDCARD;
+            return;
+        }
+        step.kind = StepKind::NAMES;
+        step.names.push_back(readName());
+        step.hints.push_back(query.hintCount++);
+    }
+
+    void readBracket(Step &step)
+    {
+        skipSpaces();
+        if (consume("*"))
+        {
+            step.kind = StepKind::WILDCARD;
+        }
+        else if (consume("?"))
+        {
+            expect("(");
+            step.kind = StepKind::FILTER;
+            step.filter = readOr();
+            expect(")");
+        }
+        else if (peek() == '\'' || peek() == '"')
+        {
+            step.kind = StepKind::NAMES;
+            do
+            {
+                skipSpaces();
+                if (peek() != '\'' && peek() != '"')
+                    fail("a quoted member name");
+                step.names.push_back(readQuoted());
+                step.hints.push_back(query.hintCount++);
+            } while (consume(","));
+        }
+        else
+        {
+            long value = 0;
+            bool hasFirst = readInteger(value);
+            if (consume(":"))
+            {
+                step.kind = StepKind::SLICE;
+                step.hasStart = hasFirst;
+                step.start = value;
+                step.hasEnd = readInteger(step.end);
+                if (consume(":") && readInteger(step.stride) && step.stride == 0)
+                    fail("a non-zero slice step");
+            }
+            else
+            {
+                if (!hasFirst)
+                    fail("an index, slice, quoted name, '*' or '?'");
+                step.kind = StepKind::INDICES;
+                step.indices.push_back(value);
+                while (consume(","))
+                {
+                    if (!readInteger(value))
+                        fail("an index");
+                    step.indices.push_back(value);
+                }
+            }
+        }
+        expect("]");
+    }
+
+    size_t add(Expr expr, size_t start)
+    {
+        size_t end = pos;
+        while (end > start && std::isspace(static_cast<unsigned char>(text[end - 1])))
+            end--;
+        while (start < end && std::isspace(static_cast<unsigned char>(text[start])))
+            start++;
+        expr.text = text.substr(start, end - start);
+        query.exprs.push_back(std::move(expr));
+        return query.exprs.size() - 1;
+    }
+
+    size_t readOr()
+    {
+        size_t start = pos;
+        size_t first = readAnd();
+        if (!consume("||"))
+            return first;
+
+        Expr expr;
+        expr.op = Op::OR;
+        expr.terms.push_back(first);
+        do
+        {
+            expr.terms.push_back(readAnd());
+        } while (consume("||"));
+        for (size_t term : expr.terms)
+            expr.cost += query.exprs[term].cost;
+        return add(std::move(expr), start);
+    }
+
+    size_t readAnd()
+    {
+        size_t start = pos;
+        size_t first = readUnary();
+        if (!consume("&&"))
+            return first;
+
+        Expr expr;
+        expr.op = Op::AND;
+        expr.terms.push_back(first);
+        do
+        {
+            expr.terms.push_back(readUnary());
+        } while (consume("&&"));
+        for (size_t term : expr.terms)
+            expr.cost += query.exprs[term].cost;
+        return add(std::move(expr), start);
+    }
+
+    size_t readUnary()
+    {
+        size_t start = pos;
+        if (consume("!"))
+        {
+            Expr expr;
+            expr.op = Op::NOT;
+            expr.terms.push_back(readUnary());
+            expr.cost = query.exprs[expr.terms[0]].cost;
+            return add(std::move(expr), start);
+        }
+        if (consume("("))
+        {
+            size_t inner = readOr();
+            expect(")");
+            return inner;
+        }
+        return readComparison();
+    }
+
+    size_t readComparison()
+    {
+        static const std::pair<const char *, Op> OPERATORS[] = {
+            {"==", Op::EQUAL}, {"!=", Op::NOT_EQUAL}, {"<=", Op::LESS_EQUAL}, {">=", Op::GREATER_EQUAL},
+            {"=~", Op::MATCH}, {"<", Op::LESS}, {">", Op::GREATER}};
+
+        skipSpaces();
+        size_t start = pos;
+        Expr expr;
+        expr.left = readOperand();
+        expr.op = Op::EXISTS;
+        for (const auto &entry : OPERATORS)
+        {
+            if (consume(entry.first))
+            {
+                expr.op = entry.second;
+                break;
+            }
+        }
+
+        if (expr.op == Op::EXISTS)
+        {
+            if (!expr.left.isPath)
+                fail("a comparison operator");
+            expr.cost = 1 + expr.left.path.size();
+            return add(std::move(expr), start);
+        }
+
+        expr.right = readOperand();
+        if (expr.op == Op::MATCH)
+        {
+            if (expr.right.isPath || expr.right.literal.type != JSONValueType::STRING)
+                fail("a literal pattern after =~");
+            JSON_STATS_ADD(REGEX_COMPILATIONS, 1);
+            expr.pattern = std::make_shared<std::regex>(expr.right.literal.stringValue, std::regex::ECMAScript | std::regex::optimize);
+            expr.cost = 16 + expr.left.path.size();
+            return add(std::move(expr), start);
+        }
+
+        // Paths from the root and path-to-path comparisons cost more than a field against a literal.
+        for (const Operand *operand : {&expr.left, &expr.right})
+        {
+            if (operand->isPath)
+                expr.cost += 2 + operand->path.size() + (operand->fromRoot ? 2 : 0);
+        }
+        return add(std::move(expr), start);
+    }
+
+    Operand readOperand()
+    {
+        skipSpaces();
+        Operand operand;
+        char c = peek();
+        if (c == '@' || c == '$')
+        {
+            pos++;
+            operand.isPath = true;
+            operand.fromRoot = c == '$';
+            readRelativePath(operand);
+        }
+        else if (c == '\'' || c == '"' || c == '/')
+        {
+            operand.literal.type = JSONValueType::STRING;
+            operand.literal.stringValue = readQuoted();
+        }
+        else if (c == '-' || std::isdigit(static_cast<unsigned char>(c)))
+        {
+            const char *begin = text.c_str() + pos;
+            char *end = nullptr;
+            operand.literal.type = JSONValueType::NUMBER;
+            operand.literal.numberValue = std::strtod(begin, &end);
+            pos += end - begin;
+        }
+        else if (consume("true"))
+        {
+            operand.literal.type = JSONValueType::BOOL;
+            operand.literal.boolValue = true;
+        }
+        else if (consume("false"))
+        {
+            operand.literal.type = JSONValueType::BOOL;
+            operand.literal.boolValue = false;
+        }
+        else if (consume("null"))
+        {
+            operand.literal.type = JSONValueType::NIL;
+        }
+        else
+        {
+            fail("a path or literal");
+        }
+        return operand;
+    }
+
+    void readRelativePath(Operand &operand)
+    {
+        while (true)
+        {
+            PathPart part;
+            if (peek() == '.' && text.compare(pos, 2, "..") != 0)
+            {
+                pos++;
+                part.name = readName();
+            }
+            else if (peek() == '[')
+            {
+                pos++;
+                skipSpaces();
+                if (peek() == '\'' || peek() == '"')
+                    part.name = readQuoted();
+                else if (readInteger(part.index))
+                    part.isIndex = true;
+                else
+                    fail("an index or quoted name");
+                expect("]");
+            }
+            else
+            {
+                return;
+            }
+            part.hint = query.hintCount++;
+            operand.path.push_back(std::move(part));
+        }
+    }
+
+    Query &query;
+    const std::string &text;
+    size_t pos = 0;
+};
+
+Query Query::compile(const std::string &expression)
+{
+    Query query;
+    query.source = expression;
+    Compiler(query, query.source).compilePath();
+    query.plan();
+    return query;
+}
+
+void Query::plan()
+{
+    // Runs of single member steps become one path step that is followed without revisiting the stack.
+    std::vector<Step> planned;
+    for (auto &step : steps)
+    {
+        bool member = step.kind == StepKind::NAMES && step.names.size() == 1 && !step.recursive;
+        if (member && !planned.empty() && planned.back().kind == StepKind::PATH)
+        {
+            planned.back().names.push_back(step.names[0]);
+            planned.back().hints.push_back(step.hints[0]);
+            continue;
+        }
+        if (member)
+            step.kind = StepKind::PATH;
+        planned.push_back(std::move(step));
+    }
+    steps = std::move(planned);
+
+    // Nested conjunctions and disjunctions are flattened, then their terms are ordered by cost.
+    for (auto &expr : exprs)
+    {
+        if (expr.op != Op::AND && expr.op != Op::OR)
+            continue;
+        std::vector<size_t> flat;
+        std::vector<size_t> pending(expr.terms.rbegin(), expr.terms.rend());
+        while (!pending.empty())
+        {
+            size_t term = pending.back();
+            pending.pop_back();
+            if (exprs[term].op == expr.op)
+                pending.insert(pending.end(), exprs[term].terms.rbegin(), exprs[term].terms.rend());
+            else
+                flat.push_back(term);
+        }
+        std::stable_sort(flat.begin(), flat.end(), [this](size_t a, size_t b)
+                         { return exprs[a].cost < exprs[b].cost; });
+        expr.terms = std::move(flat);
+    }
+}
+
+size_t Query::run(const JSONValue &root, const std::function<bool(const JSONValue &)> &visit, size_t limit) const
+{
+    struct Frame
+    {
+        const JSONValue *node;
+        size_t step;
+        size_t offset;
+        bool descending;
+    };
+
+    Context context{&root, std::vector<size_t>(hintCount, 0)};
+    std::vector<Frame> stack;
+    const JSONValue *batch[BATCH];
+    size_t produced = 0;
+
+    if (limit == 0)
+        return 0;
+    stack.push_back({&root, 0, 0, false});
+
+    while (!stack.empty())
+    {
+        Frame frame = stack.back();
+        stack.pop_back();
+
+        if (frame.step == steps.size())
+        {
+            produced++;
+            if (!visit(*frame.node) || produced == limit)
+                break;
+            continue;
+        }
+
+        const Step &step = steps[frame.step];
+        if (frame.descending)
+        {
+            // Recursive descent: the same step is applied again to every container below the node.
+            size_t count = childCount(*frame.node);
+            size_t end = std::min(count, frame.offset + BATCH);
+            if (end < count)
+                stack.push_back({frame.node, frame.step, end, true});
+            for (size_t i = end; i > frame.offset; i--)
+            {
+                const JSONValue *child = childAt(*frame.node, i - 1);
+                if (childCount(*child) > 0)
+                    stack.push_back({child, frame.step, 0, false});
+            }
+            continue;
+        }
+
+        size_t count = 0;
+        size_t next = selectBatch(step, *frame.node, frame.offset, batch, count, context);
+        if (next != ANY)
+            stack.push_back({frame.node, frame.step, next, false});
+        else if (step.recursive && childCount(*frame.node) > 0)
+            stack.push_back({frame.node, frame.step, 0, true});
+        for (size_t i = count; i > 0; i--)
+        {
+            stack.push_back({batch[i - 1], frame.step + 1, 0, false});
+        }
+    }
+
+    return produced;
+}
+
+std::vector<const JSONValue *> Query::select(const JSONValue &root, size_t limit) const
+{
+    std::vector<const JSONValue *> results;
+    run(root, [&results](const JSONValue &value)
+        {
+            results.push_back(&value);
+            return true; },
+        limit);
+    return results;
+}
+
+size_t Query::selectBatch(const Step &step, const JSONValue &node, size_t offset, const JSONValue **batch, size_t &count, Context &context) const
+{
+    count = 0;
+    switch (step.kind)
+    {
+    case StepKind::PATH:
+    {
+        const JSONValue *value = &node;
+        for (size_t i = 0; i < step.names.size() && value != nullptr; i++)
+        {
+            value = value->type == JSONValueType::OBJECT ? member(*value, step.names[i], context.hints[step.hints[i]]) : nullptr;
+        }
+        if (value != nullptr)
+            batch[count++] = value;
+        return ANY;
+    }
+    case StepKind::NAMES:
+    {
+        if (node.type != JSONValueType::OBJECT)
+            return ANY;
+        size_t i = offset;
+        for (; i < step.names.size() && count < BATCH; i++)
+        {
+            const JSONValue *value = member(node, step.names[i], context.hints[step.hints[i]]);
+            if (value != nullptr)
+                batch[count++] = value;
+        }
+        return i < step.names.size() ? i : ANY;
+    }
+    case StepKind::INDICES:
+    {
+        if (node.type != JSONValueType::ARRAY)
+            return ANY;
+        long size = static_cast<long>(node.arrayValue.size());
+        size_t i = offset;
+        for (; i < step.indices.size() && count < BATCH; i++)
+        {
+            long index = step.indices[i] < 0 ? step.indices[i] + size : step.indices[i];
+            if (index >= 0 && index < size)
+                batch[count++] = node.arrayValue[index];
+        }
+        return i < step.indices.size() ? i : ANY;
+    }
+    case StepKind::SLICE:
+    {
+        if (node.type != JSONValueType::ARRAY)
+            return ANY;
+        long size = static_cast<long>(node.arrayValue.size());
+        auto normalize = [size](long value, long low, long high)
+        {
+            value = value < 0 ? value + size : value;
+            return std::max(low, std::min(high, value));
+        };
+        long start = 0;
+        long end = 0;
+        long length = 0;
+        if (step.stride > 0)
+        {
+            start = step.hasStart ? normalize(step.start, 0, size) : 0;
+            end = step.hasEnd ? normalize(step.end, 0, size) : size;
+            length = end > start ? (end - start + step.stride - 1) / step.stride : 0;
+        }
+        else
+        {
+            start = step.hasStart ? normalize(step.start, -1, size - 1) : size - 1;
+            end = step.hasEnd ? normalize(step.end, -1, size - 1) : -1;
+            length = start > end ? (start - end - step.stride - 1) / -step.stride : 0;
+        }
+        long k = static_cast<long>(offset);
+        for (; k < length && count < BATCH; k++)
+        {
+            batch[count++] = node.arrayValue[start + k * step.stride];
+        }
+        return k < length ? static_cast<size_t>(k) : ANY;
+    }
+    case StepKind::WILDCARD:
+    case StepKind::FILTER:
+    {
+        size_t size = childCount(node);
+        size_t end = std::min(size, offset + BATCH);
+        if (step.kind == StepKind::WILDCARD)
+        {
+            for (size_t i = offset; i < end; i++)
+                batch[count++] = childAt(node, i);
+            return end < size ? end : ANY;
+        }
+
+        // The filter runs term by term over the whole batch, dropping candidates as soon as a term fails.
+        uint64_t mask = end - offset == 64 ? ~uint64_t(0) : (uint64_t(1) << (end - offset)) - 1;
+        const Expr &filter = exprs[step.filter];
+        if (filter.op == Op::AND)
+        {
+            for (size_t t = 0; t < filter.terms.size() && mask != 0; t++)
+            {
+                for (size_t i = offset; i < end; i++)
+                {
+                    uint64_t bit = uint64_t(1) << (i - offset);
+                    if ((mask & bit) && !test(filter.terms[t], *childAt(node, i), context))
+                        mask &= ~bit;
+                }
+            }
+        }
+        else
+        {
+            for (size_t i = offset; i < end; i++)
+            {
+                if (!test(step.filter, *childAt(node, i), context))
+                    mask &= ~(uint64_t(1) << (i - offset));
+            }
+        }
+        for (size_t i = offset; i < end; i++)
+        {
+            if (mask & (uint64_t(1) << (i - offset)))
+                batch[count++] = childAt(node, i);
+        }
+        return end < size ? end : ANY;
+    }
+    }
+    return ANY;
+}
+
+bool Query::test(size_t expr, const JSONValue &current, Context &context) const
+{
+    const Expr &e = exprs[expr];
+    switch (e.op)
+    {
+    case Op::AND:
+        for (size_t term : e.terms)
+        {
+            if (!test(term, current, context))
+                return false;
+        }
+        return true;
+    case Op::OR:
+        for (size_t term : e.terms)
+        {
+            if (test(term, current, context))
+                return true;
+        }
+        return false;
+    case Op::NOT:
+        return !test(e.terms[0], current, context);
+    case Op::EXISTS:
+        return resolve(e.left, current, context) != nullptr;
+    case Op::MATCH:
+    {
+        const JSONValue *value = resolve(e.left, current, context);
+        return value != nullptr && value->type == JSONValueType::STRING && std::regex_search(value->stringValue, *e.pattern);
+    }
+    default:
+    {
+        const JSONValue *left = e.left.isPath ? resolve(e.left, current, context) : &e.left.literal;
+        const JSONValue *right = e.right.isPath ? resolve(e.right, current, context) : &e.right.literal;
+        return left != nullptr && right != nullptr && compare(e.op, *left, *right);
+    }
+    }
+}
+
+const JSONValue *Query::resolve(const Operand &operand, const JSONValue &current, Context &context) const
+{
+    const JSONValue *value = operand.fromRoot ? context.root : &current;
+    for (const auto &part : operand.path)
+    {
+        if (part.isIndex)
+        {
+            if (value->type != JSONValueType::ARRAY)
+                return nullptr;
+            long size = static_cast<long>(value->arrayValue.size());
+            long index = part.index < 0 ? part.index + size : part.index;
+            if (index < 0 || index >= size)
+                return nullptr;
+            value = value->arrayValue[index];
+        }
+        else
+        {
+            if (value->type != JSONValueType::OBJECT)
+                return nullptr;
+            value = member(*value, part.name, context.hints[part.hint]);
+            if (value == nullptr)
+                return nullptr;
+        }
+    }
+    return value;
+}
+
+const JSONValue *Query::member(const JSONValue &object, const std::string &name, size_t &hint)
+{
+    const auto &members = object.objectValue;
+    if (hint < members.size() && members[hint].key == name)
+        return members[hint].value;
+    for (size_t i = 0; i < members.size(); i++)
+    {
+        if (members[i].key == name)
+        {
+            hint = i;
+            return members[i].value;
+        }
+    }
+    return nullptr;
+}
+
+bool Query::compare(Op op, const JSONValue &left, const JSONValue &right)
+{
+    int order = 0;
+    if (left.type != right.type)
+    {
+        return op == Op::NOT_EQUAL;
+    }
+    switch (left.type)
+    {
+    case JSONValueType::NUMBER:
+        order = left.numberValue < right.numberValue ? -1 : left.numberValue > right.numberValue ? 1 : 0;
+        break;
+    case JSONValueType::STRING:
+        order = left.stringValue.compare(right.stringValue);
+        break;
+    case JSONValueType::BOOL:
+        if (op != Op::EQUAL && op != Op::NOT_EQUAL)
+            return false;
+        order = left.boolValue == right.boolValue ? 0 : 1;
+        break;
+    case JSONValueType::NIL:
+        order = 0;
+        break;
+    default:
+        // Containers can only be equal or unequal, compared by their serialized text.
+        order = left.toString() == right.toString() ? 0 : 1;
+        if (op != Op::EQUAL && op != Op::NOT_EQUAL)
+            return false;
+        break;
+    }
+
+    switch (op)
+    {
+    case Op::EQUAL:
+        return order == 0;
+    case Op::NOT_EQUAL:
+        return order != 0;
+    case Op::LESS:
+        return order < 0;
+    case Op::LESS_EQUAL:
+        return order <= 0;
+    case Op::GREATER:
+        return order > 0;
+    case Op::GREATER_EQUAL:
+        return order >= 0;
+    default:
+        return false;
+    }
+}
+
+std::string Query::explain() const
+{
+    std::ostringstream out;
+    out << "Plan for " << source << std::endl;
+    for (size_t i = 0; i < steps.size(); i++)
+    {
+        const Step &step = steps[i];
+        out << "  " << i + 1 << ". " << (step.recursive ? "descend, then " : "");
+        switch (step.kind)
+        {
+        case StepKind::PATH:
+            out << "follow";
+            for (const auto &name : step.names)
+                out << " ." << name;
+            break;
+        case StepKind::NAMES:
+            out << "members";
+            for (const auto &name : step.names)
+                out << " '" << name << "'";
+            break;
+        case StepKind::WILDCARD:
+            out << "every child";
+            break;
+        case StepKind::INDICES:
+            out << "indices";
+            for (long index : step.indices)
+                out << " " << index;
+            break;
+        case StepKind::SLICE:
+            out << "slice " << (step.hasStart ? std::to_string(step.start) : "") << ":" << (step.hasEnd ? std::to_string(step.end) : "") << ":" << step.stride;
+            break;
+        case StepKind::FILTER:
+        {
+            const Expr &filter = exprs[step.filter];
+            out << "filter children in batches of " << BATCH << ", terms in order:";
+            if (filter.op == Op::AND)
+            {
+                for (size_t term : filter.terms)
+                    out << " [" << exprs[term].text << "]";
+            }
+            else
+            {
+                out << " [" << filter.text << "]";
+            }
+            break;
+        }
+        }
+        out << std::endl;
+    }
+    return out.str();
+}
@@ -0,0 +1,224 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <functional>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "JSONValue.h"
+
+/**
+ * Class holding a JSONPath-style query compiled into an execution plan.
+ *
+ * Supported syntax: $ (root), .name and ['name'] (members), .* and [*] (wildcards),
+ * ..name, ..* and ..[...] (recursive descent), [n] and [a,b] (indices, negative counting
+ * from the end), [start:end:step] (slices) and [?(predicate)] (filters). Predicates
+ * compare @- or $-relative paths with literals or other paths using ==, !=, <, <=, >, >=
+ * and =~ (regex search), combine them with &&, || and !, and test existence with a bare path.
+ *
+ * The planner fuses runs of member steps into direct lookups and reorders the terms of a
+ * conjunction so that the cheapest are evaluated first. Filters are evaluated inside the scan
+ * which produces their candidates, a batch of children at a time, one term across the whole
+ * batch before the next; member lookups remember the slot a key was found at, so arrays of
+ * objects sharing a layout resolve each key in one comparison. Execution is lazy and
+ * iterative, so a limit stops the traversal as soon as enough values were produced.
+ */
+class Query
+{
+public:
+    static const size_t ANY = static_cast<size_t>(-1);
+
+    /**
+     * Compiles a query expression.
+     * @param expression Query text.
+     * @return Compiled query.
+     */
+    static Query compile(const std::string &expression);
+
+    /**
+     * Runs the query, passing every selected value to a callback in document order.
+     * @param root Root value the query is evaluated against.
+     * @param visit Callback receiving each selected value; returning false stops the query.
+     * @param limit Number of values after which the query stops.
+     * @return Number of values passed to the callback.
+     */
+    size_t run(const JSONValue &root, const std::function<bool(const JSONValue &)> &visit, size_t limit = ANY) const;
+
+    /**
+     * Runs the query and collects the selected values.
+     * @param root Root value the query is evaluated against.
+     * @param limit Number of values after which the query stops.
+     * @return Selected values in document order.
+     */
+    std::vector<const JSONValue *> select(const JSONValue &root, size_t limit = ANY) const;
+
+    /**
+     * Describes the execution plan.
+     * @return One line per plan step.
+     */
+    std::string explain() const;
+
+private:
+    static const size_t BATCH = 64;
+
+    /**
+     * Enum listing the kinds of plan steps.
+     */
+    enum class StepKind
+    {
+        PATH,
+        NAMES,
+        WILDCARD,
+        INDICES,
+        SLICE,
+        FILTER
+    };
+
+    /**
+     * Enum listing the operators of predicate expressions.
+     */
+    enum class Op
+    {
+        AND,
+        OR,
+        NOT,
+        EXISTS,
+        EQUAL,
+        NOT_EQUAL,
+        LESS,
+        LESS_EQUAL,
+        GREATER,
+        GREATER_EQUAL,
+        MATCH
+    };
+
+    /**
+     * Structure describing one component of a path inside a predicate.
+     */
+    struct PathPart
+    {
+        std::string name;
+        long index = 0;
+        bool isIndex = false;
+        size_t hint = 0;
+    };
+
+    /**
+     * Structure describing an operand of a comparison: a path or a literal.
+     */
+    struct Operand
+    {
+        bool isPath = false;
+        bool fromRoot = false;
+        std::vector<PathPart> path;
+        JSONValue literal;
+    };
+
+    /**
+     * Structure holding one node of a predicate expression.
+     */
+    struct Expr
+    {
+        Op op = Op::EXISTS;
+        std::vector<size_t> terms;
+        Operand left;
+        Operand right;
+        std::shared_ptr<std::regex> pattern;
+        size_t cost = 0;
+        std::string text;
+    };
+
+    /**
+     * Structure holding one step of the plan.
+     */
+    struct Step
+    {
+        StepKind kind = StepKind::WILDCARD;
+        bool recursive = false;
+        std::vector<std::string> names;
+        std::vector<size_t> hints;
+        std::vector<long> indices;
+        long start = 0;
+        long end = 0;
+        long stride = 1;
+        bool hasStart = false;
+        bool hasEnd = false;
+        size_t filter = ANY;
+    };
+
+    /**
+     * Structure holding the per-run state: the root and the remembered member slots.
+     */
+    struct Context
+    {
+        const JSONValue *root;
+        std::vector<size_t> hints;
+    };
+
+    /**
+     * Class reading query text into steps and predicate expressions.
+     */
+    class Compiler;
+
+    /**
+     * Merges consecutive member steps and orders conjunction terms by cost.
+     */
+    void plan();
+
+    /**
+     * Selects the next batch of values a step produces from a node.
+     * @param step Step being applied.
+     * @param node Node the step is applied to.
+     * @param offset Position to continue from, as returned by the previous call.
+     * @param batch Receives the selected values.
+     * @param count Receives the number of selected values.
+     * @param context Per-run state.
+     * @return Position to continue from, or ANY when the node is exhausted.
+     */
+    size_t selectBatch(const Step &step, const JSONValue &node, size_t offset, const JSONValue **batch, size_t &count, Context &context) const;
+
+    /**
+     * Evaluates a predicate expression.
+     * @param expr Index of the expression.
+     * @param current Value @ refers to.
+     * @param context Per-run state.
+     * @return True if the predicate holds.
+     */
+    bool test(size_t expr, const JSONValue &current, Context &context) const;
+
+    /**
+     * Resolves an operand path.
+     * @param operand Operand holding the path.
+     * @param current Value @ refers to.
+     * @param context Per-run state.
+     * @return Value at the path, or nullptr if it does not exist.
+     */
+    const JSONValue *resolve(const Operand &operand, const JSONValue &current, Context &context) const;
+
+    /**
+     * Finds a member of an object, trying the remembered slot first.
+     * @param object Object to search.
+     * @param name Member key.
+     * @param hint Slot the key was last found at; updated when it moves.
+     * @return Member value, or nullptr if the object has no such key.
+     */
+    static const JSONValue *member(const JSONValue &object, const std::string &name, size_t &hint);
+
+    /**
+     * Compares two values.
+     * @param op Comparison operator.
+     * @param left Left value.
+     * @param right Right value.
+     * @return True if the comparison holds; values of different types are only ever unequal.
+     */
+    static bool compare(Op op, const JSONValue &left, const JSONValue &right);
+
+    std::string source;
+    std::vector<Step> steps;
+    std::vector<Expr> exprs;
+    size_t hintCount = 0;
+};
+
+#endif
@@ -0,0 +1,643 @@
+#include <charconv>
+#include <cmath>
+
+#include "Schema.h"
+#include "JSONReader.h"
+#include "MappedDocument.h"
+#include "PersistentDocument.h"
+#include "Stats.h"
+
+namespace
+{
+    double numberOf(const JSONValue &value, const std::string &at)
+    {
+        if (value.type != JSONValueType::NUMBER)
+        {
+            throw std::runtime_error("Schema " + at + " must be a number.");
+        }
+        return value.numberValue;
+    }
+
+    size_t countOf(const JSONValue &value, const std::string &at)
+    {
+        double number = numberOf(value, at);
+        if (number < 0 || number != std::floor(number))
+        {
+            throw std::runtime_error("Schema " + at + " must be a non-negative integer.");
+        }
+        return static_cast<size_t>(number);
+    }
+
+    /**
+     * Structure giving TreeTokens access to a loaded JSONValue tree.
+     */
+    struct ValueTree
+    {
+        using Node = const JSONValue *;
+
+        JSONValueType type(Node node) const { return node->type; }
+        size_t size(Node node) const { return node->type == JSONValueType::OBJECT ? node->objectValue.size() : node->arrayValue.size(); }
+        Node element(Node node, size_t index) const { return node->arrayValue[index]; }
+        const std::string &key(Node node, size_t index) const { return node->objectValue[index].key; }
+        Node member(Node node, size_t index) const { return node->objectValue[index].value; }
+        const std::string &string(Node node) const { return node->stringValue; }
+        double number(Node node) const { return node->numberValue; }
+        bool boolean(Node node) const { return node->boolValue; }
+    };
+
+    /**
+     * Structure giving TreeTokens access to a version of a PersistentDocument.
+     */
+    struct PersistentTree
+    {
+        using Node = const PersistentNode *;
+
+        JSONValueType type(Node node) const { return node->type; }
+        size_t size(Node node) const { return node->type == JSONValueType::OBJECT ? node->objectValue.size() : node->arrayValue.size(); }
+        Node element(Node node, size_t index) const { return node->arrayValue[index].get(); }
+        const std::string &key(Node node, size_t index) const { return node->objectValue[index].first; }
+        Node member(Node node, size_t index) const { return node->objectValue[index].second.get(); }
+        const std::string &string(Node node) const { return node->stringValue; }
+        double number(Node node) const { return node->numberValue; }
+        bool boolean(Node node) const { return node->boolValue; }
+    };
+
+    /**
+     * Structure giving TreeTokens access to the nodes of a MappedDocument, read in place.
+     */
+    struct MappedTree
+    {
+        using Node = uint64_t;
+
+        const MappedDocument &document;
+
+        JSONValueType type(Node node) const { return document.typeOf(node); }
+        size_t size(Node node) const { return document.countOf(node); }
+        Node element(Node node, size_t index) const { return document.childOf(node, static_cast<uint32_t>(index)); }
+        std::string key(Node node, size_t index) const { return document.keyOf(node, static_cast<uint32_t>(index)); }
+        Node member(Node node, size_t index) const { return document.valueOf(node, static_cast<uint32_t>(index)); }
+        std::string string(Node node) const { return document.stringOf(node); }
+        double number(Node node) const { return document.numberOf(node); }
+        bool boolean(Node node) const { return document.boolOf(node); }
+    };
+
+    /**
+     * Class walking a tree and producing the tokens a lexer would read from it.
+     * The tree is reached through one of the access structures above, so parsed, persistent
+     * and mapped documents are validated the same way without building a JSONValue tree.
+     */
+    template <typename Tree>
+    class TreeTokens
+    {
+    public:
+        using Node = typename Tree::Node;
+
+        TreeTokens(const Tree &tree, Node root) : tree(tree), pending(root), hasPending(true) {}
+
+        Token nextToken()
+        {
+            if (colon)
+            {
+                colon = false;
+                return Token(TokenType::COLON, ":");
+            }
+            if (hasPending)
+            {
+                hasPending = false;
+                return open(pending);
+            }
+            if (frames.empty())
+                return Token(TokenType::END);
+
+            Frame &frame = frames.back();
+            if (frame.next == frame.count)
+            {
+                bool isObject = frame.isObject;
+                frames.pop_back();
+                return isObject ? Token(TokenType::RIGHT_BRACE, "}") : Token(TokenType::RIGHT_BRACKET, "]");
+            }
+            if (frame.next > 0 && !frame.separated)
+            {
+                frame.separated = true;
+                return Token(TokenType::COMMA, ",");
+            }
+
+            frame.separated = false;
+            size_t index = frame.next++;
+            if (!frame.isObject)
+                return open(tree.element(frame.node, index));
+            pending = tree.member(frame.node, index);
+            hasPending = true;
+            colon = true;
+            return Token(TokenType::STRING, tree.key(frame.node, index));
+        }
+
+        std::string position() const
+        {
+            return "the loaded document";
+        }
+
+    private:
+        /**
+         * Structure representing a container whose members are being produced.
+         */
+        struct Frame
+        {
+            Node node;
+            size_t count;
+            size_t next;
+            bool isObject;
+            bool separated;
+        };
+
+        /**
+         * Produces the first token of a value, entering it if it is a container.
+         */
+        Token open(Node node)
+        {
+            switch (tree.type(node))
+            {
+            case JSONValueType::OBJECT:
+                frames.push_back({node, tree.size(node), 0, true, false});
+                return Token(TokenType::LEFT_BRACE, "{");
+            case JSONValueType::ARRAY:
+                frames.push_back({node, tree.size(node), 0, false, false});
+                return Token(TokenType::LEFT_BRACKET, "[");
+            case JSONValueType::STRING:
+                return Token(TokenType::STRING, tree.string(node));
+            case JSONValueType::NUMBER:
+            {
+                // The shortest text which reads back as the same double, so no precision is lost.
+                char buffer[32];
+                auto result = std::to_chars(buffer, buffer + sizeof(buffer), tree.number(node));
+                return Token(TokenType::NUMBER, std::string(buffer, result.ptr));
+            }
+            case JSONValueType::BOOL:
+                return tree.boolean(node) ? Token(TokenType::TRUE, "true") : Token(TokenType::FALSE, "false");
+            default:
+                return Token(TokenType::NULL_TYPE, "null");
+            }
+        }
+
+        const Tree &tree;
+        std::vector<Frame> frames;
+        Node pending;
+        bool hasPending;
+        bool colon = false;
+    };
+
+    size_t codePoints(const std::string &text)
+    {
+        size_t count = 0;
+        for (unsigned char c : text)
+        {
+            count += (c & 0xC0) != 0x80;
+        }
+        return count;
+    }
+}
+
+Schema Schema::compile(const JSONValue &schema)
+{
+    Schema compiled;
+    compiled.compileNode(schema, "#");
+    return compiled;
+}
+
+size_t Schema::compileNode(const JSONValue &schema, const std::string &location)
+{
+    size_t index = nodes.size();
+    nodes.emplace_back();
+    if (schema.type == JSONValueType::BOOL && schema.boolValue)
+    {
+        return index;
+    }
+    if (schema.type != JSONValueType::OBJECT)
+    {
+        throw std::runtime_error("Schema " + location + " must be an object.");
+    }
+
+    // Children are compiled into a local node first, since compiling them grows the node vector.
+    Node node;
+    for (const auto &kv : schema.objectValue)
+    {
+        const std::string &keyword = kv.key;
+        const JSONValue &value = *kv.value;
+        std::string at = location + "/" + keyword;
+
+        if (keyword == "type")
+        {
+            std::vector<const JSONValue *> names;
+            if (value.type == JSONValueType::ARRAY)
+                names.assign(value.arrayValue.begin(), value.arrayValue.end());
+            else
+                names.push_back(&value);
+
+            for (const JSONValue *name : names)
+            {
+                const std::string &type = name->stringValue;
+                if (name->type != JSONValueType::STRING)
+                    throw std::runtime_error("Schema " + at + ": type names must be strings.");
+                else if (type == "null")
+                    node.types |= NULL_BIT;
+                else if (type == "boolean")
+                    node.types |= BOOLEAN_BIT;
+                else if (type == "integer")
+                    node.types |= INTEGER_BIT;
+                else if (type == "number")
+                    node.types |= NUMBER_BIT | INTEGER_BIT;
+                else if (type == "string")
+                    node.types |= STRING_BIT;
+                else if (type == "array")
+                    node.types |= ARRAY_BIT;
+                else if (type == "object")
+                    node.types |= OBJECT_BIT;
+                else
+                    throw std::runtime_error("Schema " + at + ": unknown type " + type + ".");
+            }
+        }
+        else if (keyword == "enum" || keyword == "const")
+        {
+            std::vector<const JSONValue *> values;
+            if (keyword == "const")
+                values.push_back(&value);
+            else if (value.type == JSONValueType::ARRAY)
+                values.assign(value.arrayValue.begin(), value.arrayValue.end());
+            else
+                throw std::runtime_error("Schema " + at + " must be an array.");
+
+            for (const JSONValue *allowed : values)
+            {
+                if (allowed->type == JSONValueType::OBJECT || allowed->type == JSONValueType::ARRAY)
+                    throw std::runtime_error("Schema " + at + ": only scalar values are supported.");
+                node.allowed.push_back(*allowed);
+            }
+            node.hasAllowed = true;
+        }
+        else if (keyword == "minimum" || keyword == "maximum")
+        {
+            bool isMinimum = keyword == "minimum";
+            (isMinimum ? node.minimum : node.maximum) = numberOf(value, at);
+            (isMinimum ? node.hasMinimum : node.hasMaximum) = true;
+        }
+        else if (keyword == "exclusiveMinimum" || keyword == "exclusiveMaximum")
+        {
+            // A boolean (draft 4) makes minimum or maximum exclusive; a number is a bound of its own.
+            bool isMinimum = keyword == "exclusiveMinimum";
+            if (value.type == JSONValueType::BOOL)
+            {
+                (isMinimum ? node.minimumExclusive : node.maximumExclusive) = value.boolValue;
+                continue;
+            }
+            (isMinimum ? node.exclusiveMinimum : node.exclusiveMaximum) = numberOf(value, at);
+            (isMinimum ? node.hasExclusiveMinimum : node.hasExclusiveMaximum) = true;
+        }
+        else if (keyword == "minLength")
+            node.minLength = countOf(value, at);
+        else if (keyword == "maxLength")
+            node.maxLength = countOf(value, at);
+        else if (keyword == "minItems")
+            node.minItems = countOf(value, at);
+        else if (keyword == "maxItems")
+            node.maxItems = countOf(value, at);
+        else if (keyword == "pattern")
+        {
+            if (value.type != JSONValueType::STRING)
+                throw std::runtime_error("Schema " + at + " must be a string.");
+            JSON_STATS_ADD(REGEX_COMPILATIONS, 1);
+            node.pattern = std::make_shared<std::regex>(value.stringValue, std::regex::ECMAScript | std::regex::optimize);
+            node.patternSource = value.stringValue;
+        }
+        else if (keyword == "items")
+            node.items = compileNode(value, at);
+        else if (keyword == "properties")
+        {
+            if (value.type != JSONValueType::OBJECT)
+                throw std::runtime_error("Schema " + at + " must be an object.");
+            for (const auto &property : value.objectValue)
+            {
+                node.properties[property.key] = compileNode(*property.value, at + "/" + property.key);
+            }
+        }
+        else if (keyword == "required")
+        {
+            if (value.type != JSONValueType::ARRAY)
+                throw std::runtime_error("Schema " + at + " must be an array.");
+            for (const auto *name : value.arrayValue)
+            {
+                if (name->type != JSONValueType::STRING)
+                    throw std::runtime_error("Schema " + at + ": required names must be strings.");
+                if (node.requiredSlots.emplace(name->stringValue, node.required.size()).second)
+                    node.required.push_back(name->stringValue);
+            }
+        }
+        else if (keyword == "additionalProperties")
+        {
+            if (value.type == JSONValueType::BOOL)
+                node.additionalAllowed = value.boolValue;
+            else
+                node.additional = compileNode(value, at);
+        }
+        else if (keyword == "title" || keyword == "description" || keyword == "default" || keyword == "examples" || keyword == "$schema" ||
+                 keyword == "$id" || keyword == "$comment" || keyword == "deprecated" || keyword == "readOnly" || keyword == "writeOnly")
+        {
+            // Annotations do not change the outcome of validation.
+        }
+        else
+        {
+            throw std::runtime_error("Schema " + at + ": keyword " + keyword + " is not supported.");
+        }
+    }
+
+    nodes[index] = std::move(node);
+    return index;
+}
+
+bool Schema::validate(const std::string &input, std::vector<std::string> &errors, size_t maxErrors) const
+{
+    BasicLexer<StrictPolicy> lexer(input);
+    return validateTokens(lexer, errors, maxErrors);
+}
+
+bool Schema::validate(const JSONValue &value, std::vector<std::string> &errors, size_t maxErrors) const
+{
+    ValueTree tree;
+    TreeTokens<ValueTree> tokens(tree, &value);
+    return validateTokens(tokens, errors, maxErrors);
+}
+
+bool Schema::validate(const PersistentNode &node, std::vector<std::string> &errors, size_t maxErrors) const
+{
+    PersistentTree tree;
+    TreeTokens<PersistentTree> tokens(tree, &node);
+    return validateTokens(tokens, errors, maxErrors);
+}
+
+bool Schema::validate(const MappedDocument &document, uint64_t node, std::vector<std::string> &errors, size_t maxErrors) const
+{
+    MappedTree tree{document};
+    TreeTokens<MappedTree> tokens(tree, node);
+    return validateTokens(tokens, errors, maxErrors);
+}
+
+template <typename Tokens>
+bool Schema::validateTokens(Tokens &tokens, std::vector<std::string> &errors, size_t maxErrors) const
+{
+    struct Frame
+    {
+        size_t node;
+        bool isObject;
+        size_t count;
+        size_t seen;
+        std::string key;
+    };
+
+    auto pointer = [](const std::vector<Frame> &frames, size_t depth)
+    {
+        std::string result;
+        for (size_t i = 0; i < depth; i++)
+        {
+            result += "/" + (frames[i].isObject ? frames[i].key : std::to_string(frames[i].count - 1));
+        }
+        return result.empty() ? std::string("/") : result;
+    };
+
+    size_t initialErrors = errors.size();
+    std::vector<Frame> frames;
+    std::vector<bool> seen;
+    size_t current = nodes.empty() ? ANY : 0;
+
+    try
+    {
+        Token token = tokens.nextToken();
+
+        while (errors.size() - initialErrors < maxErrors)
+        {
+            const Node *node = current == ANY ? nullptr : &nodes[current];
+
+            switch (token.type)
+            {
+            case TokenType::LEFT_BRACE:
+            case TokenType::LEFT_BRACKET:
+            {
+                bool isObject = token.type == TokenType::LEFT_BRACE;
+                uint8_t bit = isObject ? OBJECT_BIT : ARRAY_BIT;
+                if (node != nullptr && node->types != 0 && !(node->types & bit))
+                {
+                    errors.push_back(pointer(frames, frames.size()) + ": expected " + typeNames(node->types) + ", found " + (isObject ? "object" : "array"));
+                    current = ANY;
+                }
+                else if (node != nullptr && node->hasAllowed)
+                {
+                    errors.push_back(pointer(frames, frames.size()) + ": value is not one of the allowed values");
+                }
+                frames.push_back({current, isObject, 0, seen.size(), ""});
+                if (isObject && current != ANY)
+                    seen.resize(seen.size() + nodes[current].required.size(), false);
+                token = tokens.nextToken();
+                break;
+            }
+            case TokenType::STRING:
+                if (node != nullptr)
+                    checkScalar(*node, JSONValueType::STRING, token.value, pointer(frames, frames.size()), errors);
+                token = tokens.nextToken();
+                break;
+            case TokenType::NUMBER:
+                if (node != nullptr)
+                    checkScalar(*node, JSONValueType::NUMBER, token.value, pointer(frames, frames.size()), errors);
+                token = tokens.nextToken();
+                break;
+            case TokenType::TRUE:
+            case TokenType::FALSE:
+                if (node != nullptr)
+                    checkScalar(*node, JSONValueType::BOOL, token.value, pointer(frames, frames.size()), errors);
+                token = tokens.nextToken();
+                break;
+            case TokenType::NULL_TYPE:
+                if (node != nullptr)
+                    checkScalar(*node, JSONValueType::NIL, token.value, pointer(frames, frames.size()), errors);
+                token = tokens.nextToken();
+                break;
+            default:
+                throw std::runtime_error("Unexpected token at " + tokens.position());
+            }
+
+            // Close every container whose last element was just read, unless another element follows.
+            bool more = false;
+            while (!frames.empty())
+            {
+                Frame &frame = frames.back();
+                TokenType close = frame.isObject ? TokenType::RIGHT_BRACE : TokenType::RIGHT_BRACKET;
+                if (frame.count > 0 && token.type == TokenType::COMMA)
+                {
+                    token = tokens.nextToken();
+                    more = true;
+                    break;
+                }
+                if (frame.count == 0 && token.type != close)
+                {
+                    more = true;
+                    break;
+                }
+                if (token.type != close)
+                {
+                    throw std::runtime_error(std::string("Expected '") + (frame.isObject ? "}" : "]") + "' at " + tokens.position());
+                }
+
+                if (frame.node != ANY)
+                {
+                    const Node &closed = nodes[frame.node];
+                    if (frame.isObject)
+                    {
+                        for (size_t i = 0; i < closed.required.size(); i++)
+                        {
+                            if (!seen[frame.seen + i])
+                                errors.push_back(pointer(frames, frames.size() - 1) + ": missing required property \"" + closed.required[i] + "\"");
+                        }
+                    }
+                    else if (frame.count < closed.minItems || (closed.maxItems != ANY && frame.count > closed.maxItems))
+                    {
+                        errors.push_back(pointer(frames, frames.size() - 1) + ": array has " + std::to_string(frame.count) + " items, expected " +
+                                         std::to_string(closed.minItems) + " to " + (closed.maxItems == ANY ? "any" : std::to_string(closed.maxItems)));
+                    }
+                    seen.resize(frame.seen);
+                }
+                frames.pop_back();
+                token = tokens.nextToken();
+            }
+
+            if (!more)
+            {
+                if (token.type != TokenType::END)
+                    throw std::runtime_error("Unexpected characters at the end of JSON input.");
+                break;
+            }
+
+            // Start the next element of the innermost container and pick its subschema.
+            Frame &frame = frames.back();
+            const Node *parent = frame.node == ANY ? nullptr : &nodes[frame.node];
+            frame.count++;
+            current = ANY;
+            if (!frame.isObject)
+            {
+                if (parent != nullptr)
+                    current = parent->items;
+                continue;
+            }
+
+            if (token.type != TokenType::STRING)
+                throw std::runtime_error("Expected string key at " + tokens.position());
+            frame.key = std::move(token.value);
+            token = tokens.nextToken();
+            if (token.type != TokenType::COLON)
+                throw std::runtime_error("Expected ':' at " + tokens.position());
+            token = tokens.nextToken();
+
+            if (parent == nullptr)
+                continue;
+            auto slot = parent->requiredSlots.find(frame.key);
+            if (slot != parent->requiredSlots.end())
+                seen[frame.seen + slot->second] = true;
+            auto property = parent->properties.find(frame.key);
+            if (property != parent->properties.end())
+            {
+                current = property->second;
+            }
+            else if (!parent->additionalAllowed)
+            {
+                errors.push_back(pointer(frames, frames.size()) + ": property is not allowed");
+            }
+            else
+            {
+                current = parent->additional;
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        errors.push_back(std::string("Syntax error: ") + e.what());
+    }
+
+    return errors.size() == initialErrors;
+}
+
+void Schema::checkScalar(const Node &node, JSONValueType type, const std::string &text, const std::string &pointer, std::vector<std::string> &errors) const
+{
+    double number = type == JSONValueType::NUMBER ? std::stod(text) : 0;
+    uint8_t bit = typeBit(type, number);
+    if (node.types != 0 && !(node.types & bit))
+    {
+        errors.push_back(pointer + ": expected " + typeNames(node.types) + ", found " + typeNames(bit));
+        return;
+    }
+
+    if (node.hasAllowed)
+    {
+        bool matched = false;
+        for (const auto &allowed : node.allowed)
+        {
+            matched = matched || (allowed.type == type &&
+                                  (type == JSONValueType::NIL ||
+                                   (type == JSONValueType::BOOL && allowed.boolValue == (text == "true")) ||
+                                   (type == JSONValueType::NUMBER && allowed.numberValue == number) ||
+                                   (type == JSONValueType::STRING && allowed.stringValue == text)));
+        }
+        if (!matched)
+            errors.push_back(pointer + ": value is not one of the allowed values");
+    }
+
+    if (type == JSONValueType::NUMBER)
+    {
+        if ((node.hasMinimum && (number < node.minimum || (node.minimumExclusive && number == node.minimum))) ||
+            (node.hasExclusiveMinimum && number <= node.exclusiveMinimum))
+            errors.push_back(pointer + ": " + text + " is below the minimum");
+        if ((node.hasMaximum && (number > node.maximum || (node.maximumExclusive && number == node.maximum))) ||
+            (node.hasExclusiveMaximum && number >= node.exclusiveMaximum))
+            errors.push_back(pointer + ": " + text + " is above the maximum");
+    }
+    else if (type == JSONValueType::STRING)
+    {
+        if (node.minLength > 0 || node.maxLength != ANY)
+        {
+            size_t length = codePoints(text);
+            if (length < node.minLength || (node.maxLength != ANY && length > node.maxLength))
+                errors.push_back(pointer + ": string length " + std::to_string(length) + " is out of range");
+        }
+        if (node.pattern && !std::regex_search(text, *node.pattern))
+            errors.push_back(pointer + ": \"" + text + "\" does not match pattern " + node.patternSource);
+    }
+}
+
+uint8_t Schema::typeBit(JSONValueType type, double number)
+{
+    switch (type)
+    {
+    case JSONValueType::NIL:
+        return NULL_BIT;
+    case JSONValueType::BOOL:
+        return BOOLEAN_BIT;
+    case JSONValueType::NUMBER:
+        return number == std::floor(number) ? INTEGER_BIT : NUMBER_BIT;
+    case JSONValueType::STRING:
+        return STRING_BIT;
+    case JSONValueType::ARRAY:
+        return ARRAY_BIT;
+    default:
+        return OBJECT_BIT;
+    }
+}
+
+std::string Schema::typeNames(uint8_t types)
+{
+    static const char *names[] = {"null", "boolean", "integer", "number", "string", "array", "object"};
+    std::string result;
+    for (int i = 0; i < 7; i++)
+    {
+        // "number" already covers integers, so integer is only named on its own.
+        if ((types & (1 << i)) && !(i == 2 && (types & NUMBER_BIT)))
+        {
+            result += (result.empty() ? "" : "|") + std::string(names[i]);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,175 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <cstdint>
+#include <memory>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "JSONValue.h"
+
+class MappedDocument;
+struct PersistentNode;
+
+/**
+ * Class holding a JSON Schema compiled into a flat validation program.
+ *
+ * Supported keywords: type, enum, const, minimum, maximum, exclusiveMinimum, exclusiveMaximum,
+ * minLength, maxLength, pattern, items, minItems, maxItems, properties, required and
+ * additionalProperties. Annotations (title, description, default, examples, $schema, $id,
+ * $comment, deprecated, readOnly, writeOnly) are ignored; every other keyword is rejected when
+ * compiling, since ignoring it could accept documents the schema forbids.
+ *
+ * Every subschema becomes one node. Property names are resolved through a hash map per object
+ * node, required members are numbered in a map of their own so that a bitmask tracks which were
+ * seen without declaring them as properties, and patterns are compiled once. Validation runs
+ * directly over the lexer token stream, so no JSONValue tree is built for the validated document.
+ * A tree which is already loaded, a persistent version or a mapped document is walked into the
+ * same tokens, with numbers spelled exactly as stored, so it is never re-parsed from text or
+ * materialized.
+ */
+class Schema
+{
+public:
+    /**
+     * Compiles a schema.
+     * @param schema Schema document.
+     * @return Compiled schema.
+     */
+    static Schema compile(const JSONValue &schema);
+
+    /**
+     * Validates JSON text against the schema.
+     * @param input JSON text.
+     * @param errors Receives one message per violation, prefixed with the JSON pointer of the value.
+     * @param maxErrors Number of violations after which validation stops.
+     * @return True if the text is valid JSON satisfying the schema, false otherwise.
+     */
+    bool validate(const std::string &input, std::vector<std::string> &errors, size_t maxErrors = 20) const;
+
+    /**
+     * Validates a loaded JSONValue tree against the schema.
+     * @param value Root of the tree.
+     * @param errors Receives one message per violation, prefixed with the JSON pointer of the value.
+     * @param maxErrors Number of violations after which validation stops.
+     * @return True if the tree satisfies the schema, false otherwise.
+     */
+    bool validate(const JSONValue &value, std::vector<std::string> &errors, size_t maxErrors = 20) const;
+
+    /**
+     * Validates a version of a PersistentDocument against the schema.
+     * @param node Root of the version.
+     * @param errors Receives one message per violation, prefixed with the JSON pointer of the value.
+     * @param maxErrors Number of violations after which validation stops.
+     * @return True if the version satisfies the schema, false otherwise.
+     */
+    bool validate(const PersistentNode &node, std::vector<std::string> &errors, size_t maxErrors = 20) const;
+
+    /**
+     * Validates a node of a MappedDocument against the schema, reading the mapping in place.
+     * @param document Mapped document.
+     * @param node Offset of the node.
+     * @param errors Receives one message per violation, prefixed with the JSON pointer of the value.
+     * @param maxErrors Number of violations after which validation stops.
+     * @return True if the node satisfies the schema, false otherwise.
+     */
+    bool validate(const MappedDocument &document, uint64_t node, std::vector<std::string> &errors, size_t maxErrors = 20) const;
+
+private:
+    static const size_t ANY = static_cast<size_t>(-1);
+
+    /**
+     * Enum listing the bits of a node's type mask.
+     */
+    enum TypeBit : uint8_t
+    {
+        NULL_BIT = 1,
+        BOOLEAN_BIT = 2,
+        INTEGER_BIT = 4,
+        NUMBER_BIT = 8,
+        STRING_BIT = 16,
+        ARRAY_BIT = 32,
+        OBJECT_BIT = 64
+    };
+
+    /**
+     * Structure holding one compiled subschema.
+     */
+    struct Node
+    {
+        uint8_t types = 0;
+        std::vector<JSONValue> allowed;
+        bool hasAllowed = false;
+        double minimum = 0;
+        double maximum = 0;
+        bool hasMinimum = false;
+        bool hasMaximum = false;
+        bool minimumExclusive = false;
+        bool maximumExclusive = false;
+        double exclusiveMinimum = 0;
+        double exclusiveMaximum = 0;
+        bool hasExclusiveMinimum = false;
+        bool hasExclusiveMaximum = false;
+        size_t minLength = 0;
+        size_t maxLength = ANY;
+        std::shared_ptr<std::regex> pattern;
+        std::string patternSource;
+        size_t items = ANY;
+        size_t minItems = 0;
+        size_t maxItems = ANY;
+        std::unordered_map<std::string, size_t> properties;
+        std::vector<std::string> required;
+        std::unordered_map<std::string, size_t> requiredSlots;
+        bool additionalAllowed = true;
+        size_t additional = ANY;
+    };
+
+    /**
+     * Compiles a subschema and the subschemas below it.
+     * @param schema Subschema.
+     * @param location JSON pointer of the subschema, used in error messages.
+     * @return Index of the compiled node.
+     */
+    size_t compileNode(const JSONValue &schema, const std::string &location);
+
+    /**
+     * Validates a token stream against the schema.
+     * @param tokens Source of tokens with nextToken() and position(), a lexer or a tree walker.
+     * @param errors Receives the violations.
+     * @param maxErrors Number of violations after which validation stops.
+     * @return True if no violation was found, false otherwise.
+     */
+    template <typename Tokens>
+    bool validateTokens(Tokens &tokens, std::vector<std::string> &errors, size_t maxErrors) const;
+
+    /**
+     * Checks a scalar token against a node.
+     * @param node Node to check against.
+     * @param type Type of the scalar.
+     * @param text Text of the scalar token.
+     * @param pointer JSON pointer of the value.
+     * @param errors Receives the violations.
+     */
+    void checkScalar(const Node &node, JSONValueType type, const std::string &text, const std::string &pointer, std::vector<std::string> &errors) const;
+
+    /**
+     * Gets the type bit of a value.
+     * @param type Type of the value.
+     * @param number Value of a number.
+     * @return Type bit.
+     */
+    static uint8_t typeBit(JSONValueType type, double number);
+
+    /**
+     * Gets a readable list of the types allowed by a mask.
+     * @param types Type mask.
+     * @return Type names separated by "|".
+     */
+    static std::string typeNames(uint8_t types);
+
+    std::vector<Node> nodes;
+};
+
+#endif
@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Server.h"
+
+namespace
+{
+    /**
+     * Output of the command running on this thread, or nullptr to print as usual.
+     */
+    thread_local std::string *capturedOutput = nullptr;
+
+    /**
+     * Stream buffer installed on std::cout and std::cerr while serving, so that whatever a
+     * command prints goes to the response of the thread executing it.
+     */
+    class RoutedBuffer : public std::streambuf
+    {
+    public:
+        explicit RoutedBuffer(std::streambuf *fallback) : fallback(fallback) {}
+
+    protected:
+        int overflow(int c) override
+        {
+            if (c == traits_type::eof())
+                return traits_type::not_eof(c);
+            char character = traits_type::to_char_type(c);
+            return xsputn(&character, 1) == 1 ? c : traits_type::eof();
+        }
+
+        std::streamsize xsputn(const char *data, std::streamsize size) override
+        {
+            if (capturedOutput == nullptr)
+                return fallback->sputn(data, size);
+            capturedOutput->append(data, static_cast<size_t>(size));
+            return size;
+        }
+
+        int sync() override
+        {
+            return capturedOutput == nullptr ? fallback->pubsync() : 0;
+        }
+
+    private:
+        std::streambuf *fallback;
+    };
+
+    sockaddr_un socketAddress(const std::string &socketPath)
+    {
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path))
+        {
+            throw std::runtime_error("Socket path is too long: " + socketPath);
+        }
+        std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+        return address;
+    }
+
+    bool sendPieces(int socket, const std::vector<std::string> &pieces)
+    {
+        std::vector<struct iovec> vectors;
+        for (const auto &piece : pieces)
+        {
+            if (!piece.empty())
+                vectors.push_back({const_cast<char *>(piece.data()), piece.size()});
+        }
+
+        size_t first = 0;
+        while (first < vectors.size())
+        {
+            // sendmsg is writev with MSG_NOSIGNAL, so a client hanging up does not raise SIGPIPE.
+            msghdr message;
+            std::memset(&message, 0, sizeof(message));
+            message.msg_iov = &vectors[first];
+            message.msg_iovlen = std::min<size_t>(vectors.size() - first, IOV_MAX);
+            ssize_t sent = ::sendmsg(socket, &message, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent < 0)
+                return false;
+
+            size_t left = static_cast<size_t>(sent);
+            while (first < vectors.size() && left >= vectors[first].iov_len)
+                left -= vectors[first++].iov_len;
+            if (left > 0)
+            {
+                vectors[first].iov_base = static_cast<char *>(vectors[first].iov_base) + left;
+                vectors[first].iov_len -= left;
+            }
+        }
+        return true;
+    }
+}
+
+Server::Server(const std::string &socketPath, const std::vector<std::string> &filePaths)
+    : socketPath(socketPath), documents(Engine::DEFAULT_CACHE_BUDGET)
+{
+    documents.setConcurrent(true);
+    Engine loader(documents, writer);
+    for (const auto &filePath : filePaths)
+    {
+        loader.executeCommand("open " + filePath);
+        if (firstDocument.empty() && documents.find(filePath) != nullptr)
+        {
+            firstDocument = filePath;
+        }
+    }
+}
+
+void Server::run()
+{
+    sockaddr_un address = socketAddress(socketPath);
+    listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0)
+    {
+        throw std::runtime_error(std::string("Could not create socket: ") + std::strerror(errno));
+    }
+    ::unlink(socketPath.c_str());
+    if (::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0)
+    {
+        std::string reason = std::strerror(errno);
+        ::close(listener);
+        throw std::runtime_error("Could not listen on " + socketPath + ": " + reason);
+    }
+    std::cout << "Listening on " << socketPath << std::endl;
+
+    RoutedBuffer out(std::cout.rdbuf());
+    RoutedBuffer err(std::cerr.rdbuf());
+    std::streambuf *previousOut = std::cout.rdbuf(&out);
+    std::streambuf *previousErr = std::cerr.rdbuf(&err);
+
+    while (!stopping)
+    {
+        int client = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        if (stopping)
+        {
+            ::close(client);
+            break;
+        }
+        reap(false);
+        connections.emplace_back();
+        Connection &connection = connections.back();
+        connection.socket = client;
+        connection.thread = std::thread(&Server::serve, this, std::ref(connection));
+    }
+
+    stop();
+    reap(true);
+    ::close(listener);
+    ::unlink(socketPath.c_str());
+
+    writer.flush();
+    for (const auto &result : writer.collect())
+    {
+        if (!result.error.empty())
+        {
+            std::cerr << "Error saving to file: " << result.error << std::endl;
+        }
+        documents.written(result);
+    }
+    std::cout.rdbuf(previousOut);
+    std::cerr.rdbuf(previousErr);
+}
+
+void Server::serve(Connection &connection)
+{
+    Engine session(documents, writer);
+    if (!firstDocument.empty())
+    {
+        execute(session, "use " + firstDocument);
+    }
+
+    std::string pending;
+    std::vector<char> buffer(1 << 16);
+    bool open = true;
+    bool stopServer = false;
+    while (open)
+    {
+        ssize_t received = ::read(connection.socket, buffer.data(), buffer.size());
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            break;
+        pending.append(buffer.data(), static_cast<size_t>(received));
+
+        // Every complete request that has arrived is executed before the responses go out together.
+        std::vector<std::string> responses;
+        size_t start = 0;
+        size_t end;
+        while (open && (end = pending.find('\n', start)) != std::string::npos)
+        {
+            std::string command = pending.substr(start, end - start);
+            start = end + 1;
+            if (!command.empty() && command.back() == '\r')
+            {
+                command.pop_back();
+            }
+
+            std::string output;
+            if (command == "exit")
+            {
+                open = false;
+                continue;
+            }
+            if (command == "shutdown")
+            {
+                output = "Server shutting down.\n";
+                open = false;
+                stopServer = true;
+            }
+            else
+            {
+                output = execute(session, command);
+            }
+            responses.push_back(std::to_string(output.size()) + "\n");
+            responses.push_back(std::move(output));
+        }
+        pending.erase(0, start);
+
+        if (!sendPieces(connection.socket, responses))
+            break;
+    }
+    if (stopServer)
+    {
+        stop();
+    }
+
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    ::close(connection.socket);
+    connection.finished = true;
+}
+
+std::string Server::execute(Engine &session, const std::string &command)
+{
+    std::string output;
+    capturedOutput = &output;
+    try
+    {
+        bool done = false;
+        if (Engine::isReadOnly(command))
+        {
+            std::shared_lock<std::shared_mutex> lock(documentsMutex);
+            Epoch::Guard guard;
+            if (session.resume(false))
+            {
+                session.executeReadOnly(command);
+                done = true;
+            }
+        }
+        else if (Engine::isEdit(command))
+        {
+            std::lock_guard<std::mutex> edit(editMutex);
+            std::shared_lock<std::shared_mutex> lock(documentsMutex);
+            done = session.resume(false) && session.executeEdit(command);
+            Epoch::collect();
+        }
+        if (!done)
+        {
+            std::unique_lock<std::shared_mutex> lock(documentsMutex);
+            session.resume(true);
+            session.executeCommand(command);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+    capturedOutput = nullptr;
+    return output;
+}
+
+void Server::stop()
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    if (stopping.exchange(true))
+    {
+        return;
+    }
+
+    // Shutting the sockets down wakes the threads blocked in accept and read.
+    ::shutdown(listener, SHUT_RDWR);
+    for (auto &connection : connections)
+    {
+        if (!connection.finished)
+            ::shutdown(connection.socket, SHUT_RD);
+    }
+}
+
+void Server::reap(bool all)
+{
+    if (all)
+    {
+        for (auto &connection : connections)
+            connection.thread.join();
+        connections.clear();
+        return;
+    }
+
+    for (auto it = connections.begin(); it != connections.end();)
+    {
+        if (it->finished)
+        {
+            it->thread.join();
+            it = connections.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+int Server::connect(const std::string &socketPath, std::istream &in, std::ostream &out)
+{
+    sockaddr_un address = socketAddress(socketPath);
+    int server = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server < 0 || ::connect(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        std::cerr << "Could not connect to " << socketPath << ": " << std::strerror(errno) << std::endl;
+        if (server >= 0)
+            ::close(server);
+        return 1;
+    }
+
+    std::thread reader([server, &out]
+                       {
+                           std::string pending;
+                           std::vector<char> buffer(1 << 16);
+                           ssize_t received;
+                           while ((received = ::read(server, buffer.data(), buffer.size())) > 0 || (received < 0 && errno == EINTR))
+                           {
+                               if (received < 0)
+                                   continue;
+                               pending.append(buffer.data(), static_cast<size_t>(received));
+                               size_t newline;
+                               while ((newline = pending.find('\n')) != std::string::npos)
+                               {
+                                   size_t length = std::stoull(pending.substr(0, newline));
+                                   if (pending.size() < newline + 1 + length)
+                                       break;
+                                   out.write(pending.data() + newline + 1, static_cast<std::streamsize>(length));
+                                   out.flush();
+                                   pending.erase(0, newline + 1 + length);
+                               }
+                           } });
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (!sendPieces(server, {line + "\n"}))
+            break;
+    }
+    ::shutdown(server, SHUT_WR);
+    reader.join();
+    ::close(server);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Engine.h"
+
+/**
+ * Class serving the Engine's command set to local clients over a Unix domain socket.
+ *
+ * Documents are loaded once into a cache shared by every connection. Each connection gets its
+ * own Engine session, with its own current document, and is served by its own thread.
+ * Read-only commands run under a shared lock, so reads from different clients proceed in
+ * parallel. Path edits (set, create, delete and move) also take the lock shared, one at a time:
+ * the documents' parsers are in concurrent mode, so an edit publishes a new version of the tree
+ * while readers keep the one they started with, and replaced nodes are reclaimed through Epoch.
+ * Every other command takes the lock exclusively.
+ *
+ * Requests are lines of text. A client may send any number of requests without waiting:
+ * they are executed in order, and the responses to all requests that arrived together are
+ * sent back with a single writev. Each response is its length in bytes on a line of its own,
+ * followed by everything the command printed.
+ */
+class Server
+{
+public:
+    /**
+     * Constructs a Server and loads the documents every session starts with.
+     * Sessions start on the first document; the others are reached with use.
+     * @param socketPath Path of the socket to listen on.
+     * @param filePaths Files to load.
+     */
+    Server(const std::string &socketPath, const std::vector<std::string> &filePaths);
+
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+    /**
+     * Accepts and serves clients until one sends shutdown, then waits for pending writes.
+     * Throws std::runtime_error if the socket cannot be created.
+     */
+    void run();
+
+    /**
+     * Sends the lines of an input stream to a server and prints the responses.
+     * Requests are sent without waiting for responses, which are read by a second thread.
+     * @param socketPath Path of the server's socket.
+     * @param in Stream of commands.
+     * @param out Stream receiving the responses.
+     * @return Exit status: 0 on success, 1 if the server could not be reached.
+     */
+    static int connect(const std::string &socketPath, std::istream &in, std::ostream &out);
+
+private:
+    /**
+     * Structure tracking the thread serving one client.
+     */
+    struct Connection
+    {
+        int socket;
+        std::thread thread;
+        bool finished = false;
+    };
+
+    /**
+     * Reads requests from a client and sends back the responses until the client disconnects.
+     * @param connection Connection to serve.
+     */
+    void serve(Connection &connection);
+
+    /**
+     * Executes one request in a session, holding the lock the command needs.
+     * @param session Session of the client.
+     * @param command The command to execute.
+     * @return Everything the command printed.
+     */
+    std::string execute(Engine &session, const std::string &command);
+
+    /**
+     * Stops accepting clients and disconnects the connected ones.
+     */
+    void stop();
+
+    /**
+     * Joins the threads of connections that have finished.
+     * Must be called with connectionsMutex held, unless waiting for every connection after the server stopped.
+     * @param all Whether to wait for every connection instead.
+     */
+    void reap(bool all);
+
+private:
+    std::string socketPath;
+    std::string firstDocument;
+    DocumentCache documents;
+    BackgroundWriter writer;
+    std::shared_mutex documentsMutex;
+    std::mutex editMutex;
+    std::mutex connectionsMutex;
+    std::list<Connection> connections;
+    int listener = -1;
+    std::atomic<bool> stopping{false};
+};
+
+#endif
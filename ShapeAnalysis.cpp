@@ -0,0 +1,249 @@
+#include "ShapeAnalysis.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+    const size_t SSO_CAPACITY = 15;
+
+    size_t heapBytes(const std::string &text)
+    {
+        return text.capacity() > SSO_CAPACITY ? text.capacity() + 1 : 0;
+    }
+}
+
+void ShapeAnalysis::Totals::add(const Totals &other)
+{
+    nodes += other.nodes;
+    overheadBytes += other.overheadBytes;
+    payloadBytes += other.payloadBytes;
+}
+
+size_t ShapeAnalysis::Totals::bytes() const
+{
+    return overheadBytes + payloadBytes;
+}
+
+void ShapeAnalysis::Report::merge(const Report &other)
+{
+    totals.add(other.totals);
+    maxDepth = std::max(maxDepth, other.maxDepth);
+    for (const auto &entry : other.fanOut)
+    {
+        fanOut[entry.first] += entry.second;
+    }
+    for (const auto &entry : other.stringLengths)
+    {
+        stringLengths[entry.first] += entry.second;
+    }
+    for (const auto &entry : other.keyFrequency)
+    {
+        keyFrequency[entry.first] += entry.second;
+    }
+}
+
+ShapeAnalysis::Report ShapeAnalysis::analyze(const JSONValue &value)
+{
+    Report report;
+    report.totals = account(value, 0, report);
+
+    std::vector<std::pair<std::string, const JSONValue *>> children;
+    for (const auto &kv : value.objectValue)
+    {
+        children.emplace_back(kv.key, kv.value);
+    }
+    for (size_t i = 0; i < value.arrayValue.size(); i++)
+    {
+        children.emplace_back("[" + std::to_string(i) + "]", value.arrayValue[i]);
+    }
+
+    size_t workerCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), std::max<size_t>(children.size(), 1));
+    std::vector<Report> partial(workerCount);
+    std::vector<Totals> childTotals(children.size());
+    std::atomic<size_t> next(0);
+
+    auto worker = [&](Report &local)
+    {
+        for (size_t i = next++; i < children.size(); i = next++)
+        {
+            childTotals[i] = visit(*children[i].second, 1, local);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < workerCount; i++)
+    {
+        workers.emplace_back(worker, std::ref(partial[i]));
+    }
+    worker(partial[0]);
+    for (auto &thread : workers)
+    {
+        thread.join();
+    }
+
+    for (const auto &local : partial)
+    {
+        report.merge(local);
+    }
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        report.children.emplace_back(children[i].first, childTotals[i]);
+    }
+    std::stable_sort(report.children.begin(), report.children.end(), [](const auto &a, const auto &b)
+                     { return a.second.bytes() > b.second.bytes(); });
+    return report;
+}
+
+ShapeAnalysis::Totals ShapeAnalysis::visit(const JSONValue &value, size_t depth, Report &report)
+{
+    Totals totals;
+    std::vector<std::pair<const JSONValue *, size_t>> stack;
+    stack.emplace_back(&value, depth);
+
+    while (!stack.empty())
+    {
+        const JSONValue *node = stack.back().first;
+        size_t nodeDepth = stack.back().second;
+        stack.pop_back();
+
+        totals.add(account(*node, nodeDepth, report));
+        for (const auto *item : node->arrayValue)
+        {
+            stack.emplace_back(item, nodeDepth + 1);
+        }
+        for (const auto &kv : node->objectValue)
+        {
+            stack.emplace_back(kv.value, nodeDepth + 1);
+        }
+    }
+
+    report.totals.add(totals);
+    return totals;
+}
+
+ShapeAnalysis::Totals ShapeAnalysis::account(const JSONValue &node, size_t depth, Report &report)
+{
+    // Short strings and keys live inside the node and its entries, so their characters
+    // are carved out of the fixed-size part rather than added on top of it.
+    size_t bytes = sizeof(JSONValue) + heapBytes(node.stringValue);
+    size_t payload = 0;
+    report.maxDepth = std::max(report.maxDepth, depth);
+
+    switch (node.type)
+    {
+    case JSONValueType::STRING:
+        payload = node.stringValue.size();
+        report.stringLengths[bucket(node.stringValue.size())]++;
+        break;
+    case JSONValueType::NUMBER:
+        payload = sizeof(double);
+        break;
+    case JSONValueType::BOOL:
+        payload = sizeof(bool);
+        break;
+    case JSONValueType::ARRAY:
+        bytes += node.arrayValue.capacity() * sizeof(JSONValue *);
+        report.fanOut[bucket(node.arrayValue.size())]++;
+        break;
+    case JSONValueType::OBJECT:
+        bytes += node.objectValue.capacity() * sizeof(KeyValue);
+        report.fanOut[bucket(node.objectValue.size())]++;
+        for (const auto &kv : node.objectValue)
+        {
+            bytes += heapBytes(kv.key);
+            payload += kv.key.size();
+            report.keyFrequency[kv.key]++;
+        }
+        break;
+    default:
+        break;
+    }
+
+    Totals totals;
+    totals.nodes = 1;
+    totals.payloadBytes = std::min(payload, bytes);
+    totals.overheadBytes = bytes - totals.payloadBytes;
+    return totals;
+}
+
+size_t ShapeAnalysis::bucket(size_t count)
+{
+    size_t lower = 1;
+    if (count == 0)
+    {
+        return 0;
+    }
+    while (lower <= count / 2)
+    {
+        lower *= 2;
+    }
+    return lower;
+}
+
+std::string ShapeAnalysis::formatBytes(size_t bytes)
+{
+    const char *units[] = {"B", "KB", "MB", "GB", "TB"};
+    double amount = static_cast<double>(bytes);
+    size_t unit = 0;
+    while (amount >= 1024 && unit < 4)
+    {
+        amount /= 1024;
+        unit++;
+    }
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << amount << " " << units[unit];
+    return out.str();
+}
+
+void ShapeAnalysis::print(const Report &report, std::ostream &out, size_t limit)
+{
+    out << "Nodes: " << report.totals.nodes << ", total " << formatBytes(report.totals.bytes())
+        << " (payload " << formatBytes(report.totals.payloadBytes) << ", overhead " << formatBytes(report.totals.overheadBytes) << ")" << std::endl;
+    out << "Max depth: " << report.maxDepth << std::endl;
+
+    if (!report.children.empty())
+    {
+        out << "Largest children:" << std::endl;
+        for (size_t i = 0; i < report.children.size() && i < limit; i++)
+        {
+            const auto &child = report.children[i];
+            out << "  " << std::left << std::setw(24) << child.first << std::right << std::setw(12) << formatBytes(child.second.bytes())
+                << std::setw(12) << child.second.nodes << " nodes  payload " << formatBytes(child.second.payloadBytes)
+                << ", overhead " << formatBytes(child.second.overheadBytes) << std::endl;
+        }
+    }
+
+    if (!report.fanOut.empty())
+    {
+        out << "Fan-out (children per container):" << std::endl;
+        for (const auto &entry : report.fanOut)
+        {
+            out << "  " << std::setw(8) << entry.first << (entry.first <= 1 ? "    " : "+   ") << entry.second << std::endl;
+        }
+    }
+
+    if (!report.stringLengths.empty())
+    {
+        out << "String lengths:" << std::endl;
+        for (const auto &entry : report.stringLengths)
+        {
+            out << "  " << std::setw(8) << entry.first << (entry.first <= 1 ? "    " : "+   ") << entry.second << std::endl;
+        }
+    }
+
+    if (!report.keyFrequency.empty())
+    {
+        std::vector<std::pair<std::string, size_t>> keys(report.keyFrequency.begin(), report.keyFrequency.end());
+        std::sort(keys.begin(), keys.end(), [](const auto &a, const auto &b)
+                  { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+        out << "Most frequent keys (" << keys.size() << " distinct):" << std::endl;
+        for (size_t i = 0; i < keys.size() && i < limit; i++)
+        {
+            out << "  " << std::left << std::setw(24) << keys[i].first << std::right << keys[i].second << std::endl;
+        }
+    }
+}
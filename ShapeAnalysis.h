@@ -0,0 +1,113 @@
+#ifndef SHAPE_ANALYSIS_H
+#define SHAPE_ANALYSIS_H
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "JSONValue.h"
+
+/**
+ * Memory accounting and shape statistics for an in-memory JSON tree.
+ *
+ * Bytes are split into payload (string and key characters, numbers and booleans) and
+ * overhead (node headers, unused capacity and child pointer slots). The tree is visited
+ * once with an explicit stack; the children of the analysed value are shared between
+ * worker threads and their partial reports are merged at the end.
+ */
+class ShapeAnalysis
+{
+public:
+    /**
+     * Struct holding node and byte totals for a subtree.
+     */
+    struct Totals
+    {
+        size_t nodes = 0;
+        size_t overheadBytes = 0;
+        size_t payloadBytes = 0;
+
+        /**
+         * Adds the totals of another subtree.
+         * @param other Totals to be added.
+         */
+        void add(const Totals &other);
+
+        /**
+         * Gets the total number of bytes.
+         * @return Overhead plus payload bytes.
+         */
+        size_t bytes() const;
+    };
+
+    /**
+     * Struct holding the result of an analysis.
+     */
+    struct Report
+    {
+        Totals totals;
+        std::vector<std::pair<std::string, Totals>> children;
+        size_t maxDepth = 0;
+        std::map<size_t, size_t> fanOut;
+        std::map<size_t, size_t> stringLengths;
+        std::unordered_map<std::string, size_t> keyFrequency;
+
+        /**
+         * Merges the statistics of another report, leaving the children untouched.
+         * @param other Report to be merged.
+         */
+        void merge(const Report &other);
+    };
+
+    /**
+     * Analyses a value and every value below it.
+     * @param value Root of the analysed subtree.
+     * @return Report with totals, per-child totals and shape statistics.
+     */
+    static Report analyze(const JSONValue &value);
+
+    /**
+     * Prints a report in a human-readable form.
+     * @param report Report to be printed.
+     * @param out Output stream.
+     * @param limit Maximum number of children and keys listed.
+     */
+    static void print(const Report &report, std::ostream &out, size_t limit = 10);
+
+private:
+    /**
+     * Visits a subtree and adds its statistics to a report.
+     * @param value Root of the subtree.
+     * @param depth Depth of the root of the subtree.
+     * @param report Report receiving the statistics.
+     * @return Totals of the subtree.
+     */
+    static Totals visit(const JSONValue &value, size_t depth, Report &report);
+
+    /**
+     * Accounts for a single node without its children.
+     * @param node Node to be accounted for.
+     * @param depth Depth of the node.
+     * @param report Report receiving the shape statistics.
+     * @return Totals of the node.
+     */
+    static Totals account(const JSONValue &node, size_t depth, Report &report);
+
+    /**
+     * Gets the power-of-two bucket holding a count.
+     * @param count Count to be bucketed.
+     * @return Lower bound of the bucket.
+     */
+    static size_t bucket(size_t count);
+
+    /**
+     * Formats a number of bytes with a binary unit.
+     * @param bytes Number of bytes.
+     * @return Formatted string.
+     */
+    static std::string formatBytes(size_t bytes);
+};
+
+#endif
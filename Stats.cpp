@@ -0,0 +1,142 @@
+#include <iomanip>
+
+#include "Stats.h"
+
+namespace
+{
+    const char *COUNTER_NAMES[Stats::COUNTER_COUNT] = {
+        "bytes_lexed",
+        "tokens",
+        "nodes_allocated",
+        "path_lookups",
+        "regex_compilations",
+        "bytes_written"};
+
+    int bucketOf(uint64_t value)
+    {
+        if (value < 4)
+            return static_cast<int>(value);
+        int exponent = 63 - __builtin_clzll(value);
+        int sub = static_cast<int>((value >> (exponent - 2)) & 3);
+        return exponent * 4 + sub;
+    }
+
+    uint64_t bucketUpperBound(int bucket)
+    {
+        if (bucket < 4)
+            return bucket;
+        int exponent = bucket / 4;
+        uint64_t sub = bucket % 4;
+        return ((4 + sub + 1) << (exponent - 2)) - 1;
+    }
+}
+
+std::atomic<uint64_t> Stats::counters[Stats::COUNTER_COUNT];
+std::map<std::string, Stats::Histogram> Stats::histograms;
+std::mutex Stats::histogramMutex;
+
+void Stats::Histogram::record(uint64_t nanoseconds)
+{
+    buckets[bucketOf(nanoseconds)]++;
+    count++;
+    total += nanoseconds;
+    if (nanoseconds > max)
+        max = nanoseconds;
+}
+
+uint64_t Stats::Histogram::percentile(double fraction) const
+{
+    uint64_t target = static_cast<uint64_t>(fraction * count);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen > target)
+            return std::min(bucketUpperBound(i), max);
+    }
+    return max;
+}
+
+Stats::ScopedTimer::ScopedTimer(const std::string &command) : command(command), start(std::chrono::steady_clock::now()) {}
+
+Stats::ScopedTimer::~ScopedTimer()
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    recordLatency(command, elapsed.count());
+}
+
+void Stats::recordLatency(const std::string &command, uint64_t nanoseconds)
+{
+    std::lock_guard<std::mutex> lock(histogramMutex);
+    histograms[command].record(nanoseconds);
+}
+
+void Stats::print(std::ostream &out)
+{
+    if (!enabled())
+    {
+        out << "Statistics were disabled at compile time (JSON_PARSER_NO_STATS)." << std::endl;
+        return;
+    }
+
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        out << std::left << std::setw(20) << COUNTER_NAMES[i] << std::right << counters[i].load(std::memory_order_relaxed) << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(histogramMutex);
+    if (histograms.empty())
+    {
+        return;
+    }
+    out << std::left << std::setw(12) << "command" << std::right << std::setw(8) << "count" << std::setw(12) << "p50 us"
+        << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::endl;
+    for (const auto &entry : histograms)
+    {
+        const Histogram &histogram = entry.second;
+        out << std::left << std::setw(12) << entry.first << std::right << std::setw(8) << histogram.getCount() << std::fixed << std::setprecision(1)
+            << std::setw(12) << histogram.percentile(0.50) / 1000.0 << std::setw(12) << histogram.percentile(0.99) / 1000.0
+            << std::setw(12) << histogram.getMax() / 1000.0 << std::endl;
+    }
+    out << std::defaultfloat;
+}
+
+void Stats::writeJSON(std::ostream &out)
+{
+    out << "{\n  \"enabled\": " << (enabled() ? "true" : "false") << ",\n  \"counters\": {\n";
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        out << "    \"" << COUNTER_NAMES[i] << "\": " << counters[i].load(std::memory_order_relaxed) << (i + 1 < COUNTER_COUNT ? ",\n" : "\n");
+    }
+    out << "  },\n  \"commands\": {\n";
+
+    std::lock_guard<std::mutex> lock(histogramMutex);
+    size_t written = 0;
+    for (const auto &entry : histograms)
+    {
+        const Histogram &histogram = entry.second;
+        out << "    \"" << entry.first << "\": {\"count\": " << histogram.getCount() << ", \"total_ns\": " << histogram.getTotal()
+            << ", \"p50_ns\": " << histogram.percentile(0.50) << ", \"p99_ns\": " << histogram.percentile(0.99)
+            << ", \"max_ns\": " << histogram.getMax() << "}" << (++written < histograms.size() ? ",\n" : "\n");
+    }
+    out << "  }\n}\n";
+}
+
+void Stats::reset()
+{
+    for (auto &counter : counters)
+    {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> lock(histogramMutex);
+    histograms.clear();
+}
+
+bool Stats::enabled()
+{
+#ifndef JSON_PARSER_NO_STATS
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,140 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+/**
+ * Process-wide performance counters and per-command latency histograms.
+ *
+ * Code is instrumented through the JSON_STATS_* macros. Defining JSON_PARSER_NO_STATS
+ * at compile time turns every macro into nothing, so the instrumentation costs nothing
+ * in builds which do not want it. When enabled, counters are relaxed atomics and the
+ * lexer batches its counts, which keeps collection cheap enough for production builds.
+ */
+class Stats
+{
+public:
+    /**
+     * Enum listing the counters.
+     */
+    enum Counter
+    {
+        BYTES_LEXED,
+        TOKENS,
+        NODES_ALLOCATED,
+        PATH_LOOKUPS,
+        REGEX_COMPILATIONS,
+        BYTES_WRITTEN,
+        COUNTER_COUNT
+    };
+
+    /**
+     * Class holding a log-linear histogram of latencies with four sub-buckets per power of two.
+     */
+    class Histogram
+    {
+    public:
+        /**
+         * Records a latency.
+         * @param nanoseconds Latency in nanoseconds.
+         */
+        void record(uint64_t nanoseconds);
+
+        /**
+         * Estimates a percentile as the upper bound of the bucket holding it.
+         * @param fraction Percentile between 0 and 1.
+         * @return Latency in nanoseconds.
+         */
+        uint64_t percentile(double fraction) const;
+
+        uint64_t getCount() const { return count; }
+
+        uint64_t getMax() const { return max; }
+
+        uint64_t getTotal() const { return total; }
+
+    private:
+        static const int BUCKETS = 64 * 4;
+
+        uint64_t buckets[BUCKETS] = {};
+        uint64_t count = 0;
+        uint64_t total = 0;
+        uint64_t max = 0;
+    };
+
+    /**
+     * Class timing a scope and recording the latency under a command name.
+     */
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(const std::string &command);
+
+        ~ScopedTimer();
+
+    private:
+        std::string command;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    /**
+     * Adds to a counter.
+     * @param counter Counter to increase.
+     * @param amount Amount to add.
+     */
+    static void add(Counter counter, uint64_t amount)
+    {
+        counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    /**
+     * Records the latency of a command.
+     * @param command Command name.
+     * @param nanoseconds Latency in nanoseconds.
+     */
+    static void recordLatency(const std::string &command, uint64_t nanoseconds);
+
+    /**
+     * Prints the counters and histograms in a human readable form.
+     * @param out Output stream.
+     */
+    static void print(std::ostream &out);
+
+    /**
+     * Writes the counters and histograms as JSON.
+     * @param out Output stream.
+     */
+    static void writeJSON(std::ostream &out);
+
+    /**
+     * Resets all counters and histograms.
+     */
+    static void reset();
+
+    /**
+     * Checks whether statistics were compiled in.
+     * @return True unless JSON_PARSER_NO_STATS is defined.
+     */
+    static bool enabled();
+
+private:
+    static std::atomic<uint64_t> counters[COUNTER_COUNT];
+    static std::map<std::string, Histogram> histograms;
+    static std::mutex histogramMutex;
+};
+
+#ifndef JSON_PARSER_NO_STATS
+#define JSON_STATS_ADD(counter, amount) Stats::add(Stats::counter, (amount))
+#define JSON_STATS_TIME_COMMAND(command) Stats::ScopedTimer statsTimer(command)
+#else
+#define JSON_STATS_ADD(counter, amount) ((void)0)
+#define JSON_STATS_TIME_COMMAND(command) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,284 @@
+// Micro-benchmarks for the lexer, parser and serializers over synthetic corpora.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -pthread -I. bench/Benchmark.cpp bench/CorpusGenerator.cpp $(ls *.cpp | grep -v main.cpp) -o json-bench -lz
+//
+// Add -DJSON_PARSER_HAVE_ZSTD and -lzstd to read and write zstd compressed documents.
+//
+// Usage:
+//   json-bench [--shape deep|wide|numbers|logs|mixed|all] [--size 1K,1M,64M]
+//              [--min-time <seconds>] [--out <results.json>]
+//   json-bench --emit <file> --shape <shape> --size <size>
+//
+// --emit streams a generated corpus to a file (sizes of several GB are fine) instead
+// of running the benchmarks. --out writes the results as JSON so runs can be compared.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+#include "Binding.h"
+#include "CorpusGenerator.h"
+#include "Parser.h"
+
+namespace
+{
+    /**
+     * Structure matching the records of the logs corpus, read through the Binding layer.
+     */
+    struct LogRecord
+    {
+        std::string timestamp;
+        std::string level;
+        std::string service;
+        std::string message;
+        int64_t id = 0;
+    };
+}
+
+template <>
+struct BindingFields<LogRecord>
+{
+    static constexpr auto fields = std::make_tuple(Field("timestamp", &LogRecord::timestamp), Field("level", &LogRecord::level),
+                                                   Field("service", &LogRecord::service), Field("message", &LogRecord::message),
+                                                   Field("id", &LogRecord::id));
+};
+
+namespace
+{
+    std::atomic<uint64_t> allocations(0);
+
+    /**
+     * Stream buffer which discards everything written to it.
+     */
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int c) override { return c; }
+        std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+    };
+
+    /**
+     * Structure holding the measurements of a single benchmark.
+     */
+    struct Result
+    {
+        std::string corpus;
+        std::string name;
+        uint64_t bytes;
+        uint64_t nodes;
+        uint64_t iterations;
+        double seconds;
+        uint64_t allocations;
+    };
+
+    uint64_t countNodes(const JSONValue &value)
+    {
+        uint64_t count = 1;
+        for (const auto &item : value.arrayValue)
+            count += countNodes(*item);
+        for (const auto &kv : value.objectValue)
+            count += countNodes(*kv.value);
+        return count;
+    }
+
+    Result measure(const std::string &corpus, const std::string &name, uint64_t bytes, uint64_t nodes, double minTime, const std::function<void()> &body)
+    {
+        uint64_t iterations = 0;
+        uint64_t allocationsBefore = allocations.load();
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0;
+        do
+        {
+            body();
+            iterations++;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < minTime);
+
+        return {corpus, name, bytes, nodes, iterations, elapsed, (allocations.load() - allocationsBefore) / iterations};
+    }
+
+    void report(const Result &result)
+    {
+        double perIteration = result.seconds / result.iterations;
+        std::cout << std::left << std::setw(14) << result.corpus << std::setw(16) << result.name
+                  << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << result.bytes / perIteration / (1024 * 1024) << " MB/s"
+                  << std::setw(12) << perIteration * 1e9 / result.nodes << " ns/node"
+                  << std::setw(14) << result.allocations << " allocs" << std::endl;
+    }
+
+    void writeResults(const std::vector<Result> &results, const std::string &filePath)
+    {
+        std::ofstream out(filePath);
+        out << "{\n  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result &result = results[i];
+            double perIteration = result.seconds / result.iterations;
+            out << "    {\"corpus\": \"" << result.corpus << "\", \"benchmark\": \"" << result.name << "\", \"bytes\": " << result.bytes
+                << ", \"nodes\": " << result.nodes << ", \"iterations\": " << result.iterations
+                << ", \"seconds_per_iteration\": " << std::setprecision(9) << perIteration
+                << ", \"mb_per_second\": " << result.bytes / perIteration / (1024 * 1024)
+                << ", \"ns_per_node\": " << perIteration * 1e9 / result.nodes
+                << ", \"allocations_per_iteration\": " << result.allocations << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    }
+
+    std::vector<std::string> split(const std::string &text, char separator)
+    {
+        std::vector<std::string> parts;
+        std::stringstream stream(text);
+        std::string part;
+        while (std::getline(stream, part, separator))
+            parts.push_back(part);
+        return parts;
+    }
+
+    void runCorpus(CorpusShape shape, uint64_t size, double minTime, std::vector<Result> &results)
+    {
+        CorpusGenerator generator;
+        std::string input = generator.generate(shape, size);
+        std::string corpus = CorpusGenerator::shapeName(shape) + "-" + std::to_string(input.size() / 1024) + "K";
+
+        Parser parser(input, "", InputFormat::JSON);
+        JSONValue &root = parser.getRoot();
+        uint64_t nodes = countNodes(root);
+        uint64_t bytes = input.size();
+
+        NullBuffer nullBuffer;
+        std::ostream nullStream(&nullBuffer);
+
+        std::vector<Result> corpusResults = {
+            measure(corpus, "lexer", bytes, nodes, minTime, [&]()
+                    {
+                Lexer lexer(input);
+                while (lexer.nextToken().type != TokenType::END)
+                {
+                } }),
+            measure(corpus, "parse", bytes, nodes, minTime, [&]()
+                    { Parser(input, "", InputFormat::JSON); }),
+            measure(corpus, "parse-strict", bytes, nodes, minTime, [&]()
+                    { StrictReader(input).parse(); }),
+            measure(corpus, "parse-lenient", bytes, nodes, minTime, [&]()
+                    { LenientReader(input).parse(); }),
+            measure(corpus, "validate", bytes, nodes, minTime, [&]()
+                    { parser.validate(); }),
+            measure(corpus, "searchKey", bytes, nodes, minTime, [&]()
+                    { parser.searchKey("name"); }),
+            measure(corpus, "contains", bytes, nodes, minTime, [&]()
+                    { parser.contains("value-that-is-not-there"); }),
+            measure(corpus, "writeJSON", bytes, nodes, minTime, [&]()
+                    { parser.writeJSON(nullStream, root, 0); }),
+            measure(corpus, "printJSON", bytes, nodes, minTime, [&]()
+                    {
+                std::streambuf *saved = std::cout.rdbuf(&nullBuffer);
+                parser.printJSON(root, 0);
+                std::cout.rdbuf(saved); }),
+        };
+
+        if (shape == CorpusShape::LOGS)
+        {
+            std::vector<LogRecord> records = Binding::read<std::vector<LogRecord>>(input);
+            corpusResults.push_back(measure(corpus, "bind", bytes, nodes, minTime, [&]()
+                                            { Binding::read<std::vector<LogRecord>>(input); }));
+            corpusResults.push_back(measure(corpus, "bind-write", bytes, nodes, minTime, [&]()
+                                            { Binding::write(nullStream, records); }));
+        }
+
+        for (const auto &result : corpusResults)
+        {
+            report(result);
+            results.push_back(result);
+        }
+    }
+}
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size == 0 ? 1 : size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+int main(int argc, char **argv)
+{
+    std::string shapes = "all";
+    std::string sizes = "1K,64K,1M";
+    std::string outPath;
+    std::string emitPath;
+    double minTime = 0.5;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if (option == "--shape")
+            shapes = argv[i + 1];
+        else if (option == "--size")
+            sizes = argv[i + 1];
+        else if (option == "--min-time")
+            minTime = std::stod(argv[i + 1]);
+        else if (option == "--out")
+            outPath = argv[i + 1];
+        else if (option == "--emit")
+            emitPath = argv[i + 1];
+        else
+        {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        std::vector<CorpusShape> selected;
+        for (const auto &name : split(shapes == "all" ? "deep,wide,numbers,logs,mixed" : shapes, ','))
+        {
+            CorpusShape shape;
+            if (!CorpusGenerator::parseShape(name, shape))
+            {
+                std::cerr << "Unknown shape: " << name << std::endl;
+                return 1;
+            }
+            selected.push_back(shape);
+        }
+
+        if (!emitPath.empty())
+        {
+            std::ofstream out(emitPath, std::ios::binary);
+            CorpusGenerator generator;
+            generator.generate(selected.front(), CorpusGenerator::parseSize(split(sizes, ',').front()), out);
+            return out ? 0 : 1;
+        }
+
+        std::vector<Result> results;
+        for (CorpusShape shape : selected)
+        {
+            for (const auto &size : split(sizes, ','))
+            {
+                runCorpus(shape, CorpusGenerator::parseSize(size), minTime, results);
+            }
+        }
+
+        if (!outPath.empty())
+        {
+            writeResults(results, outPath);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include <sstream>
+#include <stdexcept>
+
+#include "CorpusGenerator.h"
+
+CorpusGenerator::CorpusGenerator(uint64_t seed, size_t depth) : random(seed), depth(depth) {}
+
+void CorpusGenerator::generate(CorpusShape shape, uint64_t targetBytes, std::ostream &out)
+{
+    const size_t flushSize = 1 << 20;
+    std::string buffer;
+    buffer.reserve(flushSize + 4096);
+    uint64_t written = 0;
+
+    buffer += shape == CorpusShape::WIDE ? "{" : "[";
+    bool first = true;
+    while (written + buffer.size() + 2 < targetBytes || first)
+    {
+        if (!first)
+            buffer += ",";
+        first = false;
+
+        if (shape == CorpusShape::WIDE)
+        {
+            buffer += "\"key" + std::to_string(counter++) + "\":";
+        }
+        element(shape, buffer);
+
+        if (buffer.size() >= flushSize)
+        {
+            out.write(buffer.data(), buffer.size());
+            written += buffer.size();
+            buffer.clear();
+        }
+    }
+    buffer += shape == CorpusShape::WIDE ? "}" : "]";
+    out.write(buffer.data(), buffer.size());
+}
+
+std::string CorpusGenerator::generate(CorpusShape shape, uint64_t targetBytes)
+{
+    std::ostringstream out;
+    generate(shape, targetBytes, out);
+    return out.str();
+}
+
+bool CorpusGenerator::parseShape(const std::string &name, CorpusShape &shape)
+{
+    static const CorpusShape shapes[] = {CorpusShape::DEEP, CorpusShape::WIDE, CorpusShape::NUMBERS, CorpusShape::LOGS, CorpusShape::MIXED};
+    for (CorpusShape candidate : shapes)
+    {
+        if (shapeName(candidate) == name)
+        {
+            shape = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string CorpusGenerator::shapeName(CorpusShape shape)
+{
+    switch (shape)
+    {
+    case CorpusShape::DEEP:
+        return "deep";
+    case CorpusShape::WIDE:
+        return "wide";
+    case CorpusShape::NUMBERS:
+        return "numbers";
+    case CorpusShape::LOGS:
+        return "logs";
+    case CorpusShape::MIXED:
+        return "mixed";
+    }
+    return "";
+}
+
+uint64_t CorpusGenerator::parseSize(const std::string &text)
+{
+    size_t used = 0;
+    double value = std::stod(text, &used);
+    std::string suffix = text.substr(used);
+    if (suffix == "" || suffix == "B")
+        return static_cast<uint64_t>(value);
+    if (suffix == "K" || suffix == "KB")
+        return static_cast<uint64_t>(value * 1024);
+    if (suffix == "M" || suffix == "MB")
+        return static_cast<uint64_t>(value * 1024 * 1024);
+    if (suffix == "G" || suffix == "GB")
+        return static_cast<uint64_t>(value * 1024 * 1024 * 1024);
+    throw std::runtime_error("Invalid size: " + text);
+}
+
+void CorpusGenerator::element(CorpusShape shape, std::string &buffer)
+{
+    switch (shape)
+    {
+    case CorpusShape::DEEP:
+        for (size_t i = 0; i < depth; i++)
+            buffer += i % 2 == 0 ? "{\"level\":" : "[";
+        buffer += std::to_string(counter++);
+        for (size_t i = depth; i > 0; i--)
+            buffer += (i - 1) % 2 == 0 ? "}" : "]";
+        break;
+    case CorpusShape::WIDE:
+    case CorpusShape::NUMBERS:
+        buffer += std::to_string(static_cast<int64_t>(random() % 2000000) - 1000000);
+        if (random() % 2 == 0)
+        {
+            buffer += "." + std::to_string(random() % 1000);
+        }
+        break;
+    case CorpusShape::LOGS:
+        buffer += "{\"timestamp\":\"2024-01-01T00:00:" + std::to_string(counter % 60) + "Z\",\"level\":\"";
+        buffer += random() % 10 == 0 ? "error" : "info";
+        buffer += "\",\"service\":\"svc-" + std::to_string(random() % 16) + "\",\"message\":\"";
+        for (size_t words = 3 + random() % 12; words > 0; words--)
+        {
+            word(buffer, 2 + random() % 9);
+            if (words > 1)
+                buffer += " ";
+        }
+        buffer += "\",\"id\":" + std::to_string(counter++) + "}";
+        break;
+    case CorpusShape::MIXED:
+        switch (counter % 4)
+        {
+        case 0:
+            element(CorpusShape::LOGS, buffer);
+            break;
+        case 1:
+            buffer += "[";
+            for (int i = 0; i < 8; i++)
+            {
+                if (i > 0)
+                    buffer += ",";
+                element(CorpusShape::NUMBERS, buffer);
+            }
+            buffer += "]";
+            counter++;
+            break;
+        case 2:
+            buffer += "{\"name\":\"";
+            word(buffer, 8);
+            buffer += "\",\"enabled\":" + std::string(random() % 2 ? "true" : "false") + ",\"parent\":null,\"tags\":[\"a\",\"b\"]}";
+            counter++;
+            break;
+        default:
+        {
+            size_t saved = depth;
+            depth = 8;
+            element(CorpusShape::DEEP, buffer);
+            depth = saved;
+            break;
+        }
+        }
+        break;
+    }
+}
+
+void CorpusGenerator::word(std::string &buffer, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        buffer += static_cast<char>('a' + random() % 26);
+    }
+}
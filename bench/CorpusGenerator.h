@@ -0,0 +1,96 @@
+#ifndef CORPUS_GENERATOR_H
+#define CORPUS_GENERATOR_H
+
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Enum representing the shape of a synthetic JSON corpus.
+ */
+enum class CorpusShape
+{
+    DEEP,
+    WIDE,
+    NUMBERS,
+    LOGS,
+    MIXED
+};
+
+/**
+ * Class responsible for generating synthetic JSON documents of a requested shape and size.
+ * Output is streamed, so corpora of several gigabytes can be written to a file without
+ * holding them in memory.
+ */
+class CorpusGenerator
+{
+public:
+    /**
+     * Constructs a CorpusGenerator with a fixed seed, so runs are reproducible.
+     * @param seed Random seed.
+     * @param depth Nesting depth used by the DEEP shape.
+     */
+    CorpusGenerator(uint64_t seed = 42, size_t depth = 64);
+
+    /**
+     * Writes a document of roughly the given size.
+     * @param shape Shape of the document.
+     * @param targetBytes Approximate size of the document in bytes.
+     * @param out Output stream.
+     */
+    void generate(CorpusShape shape, uint64_t targetBytes, std::ostream &out);
+
+    /**
+     * Generates a document of roughly the given size in memory.
+     * @param shape Shape of the document.
+     * @param targetBytes Approximate size of the document in bytes.
+     * @return The document.
+     */
+    std::string generate(CorpusShape shape, uint64_t targetBytes);
+
+    /**
+     * Parses a shape name (deep, wide, numbers, logs, mixed).
+     * @param name Shape name.
+     * @param shape Parsed shape.
+     * @return True if the name is known, false otherwise.
+     */
+    static bool parseShape(const std::string &name, CorpusShape &shape);
+
+    /**
+     * Gets the name of a shape.
+     * @param shape Shape.
+     * @return Shape name.
+     */
+    static std::string shapeName(CorpusShape shape);
+
+    /**
+     * Parses a size such as 512, 64K, 10M or 2G.
+     * @param text Size text.
+     * @return Size in bytes.
+     */
+    static uint64_t parseSize(const std::string &text);
+
+private:
+    /**
+     * Writes one element of the top-level array for the given shape.
+     * @param shape Shape of the document.
+     * @param buffer Output buffer.
+     */
+    void element(CorpusShape shape, std::string &buffer);
+
+    /**
+     * Appends a random word.
+     * @param buffer Output buffer.
+     * @param length Length of the word.
+     */
+    void word(std::string &buffer, size_t length);
+
+private:
+    std::mt19937_64 random;
+    size_t depth;
+    uint64_t counter = 0;
+};
+
+#endif
@@ -0,0 +1,292 @@
+// Replays Engine command traces against a document of a given size and reports
+// per-command latency percentiles and overall throughput.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -pthread -I. bench/LoadTester.cpp bench/CorpusGenerator.cpp $(ls *.cpp | grep -v main.cpp) -o json-load -lz
+//
+// Add -DJSON_PARSER_HAVE_ZSTD and -lzstd to read and write zstd compressed documents.
+//
+// Usage:
+//   json-load [--size 1M] [--commands 2000] [--seed 42] [--trace <file>] [--out <results.json>]
+//             [--mix set=30,create=10,delete=8,move=5,search=15,contains=15,print=2,save=5,validate=5,reload=2]
+//   json-load --generate <trace-file> [--size ...] [--commands ...] [--mix ...]
+//
+// Without --trace a trace is generated against a wide document of the requested size;
+// traces recorded in the Engine with "record <file>" can be replayed with --trace, in
+// which case the trace should open its own document. Engine output is suppressed
+// while replaying. A reload entry is not an Engine command: the tester appends a newline to
+// the open document's file, as another process editing it would, and times a docs command,
+// which notices the change and reloads the file, reusing its unchanged members.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+
+#include "CorpusGenerator.h"
+#include "Engine.h"
+
+namespace
+{
+    /**
+     * Stream buffer which discards everything written to it.
+     */
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int c) override { return c; }
+        std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+    };
+
+    /**
+     * Class generating realistic command mixes which stay valid as the document changes.
+     */
+    class TraceGenerator
+    {
+    public:
+        TraceGenerator(const std::vector<std::string> &keys, const std::map<std::string, int> &mix, uint64_t seed)
+            : keys(keys), random(seed)
+        {
+            for (const auto &entry : mix)
+            {
+                commands.push_back(entry.first);
+                weights.push_back(entry.second);
+            }
+        }
+
+        std::string next()
+        {
+            std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+            const std::string &command = commands[pick(random)];
+            if (command == "set")
+                return "set " + anyKey() + " " + std::to_string(random() % 100000);
+            if (command == "create")
+            {
+                keys.push_back("created" + std::to_string(counter++));
+                return "create " + keys.back() + " \"value\"";
+            }
+            if (command == "delete" && keys.size() > 1)
+                return "delete " + takeKey();
+            if (command == "move" && keys.size() > 1)
+            {
+                std::string from = takeKey();
+                keys.push_back("moved" + std::to_string(counter++));
+                return "move " + from + " " + keys.back();
+            }
+            if (command == "search")
+                return "search " + anyKey();
+            if (command == "contains")
+                return "contains value-" + std::to_string(random() % 1000);
+            if (command == "save")
+                return "save";
+            if (command == "print")
+                return "print";
+            if (command == "reload")
+                return "reload";
+            return "validate";
+        }
+
+    private:
+        std::string anyKey()
+        {
+            return keys[random() % keys.size()];
+        }
+
+        std::string takeKey()
+        {
+            size_t index = random() % keys.size();
+            std::string key = keys[index];
+            keys[index] = keys.back();
+            keys.pop_back();
+            return key;
+        }
+
+        std::vector<std::string> keys;
+        std::vector<std::string> commands;
+        std::vector<int> weights;
+        std::mt19937_64 random;
+        uint64_t counter = 0;
+    };
+
+    std::map<std::string, int> parseMix(const std::string &text)
+    {
+        std::map<std::string, int> mix;
+        std::stringstream stream(text);
+        std::string part;
+        while (std::getline(stream, part, ','))
+        {
+            size_t pos = part.find('=');
+            if (pos == std::string::npos)
+                throw std::runtime_error("Invalid mix entry: " + part);
+            mix[part.substr(0, pos)] = std::stoi(part.substr(pos + 1));
+        }
+        return mix;
+    }
+
+    double percentile(std::vector<double> &samples, double fraction)
+    {
+        size_t index = std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+        std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+        return samples[index];
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string size = "1M";
+    std::string mixText = "set=30,create=10,delete=8,move=5,search=15,contains=15,print=2,save=5,validate=5,reload=2";
+    std::string tracePath;
+    std::string generatePath;
+    std::string outPath;
+    size_t commandCount = 2000;
+    uint64_t seed = 42;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if (option == "--size")
+            size = argv[i + 1];
+        else if (option == "--commands")
+            commandCount = std::stoull(argv[i + 1]);
+        else if (option == "--seed")
+            seed = std::stoull(argv[i + 1]);
+        else if (option == "--mix")
+            mixText = argv[i + 1];
+        else if (option == "--trace")
+            tracePath = argv[i + 1];
+        else if (option == "--generate")
+            generatePath = argv[i + 1];
+        else if (option == "--out")
+            outPath = argv[i + 1];
+        else
+        {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        std::vector<std::string> trace;
+        std::string documentPath = "load-test-document.json";
+        if (tracePath.empty())
+        {
+            std::ofstream document(documentPath, std::ios::binary);
+            CorpusGenerator generator(seed);
+            generator.generate(CorpusShape::WIDE, CorpusGenerator::parseSize(size), document);
+            document.close();
+
+            std::ifstream input(documentPath);
+            std::string text((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+            std::vector<std::string> keys;
+            Parser parser(text, documentPath, InputFormat::JSON);
+            for (const auto &kv : parser.getRoot().objectValue)
+                keys.push_back(kv.key);
+
+            TraceGenerator traceGenerator(keys, parseMix(mixText), seed);
+            trace.push_back("open " + documentPath);
+            for (size_t i = 0; i < commandCount; i++)
+                trace.push_back(traceGenerator.next());
+        }
+        else
+        {
+            std::ifstream input(tracePath);
+            std::string line;
+            while (std::getline(input, line))
+            {
+                if (!line.empty())
+                    trace.push_back(line);
+            }
+        }
+
+        if (!generatePath.empty())
+        {
+            std::ofstream out(generatePath);
+            for (const auto &command : trace)
+                out << command << "\n";
+            return 0;
+        }
+
+        std::map<std::string, std::vector<double>> latencies;
+        NullBuffer nullBuffer;
+        std::streambuf *savedOut = std::cout.rdbuf(&nullBuffer);
+        std::streambuf *savedErr = std::cerr.rdbuf(&nullBuffer);
+
+        Engine engine;
+        std::string openPath = documentPath;
+        std::string openName = documentPath;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto &command : trace)
+        {
+            if (command.rfind("open ", 0) == 0)
+            {
+                openPath = command.substr(5);
+                while (openPath.rfind("--", 0) == 0)
+                    openPath = openPath.substr(openPath.find(' ') + 1);
+                size_t as = openPath.find(" as ");
+                openName = as == std::string::npos ? openPath : openPath.substr(as + 4);
+                openPath = openPath.substr(0, as);
+            }
+            if (command == "reload")
+            {
+                // use waits for the saves in flight, which would otherwise overwrite the change unseen.
+                engine.executeCommand("use " + openName);
+                std::ofstream(openPath, std::ios::app) << "\n";
+            }
+
+            auto commandStart = std::chrono::steady_clock::now();
+            engine.executeCommand(command == "reload" ? "docs" : command);
+            double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - commandStart).count();
+            latencies[command.substr(0, command.find(' '))].push_back(micros);
+        }
+        double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout.rdbuf(savedOut);
+        std::cerr.rdbuf(savedErr);
+
+        std::ostringstream json;
+        json << "{\n  \"document_size\": \"" << size << "\", \"commands\": " << trace.size()
+             << ", \"seconds\": " << total << ", \"commands_per_second\": " << trace.size() / total << ",\n  \"latency_us\": {\n";
+
+        std::cout << std::left << std::setw(10) << "command" << std::right << std::setw(8) << "count"
+                  << std::setw(12) << "p50 us" << std::setw(12) << "p90 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::endl;
+        size_t printed = 0;
+        for (auto &entry : latencies)
+        {
+            std::vector<double> &samples = entry.second;
+            double p50 = percentile(samples, 0.50);
+            double p90 = percentile(samples, 0.90);
+            double p99 = percentile(samples, 0.99);
+            double max = *std::max_element(samples.begin(), samples.end());
+            std::cout << std::left << std::setw(10) << entry.first << std::right << std::setw(8) << samples.size() << std::fixed << std::setprecision(1)
+                      << std::setw(12) << p50 << std::setw(12) << p90 << std::setw(12) << p99 << std::setw(12) << max << std::endl;
+            json << "    \"" << entry.first << "\": {\"count\": " << samples.size() << ", \"p50\": " << p50 << ", \"p90\": " << p90
+                 << ", \"p99\": " << p99 << ", \"max\": " << max << "}" << (++printed < latencies.size() ? ",\n" : "\n");
+        }
+        json << "  }\n}\n";
+        std::cout << "Total: " << trace.size() << " commands in " << std::setprecision(3) << total << " s ("
+                  << std::setprecision(1) << trace.size() / total << " commands/s)" << std::endl;
+
+        if (!outPath.empty())
+        {
+            std::ofstream out(outPath);
+            out << json.str();
+        }
+        if (tracePath.empty())
+        {
+            std::remove(documentPath.c_str());
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -3,8 +3,9 @@
 
 #include "Parser.h"
 #include "Engine.h"
+#include "Server.h"
 
-int main()
+int main(int argc, char **argv)
 {
     // Sample commands for execution [open example.json]
     // create newPath "newValue"
@@ -13,10 +14,24 @@ int main()
     // move management newPath
     // saveas a.json newPath
 
+    // Server mode: json --serve <socket> [<file>...], client: json --connect <socket>
     try
     {
-        Engine engine;
-        engine.prompt();
+        std::string mode = argc > 2 ? argv[1] : "";
+        if (mode == "--serve")
+        {
+            Server server(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+            server.run();
+        }
+        else if (mode == "--connect")
+        {
+            return Server::connect(argv[2], std::cin, std::cout);
+        }
+        else
+        {
+            Engine engine;
+            engine.prompt();
+        }
     }
     catch (const std::exception &e)
     {